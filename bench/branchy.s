@@ -0,0 +1,33 @@
+# Data dependent branches on the bits of an xorshift generator
+.text
+.globl _start
+_start:
+	li t0, 20000000 # iterations
+	li t1, 88172645463325252 # xorshift state
+	li t2, 0
+1:
+	slli t3, t1, 13
+	xor t1, t1, t3
+	srli t3, t1, 7
+	xor t1, t1, t3
+	slli t3, t1, 17
+	xor t1, t1, t3
+	andi t4, t1, 1
+	beqz t4, 2f
+	addi t2, t2, 3
+2:
+	andi t4, t1, 6
+	bnez t4, 3f
+	xori t2, t2, 5
+3:
+	blt t1, zero, 4f
+	addi t2, t2, -1
+4:
+	addi t0, t0, -1
+	bnez t0, 1b
+
+	li a0, 3
+	mv a1, t2
+	ecall
+	li a0, 7
+	ecall
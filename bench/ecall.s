@@ -0,0 +1,23 @@
+# Console heavy guest: short strings, chars and numbers through the ecalls
+.text
+.globl _start
+_start:
+	li s0, 200000 # lines
+1:
+	li a0, 1
+	la a1, msg
+	ecall
+	li a0, 0
+	mv a1, s0
+	ecall
+	li a0, 2
+	li a1, '\n'
+	ecall
+	addi s0, s0, -1
+	bnez s0, 1b
+
+	li a0, 7
+	ecall
+
+.data
+msg: .string "line "
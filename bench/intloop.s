@@ -0,0 +1,25 @@
+# Integer ALU loop: add, xor, shifts and compares on registers only
+.text
+.globl _start
+_start:
+	li t0, 50000000 # iterations
+	li t1, 0x9e3779b9
+	li t2, 1
+	li t3, 0
+1:
+	add t3, t3, t1
+	xor t2, t2, t3
+	slli t4, t2, 7
+	srli t5, t3, 3
+	or t4, t4, t5
+	sub t3, t3, t4
+	sltu t6, t3, t2
+	add t2, t2, t6
+	addi t0, t0, -1
+	bnez t0, 1b
+
+	li a0, 3 # print the checksum
+	mv a1, t3
+	ecall
+	li a0, 7
+	ecall
@@ -0,0 +1,45 @@
+# Copy 1MB back and forth with doubleword loads and stores
+.text
+.globl _start
+_start:
+	li s0, 0x80100000 # src
+	li s1, 0x80200000 # dst
+	li s2, 0x100000 # bytes
+	li s3, 100 # passes
+
+	mv t0, s0 # fill the source
+	add t1, s0, s2
+	li t2, 0x0123456789abcdef
+1:
+	sd t2, 0(t0)
+	addi t2, t2, 1
+	addi t0, t0, 8
+	bltu t0, t1, 1b
+
+2:
+	mv t0, s0
+	mv t1, s1
+	add t2, s0, s2
+3:
+	ld t3, 0(t0)
+	ld t4, 8(t0)
+	ld t5, 16(t0)
+	ld t6, 24(t0)
+	sd t3, 0(t1)
+	sd t4, 8(t1)
+	sd t5, 16(t1)
+	sd t6, 24(t1)
+	addi t0, t0, 32
+	addi t1, t1, 32
+	bltu t0, t2, 3b
+	mv t0, s0 # swap the direction
+	mv s0, s1
+	mv s1, t0
+	addi s3, s3, -1
+	bnez s3, 2b
+
+	li a0, 3
+	ld a1, 8(s1)
+	ecall
+	li a0, 7
+	ecall
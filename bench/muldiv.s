@@ -0,0 +1,27 @@
+# Multiply, divide and remainder chains
+.text
+.globl _start
+_start:
+	li t0, 10000000 # iterations
+	li t1, 0x123456789
+	li t2, 7
+	li t3, 0
+1:
+	mul t4, t1, t2
+	mulh t5, t1, t4
+	divu t6, t4, t2
+	rem a2, t4, t0
+	mulw a3, t6, t2
+	divw a4, a3, t2
+	add t3, t3, t5
+	add t3, t3, a2
+	xor t3, t3, a4
+	addi t1, t1, 3
+	addi t0, t0, -1
+	bnez t0, 1b
+
+	li a0, 3
+	mv a1, t3
+	ecall
+	li a0, 7
+	ecall
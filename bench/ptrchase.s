@@ -0,0 +1,38 @@
+# Chase pointers through 4MB in a full period LCG order, every load depends on the last one
+.text
+.globl _start
+_start:
+	li s0, 0x80100000 # nodes, 8 bytes each
+	li s1, 0x80000 # nodes, a power of two
+	addi s2, s1, -1 # index mask
+	li s3, 1103515245 # a = 1 mod 4 and odd c give the full period
+	li s4, 12345
+
+	li t0, 0 # node[i] = &node[(a * i + c) mod n]
+1:
+	mul t1, t0, s3
+	add t1, t1, s4
+	and t1, t1, s2
+	slli t1, t1, 3
+	add t1, t1, s0
+	slli t2, t0, 3
+	add t2, t2, s0
+	sd t1, 0(t2)
+	addi t0, t0, 1
+	bltu t0, s1, 1b
+
+	li t0, 20000000 # steps
+	mv t1, s0
+2:
+	ld t1, 0(t1)
+	ld t1, 0(t1)
+	ld t1, 0(t1)
+	ld t1, 0(t1)
+	addi t0, t0, -4
+	bnez t0, 2b
+
+	li a0, 3
+	mv a1, t1
+	ecall
+	li a0, 7
+	ecall
@@ -0,0 +1,33 @@
+#!/bin/sh
+# Usage: run.sh <frv> [baseline.json] > results.json
+# Runs every kernel with --stats, the JSON goes to stdout and a summary to stderr
+FRV=$1
+BASE=$2
+DIR=$(dirname "$0")
+KERNELS="intloop memcpy ptrchase muldiv branchy ecall"
+
+[ -x "$FRV" ] || { echo "Usage: $0 <frv> [baseline.json]" >&2; exit 1; }
+echo "["
+sep=""
+for k in $KERNELS; do
+	# The stats are the last line on stderr, the guest output is not needed
+	stats=$("$FRV" --stats "$DIR/$k.bin" 2>&1 >/dev/null | tail -n 1)
+	case "$stats" in
+	"{"*) ;;
+	*) echo "$k failed: $stats" >&2; exit 1 ;;
+	esac
+	printf '%s  {"kernel": "%s", "stats": %s}' "$sep" "$k" "$stats"
+	sep=",
+"
+	mips=$(echo "$stats" | sed 's/.*"mips": \([0-9.]*\).*/\1/')
+	ns=$(echo "$stats" | sed 's/.*"ns_per_inst": \([0-9.]*\).*/\1/')
+	misses=$(echo "$stats" | sed 's/.*"cache_misses": \([0-9a-z]*\).*/\1/')
+	line=$(printf '%-10s %10s MIPS %8s ns/inst %14s cache misses' "$k" "$mips" "$ns" "$misses")
+	# One kernel per line in the baseline, as written here
+	if [ -n "$BASE" ]; then
+		old=$(grep "\"kernel\": \"$k\"" "$BASE" | sed 's/.*"mips": \([0-9.]*\).*/\1/')
+		[ -n "$old" ] && line="$line $(awk "BEGIN { printf \"%+.1f%% vs baseline\", ($mips / $old - 1) * 100 }")"
+	fi
+	echo "$line" >&2
+done
+printf '\n]\n'
@@ -0,0 +1,188 @@
+#define _DEFAULT_SOURCE // open_memstream
+
+#include <pthread.h>
+
+#include "batch.h"
+
+struct FrvBatchJob {
+	const char*	path;
+	char*		out; // Captured output of the guest
+	size_t		outlen;
+	bool		ok; // Loaded and ended by the guest itself, see halted of struct FrvCPU
+	int64_t		status; // Exit status of the guest, only a Linux one sets it
+};
+
+/* The jobs are split into one range per worker, packed as next | end << 32 so a single
+ * compare-and-swap moves either end. Owners take from the front, thieves take half from the back
+ */
+struct FrvBatch {
+	struct FrvBatchJob*	jobs;
+	uint64_t		njobs;
+	uint64_t*		ranges;
+	uint64_t		nworkers;
+	uint64_t		ramsize;
+};
+
+struct FrvBatchWorker {
+	struct FrvBatch*	batch;
+	uint64_t		id;
+	bool			ok;
+};
+
+static inline uint64_t frvBatchPack(const uint64_t next, const uint64_t end)
+{
+	return next | (end << 32);
+}
+
+// Index of the next job of the worker, false once there is nothing left to take anywhere
+static bool frvBatchNext(struct FrvBatch* batch, const uint64_t id, uint64_t* job)
+{
+	uint64_t* own = &batch->ranges[id];
+	uint64_t range = __atomic_load_n(own, __ATOMIC_ACQUIRE);
+	while ((range & 0xffffffff) < (range >> 32)) {
+		if (__atomic_compare_exchange_n(own, &range, range + 1, true, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+			*job = range & 0xffffffff;
+			return true;
+		}
+	}
+
+	for (uint64_t i = 1; i < batch->nworkers; i++) {
+		uint64_t* victim = &batch->ranges[(id + i) % batch->nworkers];
+		range = __atomic_load_n(victim, __ATOMIC_ACQUIRE);
+		while ((range & 0xffffffff) < (range >> 32)) {
+			const uint64_t next = range & 0xffffffff, end = range >> 32;
+			const uint64_t first = end - (end - next + 1) / 2;
+			if (__atomic_compare_exchange_n(victim, &range, frvBatchPack(next, first), true,
+							__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+				__atomic_store_n(own, frvBatchPack(first + 1, end), __ATOMIC_RELEASE);
+				*job = first;
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+static void frvBatchRunJob(struct FrvRAM* ram, struct FrvBatchJob* job)
+{
+	FILE* out = open_memstream(&job->out, &job->outlen);
+	if (!out) {
+		fprintf(stderr, "Failed to capture the output of %s: %s\n", job->path, strerror(errno));
+		return;
+	}
+
+	struct FrvBUS bus = frvNewBus(ram);
+	struct FrvCLINT clint = frvNewClint();
+	if (frvIsBusValid(&bus) && frvClintAttach(&clint, &bus)) {
+		struct FrvCPU cpu;
+		frvCpuInit(&cpu, &bus, 0);
+		cpu.out = out;
+		if (frvIsCpuValid(&cpu) && frvCpuLoadProgram(&cpu, job->path)) {
+			frvCpuRun(&cpu);
+			job->ok = cpu.halted;
+			job->status = (cpu.env == FRV_ENV_LINUX) ? cpu.sys.status : 0;
+		}
+		frvCpuDestroy(&cpu);
+	}
+	frvBusDestroy(&bus);
+	fclose(out);
+}
+
+// Every worker keeps one RAM for all of its jobs, only the pages a guest wrote are wiped after it
+static void* frvBatchWorkerThread(void* arg)
+{
+	struct FrvBatchWorker* worker = arg;
+	struct FrvBatch* batch = worker->batch;
+	struct FrvRAM ram = frvNewLazyRam(batch->ramsize, false);
+	if (!frvIsRamValid(&ram) || !frvRamTrackDirty(&ram)) {
+		frvRamDestroy(&ram);
+		return NULL;
+	}
+
+	uint64_t job;
+	worker->ok = true;
+	while (worker->ok && frvBatchNext(batch, worker->id, &job)) {
+		frvBatchRunJob(&ram, &batch->jobs[job]);
+		worker->ok = frvRamReset(&ram);
+	}
+	frvRamDestroy(&ram);
+	return NULL;
+}
+
+// Split the manifest into paths in place, jobs has room for a path per line
+static uint64_t frvBatchParse(char* text, struct FrvBatchJob* jobs)
+{
+	uint64_t njobs = 0;
+	for (char* line = strtok(text, "\n"); line; line = strtok(NULL, "\n")) {
+		while (*line == ' ' || *line == '\t') line++;
+		char* end = line + strlen(line);
+		while (end > line && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r')) *--end = '\0';
+		if (*line && *line != '#') jobs[njobs++].path = line;
+	}
+	return njobs;
+}
+
+bool frvBatchRun(const char* manifest, const uint64_t nworkers, const uint64_t ramsize)
+{
+	const int64_t size = frvReadFileToBuf(manifest, NULL, 0, false);
+	if (size < 0) return false;
+	char* text = malloc(size + 1);
+	if (!text) {
+		fprintf(stderr, "Failed to read the manifest: %s\n", strerror(errno));
+		return false;
+	}
+	if (frvReadFileToBuf(manifest, (uint8_t*)text, size + 1, false) < 0) {
+		free(text);
+		return false;
+	}
+
+	uint64_t lines = 1;
+	for (const char* c = text; *c; c++) lines += (*c == '\n');
+	struct FrvBatch batch = { .nworkers = nworkers, .ramsize = ramsize };
+	batch.jobs = calloc(lines, sizeof(struct FrvBatchJob));
+	batch.ranges = calloc(nworkers, sizeof(uint64_t));
+	struct FrvBatchWorker* workers = calloc(nworkers, sizeof(struct FrvBatchWorker));
+	pthread_t* threads = calloc(nworkers, sizeof(pthread_t));
+	bool ok = batch.jobs && batch.ranges && workers && threads && lines <= UINT32_MAX;
+	if (!ok) fprintf(stderr, "Failed to set up the batch: %s\n", (lines > UINT32_MAX) ? "too many jobs" : strerror(errno));
+
+	// The workers that do not start have their share stolen by the others
+	uint64_t started = 0;
+	if (ok) {
+		batch.njobs = frvBatchParse(text, batch.jobs);
+		for (uint64_t i = 0; i < nworkers; i++)
+			batch.ranges[i] = frvBatchPack(batch.njobs * i / nworkers, batch.njobs * (i + 1) / nworkers);
+		for (; started < nworkers; started++) {
+			workers[started] = (struct FrvBatchWorker) { .batch = &batch, .id = started };
+			const int err = pthread_create(&threads[started], NULL, frvBatchWorkerThread, &workers[started]);
+			if (err) {
+				fprintf(stderr, "Failed to start batch worker %lu: %s\n", started, strerror(err));
+				break;
+			}
+		}
+	}
+	bool done = (started > 0);
+	for (uint64_t i = 0; i < started; i++) {
+		pthread_join(threads[i], NULL);
+		done = done && workers[i].ok;
+	}
+
+	// Like a single run, the batch fails when any guest failed or exited non-zero
+	for (uint64_t i = 0; i < batch.njobs; i++) {
+		const struct FrvBatchJob* job = &batch.jobs[i];
+		if (job->ok) printf("==> %s (exit %ld) <==\n", job->path, job->status);
+		else printf("==> %s (failed) <==\n", job->path);
+		done = done && job->ok && !job->status;
+		if (job->outlen) {
+			fwrite(job->out, 1, job->outlen, stdout);
+			if (job->out[job->outlen - 1] != '\n') putchar('\n');
+		}
+		free(job->out);
+	}
+	free(batch.jobs);
+	free(batch.ranges);
+	free(workers);
+	free(threads);
+	free(text);
+	return ok && done;
+}
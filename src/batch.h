@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "cpu.h"
+
+/* Run every binary listed in the manifest (one path per line, # starts a comment)
+ * on nworkers host threads, each guest on a single hart with ramsize bytes of RAM
+ * The output of the guests is captured and printed in manifest order once all are done,
+ * each behind a header with its exit status. False if any of them failed or exited non-zero
+ */
+bool frvBatchRun(const char* manifest, const uint64_t nworkers, const uint64_t ramsize);
@@ -2,34 +2,154 @@
 
 struct FrvBUS frvNewBus(struct FrvRAM* ram)
 {
-	return (struct FrvBUS) {
-		.ram = ram
+	struct FrvBUS bus = { 0 };
+	bus.ram = ram;
+
+	const struct FrvRegion region = {
+		.base = FRV_RAM_BASE_ADDR,
+		.size = ram->size,
+		.type = FRV_REGION_RAM,
+		.bytes = ram->bytes
 	};
+	if (!frvBusAddRegion(&bus, &region)) fprintf(stderr, "Failed to create a new FrvBUS\n");
+	return bus;
+}
+
+bool frvIsBusValid(const struct FrvBUS* const bus)
+{
+	return (bus->nregions > 0);
+}
+
+void frvBusDestroy(struct FrvBUS* bus)
+{
+	for (uint32_t i = 0; i < FRV_BUS_MAP_SIZE; i++)
+		free(bus->map[i]);
+}
+
+void frvBusFlushTlb(struct FrvTlbEntry* tlb)
+{
+	for (uint32_t i = 0; i < FRV_BUS_TLB_SIZE; i++)
+		tlb[i].page = FRV_BUS_TLB_EMPTY;
 }
 
-bool frvBusLoad(const struct FrvBUS* const bus, const uint64_t addr, const uint64_t size, uint64_t* dest)
+bool frvBusAddRegion(struct FrvBUS* bus, const struct FrvRegion* const region)
 {
-	if (addr < FRV_RAM_BASE_ADDR) {
-		fprintf(stderr, "FrvBUS->FrvRAM load failed: illegal access\n");
+	const uint64_t first = region->base >> FRV_BUS_PAGE_SHIFT;
+	const uint64_t last = (region->base + region->size - 1) >> FRV_BUS_PAGE_SHIFT;
+
+	if (bus->nregions == FRV_BUS_MAX_REGIONS) {
+		fprintf(stderr, "FrvBUS add region failed: too many regions\n");
 		return false;
 	}
-	return frvRamLoad(bus->ram, addr, size, dest);
+	if (!region->size || (region->base | region->size) & FRV_BUS_PAGE_MASK) {
+		fprintf(stderr, "FrvBUS add region failed: region is not page aligned\n");
+		return false;
+	}
+	if (last < first || (last >> FRV_BUS_MAP_BITS) >= FRV_BUS_MAP_SIZE) {
+		fprintf(stderr, "FrvBUS add region failed: out of the physical address space\n");
+		return false;
+	}
+	if (region->type == FRV_REGION_MMIO ? !region->mmio.load || !region->mmio.store : !region->bytes) {
+		fprintf(stderr, "FrvBUS add region failed: region has no backing\n");
+		return false;
+	}
+
+	// Allocate the second level tables and check for overlaps before touching anything
+	for (uint64_t page = first; page <= last; page++) {
+		uint8_t** table = &bus->map[page >> FRV_BUS_MAP_BITS];
+		if (!*table && !(*table = calloc(1 << FRV_BUS_MAP_BITS, sizeof(uint8_t)))) {
+			fprintf(stderr, "FrvBUS add region failed: %s\n", strerror(errno));
+			return false;
+		}
+		if ((*table)[page & ((1 << FRV_BUS_MAP_BITS) - 1)]) {
+			fprintf(stderr, "FrvBUS add region failed: overlapping regions\n");
+			return false;
+		}
+	}
+
+	bus->regions[bus->nregions++] = *region;
+	for (uint64_t page = first; page <= last; page++)
+		bus->map[page >> FRV_BUS_MAP_BITS][page & ((1 << FRV_BUS_MAP_BITS) - 1)] = bus->nregions;
+	return true;
 }
 
-bool frvBusLoadInst(const struct FrvBUS* const bus, const uint64_t addr, uint32_t* dest)
+/* Walk the page table on a TLB miss and refill the entry, NULL if nothing is mapped at addr
+ * The RAM is checked by range before getting here, only ROM and devices go through the TLB
+ */
+static const struct FrvRegion* frvBusLookup(const struct FrvBUS* const bus, struct FrvTlbEntry* tlb, const uint64_t addr)
 {
-	if (addr < FRV_RAM_BASE_ADDR) {
-		fprintf(stderr, "FrvBUS->FrvRAM load failed: illegal access\n");
-		return false;
+	const uint64_t page = addr >> FRV_BUS_PAGE_SHIFT;
+	struct FrvTlbEntry* e = &tlb[page & (FRV_BUS_TLB_SIZE - 1)];
+	if (e->page == page) return &bus->regions[e->region];
+
+	const uint8_t* table = ((page >> FRV_BUS_MAP_BITS) < FRV_BUS_MAP_SIZE) ? bus->map[page >> FRV_BUS_MAP_BITS] : NULL;
+	const uint8_t idx = table ? table[page & ((1 << FRV_BUS_MAP_BITS) - 1)] : 0;
+	if (!idx) return NULL;
+
+	e->page = page;
+	e->region = idx - 1;
+	return &bus->regions[idx - 1];
+}
+
+bool frvBusLoad(const struct FrvBUS* const bus, struct FrvTlbEntry* tlb, const uint64_t addr, const uint64_t size,
+		uint64_t* dest)
+{
+	const uint64_t off = addr - FRV_RAM_BASE_ADDR;
+	if (off <= bus->ram->size - size) {
+		*dest = frvRamRead(&bus->ram->bytes[off], size);
+		return true;
 	}
-	return frvRamLoadInst(bus->ram, addr, dest);
+	const struct FrvRegion* region = frvBusLookup(bus, tlb, addr);
+	if (!region || addr - region->base > region->size - size) return false;
+	if (region->type == FRV_REGION_MMIO) return region->mmio.load(region->mmio.dev, addr - region->base, size, dest);
+	*dest = frvRamRead(&region->bytes[addr - region->base], size);
+	return true;
 }
 
-bool frvBusStore(const struct FrvBUS* const bus, const uint64_t addr, const uint64_t size, const uint64_t val)
+bool frvBusLoadInst(const struct FrvBUS* const bus, struct FrvTlbEntry* tlb, const uint64_t addr, uint16_t* dest)
 {
-	if (addr < FRV_RAM_BASE_ADDR) {
-		fprintf(stderr, "FrvBUS->FrvRAM store failed: illegal access\n");
+	const uint64_t off = addr - FRV_RAM_BASE_ADDR;
+	if (off <= bus->ram->size - 2) {
+		*dest = frvRamRead(&bus->ram->bytes[off], 2);
+		return true;
+	}
+	const struct FrvRegion* region = frvBusLookup(bus, tlb, addr);
+	if (!region || addr - region->base > region->size - 2 || region->type == FRV_REGION_MMIO) return false;
+	*dest = frvRamRead(&region->bytes[addr - region->base], 2);
+	return true;
+}
+
+bool frvBusStore(const struct FrvBUS* const bus, struct FrvTlbEntry* tlb, const uint64_t addr, const uint64_t size,
+		 const uint64_t val)
+{
+	const uint64_t off = addr - FRV_RAM_BASE_ADDR;
+	if (off <= bus->ram->size - size) {
+		frvRamWrite(&bus->ram->bytes[off], size, val);
+		frvRamMarkDirty(bus->ram, off, size);
+		return true;
+	}
+	const struct FrvRegion* region = frvBusLookup(bus, tlb, addr);
+	if (!region || addr - region->base > region->size - size) return false;
+	switch (region->type) {
+	case FRV_REGION_MMIO:
+		return region->mmio.store(region->mmio.dev, addr - region->base, size, val);
+	case FRV_REGION_ROM:
 		return false;
+	default:
+		frvRamWrite(&region->bytes[addr - region->base], size, val);
+		return true;
+	}
+}
+
+uint8_t* frvBusHostPage(const struct FrvBUS* const bus, struct FrvTlbEntry* tlb, const uint64_t addr, bool* writable)
+{
+	const uint64_t off = addr - FRV_RAM_BASE_ADDR;
+	if (off < bus->ram->size) {
+		*writable = true;
+		return &bus->ram->bytes[off & ~FRV_BUS_PAGE_MASK];
 	}
-	return frvRamStore(bus->ram, addr, size, val);
+	const struct FrvRegion* region = frvBusLookup(bus, tlb, addr);
+	if (!region || region->type == FRV_REGION_MMIO) return NULL;
+	*writable = (region->type == FRV_REGION_RAM);
+	return &region->bytes[(addr & ~FRV_BUS_PAGE_MASK) - region->base];
 }
@@ -2,14 +2,95 @@
 
 #include <stdio.h>
 #include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
 
 #include "ram.h"
 
+#define FRV_BUS_PAGE_SHIFT	(12)
+#define FRV_BUS_PAGE_SIZE	(1ull << FRV_BUS_PAGE_SHIFT)
+#define FRV_BUS_PAGE_MASK	(FRV_BUS_PAGE_SIZE - 1)
+#define FRV_BUS_MAP_BITS	(18) // One second level table maps 1GB
+#define FRV_BUS_MAP_SIZE	(1024) // First level covers a 40-bit physical address space
+#define FRV_BUS_MAX_REGIONS	(16)
+#define FRV_BUS_TLB_SIZE	(256) // Power of 2
+#define FRV_BUS_TLB_EMPTY	(UINT64_MAX)
+
+struct FrvCLINT;
+
+enum FrvRegionType {
+	FRV_REGION_RAM,
+	FRV_REGION_ROM,
+	FRV_REGION_MMIO
+};
+
+/* Device handlers, off is relative to the base of the region
+ * they print their own errors and return false on fail
+ */
+struct FrvMmio {
+	void*	dev;
+	bool	(*load)(void* dev, const uint64_t off, const uint64_t size, uint64_t* dest);
+	bool	(*store)(void* dev, const uint64_t off, const uint64_t size, const uint64_t val);
+};
+
+// base and size are page aligned, bytes backs RAM and ROM regions
+struct FrvRegion {
+	uint64_t		base;
+	uint64_t		size;
+	enum FrvRegionType	type;
+	uint8_t*		bytes;
+	struct FrvMmio		mmio;
+};
+
+// One cached page translation, the region of a ROM or device page
+struct FrvTlbEntry {
+	uint64_t	page;
+	uint32_t	region;
+};
+
+/* Physical memory map: a two level page table from page number to region index + 1 (0 = unmapped)
+ * filled when a region is registered, so a lookup costs the same however many regions there are
+ * It is read-only once the harts run, each of them keeps its own TLB (FRV_BUS_TLB_SIZE entries)
+ * in front of it. The RAM is found by a range check before both, a random access to it costs the same
+ * whatever the working set
+ */
 struct FrvBUS {
-	struct FrvRAM* ram;
+	struct FrvRAM*		ram;
+	struct FrvRegion	regions[FRV_BUS_MAX_REGIONS];
+	uint32_t		nregions;
+	uint8_t*		map[FRV_BUS_MAP_SIZE];
+	struct FrvCLINT*	clint; // Timer the harts read time from, NULL without one
 };
 
+/* The RAM is registered at FRV_RAM_BASE_ADDR, it is the only writable region
+ * Regions have to be added before any cpu caches their host memory
+ */
 struct FrvBUS frvNewBus(struct FrvRAM* ram);
-bool frvBusLoad(const struct FrvBUS* const bus, const uint64_t addr, const uint64_t size, uint64_t* dest);
-bool frvBusLoadInst(const struct FrvBUS* const bus, const uint64_t addr, uint32_t* dest);
-bool frvBusStore(const struct FrvBUS* const bus, const uint64_t addr, const uint64_t size, const uint64_t val);
+bool frvIsBusValid(const struct FrvBUS* const bus);
+void frvBusDestroy(struct FrvBUS* bus);
+bool frvBusAddRegion(struct FrvBUS* bus, const struct FrvRegion* const region);
+void frvBusFlushTlb(struct FrvTlbEntry* tlb);
+
+// Failed accesses are not printed, they become access faults the guest may handle
+bool frvBusLoad(const struct FrvBUS* const bus, struct FrvTlbEntry* tlb, const uint64_t addr, const uint64_t size,
+		uint64_t* dest);
+// A 16-bit instruction parcel, instructions are fetched one or two of them at a time
+bool frvBusLoadInst(const struct FrvBUS* const bus, struct FrvTlbEntry* tlb, const uint64_t addr, uint16_t* dest);
+bool frvBusStore(const struct FrvBUS* const bus, struct FrvTlbEntry* tlb, const uint64_t addr, const uint64_t size,
+		 const uint64_t val);
+// Host memory of the page at addr, NULL for devices and unmapped pages
+uint8_t* frvBusHostPage(const struct FrvBUS* const bus, struct FrvTlbEntry* tlb, const uint64_t addr, bool* writable);
+
+/* Inlined fast path: a load inside the RAM is one range check and a single native move on the host memory
+ * Anything else (ROM, devices, errors) takes the generic path above
+ */
+static inline bool frvBusLoadFast(const struct FrvBUS* const bus, struct FrvTlbEntry* tlb, const uint64_t addr,
+				  const uint64_t size, uint64_t* dest)
+{
+	const uint64_t off = addr - FRV_RAM_BASE_ADDR;
+	if (off <= bus->ram->size - size) {
+		*dest = frvRamRead(&bus->ram->bytes[off], size);
+		return true;
+	}
+	return frvBusLoad(bus, tlb, addr, size, dest);
+}
@@ -0,0 +1,100 @@
+#include <time.h>
+
+#include "clint.h"
+
+static uint64_t frvClintHostNs(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+struct FrvCLINT frvNewClint(void)
+{
+	struct FrvCLINT clint = { .start = frvClintHostNs() };
+	for (uint32_t i = 0; i < FRV_CLINT_MAX_HARTS; i++) clint.mtimecmp[i] = UINT64_MAX; // No timer armed
+	return clint;
+}
+
+uint64_t frvClintTime(const struct FrvCLINT* const clint)
+{
+	const uint64_t ns = frvClintHostNs() - clint->start;
+	const uint64_t ticks = (ns / 1000000000ull) * FRV_CLINT_FREQ + (ns % 1000000000ull) * FRV_CLINT_FREQ / 1000000000ull;
+	return ticks + __atomic_load_n(&clint->offset, __ATOMIC_RELAXED);
+}
+
+void frvClintSetTime(struct FrvCLINT* clint, const uint64_t mtime)
+{
+	__atomic_add_fetch(&clint->offset, mtime - frvClintTime(clint), __ATOMIC_RELAXED);
+}
+
+uint64_t frvClintPending(const struct FrvCLINT* const clint, const uint64_t hartid)
+{
+	if (hartid >= FRV_CLINT_MAX_HARTS) return 0;
+	uint64_t mip = (__atomic_load_n(&clint->msip[hartid], __ATOMIC_RELAXED) & 1) ? FRV_MIP_MSIP : 0;
+	if (frvClintTime(clint) >= __atomic_load_n(&clint->mtimecmp[hartid], __ATOMIC_RELAXED)) mip |= FRV_MIP_MTIP;
+	return mip;
+}
+
+/* The 64-bit registers can be accessed as a whole or as 32-bit halves
+ * A register is picked by its offset, the lower bits select the bytes in it
+ */
+static bool frvClintLoad(void* dev, const uint64_t off, const uint64_t size, uint64_t* dest)
+{
+	const struct FrvCLINT* clint = dev;
+	const uint64_t reg = off & ~7ull, shift = (off & 7) * 8;
+	uint64_t val;
+	if ((size != 4 && size != 8) || (off & (size - 1))) {
+		fprintf(stderr, "FrvCLINT load failed: %lu byte access at 0x%lx\n", size, off);
+		return false;
+	}
+
+	if (off < FRV_CLINT_MSIP + 4 * FRV_CLINT_MAX_HARTS) {
+		*dest = (size == 4) ? __atomic_load_n(&clint->msip[off / 4], __ATOMIC_RELAXED) : 0;
+		return true;
+	}
+	if (reg >= FRV_CLINT_MTIMECMP && reg < FRV_CLINT_MTIMECMP + 8 * FRV_CLINT_MAX_HARTS)
+		val = __atomic_load_n(&clint->mtimecmp[(reg - FRV_CLINT_MTIMECMP) / 8], __ATOMIC_RELAXED);
+	else if (reg == FRV_CLINT_MTIME)
+		val = frvClintTime(clint);
+	else
+		val = 0; // Reserved space reads as zero
+	*dest = (size == 8) ? val : (uint32_t)(val >> shift);
+	return true;
+}
+
+static bool frvClintStore(void* dev, const uint64_t off, const uint64_t size, const uint64_t val)
+{
+	struct FrvCLINT* clint = dev;
+	const uint64_t reg = off & ~7ull, shift = (off & 7) * 8;
+	const uint64_t mask = (size == 8) ? UINT64_MAX : 0xffffffffull << shift;
+	if ((size != 4 && size != 8) || (off & (size - 1))) {
+		fprintf(stderr, "FrvCLINT store failed: %lu byte access at 0x%lx\n", size, off);
+		return false;
+	}
+
+	if (off < FRV_CLINT_MSIP + 4 * FRV_CLINT_MAX_HARTS) {
+		if (size == 4) __atomic_store_n(&clint->msip[off / 4], val & 1, __ATOMIC_RELAXED);
+	} else if (reg >= FRV_CLINT_MTIMECMP && reg < FRV_CLINT_MTIMECMP + 8 * FRV_CLINT_MAX_HARTS) {
+		uint64_t* cmp = &clint->mtimecmp[(reg - FRV_CLINT_MTIMECMP) / 8];
+		const uint64_t old = __atomic_load_n(cmp, __ATOMIC_RELAXED);
+		__atomic_store_n(cmp, (old & ~mask) | ((val << shift) & mask), __ATOMIC_RELAXED);
+	} else if (reg == FRV_CLINT_MTIME) {
+		const uint64_t now = frvClintTime(clint);
+		frvClintSetTime(clint, (now & ~mask) | ((val << shift) & mask));
+	}
+	return true;
+}
+
+bool frvClintAttach(struct FrvCLINT* clint, struct FrvBUS* bus)
+{
+	const struct FrvRegion region = {
+		.base = FRV_CLINT_BASE,
+		.size = FRV_CLINT_SIZE,
+		.type = FRV_REGION_MMIO,
+		.mmio = { .dev = clint, .load = frvClintLoad, .store = frvClintStore }
+	};
+	if (!frvBusAddRegion(bus, &region)) return false;
+	bus->clint = clint;
+	return true;
+}
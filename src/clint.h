@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "bus.h"
+
+#define FRV_CLINT_BASE		(0x2000000) // Where QEMU's virt and the SiFive boards put it
+#define FRV_CLINT_SIZE		(0x10000)
+#define FRV_CLINT_FREQ		(10000000) // mtime ticks per second
+#define FRV_CLINT_MAX_HARTS	(64)
+#define FRV_CLINT_MSIP		(0x0) // 4 bytes per hart
+#define FRV_CLINT_MTIMECMP	(0x4000) // 8 bytes per hart
+#define FRV_CLINT_MTIME		(0xbff8)
+
+// mip bits the CLINT drives
+#define FRV_MIP_MSIP		(1ull << 3)
+#define FRV_MIP_MTIP		(1ull << 7)
+
+/* Core local interruptor: the machine timer and the software interrupts of every hart
+ * mtime is never ticked, it is worked out from the host clock whenever someone reads it
+ * The harts share it, so the registers are accessed atomically
+ */
+struct FrvCLINT {
+	uint64_t	start; // Host ns at mtime 0
+	int64_t		offset; // Ticks added by writes to mtime
+	uint64_t	mtimecmp[FRV_CLINT_MAX_HARTS];
+	uint32_t	msip[FRV_CLINT_MAX_HARTS];
+};
+
+struct FrvCLINT frvNewClint(void);
+bool frvClintAttach(struct FrvCLINT* clint, struct FrvBUS* bus); // Map it at FRV_CLINT_BASE, bus->clint points to it
+uint64_t frvClintTime(const struct FrvCLINT* const clint);
+void frvClintSetTime(struct FrvCLINT* clint, const uint64_t mtime); // mtime keeps counting from there
+uint64_t frvClintPending(const struct FrvCLINT* const clint, const uint64_t hartid); // The mip bits it raises
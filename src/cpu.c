@@ -1,5 +1,8 @@
+#define _DEFAULT_SOURCE // pread, pwrite
+
 #include "cpu.h"
 #include "env.h"
+#include "rvc.h"
 
 // Create a unique cose for each instruction
 static uint32_t frvCpuInstCode(const uint32_t inst)
@@ -9,15 +12,21 @@ static uint32_t frvCpuInstCode(const uint32_t inst)
 	const uint32_t funct6 = FRV_INST_FUNCT6(inst);
 	const uint32_t funct7 = FRV_INST_FUNCT7(inst);
 	const uint32_t funct12 = FRV_INST_FUNCT12(inst);
+	const uint32_t rs2 = (uint32_t) FRV_INST_RS2(inst);
 	switch (opcode) {
 		case 0x33: // R-type
 		case 0x3b: // RV64I
+			if (opcode == 0x3b && funct7 == 0x04 && funct3 == 0x4) // zext.h, rs2 is part of the encoding
+				return (rs2 << 17) | (funct7 << 10) | (funct3 << 7) | opcode;
 			return (funct7 << 10) | (funct3 << 7) | opcode;
 
 		case 0x13: // I-type
 			switch (funct3) {
-			case 0x1:
+			case 0x1: // The unary Zbb ops are told apart by all of funct12
+				if (funct6 == 0x18) return (funct12 << 10) | (funct3 << 7) | opcode;
+				return (funct6 << 10)| (funct3 << 7) | opcode;
 			case 0x5:
+				if (funct6 == 0x0a || funct6 == 0x1a) return (funct12 << 10) | (funct3 << 7) | opcode;
 				return (funct6 << 10)| (funct3 << 7) | opcode;
 			default:
 				return (funct3 << 7) | opcode;
@@ -28,14 +37,27 @@ static uint32_t frvCpuInstCode(const uint32_t inst)
 		case 0x6f:
 			return opcode;
 
-		case 0x73: // CSR, ECALL
+		case 0x73: // CSR, ECALL, xRET, SFENCE.VMA
 			switch (funct3) {
 			case 0:
+				if (funct7 == 0x09) return ((funct7 << 5) << 10) | opcode; // SFENCE.VMA has rs2 in funct12
 				return (funct12 << 10) | (funct3 << 7) | opcode;
 			default:
 				return (funct3 << 7) | opcode;
 			}
 
+		case 0x07: // FP and vector loads and stores, funct3 is the width
+		case 0x27:
+			switch (funct3) {
+			case 0x0: // Vector, funct6 is nf, mew and mop. Unit-stride has its mode in rs2
+			case 0x5:
+			case 0x6:
+			case 0x7:
+				return ((((funct6 & 0x3) == 0) ? rs2 : 0) << 17) | (funct6 << 10) | opcode;
+			default:
+				return (funct3 << 7) | opcode;
+			}
+
 		case 0x23: // S-type, B-type, I-type(Load), J-type, CSR
 		case 0x63:
 		case 0x67:
@@ -43,19 +65,393 @@ static uint32_t frvCpuInstCode(const uint32_t inst)
 		case 0x0f: // Fence
 			return (funct3 << 7) | opcode;
 
+		case 0x2f: // A-extension, aq and rl do not change the code
+			return ((funct7 & 0x7c) << 10) | (funct3 << 7) | opcode;
+
 		case 0x1b: // RV64I
 			switch (funct3) {
 			case 0x0:
 				return (funct3 << 7) | opcode;
+			case 0x1:
+				if (funct6 == 0x02) return (0x04 << 10) | (funct3 << 7) | opcode; // slli.uw, shamt[5] in funct7
+				if (funct7 == 0x30) return (funct12 << 10) | (funct3 << 7) | opcode;
+				return (funct7 << 10) | (funct3 << 7) | opcode;
 			default:
 				return (funct7 << 10) | (funct3 << 7) | opcode;
 			}
 
+		case 0x43: // F/D fused multiply-add, the low bits of funct7 are the format, funct3 the rounding mode
+		case 0x47:
+		case 0x4b:
+		case 0x4f:
+			return ((funct7 & 0x3) << 10) | opcode;
+
+		case 0x53: // F/D, funct3 is the rounding mode unless it picks the operation
+			switch (funct7) {
+			case 0x10: // Sign injection, min/max, compares
+			case 0x11:
+			case 0x14:
+			case 0x15:
+			case 0x50:
+			case 0x51:
+				return (funct7 << 10) | (funct3 << 7) | opcode;
+			case 0x70: // Moves and fclass
+			case 0x71:
+			case 0x78:
+			case 0x79:
+				return (rs2 << 17) | (funct7 << 10) | (funct3 << 7) | opcode;
+			case 0x20: // Conversions and sqrt, rs2 picks the operation
+			case 0x21:
+			case 0x2c:
+			case 0x2d:
+			case 0x60:
+			case 0x61:
+			case 0x68:
+			case 0x69:
+				return (rs2 << 17) | (funct7 << 10) | opcode;
+			default:
+				return (funct7 << 10) | opcode;
+			}
+
+		case 0x57: // Vector, funct3 is the operand form and vm does not change the code
+			switch (funct3) {
+			case 0x7: // vsetvli, vsetivli and vsetvl
+				if (!(inst >> 31)) return (funct3 << 7) | opcode;
+				if ((inst >> 30) == 0x3) return (0x30 << 10) | (funct3 << 7) | opcode;
+				return (funct7 << 10) | (funct3 << 7) | opcode;
+			case 0x2: // vmv.x.s has its operation in vs1, vmv.s.x in vs2
+				if (funct6 == 0x10) return (FRV_INST_RS1(inst) << 17) | (funct6 << 10) | (funct3 << 7) | opcode;
+				return (funct6 << 10) | (funct3 << 7) | opcode;
+			case 0x6:
+				if (funct6 == 0x10) return (rs2 << 17) | (funct6 << 10) | (funct3 << 7) | opcode;
+				return (funct6 << 10) | (funct3 << 7) | opcode;
+			default:
+				return (funct6 << 10) | (funct3 << 7) | opcode;
+			}
+
 		default:
 			return 0xFFFFFFFF;
 	}
 }
 
+// Map the unique instruction code to its handler
+static uint8_t frvCpuInstOp(const uint32_t instcode)
+{
+	switch (instcode) {
+	case FRV_INSTCODE_ADD:		return FRV_OP_ADD;
+	case FRV_INSTCODE_SUB:		return FRV_OP_SUB;
+	case FRV_INSTCODE_ADDI:		return FRV_OP_ADDI;
+	case FRV_INSTCODE_ADDIW:	return FRV_OP_ADDIW;
+	case FRV_INSTCODE_ADDW:		return FRV_OP_ADDW;
+	case FRV_INSTCODE_SUBW:		return FRV_OP_SUBW;
+	case FRV_INSTCODE_ANDI:		return FRV_OP_ANDI;
+	case FRV_INSTCODE_ORI:		return FRV_OP_ORI;
+	case FRV_INSTCODE_XORI:		return FRV_OP_XORI;
+	case FRV_INSTCODE_SLLI:		return FRV_OP_SLLI;
+	case FRV_INSTCODE_SRLI:		return FRV_OP_SRLI;
+	case FRV_INSTCODE_SRAI:		return FRV_OP_SRAI;
+	case FRV_INSTCODE_AND:		return FRV_OP_AND;
+	case FRV_INSTCODE_OR:		return FRV_OP_OR;
+	case FRV_INSTCODE_XOR:		return FRV_OP_XOR;
+	case FRV_INSTCODE_SLL:		return FRV_OP_SLL;
+	case FRV_INSTCODE_SRL:		return FRV_OP_SRL;
+	case FRV_INSTCODE_SRA:		return FRV_OP_SRA;
+	case FRV_INSTCODE_SLLIW:	return FRV_OP_SLLIW;
+	case FRV_INSTCODE_SRLIW:	return FRV_OP_SRLIW;
+	case FRV_INSTCODE_SRAIW:	return FRV_OP_SRAIW;
+	case FRV_INSTCODE_SLLW:		return FRV_OP_SLLW;
+	case FRV_INSTCODE_SRLW:		return FRV_OP_SRLW;
+	case FRV_INSTCODE_SRAW:		return FRV_OP_SRAW;
+	case FRV_INSTCODE_SLTI:		return FRV_OP_SLTI;
+	case FRV_INSTCODE_SLTIU:	return FRV_OP_SLTIU;
+	case FRV_INSTCODE_SLT:		return FRV_OP_SLT;
+	case FRV_INSTCODE_SLTU:		return FRV_OP_SLTU;
+	case FRV_INSTCODE_LB:		return FRV_OP_LB;
+	case FRV_INSTCODE_LH:		return FRV_OP_LH;
+	case FRV_INSTCODE_LW:		return FRV_OP_LW;
+	case FRV_INSTCODE_LBU:		return FRV_OP_LBU;
+	case FRV_INSTCODE_LHU:		return FRV_OP_LHU;
+	case FRV_INSTCODE_LWU:		return FRV_OP_LWU;
+	case FRV_INSTCODE_LD:		return FRV_OP_LD;
+	case FRV_INSTCODE_SB:		return FRV_OP_SB;
+	case FRV_INSTCODE_SH:		return FRV_OP_SH;
+	case FRV_INSTCODE_SW:		return FRV_OP_SW;
+	case FRV_INSTCODE_SD:		return FRV_OP_SD;
+	case FRV_INSTCODE_LUI:		return FRV_OP_LUI;
+	case FRV_INSTCODE_AUIPC:	return FRV_OP_AUIPC;
+	case FRV_INSTCODE_JAL:		return FRV_OP_JAL;
+	case FRV_INSTCODE_JALR:		return FRV_OP_JALR;
+	case FRV_INSTCODE_BEQ:		return FRV_OP_BEQ;
+	case FRV_INSTCODE_BNE:		return FRV_OP_BNE;
+	case FRV_INSTCODE_BLT:		return FRV_OP_BLT;
+	case FRV_INSTCODE_BLTU:		return FRV_OP_BLTU;
+	case FRV_INSTCODE_BGE:		return FRV_OP_BGE;
+	case FRV_INSTCODE_BGEU:		return FRV_OP_BGEU;
+	case FRV_INSTCODE_FENCE:	return FRV_OP_FENCE;
+	case FRV_INSTCODE_FENCEI:	return FRV_OP_FENCEI;
+	case FRV_INSTCODE_ECALL:	return FRV_OP_ECALL;
+	case FRV_INSTCODE_EBREAK:	return FRV_OP_EBREAK;
+	case FRV_INSTCODE_SRET:		return FRV_OP_SRET;
+	case FRV_INSTCODE_MRET:		return FRV_OP_MRET;
+	case FRV_INSTCODE_WFI:		return FRV_OP_WFI;
+	case FRV_INSTCODE_SFENCEVMA:	return FRV_OP_SFENCEVMA;
+	case FRV_INSTCODE_CSRRW:	return FRV_OP_CSRRW;
+	case FRV_INSTCODE_CSRRS:	return FRV_OP_CSRRS;
+	case FRV_INSTCODE_CSRRC:	return FRV_OP_CSRRC;
+	case FRV_INSTCODE_CSRRWI:	return FRV_OP_CSRRWI;
+	case FRV_INSTCODE_CSRRSI:	return FRV_OP_CSRRSI;
+	case FRV_INSTCODE_CSRRCI:	return FRV_OP_CSRRCI;
+	case FRV_INSTCODE_MUL:		return FRV_OP_MUL;
+	case FRV_INSTCODE_MULH:		return FRV_OP_MULH;
+	case FRV_INSTCODE_MULHU:	return FRV_OP_MULHU;
+	case FRV_INSTCODE_MULHSU:	return FRV_OP_MULHSU;
+	case FRV_INSTCODE_MULW:		return FRV_OP_MULW;
+	case FRV_INSTCODE_DIV:		return FRV_OP_DIV;
+	case FRV_INSTCODE_DIVU:		return FRV_OP_DIVU;
+	case FRV_INSTCODE_DIVW:		return FRV_OP_DIVW;
+	case FRV_INSTCODE_DIVUW:	return FRV_OP_DIVUW;
+	case FRV_INSTCODE_REM:		return FRV_OP_REM;
+	case FRV_INSTCODE_REMU:		return FRV_OP_REMU;
+	case FRV_INSTCODE_REMW:		return FRV_OP_REMW;
+	case FRV_INSTCODE_REMUW:	return FRV_OP_REMUW;
+	case FRV_INSTCODE_LRW:		return FRV_OP_LRW;
+	case FRV_INSTCODE_SCW:		return FRV_OP_SCW;
+	case FRV_INSTCODE_AMOSWAPW:	return FRV_OP_AMOSWAPW;
+	case FRV_INSTCODE_AMOADDW:	return FRV_OP_AMOADDW;
+	case FRV_INSTCODE_AMOXORW:	return FRV_OP_AMOXORW;
+	case FRV_INSTCODE_AMOANDW:	return FRV_OP_AMOANDW;
+	case FRV_INSTCODE_AMOORW:	return FRV_OP_AMOORW;
+	case FRV_INSTCODE_AMOMINW:	return FRV_OP_AMOMINW;
+	case FRV_INSTCODE_AMOMAXW:	return FRV_OP_AMOMAXW;
+	case FRV_INSTCODE_AMOMINUW:	return FRV_OP_AMOMINUW;
+	case FRV_INSTCODE_AMOMAXUW:	return FRV_OP_AMOMAXUW;
+	case FRV_INSTCODE_LRD:		return FRV_OP_LRD;
+	case FRV_INSTCODE_SCD:		return FRV_OP_SCD;
+	case FRV_INSTCODE_AMOSWAPD:	return FRV_OP_AMOSWAPD;
+	case FRV_INSTCODE_AMOADDD:	return FRV_OP_AMOADDD;
+	case FRV_INSTCODE_AMOXORD:	return FRV_OP_AMOXORD;
+	case FRV_INSTCODE_AMOANDD:	return FRV_OP_AMOANDD;
+	case FRV_INSTCODE_AMOORD:	return FRV_OP_AMOORD;
+	case FRV_INSTCODE_AMOMIND:	return FRV_OP_AMOMIND;
+	case FRV_INSTCODE_AMOMAXD:	return FRV_OP_AMOMAXD;
+	case FRV_INSTCODE_AMOMINUD:	return FRV_OP_AMOMINUD;
+	case FRV_INSTCODE_AMOMAXUD:	return FRV_OP_AMOMAXUD;
+	case FRV_INSTCODE_FLW:		return FRV_OP_FLW;
+	case FRV_INSTCODE_FSW:		return FRV_OP_FSW;
+	case FRV_INSTCODE_FMADDS:	return FRV_OP_FMADDS;
+	case FRV_INSTCODE_FMSUBS:	return FRV_OP_FMSUBS;
+	case FRV_INSTCODE_FNMSUBS:	return FRV_OP_FNMSUBS;
+	case FRV_INSTCODE_FNMADDS:	return FRV_OP_FNMADDS;
+	case FRV_INSTCODE_FADDS:	return FRV_OP_FADDS;
+	case FRV_INSTCODE_FSUBS:	return FRV_OP_FSUBS;
+	case FRV_INSTCODE_FMULS:	return FRV_OP_FMULS;
+	case FRV_INSTCODE_FDIVS:	return FRV_OP_FDIVS;
+	case FRV_INSTCODE_FSQRTS:	return FRV_OP_FSQRTS;
+	case FRV_INSTCODE_FSGNJS:	return FRV_OP_FSGNJS;
+	case FRV_INSTCODE_FSGNJNS:	return FRV_OP_FSGNJNS;
+	case FRV_INSTCODE_FSGNJXS:	return FRV_OP_FSGNJXS;
+	case FRV_INSTCODE_FMINS:	return FRV_OP_FMINS;
+	case FRV_INSTCODE_FMAXS:	return FRV_OP_FMAXS;
+	case FRV_INSTCODE_FCVTWS:	return FRV_OP_FCVTWS;
+	case FRV_INSTCODE_FCVTWUS:	return FRV_OP_FCVTWUS;
+	case FRV_INSTCODE_FCVTLS:	return FRV_OP_FCVTLS;
+	case FRV_INSTCODE_FCVTLUS:	return FRV_OP_FCVTLUS;
+	case FRV_INSTCODE_FCVTSW:	return FRV_OP_FCVTSW;
+	case FRV_INSTCODE_FCVTSWU:	return FRV_OP_FCVTSWU;
+	case FRV_INSTCODE_FCVTSL:	return FRV_OP_FCVTSL;
+	case FRV_INSTCODE_FCVTSLU:	return FRV_OP_FCVTSLU;
+	case FRV_INSTCODE_FMVXW:	return FRV_OP_FMVXW;
+	case FRV_INSTCODE_FMVWX:	return FRV_OP_FMVWX;
+	case FRV_INSTCODE_FEQS:		return FRV_OP_FEQS;
+	case FRV_INSTCODE_FLTS:		return FRV_OP_FLTS;
+	case FRV_INSTCODE_FLES:		return FRV_OP_FLES;
+	case FRV_INSTCODE_FCLASSS:	return FRV_OP_FCLASSS;
+	case FRV_INSTCODE_FLD:		return FRV_OP_FLD;
+	case FRV_INSTCODE_FSD:		return FRV_OP_FSD;
+	case FRV_INSTCODE_FMADDD:	return FRV_OP_FMADDD;
+	case FRV_INSTCODE_FMSUBD:	return FRV_OP_FMSUBD;
+	case FRV_INSTCODE_FNMSUBD:	return FRV_OP_FNMSUBD;
+	case FRV_INSTCODE_FNMADDD:	return FRV_OP_FNMADDD;
+	case FRV_INSTCODE_FADDD:	return FRV_OP_FADDD;
+	case FRV_INSTCODE_FSUBD:	return FRV_OP_FSUBD;
+	case FRV_INSTCODE_FMULD:	return FRV_OP_FMULD;
+	case FRV_INSTCODE_FDIVD:	return FRV_OP_FDIVD;
+	case FRV_INSTCODE_FSQRTD:	return FRV_OP_FSQRTD;
+	case FRV_INSTCODE_FSGNJD:	return FRV_OP_FSGNJD;
+	case FRV_INSTCODE_FSGNJND:	return FRV_OP_FSGNJND;
+	case FRV_INSTCODE_FSGNJXD:	return FRV_OP_FSGNJXD;
+	case FRV_INSTCODE_FMIND:	return FRV_OP_FMIND;
+	case FRV_INSTCODE_FMAXD:	return FRV_OP_FMAXD;
+	case FRV_INSTCODE_FCVTWD:	return FRV_OP_FCVTWD;
+	case FRV_INSTCODE_FCVTWUD:	return FRV_OP_FCVTWUD;
+	case FRV_INSTCODE_FCVTLD:	return FRV_OP_FCVTLD;
+	case FRV_INSTCODE_FCVTLUD:	return FRV_OP_FCVTLUD;
+	case FRV_INSTCODE_FCVTDW:	return FRV_OP_FCVTDW;
+	case FRV_INSTCODE_FCVTDWU:	return FRV_OP_FCVTDWU;
+	case FRV_INSTCODE_FCVTDL:	return FRV_OP_FCVTDL;
+	case FRV_INSTCODE_FCVTDLU:	return FRV_OP_FCVTDLU;
+	case FRV_INSTCODE_FCVTSD:	return FRV_OP_FCVTSD;
+	case FRV_INSTCODE_FCVTDS:	return FRV_OP_FCVTDS;
+	case FRV_INSTCODE_FMVXD:	return FRV_OP_FMVXD;
+	case FRV_INSTCODE_FMVDX:	return FRV_OP_FMVDX;
+	case FRV_INSTCODE_FEQD:		return FRV_OP_FEQD;
+	case FRV_INSTCODE_FLTD:		return FRV_OP_FLTD;
+	case FRV_INSTCODE_FLED:		return FRV_OP_FLED;
+	case FRV_INSTCODE_FCLASSD:	return FRV_OP_FCLASSD;
+	case FRV_INSTCODE_VSETVLI:	return FRV_OP_VSETVLI;
+	case FRV_INSTCODE_VSETIVLI:	return FRV_OP_VSETIVLI;
+	case FRV_INSTCODE_VSETVL:	return FRV_OP_VSETVL;
+	case FRV_INSTCODE_VLE:		return FRV_OP_VLE;
+	case FRV_INSTCODE_VLSE:		return FRV_OP_VLSE;
+	case FRV_INSTCODE_VSE:		return FRV_OP_VSE;
+	case FRV_INSTCODE_VSSE:		return FRV_OP_VSSE;
+	case FRV_INSTCODE_VADDVV:
+	case FRV_INSTCODE_VADDVX:
+	case FRV_INSTCODE_VADDVI:	return FRV_OP_VADD;
+	case FRV_INSTCODE_VSUBVV:
+	case FRV_INSTCODE_VSUBVX:	return FRV_OP_VSUB;
+	case FRV_INSTCODE_VRSUBVX:
+	case FRV_INSTCODE_VRSUBVI:	return FRV_OP_VRSUB;
+	case FRV_INSTCODE_VMINUVV:
+	case FRV_INSTCODE_VMINUVX:	return FRV_OP_VMINU;
+	case FRV_INSTCODE_VMINVV:
+	case FRV_INSTCODE_VMINVX:	return FRV_OP_VMIN;
+	case FRV_INSTCODE_VMAXUVV:
+	case FRV_INSTCODE_VMAXUVX:	return FRV_OP_VMAXU;
+	case FRV_INSTCODE_VMAXVV:
+	case FRV_INSTCODE_VMAXVX:	return FRV_OP_VMAX;
+	case FRV_INSTCODE_VANDVV:
+	case FRV_INSTCODE_VANDVX:
+	case FRV_INSTCODE_VANDVI:	return FRV_OP_VAND;
+	case FRV_INSTCODE_VORVV:
+	case FRV_INSTCODE_VORVX:
+	case FRV_INSTCODE_VORVI:	return FRV_OP_VOR;
+	case FRV_INSTCODE_VXORVV:
+	case FRV_INSTCODE_VXORVX:
+	case FRV_INSTCODE_VXORVI:	return FRV_OP_VXOR;
+	case FRV_INSTCODE_VSLLVV:
+	case FRV_INSTCODE_VSLLVX:
+	case FRV_INSTCODE_VSLLVI:	return FRV_OP_VSLL;
+	case FRV_INSTCODE_VSRLVV:
+	case FRV_INSTCODE_VSRLVX:
+	case FRV_INSTCODE_VSRLVI:	return FRV_OP_VSRL;
+	case FRV_INSTCODE_VSRAVV:
+	case FRV_INSTCODE_VSRAVX:
+	case FRV_INSTCODE_VSRAVI:	return FRV_OP_VSRA;
+	case FRV_INSTCODE_VMERGEVV:
+	case FRV_INSTCODE_VMERGEVX:
+	case FRV_INSTCODE_VMERGEVI:	return FRV_OP_VMERGE;
+	case FRV_INSTCODE_VMULVV:
+	case FRV_INSTCODE_VMULVX:	return FRV_OP_VMUL;
+	case FRV_INSTCODE_VMACCVV:
+	case FRV_INSTCODE_VMACCVX:	return FRV_OP_VMACC;
+	case FRV_INSTCODE_VMVXS:	return FRV_OP_VMVXS;
+	case FRV_INSTCODE_VMVSX:	return FRV_OP_VMVSX;
+	case FRV_INSTCODE_VREDSUMVS:	return FRV_OP_VREDSUM;
+	case FRV_INSTCODE_VREDANDVS:	return FRV_OP_VREDAND;
+	case FRV_INSTCODE_VREDORVS:	return FRV_OP_VREDOR;
+	case FRV_INSTCODE_VREDXORVS:	return FRV_OP_VREDXOR;
+	case FRV_INSTCODE_VREDMINUVS:	return FRV_OP_VREDMINU;
+	case FRV_INSTCODE_VREDMINVS:	return FRV_OP_VREDMIN;
+	case FRV_INSTCODE_VREDMAXUVS:	return FRV_OP_VREDMAXU;
+	case FRV_INSTCODE_VREDMAXVS:	return FRV_OP_VREDMAX;
+	case FRV_INSTCODE_SH1ADD:	return FRV_OP_SH1ADD;
+	case FRV_INSTCODE_SH2ADD:	return FRV_OP_SH2ADD;
+	case FRV_INSTCODE_SH3ADD:	return FRV_OP_SH3ADD;
+	case FRV_INSTCODE_ADDUW:	return FRV_OP_ADDUW;
+	case FRV_INSTCODE_SH1ADDUW:	return FRV_OP_SH1ADDUW;
+	case FRV_INSTCODE_SH2ADDUW:	return FRV_OP_SH2ADDUW;
+	case FRV_INSTCODE_SH3ADDUW:	return FRV_OP_SH3ADDUW;
+	case FRV_INSTCODE_SLLIUW:	return FRV_OP_SLLIUW;
+	case FRV_INSTCODE_ANDN:		return FRV_OP_ANDN;
+	case FRV_INSTCODE_ORN:		return FRV_OP_ORN;
+	case FRV_INSTCODE_XNOR:		return FRV_OP_XNOR;
+	case FRV_INSTCODE_CLZ:		return FRV_OP_CLZ;
+	case FRV_INSTCODE_CTZ:		return FRV_OP_CTZ;
+	case FRV_INSTCODE_CPOP:		return FRV_OP_CPOP;
+	case FRV_INSTCODE_CLZW:		return FRV_OP_CLZW;
+	case FRV_INSTCODE_CTZW:		return FRV_OP_CTZW;
+	case FRV_INSTCODE_CPOPW:	return FRV_OP_CPOPW;
+	case FRV_INSTCODE_MAX:		return FRV_OP_MAX;
+	case FRV_INSTCODE_MAXU:		return FRV_OP_MAXU;
+	case FRV_INSTCODE_MIN:		return FRV_OP_MIN;
+	case FRV_INSTCODE_MINU:		return FRV_OP_MINU;
+	case FRV_INSTCODE_SEXTB:	return FRV_OP_SEXTB;
+	case FRV_INSTCODE_SEXTH:	return FRV_OP_SEXTH;
+	case FRV_INSTCODE_ZEXTH:	return FRV_OP_ZEXTH;
+	case FRV_INSTCODE_ROL:		return FRV_OP_ROL;
+	case FRV_INSTCODE_ROR:		return FRV_OP_ROR;
+	case FRV_INSTCODE_ROLW:		return FRV_OP_ROLW;
+	case FRV_INSTCODE_RORW:		return FRV_OP_RORW;
+	case FRV_INSTCODE_RORI:		return FRV_OP_RORI;
+	case FRV_INSTCODE_RORIW:	return FRV_OP_RORIW;
+	case FRV_INSTCODE_ORCB:		return FRV_OP_ORCB;
+	case FRV_INSTCODE_REV8:		return FRV_OP_REV8;
+	case FRV_INSTCODE_BCLR:		return FRV_OP_BCLR;
+	case FRV_INSTCODE_BCLRI:	return FRV_OP_BCLRI;
+	case FRV_INSTCODE_BEXT:		return FRV_OP_BEXT;
+	case FRV_INSTCODE_BEXTI:	return FRV_OP_BEXTI;
+	case FRV_INSTCODE_BINV:		return FRV_OP_BINV;
+	case FRV_INSTCODE_BINVI:	return FRV_OP_BINVI;
+	case FRV_INSTCODE_BSET:		return FRV_OP_BSET;
+	case FRV_INSTCODE_BSETI:	return FRV_OP_BSETI;
+	default:			return FRV_OP_ILLEGAL;
+	}
+}
+
+// Decode the raw instruction once, so the executor never looks at the bits again
+static void frvCpuDecode(const uint32_t raw, struct FrvInst* inst)
+{
+	inst->raw = raw;
+	inst->op = frvCpuInstOp(frvCpuInstCode(raw));
+	inst->rd = FRV_INST_RD(raw);
+	inst->rs1 = FRV_INST_RS1(raw);
+	inst->rs2 = FRV_INST_RS2(raw);
+
+	switch (FRV_INST_OPCODE(raw)) {
+	case 0x13: // I-type, shifts keep only the shamt
+		inst->imm = (FRV_INST_FUNCT3(raw) == 0x1 || FRV_INST_FUNCT3(raw) == 0x5) ?
+				FRV_INST_SHAMT64(raw) : FRV_INST_IMM_I(raw);
+		break;
+	case 0x1b: // slli.uw is the one with a 6-bit shamt
+		if (FRV_INST_FUNCT3(raw) == 0x1 && FRV_INST_FUNCT6(raw) == 0x02) inst->imm = FRV_INST_SHAMT64(raw);
+		else if (FRV_INST_FUNCT3(raw) == 0x1 || FRV_INST_FUNCT3(raw) == 0x5) inst->imm = FRV_INST_SHAMT32(raw);
+		else inst->imm = FRV_INST_IMM_I(raw);
+		break;
+	case 0x3: // I-type(Load), JALR, FENCE (pred and succ), FP loads
+	case 0x67:
+	case 0xf:
+	case 0x7:
+		inst->imm = FRV_INST_IMM_I(raw);
+		break;
+	case 0x23: // S-type, FP stores
+	case 0x27:
+		inst->imm = FRV_INST_IMM_S(raw);
+		break;
+	case 0x63: // B-type
+		inst->imm = FRV_INST_IMM_B(raw);
+		break;
+	case 0x37: // U-type
+	case 0x17:
+		inst->imm = FRV_INST_IMM_U(raw);
+		break;
+	case 0x6f: // J-type
+		inst->imm = FRV_INST_IMM_J(raw);
+		break;
+	case 0x73: // CSR
+		inst->imm = FRV_INST_CSR_CODE(raw);
+		break;
+	case 0x57: // Vector, vtypei of vsetvli/vsetivli and the sign-extended simm5 of the .vi forms
+		if (FRV_INST_FUNCT3(raw) == 0x7) inst->imm = (raw >> 20) & (((raw >> 30) == 0x3) ? 0x3ff : 0x7ff);
+		else if (FRV_INST_FUNCT3(raw) == 0x3) inst->imm = ((int32_t)(raw << 12)) >> 27;
+		else inst->imm = 0;
+		break;
+	default:
+		inst->imm = 0;
+		break;
+	}
+}
+
 static inline uint64_t frvMulhu(const uint64_t a, const uint64_t b)
 {
 	unsigned __int128 r = (unsigned __int128)a * (unsigned __int128)b;
@@ -76,548 +472,1490 @@ static inline uint64_t frvMulhsu(const int64_t a, const uint64_t b)
 
 static inline uint64_t frvMulw(const uint64_t a, const uint64_t b)
 {
-	return (uint64_t)((int64_t)(int32_t)(((int32_t) a) * ((int32_t) b)));
+	return (uint64_t)(int64_t)(int32_t)((uint32_t)a * (uint32_t)b);
+}
+
+/* RISC-V never traps on a division: by zero gives all ones (the dividend for rem), and the overflow
+ * of the most negative value by -1 gives it back (0 for rem), where the host raises SIGFPE
+ * The w forms only look at the low words of both operands
+ */
+static inline uint64_t frvDiv(const uint64_t a, const uint64_t b)
+{
+	if (!b) return -1;
+	if ((int64_t)a == INT64_MIN && (int64_t)b == -1) return a;
+	return (int64_t)a / (int64_t)b;
+}
+
+static inline uint64_t frvRem(const uint64_t a, const uint64_t b)
+{
+	if (!b) return a;
+	if ((int64_t)a == INT64_MIN && (int64_t)b == -1) return 0;
+	return (int64_t)a % (int64_t)b;
 }
 
 static inline uint64_t frvDivw(const uint64_t a, const uint64_t b)
 {
-	return (b) ? ((uint64_t)((int64_t)(int32_t)(((int32_t) a) / ((int32_t) b)))) : -1;
+	if (!(int32_t)b) return -1;
+	if ((int32_t)a == INT32_MIN && (int32_t)b == -1) return (int64_t)(int32_t)a;
+	return (int64_t)((int32_t)a / (int32_t)b);
 }
 
 static inline uint64_t frvDivuw(const uint64_t a, const uint64_t b)
 {
-	return (b) ? ((uint64_t)((int64_t)((int32_t)(((uint32_t) a) / ((uint32_t) b))))) : -1;
+	return ((uint32_t)b) ? (uint64_t)(int64_t)(int32_t)((uint32_t)a / (uint32_t)b) : -1;
 }
 
 static inline uint64_t frvRemw(const uint64_t a, const uint64_t b)
 {
-	return (b) ? ((uint64_t)((int64_t)((int32_t)(((int32_t) a) % ((int32_t) b))))) : a;
+	if (!(int32_t)b) return (int64_t)(int32_t)a;
+	if ((int32_t)a == INT32_MIN && (int32_t)b == -1) return 0;
+	return (int64_t)((int32_t)a % (int32_t)b);
 }
 
 static inline uint64_t frvRemuw(const uint64_t a, const uint64_t b)
 {
-	return (b) ? ((uint64_t)((int64_t)((int32_t)(((uint32_t) a) % ((uint32_t) b))))) : a;
+	return ((uint32_t)b) ? (uint64_t)(int64_t)(int32_t)((uint32_t)a % (uint32_t)b) : (uint64_t)(int64_t)(int32_t)a;
 }
 
-static uint64_t frvLoadCsr(const struct FrvCPU* const cpu, const uint32_t addr) 
+// The host builtins leave a zero input undefined, RISC-V counts all the bits
+static inline uint64_t frvClz(const uint64_t a)
 {
-	switch (addr) {
-	case FRV_CSR_SIE:
-		return cpu->csrs[FRV_CSR_MIE] & cpu->csrs[FRV_CSR_MIDELEG];
+	return (a) ? __builtin_clzll(a) : 64;
+}
 
-	default:
-		return cpu->csrs[addr];
-	}
+static inline uint64_t frvCtz(const uint64_t a)
+{
+	return (a) ? __builtin_ctzll(a) : 64;
 }
 
-static void frvStoreCsr(struct FrvCPU* cpu, const uint32_t addr, const uint64_t val) 
+static inline uint64_t frvClzw(const uint64_t a)
 {
-	switch (addr) {
-	case FRV_CSR_SIE:
-		cpu->csrs[FRV_CSR_MIE] = (cpu->csrs[FRV_CSR_MIE] &
-				!cpu->csrs[FRV_CSR_MIDELEG]) | (val & cpu->csrs[FRV_CSR_MIDELEG]);
+	return ((uint32_t) a) ? __builtin_clz((uint32_t) a) : 32;
+}
 
-	default:
-		cpu->csrs[addr] = val;
-	}
+static inline uint64_t frvCtzw(const uint64_t a)
+{
+	return ((uint32_t) a) ? __builtin_ctz((uint32_t) a) : 32;
 }
 
-void frvCpuPrintRegs(const struct FrvCPU* const cpu)
+// Written so the compiler emits a single rotate
+static inline uint64_t frvRor(const uint64_t a, const uint64_t b)
 {
-	printf("PC => 0x%lX | %ld\n", cpu->pc, cpu->pc);
-	for (int i = 0; i < FRV_NUM_REGS; i++) {
-		printf("x%d => 0x%lX | %ld\n", i, cpu->regs[i], cpu->regs[i]);
-	}
+	return (a >> (b & 0x3f)) | (a << (-b & 0x3f));
 }
 
-void frvCpuPrintCsrs(const struct FrvCPU* const cpu)
+static inline uint64_t frvRorw(const uint64_t a, const uint64_t b)
 {
-	printf("mstatus=0x%lX\tmtvec=0x%lX\tmepc=0x%lX\tmcause=0x%lX\n",
-                frvLoadCsr(cpu, FRV_CSR_MSTATUS),
-                frvLoadCsr(cpu, FRV_CSR_MTVEC),
-                frvLoadCsr(cpu, FRV_CSR_MEPC),
-                frvLoadCsr(cpu, FRV_CSR_MCAUSE)
-        );
+	const uint32_t x = (uint32_t) a;
+	return (uint64_t)((int64_t)((int32_t)((x >> (b & 0x1f)) | (x << (-b & 0x1f)))));
+}
 
-	printf("sstatus=0x%lX\tstvec=0x%lX\tsepc=0x%lX\tscause=0x%lX\n",
-                frvLoadCsr(cpu, FRV_CSR_SSTATUS),
-                frvLoadCsr(cpu, FRV_CSR_STVEC),
-                frvLoadCsr(cpu, FRV_CSR_SEPC),
-                frvLoadCsr(cpu, FRV_CSR_SCAUSE)
-        );
+// Every non-zero byte becomes 0xff, the top bit of each byte is set when the byte is not zero
+static inline uint64_t frvOrcb(const uint64_t a)
+{
+	const uint64_t low = 0x7f7f7f7f7f7f7f7full;
+	return (((((a & low) + low) | a) & ~low) >> 7) * 0xff;
 }
 
-struct FrvCPU frvNewCpu(struct FrvBUS* bus)
+// Hand the translation state to the MMU, the blocks follow its fetch context
+static void frvCpuUpdateMmu(struct FrvCPU* cpu)
 {
-	struct FrvCPU cpu = { 0 };
-	cpu.regs[FRV_ABI_REG_ZERO] = 0; // x0 hard wired to zero
-	cpu.regs[FRV_ABI_REG_SP] = bus->ram->size + FRV_RAM_BASE_ADDR; // x2 stack pointer
-	cpu.pc = FRV_RAM_BASE_ADDR; // Program-couter
-	cpu.bus = bus;
-	return cpu;
+	const uint64_t status = cpu->csrs[FRV_CSRS_MSTATUS];
+	const uint8_t dpriv = (cpu->priv == FRV_PRIV_M && (status & FRV_MSTATUS_MPRV)) ?
+			(status & FRV_MSTATUS_MPP) >> FRV_MSTATUS_MPP_SHIFT : cpu->priv;
+	frvMmuSetContext(&cpu->mmu, cpu->csrs[FRV_CSRS_SATP], cpu->priv, dpriv,
+			 status & FRV_MSTATUS_SUM, status & FRV_MSTATUS_MXR);
+	cpu->tcache.ctx = cpu->mmu.ctx;
 }
 
-bool frvCpuLoadProgram(struct FrvCPU* cpu, const char* path)
+// Retired instructions including the running one, instret itself only moves a block at a time
+static inline uint64_t frvCpuInstret(const struct FrvCPU* const cpu)
 {
-	int64_t read_bytes;
-	int64_t file_size;
-	if ((file_size = frvReadFileToBuf(path, NULL, 0, true)) < 0) return false;
-	if ((read_bytes = frvReadFileToBuf(path, cpu->bus->ram->bytes , cpu->bus->ram->size, true)) < 0) return false;
-	if (read_bytes != file_size) {
-		fprintf(stderr, "Could'nt read program to memory! (Out of mem)\n");
-		return false;
-	}
-	return true;
+	return cpu->instret + frvBlockCount(cpu->block, cpu->pc);
 }
 
-// Loading without a bus to avoid mismatch of 32 and 64 bits
-static bool frvCpuFetch(struct FrvCPU* cpu, uint32_t* inst)
+// Leave the exception for the run loop, false so the handler can fail with it
+static bool frvCpuRaise(struct FrvCPU* cpu, const uint64_t cause, const uint64_t tval)
 {
-	return frvBusLoadInst(cpu->bus, cpu->pc, inst);
+	cpu->cause = cause;
+	cpu->tval = tval;
+	return false;
 }
 
-static bool frvCpuExec(struct FrvCPU* cpu, uint32_t inst)
+static bool frvCpuIllegal(struct FrvCPU* cpu, const struct FrvInst* inst)
 {
-	uint32_t instcode = frvCpuInstCode(inst);
-        uint64_t rd = FRV_INST_RD(inst);
-        uint64_t rs1 = FRV_INST_RS1(inst);
-        uint64_t rs2 = FRV_INST_RS2(inst);
-	uint32_t csr = FRV_INST_CSR_CODE(inst);
+	return frvCpuRaise(cpu, FRV_CAUSE_ILLEGAL_INST, inst->raw);
+}
 
-	switch (instcode) {
-	// Arithmetic
-	case FRV_INSTCODE_ADD: {
-		cpu->regs[rd] = cpu->regs[rs1] + cpu->regs[rs2];
-		return true;
-	}
+/* The FP and vector state is not tracked as it changes, a unit that is on is always dirty
+ * FS or VS == 0 turns it off and its instructions trap
+ */
+static inline uint64_t frvCpuStatusDirty(const uint64_t status)
+{
+	uint64_t dirty = status & ~FRV_MSTATUS_SD;
+	if (status & FRV_MSTATUS_FS) dirty |= FRV_MSTATUS_FS | FRV_MSTATUS_SD;
+	if (status & FRV_MSTATUS_VS) dirty |= FRV_MSTATUS_VS | FRV_MSTATUS_SD;
+	return dirty;
+}
 
-	case FRV_INSTCODE_SUB: {
-		cpu->regs[rd] = cpu->regs[rs1] - cpu->regs[rs2];
-		return true;
-	}
+static inline bool frvCpuFpuOn(struct FrvCPU* cpu, const struct FrvInst* inst)
+{
+	return (cpu->csrs[FRV_CSRS_MSTATUS] & FRV_MSTATUS_FS) || frvCpuIllegal(cpu, inst);
+}
 
-	case FRV_INSTCODE_ADDI: {
-		uint64_t imm = FRV_INST_IMM_I(inst);
-		cpu->regs[rd] = cpu->regs[rs1] + imm;
-		return true;
-	}
+// RNE, the rounding mode the host runs in, the handlers do it inline
+static inline bool frvCpuFpuFast(const struct FrvCPU* const cpu, const struct FrvInst* inst)
+{
+	const uint32_t rm = FRV_INST_FUNCT3(inst->raw);
+	return (cpu->csrs[FRV_CSRS_MSTATUS] & FRV_MSTATUS_FS) &&
+		(rm == FRV_RM_RNE || (rm == FRV_RM_DYN && !(cpu->csrs[FRV_CSRS_FCSR] >> FRV_FRM_SHIFT)));
+}
 
-	case FRV_INSTCODE_ADDIW: {
-		uint64_t imm = FRV_INST_IMM_I(inst);
-		cpu->regs[rd] = (uint64_t)((int64_t)((int32_t)(cpu->regs[rs1] + imm)));
-		return true;
-	}
+// Everything else goes through fpu.c, a reserved rounding mode is illegal
+static bool frvCpuFpu(struct FrvCPU* cpu, const struct FrvInst* inst)
+{
+	uint32_t rm = FRV_INST_FUNCT3(inst->raw);
+	if (rm == FRV_RM_DYN) rm = (uint32_t)(cpu->csrs[FRV_CSRS_FCSR] >> FRV_FRM_SHIFT);
+	if (!(cpu->csrs[FRV_CSRS_MSTATUS] & FRV_MSTATUS_FS) || !frvFpuExec(inst, rm, cpu->fregs, cpu->regs))
+		return frvCpuIllegal(cpu, inst);
+	return true;
+}
 
-	case FRV_INSTCODE_ADDW: {
-		cpu->regs[rd] = (uint64_t)((int64_t)((int32_t)(cpu->regs[rs1] + cpu->regs[rs2])));
-		return true;
-	}
+// How a CSR number is read and written
+enum FrvCsrKind {
+	FRV_CSRK_NONE = 0,	// Not implemented, any access is an illegal instruction
+	FRV_CSRK_RW,		// Plain storage
+	FRV_CSRK_RO,		// Read-only storage
+	FRV_CSRK_IRQ,		// mie and mideleg, the interrupts are looked at again after a write
+	FRV_CSRK_STATUS,	// mstatus, the translation follows it
+	FRV_CSRK_SSTATUS,	// The supervisor part of mstatus
+	FRV_CSRK_SIE,		// mie through mideleg
+	FRV_CSRK_MIP,		// Software bits and the ones of the CLINT
+	FRV_CSRK_SIP,		// mip through mideleg
+	FRV_CSRK_SATP,		// Only the supported modes stick
+	FRV_CSRK_COUNTER,	// mcycle and minstret, slot holds the offset to the retired count
+	FRV_CSRK_COUNTER_RO,	// cycle and instret, the shadows of the machine counters
+	FRV_CSRK_TIME,		// mtime of the CLINT
+	FRV_CSRK_FFLAGS,	// The views of fcsr, the host FPU holds the flags raised since the last look
+	FRV_CSRK_FRM,
+	FRV_CSRK_FCSR,
+	FRV_CSRK_VSTART,	// Only holds element numbers of the largest group
+	FRV_CSRK_VXSAT,		// The views of vcsr
+	FRV_CSRK_VXRM,
+	FRV_CSRK_VCSR
+};
+
+struct FrvCsrDesc {
+	uint8_t		slot; // enum FrvCsrSlot, for views the slot they show
+	uint8_t		kind; // enum FrvCsrKind
+};
+
+// CSR number to storage and handler, zero (FRV_CSRK_NONE) for everything not listed
+static const struct FrvCsrDesc frvCsrTable[FRV_NUM_CSRS] = {
+	[FRV_CSR_MSTATUS] = { FRV_CSRS_MSTATUS, FRV_CSRK_STATUS },
+	[FRV_CSR_MISA] = { FRV_CSRS_MISA, FRV_CSRK_RO },
+	[FRV_CSR_MEDELEG] = { FRV_CSRS_MEDELEG, FRV_CSRK_RW },
+	[FRV_CSR_MIDELEG] = { FRV_CSRS_MIDELEG, FRV_CSRK_IRQ },
+	[FRV_CSR_MIE] = { FRV_CSRS_MIE, FRV_CSRK_IRQ },
+	[FRV_CSR_MTVEC] = { FRV_CSRS_MTVEC, FRV_CSRK_RW },
+	[FRV_CSR_MCOUNTEREN] = { FRV_CSRS_MCOUNTEREN, FRV_CSRK_RW },
+	[FRV_CSR_MSCRATCH] = { FRV_CSRS_MSCRATCH, FRV_CSRK_RW },
+	[FRV_CSR_MEPC] = { FRV_CSRS_MEPC, FRV_CSRK_RW },
+	[FRV_CSR_MCAUSE] = { FRV_CSRS_MCAUSE, FRV_CSRK_RW },
+	[FRV_CSR_MTVAL] = { FRV_CSRS_MTVAL, FRV_CSRK_RW },
+	[FRV_CSR_MIP] = { FRV_CSRS_MIP, FRV_CSRK_MIP },
+	[FRV_CSR_MCYCLE] = { FRV_CSRS_MCYCLE, FRV_CSRK_COUNTER },
+	[FRV_CSR_MINSTRET] = { FRV_CSRS_MINSTRET, FRV_CSRK_COUNTER },
+	[FRV_CSR_MHARTID] = { FRV_CSRS_MHARTID, FRV_CSRK_RO },
+	[FRV_CSR_SSTATUS] = { FRV_CSRS_MSTATUS, FRV_CSRK_SSTATUS },
+	[FRV_CSR_SIE] = { FRV_CSRS_MIE, FRV_CSRK_SIE },
+	[FRV_CSR_STVEC] = { FRV_CSRS_STVEC, FRV_CSRK_RW },
+	[FRV_CSR_SCOUNTEREN] = { FRV_CSRS_SCOUNTEREN, FRV_CSRK_RW },
+	[FRV_CSR_SSCRATCH] = { FRV_CSRS_SSCRATCH, FRV_CSRK_RW },
+	[FRV_CSR_SEPC] = { FRV_CSRS_SEPC, FRV_CSRK_RW },
+	[FRV_CSR_SCAUSE] = { FRV_CSRS_SCAUSE, FRV_CSRK_RW },
+	[FRV_CSR_STVAL] = { FRV_CSRS_STVAL, FRV_CSRK_RW },
+	[FRV_CSR_SIP] = { FRV_CSRS_MIP, FRV_CSRK_SIP },
+	[FRV_CSR_SATP] = { FRV_CSRS_SATP, FRV_CSRK_SATP },
+	[FRV_CSR_CYCLE] = { FRV_CSRS_MCYCLE, FRV_CSRK_COUNTER_RO },
+	[FRV_CSR_TIME] = { 0, FRV_CSRK_TIME },
+	[FRV_CSR_INSTRET] = { FRV_CSRS_MINSTRET, FRV_CSRK_COUNTER_RO },
+	[FRV_CSR_FFLAGS] = { FRV_CSRS_FCSR, FRV_CSRK_FFLAGS },
+	[FRV_CSR_FRM] = { FRV_CSRS_FCSR, FRV_CSRK_FRM },
+	[FRV_CSR_FCSR] = { FRV_CSRS_FCSR, FRV_CSRK_FCSR },
+	[FRV_CSR_VSTART] = { FRV_CSRS_VSTART, FRV_CSRK_VSTART },
+	[FRV_CSR_VXSAT] = { FRV_CSRS_VCSR, FRV_CSRK_VXSAT },
+	[FRV_CSR_VXRM] = { FRV_CSRS_VCSR, FRV_CSRK_VXRM },
+	[FRV_CSR_VCSR] = { FRV_CSRS_VCSR, FRV_CSRK_VCSR },
+	[FRV_CSR_VL] = { FRV_CSRS_VL, FRV_CSRK_RO },
+	[FRV_CSR_VTYPE] = { FRV_CSRS_VTYPE, FRV_CSRK_RO },
+	[FRV_CSR_VLENB] = { FRV_CSRS_VLENB, FRV_CSRK_RO },
+};
+
+// mip as the harts see it, the CLINT bits are worked out when read
+static uint64_t frvCpuMip(const struct FrvCPU* const cpu)
+{
+	return cpu->csrs[FRV_CSRS_MIP] |
+		(cpu->bus->clint ? frvClintPending(cpu->bus->clint, cpu->csrs[FRV_CSRS_MHARTID]) : 0);
+}
 
-	case FRV_INSTCODE_SUBW: {
-		cpu->regs[rd] = (uint64_t)((int32_t)(cpu->regs[rs1] - cpu->regs[rs2]));
-		return true;
-	}
+/* The counters are never ticked, they are worked out when read
+ * One instruction is one cycle
+ */
+static uint64_t frvLoadCsr(const struct FrvCPU* const cpu, const uint32_t addr) 
+{
+	const struct FrvCsrDesc desc = frvCsrTable[addr & (FRV_NUM_CSRS - 1)];
+	switch (desc.kind) {
+	case FRV_CSRK_RW:
+	case FRV_CSRK_RO:
+	case FRV_CSRK_IRQ:
+	case FRV_CSRK_STATUS:
+	case FRV_CSRK_SATP:
+		return cpu->csrs[desc.slot];
 
-	// Logic
-	case FRV_INSTCODE_ANDI: {
-		uint64_t imm = FRV_INST_IMM_I(inst);
-		cpu->regs[rd] = cpu->regs[rs1] & imm;
-		return true;
-	}
+	case FRV_CSRK_SSTATUS:
+		return cpu->csrs[FRV_CSRS_MSTATUS] & FRV_SSTATUS_MASK;
 
-	case FRV_INSTCODE_ORI: {
-		uint64_t imm = FRV_INST_IMM_I(inst);
-		cpu->regs[rd] = cpu->regs[rs1] | imm;
-		return true;
-	}
+	case FRV_CSRK_SIE:
+		return cpu->csrs[FRV_CSRS_MIE] & cpu->csrs[FRV_CSRS_MIDELEG];
 
-	case FRV_INSTCODE_XORI: {
-		uint64_t imm = FRV_INST_IMM_I(inst);
-		cpu->regs[rd] = cpu->regs[rs1] ^ imm;
-		return true;
-	}
+	case FRV_CSRK_MIP:
+		return frvCpuMip(cpu);
 
-	case FRV_INSTCODE_SLLI: {
-		cpu->regs[rd] = cpu->regs[rs1] << FRV_INST_SHAMT64(inst);
-		return true;
-	}
+	case FRV_CSRK_SIP:
+		return frvCpuMip(cpu) & cpu->csrs[FRV_CSRS_MIDELEG];
 
-	case FRV_INSTCODE_SRLI: {
-		cpu->regs[rd] = cpu->regs[rs1] >> FRV_INST_SHAMT64(inst);
-		return true;
-	}
+	case FRV_CSRK_COUNTER:
+	case FRV_CSRK_COUNTER_RO:
+		return frvCpuInstret(cpu) + cpu->csrs[desc.slot];
 
-	case FRV_INSTCODE_SRAI: {
-		cpu->regs[rd] = ((int64_t)cpu->regs[rs1]) >> FRV_INST_SHAMT64(inst);
-		return true;
-	}
+	case FRV_CSRK_TIME:
+		return cpu->bus->clint ? frvClintTime(cpu->bus->clint) : 0;
 
-	case FRV_INSTCODE_AND: {
-		cpu->regs[rd] = cpu->regs[rs1] & cpu->regs[rs2];
-		return true;
-	}
+	case FRV_CSRK_FFLAGS:
+		return (cpu->csrs[desc.slot] | frvFpuFlags()) & FRV_FFLAGS_MASK;
 
-	case FRV_INSTCODE_OR: {
-		cpu->regs[rd] = cpu->regs[rs1] | cpu->regs[rs2];
-		return true;
-	}
+	case FRV_CSRK_FRM:
+		return cpu->csrs[desc.slot] >> FRV_FRM_SHIFT;
 
-	case FRV_INSTCODE_XOR: {
-		cpu->regs[rd] = cpu->regs[rs1] ^ cpu->regs[rs2];
-		return true;
-	}
+	case FRV_CSRK_FCSR:
+		return cpu->csrs[desc.slot] | frvFpuFlags();
 
-	case FRV_INSTCODE_SLL: {
-		cpu->regs[rd] = cpu->regs[rs1] << (cpu->regs[rs2] & 0x3f);
-		return true;
-	}
+	case FRV_CSRK_VSTART:
+	case FRV_CSRK_VCSR:
+		return cpu->csrs[desc.slot];
 
-	case FRV_INSTCODE_SRL: {
-		cpu->regs[rd] = cpu->regs[rs1] >> (cpu->regs[rs2] & 0x3f);
-		return true;
-	}
+	case FRV_CSRK_VXSAT:
+		return cpu->csrs[desc.slot] & FRV_VCSR_VXSAT;
 
-	case FRV_INSTCODE_SRA: {
-		cpu->regs[rd] = ((int64_t)cpu->regs[rs1]) >> (cpu->regs[rs2] & 0x3f);
-		return true;
-	}
+	case FRV_CSRK_VXRM:
+		return cpu->csrs[desc.slot] >> FRV_VCSR_VXRM_SHIFT;
 
-	case FRV_INSTCODE_SLLIW: {
-		cpu->regs[rd] = (uint64_t)((int64_t)((int32_t)(cpu->regs[rs1] << FRV_INST_SHAMT32(inst))));
-		return true;
+	default:
+		return 0;
 	}
+}
 
-	case FRV_INSTCODE_SRLIW: {
-		cpu->regs[rd] = (uint64_t)((int64_t)((int32_t)(((uint32_t)cpu->regs[rs1]) >> FRV_INST_SHAMT32(inst))));
-		return true;
+static void frvStoreCsr(struct FrvCPU* cpu, const uint32_t addr, const uint64_t val) 
+{
+	const struct FrvCsrDesc desc = frvCsrTable[addr & (FRV_NUM_CSRS - 1)];
+	uint64_t* slot = &cpu->csrs[desc.slot];
+	switch (desc.kind) {
+	case FRV_CSRK_RW:
+		*slot = val;
+		break;
+
+	case FRV_CSRK_IRQ:
+		*slot = val;
+		cpu->irqpoll = 0;
+		break;
+
+	case FRV_CSRK_STATUS:
+		*slot = frvCpuStatusDirty(val);
+		cpu->irqpoll = 0;
+		frvCpuUpdateMmu(cpu);
+		break;
+
+	case FRV_CSRK_SSTATUS:
+		*slot = frvCpuStatusDirty((*slot & ~FRV_SSTATUS_MASK) | (val & FRV_SSTATUS_MASK));
+		cpu->irqpoll = 0;
+		frvCpuUpdateMmu(cpu);
+		break;
+
+	case FRV_CSRK_SIE:
+		*slot = (*slot & ~cpu->csrs[FRV_CSRS_MIDELEG]) | (val & cpu->csrs[FRV_CSRS_MIDELEG]);
+		cpu->irqpoll = 0;
+		break;
+
+	case FRV_CSRK_MIP: // The CLINT drives the machine timer and software bits
+		*slot = val & ~(FRV_MIP_MTIP | FRV_MIP_MSIP);
+		cpu->irqpoll = 0;
+		break;
+
+	case FRV_CSRK_SIP: // Only the delegated software bit is writable here
+		*slot = (*slot & ~(cpu->csrs[FRV_CSRS_MIDELEG] & FRV_MIP_SSIP)) |
+			(val & cpu->csrs[FRV_CSRS_MIDELEG] & FRV_MIP_SSIP);
+		cpu->irqpoll = 0;
+		break;
+
+	case FRV_CSRK_SATP: // Unsupported modes leave it alone
+		if ((val >> FRV_SATP_MODE_SHIFT) == FRV_SATP_MODE_BARE) *slot = 0;
+		else if ((val >> FRV_SATP_MODE_SHIFT) == FRV_SATP_MODE_SV39) *slot = val;
+		frvCpuUpdateMmu(cpu);
+		break;
+
+	case FRV_CSRK_COUNTER:
+		*slot = val - frvCpuInstret(cpu);
+		break;
+
+	case FRV_CSRK_FFLAGS:
+		*slot = (*slot & ~(uint64_t)FRV_FFLAGS_MASK) | (val & FRV_FFLAGS_MASK);
+		frvFpuClearFlags();
+		break;
+
+	case FRV_CSRK_FRM:
+		*slot = (*slot & FRV_FFLAGS_MASK) | ((val << FRV_FRM_SHIFT) & FRV_FCSR_MASK);
+		break;
+
+	case FRV_CSRK_FCSR:
+		*slot = val & FRV_FCSR_MASK;
+		frvFpuClearFlags();
+		break;
+
+	case FRV_CSRK_VSTART:
+		*slot = val & (FRV_VEC_GROUP_MAX - 1);
+		break;
+
+	case FRV_CSRK_VXSAT:
+		*slot = (*slot & ~(uint64_t)FRV_VCSR_VXSAT) | (val & FRV_VCSR_VXSAT);
+		break;
+
+	case FRV_CSRK_VXRM:
+		*slot = (*slot & FRV_VCSR_VXSAT) | ((val << FRV_VCSR_VXRM_SHIFT) & FRV_VCSR_MASK);
+		break;
+
+	case FRV_CSRK_VCSR:
+		*slot = val & FRV_VCSR_MASK;
+		break;
+
+	default: // Read-only or not implemented
+		break;
 	}
+}
 
-	case FRV_INSTCODE_SRAIW: {
-		cpu->regs[rd] = (uint64_t)((int64_t)(((int32_t)cpu->regs[rs1]) >> FRV_INST_SHAMT32(inst)));
-		return true;
-	}
-	
-	case FRV_INSTCODE_SLLW: {
-		uint32_t shamt = ((uint32_t)(cpu->regs[rs2] & 0x1f));
-		cpu->regs[rd] = (uint64_t)((int32_t)(((uint32_t)cpu->regs[rs1]) << shamt));
-		return true;
-	}
+/* The CSR number encodes who may touch it: bits 9:8 the lowest privilege, 11:10 == 3 read-only
+ * The counters below M-mode also need their bit in mcounteren (and scounteren for U-mode),
+ * the FP and vector ones their unit on. The unimplemented ones are illegal everywhere
+ */
+static bool frvCpuCsrAllowed(const struct FrvCPU* const cpu, const uint32_t addr, const bool write)
+{
+	if (frvCsrTable[addr & (FRV_NUM_CSRS - 1)].kind == FRV_CSRK_NONE) return false;
+	if (((addr >> 8) & 3) > cpu->priv || (write && (addr >> 10) == 3)) return false;
+	if (addr >= FRV_CSR_FFLAGS && addr <= FRV_CSR_FCSR) return cpu->csrs[FRV_CSRS_MSTATUS] & FRV_MSTATUS_FS;
+	if ((addr >= FRV_CSR_VSTART && addr <= FRV_CSR_VCSR) || (addr >= FRV_CSR_VL && addr <= FRV_CSR_VLENB))
+		return cpu->csrs[FRV_CSRS_MSTATUS] & FRV_MSTATUS_VS;
+	if (addr < FRV_CSR_CYCLE || addr >= FRV_CSR_CYCLE + 32 || cpu->priv == FRV_PRIV_M) return true;
+
+	const uint64_t bit = 1ull << (addr - FRV_CSR_CYCLE);
+	if (!(cpu->csrs[FRV_CSRS_MCOUNTEREN] & bit)) return false;
+	return cpu->priv == FRV_PRIV_S || (cpu->csrs[FRV_CSRS_SCOUNTEREN] & bit);
+}
 
-	case FRV_INSTCODE_SRLW: {
-		uint32_t shamt = ((uint32_t)(cpu->regs[rs2] & 0x1f));
-		cpu->regs[rd] = (uint64_t)((int32_t)(((uint32_t)cpu->regs[rs1]) >> shamt));
-		return true;
+/* CSRRW/S/C and their immediate forms, funct3 bit 2 picks the immediate
+ * Set and clear with a zero source only read, so they work on the read-only CSRs too
+ */
+static bool frvCpuCsr(struct FrvCPU* cpu, const struct FrvInst* inst)
+{
+	const uint32_t funct3 = FRV_INST_FUNCT3(inst->raw);
+	const uint64_t src = (funct3 & 0x4) ? inst->rs1 : cpu->regs[inst->rs1]; // Rs1 is the same as imm here
+	const bool write = ((funct3 & 0x3) == 0x1) || inst->rs1 != 0;
+	if (!frvCpuCsrAllowed(cpu, inst->imm, write)) return frvCpuIllegal(cpu, inst);
+
+	const uint64_t old = frvLoadCsr(cpu, inst->imm);
+	if (write) {
+		switch (funct3 & 0x3) {
+		case 0x1:	frvStoreCsr(cpu, inst->imm, src); break;
+		case 0x2:	frvStoreCsr(cpu, inst->imm, old | src); break;
+		default:	frvStoreCsr(cpu, inst->imm, old & ~src); break;
+		}
 	}
+	cpu->regs[inst->rd] = old;
+	return true;
+}
 
-	case FRV_INSTCODE_SRAW: {
-		int32_t shamt = ((int32_t)(cpu->regs[rs2] & 0x1f));
-		cpu->regs[rd] = (uint64_t)(((int32_t)cpu->regs[rs1]) >> shamt);
-		return true;
-	}
+static bool frvCpuMret(struct FrvCPU* cpu)
+{
+	if (cpu->priv != FRV_PRIV_M) return false;
+	uint64_t status = cpu->csrs[FRV_CSRS_MSTATUS];
+	cpu->priv = (status & FRV_MSTATUS_MPP) >> FRV_MSTATUS_MPP_SHIFT;
+	status = (status & ~FRV_MSTATUS_MIE) | ((status & FRV_MSTATUS_MPIE) ? FRV_MSTATUS_MIE : 0);
+	status = (status | FRV_MSTATUS_MPIE) & ~FRV_MSTATUS_MPP;
+	if (cpu->priv != FRV_PRIV_M) status &= ~FRV_MSTATUS_MPRV;
+	cpu->csrs[FRV_CSRS_MSTATUS] = status;
+	cpu->pc = cpu->csrs[FRV_CSRS_MEPC];
+	cpu->irqpoll = 0;
+	frvCpuUpdateMmu(cpu);
+	return true;
+}
 
-	// Compares
-	case FRV_INSTCODE_SLTI: {
-		int64_t imm = FRV_INST_IMM_I(inst);
-		cpu->regs[rd] = (((int64_t)(cpu->regs[rs1])) < imm) ? 1 : 0;
-		return true;
-	}
+static bool frvCpuSret(struct FrvCPU* cpu)
+{
+	if (cpu->priv == FRV_PRIV_U) return false;
+	uint64_t status = cpu->csrs[FRV_CSRS_MSTATUS];
+	cpu->priv = (status & FRV_MSTATUS_SPP) ? FRV_PRIV_S : FRV_PRIV_U;
+	status = (status & ~FRV_MSTATUS_SIE) | ((status & FRV_MSTATUS_SPIE) ? FRV_MSTATUS_SIE : 0);
+	status = (status | FRV_MSTATUS_SPIE) & ~(FRV_MSTATUS_SPP | FRV_MSTATUS_MPRV);
+	cpu->csrs[FRV_CSRS_MSTATUS] = status;
+	cpu->pc = cpu->csrs[FRV_CSRS_SEPC];
+	cpu->irqpoll = 0;
+	frvCpuUpdateMmu(cpu);
+	return true;
+}
 
-	case FRV_INSTCODE_SLTIU: {
-		uint64_t imm = FRV_INST_IMM_I(inst);
-		cpu->regs[rd] = ((cpu->regs[rs1]) < imm) ? 1 : 0;
-		return true;
-	}
+// Traps below M-mode go to S-mode when their bit in medeleg/mideleg is set
+static bool frvCpuDelegated(const struct FrvCPU* const cpu, const uint64_t cause)
+{
+	const uint64_t deleg = cpu->csrs[(cause & FRV_CAUSE_INTERRUPT) ? FRV_CSRS_MIDELEG : FRV_CSRS_MEDELEG];
+	return cpu->priv != FRV_PRIV_M && ((deleg >> (cause & 63)) & 1);
+}
 
-	case FRV_INSTCODE_SLT: {
-		cpu->regs[rd] = (((int64_t)cpu->regs[rs1]) < ((int64_t)(cpu->regs[rs2]))) ? 1 : 0;
-		return true;
-	}
+/* Enter the trap handler, epc is the instruction to return to
+ * A trap vector of 0 means the guest has no handler, then nothing changes and it is false
+ */
+static bool frvCpuTrap(struct FrvCPU* cpu, const uint64_t cause, const uint64_t tval, const uint64_t epc)
+{
+	uint64_t status = cpu->csrs[FRV_CSRS_MSTATUS], tvec;
+	if (frvCpuDelegated(cpu, cause)) {
+		tvec = cpu->csrs[FRV_CSRS_STVEC];
+		if (!tvec) return false;
+		cpu->csrs[FRV_CSRS_SEPC] = epc;
+		cpu->csrs[FRV_CSRS_SCAUSE] = cause;
+		cpu->csrs[FRV_CSRS_STVAL] = tval;
+		status = (status & ~(FRV_MSTATUS_SPIE | FRV_MSTATUS_SPP)) | ((status & FRV_MSTATUS_SIE) ? FRV_MSTATUS_SPIE : 0);
+		status = (status & ~FRV_MSTATUS_SIE) | ((cpu->priv == FRV_PRIV_S) ? FRV_MSTATUS_SPP : 0);
+		cpu->priv = FRV_PRIV_S;
+	} else {
+		tvec = cpu->csrs[FRV_CSRS_MTVEC];
+		if (!tvec) return false;
+		cpu->csrs[FRV_CSRS_MEPC] = epc;
+		cpu->csrs[FRV_CSRS_MCAUSE] = cause;
+		cpu->csrs[FRV_CSRS_MTVAL] = tval;
+		status = (status & ~(FRV_MSTATUS_MPIE | FRV_MSTATUS_MPP)) | ((status & FRV_MSTATUS_MIE) ? FRV_MSTATUS_MPIE : 0);
+		status = (status & ~FRV_MSTATUS_MIE) | ((uint64_t)cpu->priv << FRV_MSTATUS_MPP_SHIFT);
+		cpu->priv = FRV_PRIV_M;
+	}
+	cpu->csrs[FRV_CSRS_MSTATUS] = status;
+
+	// Vectored mode (tvec bit 0) sends the interrupts to base + 4 * cause
+	cpu->pc = tvec & ~3ull;
+	if ((tvec & 1) && (cause & FRV_CAUSE_INTERRUPT)) cpu->pc += 4 * (cause & 63);
+	frvCpuUpdateMmu(cpu);
+	return true;
+}
 
-	case FRV_INSTCODE_SLTU: {
-		cpu->regs[rd] = (cpu->regs[rs1] < cpu->regs[rs2]) ? 1 : 0;
-		return true;
-	}
+/* Take the exception raised by the failed instruction (or fetch) at epc
+ * false to stop: nothing was raised, or it was and the guest has no handler for it
+ */
+static bool frvCpuException(struct FrvCPU* cpu, const uint64_t epc)
+{
+	static const char* const names[] = {
+		"instruction address misaligned", "instruction access fault", "illegal instruction", "breakpoint",
+		"load address misaligned", "load access fault", "store address misaligned", "store access fault",
+		"ecall from U-mode", "ecall from S-mode", "?", "ecall from M-mode",
+		"instruction page fault", "load page fault", "?", "store page fault"
+	};
+	const bool own = (cpu->cause != FRV_CAUSE_NONE);
+	const uint64_t cause = own ? cpu->cause : cpu->mmu.cause;
+	const uint64_t tval = own ? cpu->tval : cpu->mmu.tval;
+	cpu->cause = FRV_CAUSE_NONE;
+	cpu->mmu.cause = FRV_CAUSE_NONE;
+	if (cause == FRV_CAUSE_NONE) return false;
+
+	if (frvCpuTrap(cpu, cause, tval, epc)) return true;
+	fprintf(stderr, "FrvCPU %s at 0x%lx: 0x%lx\n", (cause < 16) ? names[cause] : "?", epc, tval);
+	return false;
+}
 
-	// Loads
-	case FRV_INSTCODE_LB: {
-		uint64_t imm = FRV_INST_IMM_I(inst);
-		uint64_t addr = cpu->regs[rs1] + imm;
-		uint64_t val;
-		if (!frvBusLoad(cpu->bus, addr, 1, &val)) return false;
-		cpu->regs[rd] = (uint64_t)((int64_t)((int8_t) (val)));
-		return true;
-	}
+/* Take the highest priority interrupt that is pending and enabled, only called between blocks
+ * Machine ones are enabled below M-mode or by mstatus.MIE, the delegated ones below S-mode or by SIE
+ */
+static bool frvCpuInterrupt(struct FrvCPU* cpu)
+{
+	static const uint8_t order[] = { 11, 3, 7, 9, 1, 5 }; // MEI, MSI, MTI, SEI, SSI, STI
+	cpu->irqpoll = cpu->instret + FRV_IRQ_POLL_INSTS;
+	if (!cpu->csrs[FRV_CSRS_MIE]) return false; // Spares the CLINT the look at the clock
+
+	const uint64_t status = cpu->csrs[FRV_CSRS_MSTATUS], deleg = cpu->csrs[FRV_CSRS_MIDELEG];
+	const uint64_t pending = frvCpuMip(cpu) & cpu->csrs[FRV_CSRS_MIE];
+	uint64_t irqs = 0;
+	if (cpu->priv != FRV_PRIV_M || (status & FRV_MSTATUS_MIE)) irqs = pending & ~deleg;
+	if (!irqs && (cpu->priv == FRV_PRIV_U || (cpu->priv == FRV_PRIV_S && (status & FRV_MSTATUS_SIE))))
+		irqs = pending & deleg;
+	if (!irqs) return false;
+
+	for (uint32_t i = 0; i < sizeof(order); i++)
+		if (irqs & (1ull << order[i])) return frvCpuTrap(cpu, FRV_CAUSE_INTERRUPT | order[i], 0, cpu->pc);
+	return false;
+}
 
-	case FRV_INSTCODE_LH: {
-		uint64_t imm = FRV_INST_IMM_I(inst);
-		uint64_t addr = cpu->regs[rs1] + imm;
-		uint64_t val;
-		if (!frvBusLoad(cpu->bus, addr, 2, &val)) return false;
-		cpu->regs[rd] = (uint64_t)((int64_t)((int16_t) (val)));
-		return true;
-	}
+/* The env stands in for the M-mode firmware: it serves the ecalls of M-mode and the ones
+ * the guest has no handler for, the Linux env all of them
+ * A fault while it serves one is taken on the ecall
+ */
+static bool frvCpuEcall(struct FrvCPU* cpu)
+{
+	const uint64_t cause = FRV_CAUSE_ECALL_U + cpu->priv;
+	if (cpu->env == FRV_ENV_FRV && cpu->priv != FRV_PRIV_M &&
+	    cpu->csrs[frvCpuDelegated(cpu, cause) ? FRV_CSRS_STVEC : FRV_CSRS_MTVEC])
+		return frvCpuRaise(cpu, cause, 0);
+
+	if (frvEcallExec(cpu)) return true;
+	if (cpu->env == FRV_ENV_LINUX) cpu->mmu.cause = FRV_CAUSE_NONE; // Faults are -EFAULT, this is the exit
+	return false;
+}
 
-	case FRV_INSTCODE_LW: {
-		uint64_t imm = FRV_INST_IMM_I(inst);
-		uint64_t addr = cpu->regs[rs1] + imm;
-		uint64_t val;
-		if (!frvBusLoad(cpu->bus, addr, 4, &val)) return false;
-		cpu->regs[rd] = (uint64_t)((int64_t)((int32_t) (val)));
-		return true;
+void frvCpuPrintRegs(const struct FrvCPU* const cpu)
+{
+	printf("PC => 0x%lX | %ld\n", cpu->pc, cpu->pc);
+	for (int i = 0; i < FRV_NUM_REGS; i++) {
+		printf("x%d => 0x%lX | %ld\n", i, cpu->regs[i], cpu->regs[i]);
 	}
+}
 
-	case FRV_INSTCODE_LD: {
-		uint64_t imm = FRV_INST_IMM_I(inst);
-		uint64_t addr = cpu->regs[rs1] + imm;
-		return frvBusLoad(cpu->bus, addr, 8, &cpu->regs[rd]);
-	}
+void frvCpuPrintCsrs(const struct FrvCPU* const cpu)
+{
+	printf("mstatus=0x%lX\tmtvec=0x%lX\tmepc=0x%lX\tmcause=0x%lX\n",
+                frvLoadCsr(cpu, FRV_CSR_MSTATUS),
+                frvLoadCsr(cpu, FRV_CSR_MTVEC),
+                frvLoadCsr(cpu, FRV_CSR_MEPC),
+                frvLoadCsr(cpu, FRV_CSR_MCAUSE)
+        );
 
-	case FRV_INSTCODE_LBU: {
-		uint64_t imm = FRV_INST_IMM_I(inst);
-		uint64_t addr = cpu->regs[rs1] + imm;
-		return frvBusLoad(cpu->bus, addr, 1, &cpu->regs[rd]);
-	}
+	printf("sstatus=0x%lX\tstvec=0x%lX\tsepc=0x%lX\tscause=0x%lX\n",
+                frvLoadCsr(cpu, FRV_CSR_SSTATUS),
+                frvLoadCsr(cpu, FRV_CSR_STVEC),
+                frvLoadCsr(cpu, FRV_CSR_SEPC),
+                frvLoadCsr(cpu, FRV_CSR_SCAUSE)
+        );
+}
 
-	case FRV_INSTCODE_LHU: {
-		uint64_t imm = FRV_INST_IMM_I(inst);
-		uint64_t addr = cpu->regs[rs1] + imm;
-		return frvBusLoad(cpu->bus, addr, 2, &cpu->regs[rd]);
-	}
+void frvCpuInit(struct FrvCPU* cpu, struct FrvBUS* bus, const uint64_t hartid)
+{
+	memset(cpu, 0, sizeof(*cpu));
+	cpu->regs[FRV_ABI_REG_ZERO] = 0; // x0 hard wired to zero
+	cpu->regs[FRV_ABI_REG_SP] = bus->ram->size + FRV_RAM_BASE_ADDR - hartid * FRV_HART_STACK_SIZE; // x2 stack pointer
+	cpu->regs[FRV_ABI_REG_A0] = hartid;
+	cpu->csrs[FRV_CSRS_MHARTID] = hartid;
+	cpu->csrs[FRV_CSRS_MISA] = FRV_MISA;
+	cpu->csrs[FRV_CSRS_MSTATUS] = frvCpuStatusDirty(FRV_MSTATUS_FS | FRV_MSTATUS_VS); // Both start on, programs use them without setup
+	cpu->csrs[FRV_CSRS_VTYPE] = FRV_VTYPE_VILL; // Until the first vsetvl
+	cpu->csrs[FRV_CSRS_VLENB] = FRV_VLENB;
+	cpu->resaddr = FRV_NO_RESERVATION;
+	cpu->cause = FRV_CAUSE_NONE;
+	cpu->out = stdout;
+	cpu->pc = FRV_RAM_BASE_ADDR; // Program-couter
+	cpu->priv = FRV_PRIV_M;
+	cpu->bus = bus;
+	frvMmuInit(&cpu->mmu, bus);
+	cpu->tcache = frvNewTCache(bus->ram->size);
+#ifdef FRV_JIT
+	cpu->jit = frvNewJit();
+#endif
+#ifdef FRV_PROFILE
+	cpu->prof = frvNewProfile();
+#endif
+}
 
-	case FRV_INSTCODE_LWU: {
-		uint64_t imm = FRV_INST_IMM_I(inst);
-		uint64_t addr = cpu->regs[rs1] + imm;
-		return frvBusLoad(cpu->bus, addr, 4, &cpu->regs[rd]);
-	}
+bool frvIsCpuValid(const struct FrvCPU* const cpu)
+{
+#ifdef FRV_JIT
+	if (!frvIsJitValid(&cpu->jit)) return false;
+#endif
+#ifdef FRV_PROFILE
+	if (!frvIsProfileValid(&cpu->prof)) return false;
+#endif
+	return frvIsTCacheValid(&cpu->tcache);
+}
 
-	// Stores
-	case FRV_INSTCODE_SB: {
-		uint64_t imm = FRV_INST_IMM_S(inst);
-		uint64_t addr = cpu->regs[rs1] + imm;
-		return frvBusStore(cpu->bus, addr, 1, cpu->regs[rs2]);
-	}
+void frvCpuDestroy(struct FrvCPU* cpu)
+{
+#ifdef FRV_JIT
+	frvJitDestroy(&cpu->jit);
+#endif
+#ifdef FRV_PROFILE
+	frvProfileDestroy(&cpu->prof);
+#endif
+	frvTCacheDestroy(&cpu->tcache);
+}
 
-	case FRV_INSTCODE_SH: {
-		uint64_t imm = FRV_INST_IMM_S(inst);
-		uint64_t addr = cpu->regs[rs1] + imm;
-		return frvBusStore(cpu->bus, addr, 2, cpu->regs[rs2]);
+bool frvCpuLoadProgram(struct FrvCPU* cpu, const char* path)
+{
+	const int fd = open(path, O_RDONLY);
+	if (fd == -1) {
+		fprintf(stderr, "Failed to open file: %s [%s]\n", path, strerror(errno));
+		return false;
 	}
 
-	case FRV_INSTCODE_SW: {
-		uint64_t imm = FRV_INST_IMM_S(inst);
-		uint64_t addr = cpu->regs[rs1] + imm;
-		return frvBusStore(cpu->bus, addr, 4, cpu->regs[rs2]);
-	}
+	// ELF executables start at their entry, flat binaries at the start of the RAM
+	bool ok;
+	struct stat sb;
+	struct FrvElfInfo info;
+	if (frvIsElf(fd)) {
+		ok = frvElfLoad(cpu->bus->ram, fd, false, &info);
+		cpu->pc = info.entry;
+	} else if (fstat(fd, &sb) == -1) {
+		fprintf(stderr, "Failed to fetch file size: %s [%s]\n", path, strerror(errno));
+		ok = false;
+	} else {
+		ok = frvRamLoadFile(cpu->bus->ram, fd, 0, 0, sb.st_size);
+		cpu->pc = FRV_RAM_BASE_ADDR;
+	}
+	close(fd);
+	return ok;
+}
 
-	case FRV_INSTCODE_SD: {
-		uint64_t imm = FRV_INST_IMM_S(inst);
-		uint64_t addr = cpu->regs[rs1] + imm;
-		return frvBusStore(cpu->bus, addr, 8, cpu->regs[rs2]);
+#define FRV_SNAPSHOT_MAGIC "FRVSNAP5" // 2: only the implemented CSRs, 3: the FP registers, 4: the vector ones, 5: the CLINT
+#define FRV_SNAPSHOT_RAM_OFF (64 * 1024) // Page aligned for any host page size up to 64KB
+
+// Host endian, snapshots are not meant to move between machines
+struct FrvSnapshot {
+	char		magic[8];
+	uint64_t	ramsize;
+	uint64_t	pc;
+	uint64_t	priv;
+	uint64_t	regs[FRV_NUM_REGS];
+	uint64_t	fregs[FRV_NUM_REGS];
+	uint64_t	csrs[FRV_CSRS_COUNT];
+	uint8_t		vregs[FRV_NUM_VREGS][FRV_VLENB];
+	uint64_t	mtime; // The host clock behind it is not saved, mtime goes on from here
+	uint64_t	mtimecmp[FRV_CLINT_MAX_HARTS];
+	uint32_t	msip[FRV_CLINT_MAX_HARTS];
+};
+
+_Static_assert(sizeof(struct FrvSnapshot) <= FRV_SNAPSHOT_RAM_OFF, "snapshot header overlaps the RAM image");
+
+static bool frvCpuReadSnapshot(const int fd, const char* path, struct FrvSnapshot* snap)
+{
+	if (pread(fd, snap, sizeof(*snap), 0) != sizeof(*snap) ||
+	    memcmp(snap->magic, FRV_SNAPSHOT_MAGIC, sizeof(snap->magic))) {
+		fprintf(stderr, "Snapshot restore failed: %s is not a snapshot\n", path);
+		return false;
 	}
+	return true;
+}
 
-	// Upper immidiate
-	case FRV_INSTCODE_LUI: {
-		cpu->regs[rd] = FRV_INST_IMM_U(inst);
-		return true;
+/* Written next to path and renamed over it once complete, running guests may still map the old file
+ * privately and the pages they did not write yet have to stay behind it
+ */
+bool frvCpuSaveSnapshot(const struct FrvCPU* const cpu, const char* path)
+{
+	char tmp[strlen(path) + sizeof(".XXXXXX")];
+	sprintf(tmp, "%s.XXXXXX", path);
+	const int fd = mkstemp(tmp);
+	if (fd == -1 || fchmod(fd, 0644) == -1) {
+		fprintf(stderr, "Failed to open file: %s [%s]\n", tmp, strerror(errno));
+		if (fd != -1) {
+			close(fd);
+			unlink(tmp);
+		}
+		return false;
 	}
 
-	case FRV_INSTCODE_AUIPC: {
-		cpu->regs[rd] = cpu->pc + FRV_INST_IMM_U(inst) - 4;
-		return true;
+	struct FrvSnapshot snap = { 0 };
+	memcpy(snap.magic, FRV_SNAPSHOT_MAGIC, sizeof(snap.magic));
+	snap.ramsize = cpu->bus->ram->size;
+	snap.pc = cpu->pc;
+	snap.priv = cpu->priv;
+	memcpy(snap.regs, cpu->regs, sizeof(snap.regs));
+	memcpy(snap.fregs, cpu->fregs, sizeof(snap.fregs));
+	memcpy(snap.csrs, cpu->csrs, sizeof(snap.csrs));
+	memcpy(snap.vregs, cpu->vregs, sizeof(snap.vregs));
+	snap.csrs[FRV_CSRS_FCSR] |= frvFpuFlags();
+	// The retired count starts over on restore, the counters are saved as their value
+	snap.csrs[FRV_CSRS_MCYCLE] += frvCpuInstret(cpu);
+	snap.csrs[FRV_CSRS_MINSTRET] += frvCpuInstret(cpu);
+	if (cpu->bus->clint) {
+		snap.mtime = frvClintTime(cpu->bus->clint);
+		memcpy(snap.mtimecmp, cpu->bus->clint->mtimecmp, sizeof(snap.mtimecmp));
+		memcpy(snap.msip, cpu->bus->clint->msip, sizeof(snap.msip));
+	}
+
+	bool ok = (pwrite(fd, &snap, sizeof(snap), 0) == sizeof(snap));
+	if (!ok) fprintf(stderr, "Snapshot save failed: %s\n", strerror(errno));
+	ok = ok && frvRamSaveFile(cpu->bus->ram, fd, FRV_SNAPSHOT_RAM_OFF);
+	if (ok && fsync(fd) == -1) {
+		fprintf(stderr, "Snapshot save failed: %s\n", strerror(errno));
+		ok = false;
+	}
+	if ((close(fd) == -1 && ok) || (ok && rename(tmp, path) == -1)) {
+		fprintf(stderr, "Snapshot save failed: %s\n", strerror(errno));
+		ok = false;
+	}
+	if (!ok) unlink(tmp);
+	return ok;
+}
+
+bool frvCpuRestoreSnapshot(struct FrvCPU* cpu, const char* path)
+{
+	const int fd = open(path, O_RDONLY);
+	if (fd == -1) {
+		fprintf(stderr, "Failed to open file: %s [%s]\n", path, strerror(errno));
+		return false;
 	}
 
-	// Jumps
-	case FRV_INSTCODE_JAL: {
-		cpu->regs[rd] = cpu->pc;
-		uint64_t imm = FRV_INST_IMM_J(inst);
-		cpu->pc += imm - 4;
-		return true;
-        }
+	struct FrvSnapshot snap;
+	bool ok = frvCpuReadSnapshot(fd, path, &snap);
+	if (ok && snap.ramsize != cpu->bus->ram->size) {
+		fprintf(stderr, "Snapshot restore failed: it needs %luMB of RAM\n", snap.ramsize >> 20);
+		ok = false;
+	}
+	// The mapping outlives the fd
+	ok = ok && frvRamLoadFile(cpu->bus->ram, fd, 0, FRV_SNAPSHOT_RAM_OFF, snap.ramsize);
+	close(fd);
+	if (!ok) return false;
+
+	cpu->pc = snap.pc;
+	cpu->priv = snap.priv;
+	memcpy(cpu->regs, snap.regs, sizeof(cpu->regs));
+	memcpy(cpu->fregs, snap.fregs, sizeof(cpu->fregs));
+	memcpy(cpu->csrs, snap.csrs, sizeof(cpu->csrs));
+	memcpy(cpu->vregs, snap.vregs, sizeof(cpu->vregs));
+	if (cpu->bus->clint) {
+		memcpy(cpu->bus->clint->mtimecmp, snap.mtimecmp, sizeof(snap.mtimecmp));
+		memcpy(cpu->bus->clint->msip, snap.msip, sizeof(snap.msip));
+		frvClintSetTime(cpu->bus->clint, snap.mtime);
+	}
+	frvTCacheFlush(&cpu->tcache);
+	frvCpuUpdateMmu(cpu);
+	return true;
+}
 
-	case FRV_INSTCODE_JALR: {
-		uint64_t tmp = cpu->pc;
-		uint64_t imm = FRV_INST_IMM_I(inst);
-                cpu->pc = (cpu->regs[rs1] + imm) & (~1);
-                cpu->regs[rd] = tmp;
-		return true;
-        }
+uint64_t frvCpuSnapshotRamSize(const char* path)
+{
+	const int fd = open(path, O_RDONLY);
+	if (fd == -1) {
+		fprintf(stderr, "Failed to open file: %s [%s]\n", path, strerror(errno));
+		return 0;
+	}
+	struct FrvSnapshot snap;
+	const bool ok = frvCpuReadSnapshot(fd, path, &snap);
+	close(fd);
+	return ok ? snap.ramsize : 0;
+}
 
-	// Branch
-	case FRV_INSTCODE_BEQ: {
-		uint64_t imm = FRV_INST_IMM_B(inst);
-		if (cpu->regs[rs1] == cpu->regs[rs2]) {
-                            cpu->pc += imm; cpu->pc -= 4; 
-		}
-		return true;
-        }
-	
-	case FRV_INSTCODE_BNE: {
-		uint64_t imm = FRV_INST_IMM_B(inst);
-		if (cpu->regs[rs1] != cpu->regs[rs2]) {
-                            cpu->pc += imm; cpu->pc -= 4;
-		}
+// Branches and jumps end a block, as does anything that has to be seen by the run loop
+static bool frvCpuIsBlockEnd(const uint8_t op)
+{
+	switch (op) {
+	case FRV_OP_JAL:
+	case FRV_OP_JALR:
+	case FRV_OP_BEQ:
+	case FRV_OP_BNE:
+	case FRV_OP_BLT:
+	case FRV_OP_BLTU:
+	case FRV_OP_BGE:
+	case FRV_OP_BGEU:
+	case FRV_OP_ECALL:
+	case FRV_OP_EBREAK:
+	case FRV_OP_SRET:
+	case FRV_OP_MRET:
+	case FRV_OP_WFI:
+	case FRV_OP_SFENCEVMA:
+	case FRV_OP_FENCEI:
+	case FRV_OP_ILLEGAL:
 		return true;
-        }
+	default:
+		return false;
+	}
+}
 
-	case FRV_INSTCODE_BLT: {
-		uint64_t imm = FRV_INST_IMM_B(inst);
-		if (((int64_t)cpu->regs[rs1]) < ((int64_t)cpu->regs[rs2])) {
-                            cpu->pc += imm; cpu->pc -= 4;
+// Fetch and decode the straight-line code at pc into a new block, NULL with the fault raised
+static struct FrvBlock* frvCpuTranslate(struct FrvCPU* cpu)
+{
+	if (cpu->pc & 1) {
+		frvCpuRaise(cpu, FRV_CAUSE_MISALIGNED_FETCH, cpu->pc);
+		return NULL;
+	}
+
+	/* Compressed instructions are expanded here, once per translation
+	 * A 32-bit one may straddle two pages, it is fetched a half at a time and ends the block
+	 */
+	struct FrvBlock* block = frvTCacheAlloc(&cpu->tcache, cpu->pc);
+	const uint64_t page = cpu->pc & ~(uint64_t)(FRV_BLOCK_PAGE_SIZE - 1);
+	uint64_t pc = cpu->pc;
+	do {
+		struct FrvInst* inst = &block->insts[block->len];
+		uint16_t lo, hi;
+		uint64_t phys, phys2;
+		if (!frvMmuFetch(&cpu->mmu, pc, &lo, &phys)) break;
+		if (FRV_RVC_IS_COMPRESSED(lo)) {
+			frvCpuDecode(frvRvcExpand(lo), inst);
+			inst->len = 2;
+			frvTCacheMarkCode(&cpu->tcache, phys, 2);
+		} else {
+			if (!frvMmuFetch(&cpu->mmu, pc + 2, &hi, &phys2)) break;
+			frvCpuDecode(lo | ((uint32_t)hi << 16), inst);
+			inst->len = 4;
+			frvTCacheMarkCode(&cpu->tcache, phys, 2);
+			frvTCacheMarkCode(&cpu->tcache, phys2, 2);
 		}
-		return true;
-        }
+		pc += inst->len;
+	} while (!frvCpuIsBlockEnd(block->insts[block->len++].op) &&
+		 block->len < FRV_BLOCK_MAX_INSTS && (pc & ~(uint64_t)(FRV_BLOCK_PAGE_SIZE - 1)) == page);
+
+	if (block->len == 0) return NULL;
+	cpu->mmu.cause = FRV_CAUSE_NONE; // A later instruction that failed to fetch faults when it starts a block
+	frvTCacheCommit(&cpu->tcache, block);
+	return block;
+}
 
-	case FRV_INSTCODE_BLTU: {
-		uint64_t imm = FRV_INST_IMM_B(inst);
-		if (cpu->regs[rs1] < cpu->regs[rs2]) {
-                            cpu->pc += imm; cpu->pc -= 4;
+// TLB misses and stores crossing a page, the crossing ones are split into bytes
+static bool frvCpuStoreSlow(struct FrvCPU* cpu, const uint64_t addr, const uint64_t size, const uint64_t val)
+{
+	uint64_t paddr;
+	if ((addr & FRV_BUS_PAGE_MASK) > FRV_BUS_PAGE_SIZE - size) {
+		for (uint64_t i = 0; i < size; i++) {
+			if (!frvMmuStore(&cpu->mmu, addr + i, 1, val >> (8 * i), &paddr)) return false;
+			frvTCacheInvalidate(&cpu->tcache, paddr, 1);
 		}
-		return true;
-        }
+		return !cpu->tcache.stale;
+	}
+	if (!frvMmuStore(&cpu->mmu, addr, size, val, &paddr)) return false;
+	frvTCacheInvalidate(&cpu->tcache, paddr, size);
+	return !cpu->tcache.stale;
+}
 
-	case FRV_INSTCODE_BGE: {
-		uint64_t imm = FRV_INST_IMM_B(inst);
-		if (((int64_t)cpu->regs[rs1]) >= ((int64_t)cpu->regs[rs2])) {
-                            cpu->pc += imm; cpu->pc -= 4;
-		}
-		return true;
-        }
+// Stores have to drop the blocks they overwrite
+static inline bool frvCpuStore(struct FrvCPU* cpu, const uint64_t addr, const uint64_t size, const uint64_t val)
+{
+	const struct FrvMmuEntry* e = frvMmuDtlb(&cpu->mmu, addr);
+	const uint64_t off = addr & FRV_BUS_PAGE_MASK;
+	if (e->wtag == (addr >> FRV_BUS_PAGE_SHIFT) && off <= FRV_BUS_PAGE_SIZE - size) {
+		frvRamWrite(e->host + off, size, val);
+		frvTCacheInvalidate(&cpu->tcache, e->phys + off, size);
+		return !cpu->tcache.stale;
+	}
+	return frvCpuStoreSlow(cpu, addr, size, val);
+}
 
-	case FRV_INSTCODE_BGEU: {
-		uint64_t imm = FRV_INST_IMM_B(inst);
-		if (cpu->regs[rs1] >= cpu->regs[rs2]) {
-                            cpu->pc += imm; cpu->pc -= 4;
-		}
-		return true;
-        }
+/* Host memory behind an atomic access, which has to be aligned and in RAM
+ * Atomics work on the host words directly, so this assumes a little-endian host
+ */
+static uint8_t* frvCpuAtomicHost(struct FrvCPU* cpu, const uint64_t addr, const uint64_t size,
+				 const enum FrvAccess access, uint64_t* paddr)
+{
+	const bool store = (access == FRV_ACCESS_STORE);
+	uint8_t* host;
+	if (addr & (size - 1)) {
+		frvCpuRaise(cpu, store ? FRV_CAUSE_MISALIGNED_STORE : FRV_CAUSE_MISALIGNED_LOAD, addr);
+		return NULL;
+	}
+	if (!frvMmuHost(&cpu->mmu, addr, access, &host, paddr)) return NULL;
+	if (!host) frvCpuRaise(cpu, store ? FRV_CAUSE_STORE_ACCESS : FRV_CAUSE_LOAD_ACCESS, addr);
+	return host;
+}
 
-	// ECALL
-	case FRV_INSTCODE_ECALL: {
-		return frvEcallExec(cpu);
-	}
+// funct5 of the AMOs
+#define FRV_AMO_ADD	(0x00)
+#define FRV_AMO_SWAP	(0x01)
+#define FRV_AMO_XOR	(0x04)
+#define FRV_AMO_OR	(0x08)
+#define FRV_AMO_AND	(0x0c)
+#define FRV_AMO_MIN	(0x10)
+#define FRV_AMO_MAX	(0x14)
+#define FRV_AMO_MINU	(0x18)
+#define FRV_AMO_MAXU	(0x1c)
+
+/* The read-modify-write on the host word, returns the old value
+ * Everything is sequentially consistent, which covers any aq/rl combination
+ * Min and max have no builtin and retry a compare-and-swap instead
+ */
+#define FRV_CPU_AMO(name, type, stype)								\
+static type name(type* p, const uint32_t funct5, const type val)				\
+{												\
+	switch (funct5) {									\
+	case FRV_AMO_SWAP:	return __atomic_exchange_n(p, val, __ATOMIC_SEQ_CST);		\
+	case FRV_AMO_ADD:	return __atomic_fetch_add(p, val, __ATOMIC_SEQ_CST);		\
+	case FRV_AMO_XOR:	return __atomic_fetch_xor(p, val, __ATOMIC_SEQ_CST);		\
+	case FRV_AMO_OR:	return __atomic_fetch_or(p, val, __ATOMIC_SEQ_CST);		\
+	case FRV_AMO_AND:	return __atomic_fetch_and(p, val, __ATOMIC_SEQ_CST);		\
+	default: {										\
+		type old = __atomic_load_n(p, __ATOMIC_RELAXED), next;				\
+		do {										\
+			switch (funct5) {							\
+			case FRV_AMO_MIN:	next = ((stype)old < (stype)val) ? old : val; break;	\
+			case FRV_AMO_MAX:	next = ((stype)old > (stype)val) ? old : val; break;	\
+			case FRV_AMO_MINU:	next = (old < val) ? old : val; break;		\
+			default:		next = (old > val) ? old : val; break;		\
+			}									\
+		} while (!__atomic_compare_exchange_n(p, &old, next, true, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)); \
+		return old;									\
+	}											\
+	}											\
+}
 
-	// CSRs
-	case FRV_INSTCODE_CSRRW: {
-		cpu->regs[rd] = frvLoadCsr(cpu, csr);
-		frvStoreCsr(cpu, csr, cpu->regs[rs1]);
-		return true;
-	}
+FRV_CPU_AMO(frvCpuAmo32, uint32_t, int32_t)
+FRV_CPU_AMO(frvCpuAmo64, uint64_t, int64_t)
 
-	case FRV_INSTCODE_CSRRS: {
-		cpu->regs[rd] = frvLoadCsr(cpu, csr);
-		frvStoreCsr(cpu, csr, cpu->regs[rs1] | cpu->regs[rd]);
-		return true;
-	}
+static bool frvCpuAmo(struct FrvCPU* cpu, const struct FrvInst* inst)
+{
+	const bool word = (FRV_INST_FUNCT3(inst->raw) == 0x2);
+	const uint64_t addr = cpu->regs[inst->rs1], val = cpu->regs[inst->rs2];
+	uint64_t paddr;
+	uint8_t* host = frvCpuAtomicHost(cpu, addr, word ? 4 : 8, FRV_ACCESS_STORE, &paddr);
+	if (!host) return false;
+
+	if (word) cpu->regs[inst->rd] = (uint64_t)(int64_t)(int32_t)frvCpuAmo32((uint32_t*)host, inst->raw >> 27, val);
+	else cpu->regs[inst->rd] = frvCpuAmo64((uint64_t*)host, inst->raw >> 27, val);
+	frvTCacheInvalidate(&cpu->tcache, paddr, word ? 4 : 8);
+	return !cpu->tcache.stale;
+}
 
-	case FRV_INSTCODE_CSRRC: {
-		cpu->regs[rd] = frvLoadCsr(cpu, csr);
-		frvStoreCsr(cpu, csr, (~cpu->regs[rs1]) & cpu->regs[rd]);
-		return true;
+/* LR/SC without any lock: LR remembers the value it read and SC is a compare-and-swap
+ * against it, so it fails once another hart changed the word (but not if it wrote the same value back)
+ */
+static bool frvCpuLr(struct FrvCPU* cpu, const struct FrvInst* inst)
+{
+	const bool word = (FRV_INST_FUNCT3(inst->raw) == 0x2);
+	const uint64_t addr = cpu->regs[inst->rs1];
+	uint64_t paddr;
+	uint8_t* host = frvCpuAtomicHost(cpu, addr, word ? 4 : 8, FRV_ACCESS_LOAD, &paddr);
+	if (!host) return false;
+
+	cpu->resaddr = addr;
+	if (word) {
+		cpu->resval = __atomic_load_n((uint32_t*)host, __ATOMIC_SEQ_CST);
+		cpu->regs[inst->rd] = (uint64_t)(int64_t)(int32_t)cpu->resval;
+	} else {
+		cpu->resval = __atomic_load_n((uint64_t*)host, __ATOMIC_SEQ_CST);
+		cpu->regs[inst->rd] = cpu->resval;
 	}
+	return true;
+}
 
-	case FRV_INSTCODE_CSRRWI: {
-		cpu->regs[rd] = frvLoadCsr(cpu, csr);
-		frvStoreCsr(cpu, csr, rs1); // Rs1 is the same as imm here
-		return true;
-	}
+static bool frvCpuSc(struct FrvCPU* cpu, const struct FrvInst* inst)
+{
+	const bool word = (FRV_INST_FUNCT3(inst->raw) == 0x2);
+	const uint64_t addr = cpu->regs[inst->rs1], val = cpu->regs[inst->rs2];
+	const uint64_t reserved = cpu->resaddr;
+	cpu->resaddr = FRV_NO_RESERVATION;
+	uint64_t paddr;
+	uint8_t* host = frvCpuAtomicHost(cpu, addr, word ? 4 : 8, FRV_ACCESS_STORE, &paddr);
+	if (!host) return false;
+
+	bool ok = false;
+	if (reserved == addr) {
+		uint32_t old32 = cpu->resval;
+		uint64_t old64 = cpu->resval;
+		ok = word ? __atomic_compare_exchange_n((uint32_t*)host, &old32, (uint32_t)val, false,
+							__ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST) :
+			    __atomic_compare_exchange_n((uint64_t*)host, &old64, val, false,
+							__ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+	}
+	cpu->regs[inst->rd] = !ok;
+	if (ok) frvTCacheInvalidate(&cpu->tcache, paddr, word ? 4 : 8);
+	return !cpu->tcache.stale;
+}
 
-	case FRV_INSTCODE_CSRRSI: {
-		cpu->regs[rd] = frvLoadCsr(cpu, csr);
-		frvStoreCsr(cpu, csr, rs1 | cpu->regs[rd]); // Rs1 is the same as imm here
-		return true;
-	}
+// The vector unit is off while VS is 0, and everything but vsetvl* needs a vtype that is not vill
+static inline bool frvCpuVecOn(const struct FrvCPU* const cpu)
+{
+	return (cpu->csrs[FRV_CSRS_MSTATUS] & FRV_MSTATUS_VS) && !(cpu->csrs[FRV_CSRS_VTYPE] & FRV_VTYPE_VILL);
+}
 
-	case FRV_INSTCODE_CSRRCI: {
-		cpu->regs[rd] = frvLoadCsr(cpu, csr);
-		frvStoreCsr(cpu, csr, (~rs1) & cpu->regs[rd]); // Rs1 is the same as imm here
-		return true;
-	}
+static inline uint32_t frvCpuVecSew(const uint64_t vtype)
+{
+	return (vtype & FRV_VTYPE_VSEW) >> FRV_VTYPE_VSEW_SHIFT;
+}
 
-	// M-extension
-	case FRV_INSTCODE_MUL: {
-		cpu->regs[rd] = (int64_t)cpu->regs[rs1] * (int64_t)cpu->regs[rs2];
-		return true;
-        }
+// log2 of LMUL, the fractional ones are negative and the reserved vlmul 4 is -4
+static inline int32_t frvCpuVecLmul(const uint64_t vtype)
+{
+	const int32_t vlmul = vtype & FRV_VTYPE_VLMUL;
+	return (vlmul & 4) ? vlmul - 8 : vlmul;
+}
 
-	case FRV_INSTCODE_MULH: {
-		cpu->regs[rd] = frvMulh((int64_t)cpu->regs[rs1], (int64_t)cpu->regs[rs2]);
-		return true;
-        }
+/* vsetvli, vsetivli and vsetvl: vl is the requested length up to VLMAX
+ * rs1 = x0 asks for VLMAX, or keeps vl when rd is x0 too. A vtype the unit does not support
+ * (a reserved field, SEW above LMUL * ELEN) sets vill and vl 0
+ */
+static bool frvCpuVset(struct FrvCPU* cpu, const struct FrvInst* inst)
+{
+	if (!(cpu->csrs[FRV_CSRS_MSTATUS] & FRV_MSTATUS_VS)) return frvCpuIllegal(cpu, inst);
+	const uint64_t vtype = (inst->op == FRV_OP_VSETVL) ? cpu->regs[inst->rs2] : (uint64_t)inst->imm;
+	uint64_t avl = inst->rs1;
+	if (inst->op != FRV_OP_VSETIVLI) {
+		if (inst->rs1) avl = cpu->regs[inst->rs1];
+		else avl = inst->rd ? UINT64_MAX : cpu->csrs[FRV_CSRS_VL];
+	}
+
+	const uint32_t sew = frvCpuVecSew(vtype);
+	const int32_t lmul = frvCpuVecLmul(vtype);
+	cpu->csrs[FRV_CSRS_VSTART] = 0;
+	if ((vtype & ~(uint64_t)FRV_VTYPE_MASK) || sew > 3 || lmul == -4 || (int32_t)sew > 3 + lmul) {
+		cpu->csrs[FRV_CSRS_VTYPE] = FRV_VTYPE_VILL;
+		cpu->csrs[FRV_CSRS_VL] = 0;
+	} else {
+		const uint64_t vlmax = (lmul >= 0) ? (FRV_VLENB >> sew) << lmul : (FRV_VLENB >> sew) >> -lmul;
+		cpu->csrs[FRV_CSRS_VTYPE] = vtype;
+		cpu->csrs[FRV_CSRS_VL] = (avl < vlmax) ? avl : vlmax;
+	}
+	cpu->regs[inst->rd] = cpu->csrs[FRV_CSRS_VL];
+	return true;
+}
 
-	case FRV_INSTCODE_MULHU: {
-		cpu->regs[rd] = frvMulhu(cpu->regs[rs1], cpu->regs[rs2]);
-		return true;
-        }
+// The register group starting at reg for an EMUL of 2^emul, NULL if reg is not a multiple of it
+static inline uint8_t* frvCpuVecGroup(struct FrvCPU* cpu, const uint32_t reg, const int32_t emul)
+{
+	if (emul > 0 && (reg & ((1u << emul) - 1))) return NULL;
+	return cpu->vregs[reg];
+}
 
-	case FRV_INSTCODE_MULHSU: {
-		cpu->regs[rd] = frvMulhsu((int64_t)cpu->regs[rs1], cpu->regs[rs2]);
-		return true;
-        }
+/* What every vector instruction shares: the unit is on, vd is a group of 2^emul registers
+ * and, as a destination (dest) of a masked instruction, not v0. False if it is illegal
+ */
+static bool frvCpuVecArgs(struct FrvCPU* cpu, const struct FrvInst* inst, const uint32_t sew, const int32_t emul,
+			  const bool dest, struct FrvVecArgs* a)
+{
+	const bool masked = !((inst->raw >> 25) & 1);
+	a->vd = frvCpuVecGroup(cpu, inst->rd, emul);
+	a->vs2 = NULL;
+	a->vs1 = NULL;
+	a->mask = masked ? cpu->vregs[0] : NULL;
+	a->scalar = 0;
+	a->sew = sew;
+	a->vstart = cpu->csrs[FRV_CSRS_VSTART];
+	a->vl = cpu->csrs[FRV_CSRS_VL];
+	return frvCpuVecOn(cpu) && a->vd && !(dest && masked && inst->rd == 0);
+}
 
-	case FRV_INSTCODE_MULW: {
-		cpu->regs[rd] = frvMulw(cpu->regs[rs1], cpu->regs[rs2]);
-		return true;
-	}
+/* The element-wise ops, funct3 picks the form of the first operand: a group (.vv), x[rs1] (.vx)
+ * or simm5 (.vi, unsigned for the shifts). vmv.v.* is vmerge unmasked, with vs2 0
+ */
+static bool frvCpuVecArith(struct FrvCPU* cpu, const struct FrvInst* inst)
+{
+	const uint64_t vtype = cpu->csrs[FRV_CSRS_VTYPE];
+	const int32_t lmul = frvCpuVecLmul(vtype);
+	struct FrvVecArgs a;
+	if (!frvCpuVecArgs(cpu, inst, frvCpuVecSew(vtype), lmul, true, &a) ||
+	    !(a.vs2 = frvCpuVecGroup(cpu, inst->rs2, lmul)) || (inst->op == FRV_OP_VMERGE && !a.mask && inst->rs2))
+		return frvCpuIllegal(cpu, inst);
+
+	switch (FRV_INST_FUNCT3(inst->raw)) {
+	case 0x0: // OPIVV, OPMVV
+	case 0x2:
+		if (!(a.vs1 = frvCpuVecGroup(cpu, inst->rs1, lmul))) return frvCpuIllegal(cpu, inst);
+		break;
+	case 0x3: // OPIVI
+		if (inst->op == FRV_OP_VSLL || inst->op == FRV_OP_VSRL || inst->op == FRV_OP_VSRA) a.scalar = inst->rs1;
+		else a.scalar = (uint64_t)(int64_t)inst->imm;
+		break;
+	default: // OPIVX, OPMVX
+		a.scalar = cpu->regs[inst->rs1];
+		break;
+	}
+	frvVecArith(inst->op, &a);
+	cpu->csrs[FRV_CSRS_VSTART] = 0;
+	return true;
+}
 
-	case FRV_INSTCODE_DIV: {
-		cpu->regs[rd] = (cpu->regs[rs2]) ? (((int64_t)cpu->regs[rs1]) / ((int64_t)cpu->regs[rs2])) :
-				-1;
-		return true;
-	}
+// vd[0] = vs1[0] op the active elements of vs2, vd and vs1 are single registers and vstart has to be 0
+static bool frvCpuVecReduce(struct FrvCPU* cpu, const struct FrvInst* inst)
+{
+	const uint64_t vtype = cpu->csrs[FRV_CSRS_VTYPE];
+	struct FrvVecArgs a;
+	if (!frvCpuVecArgs(cpu, inst, frvCpuVecSew(vtype), 0, false, &a) || a.vstart ||
+	    !(a.vs2 = frvCpuVecGroup(cpu, inst->rs2, frvCpuVecLmul(vtype))))
+		return frvCpuIllegal(cpu, inst);
+
+	a.vs1 = cpu->vregs[inst->rs1];
+	if (a.vl) frvVecReduce(inst->op, &a);
+	return true;
+}
 
-	case FRV_INSTCODE_DIVU: {
-		cpu->regs[rd] = (cpu->regs[rs2]) ? (cpu->regs[rs1] / cpu->regs[rs2]) : UINT64_MAX;
-		return true;
-	}
+// vmv.x.s and vmv.s.x, element 0 whatever vl is (vmv.s.x only writes it when vl is not 0)
+static bool frvCpuVecMove(struct FrvCPU* cpu, const struct FrvInst* inst)
+{
+	if (!frvCpuVecOn(cpu) || !((inst->raw >> 25) & 1)) return frvCpuIllegal(cpu, inst);
+	const uint32_t size = 1u << frvCpuVecSew(cpu->csrs[FRV_CSRS_VTYPE]), shift = 64 - 8 * size;
+	if (inst->op == FRV_OP_VMVXS)
+		cpu->regs[inst->rd] = (uint64_t)((int64_t)(frvRamRead(cpu->vregs[inst->rs2], size) << shift) >> shift);
+	else if (cpu->csrs[FRV_CSRS_VSTART] < cpu->csrs[FRV_CSRS_VL])
+		frvRamWrite(cpu->vregs[inst->rd], size, cpu->regs[inst->rs1]);
+	cpu->csrs[FRV_CSRS_VSTART] = 0;
+	return true;
+}
 
-	case FRV_INSTCODE_DIVW: {
-		cpu->regs[rd] = frvDivw(cpu->regs[rs1], cpu->regs[rs2]);
-		return true;
-	}
+/* Unit-stride and strided loads and stores, the width (EEW) is in funct3 and EMUL = EEW / SEW * LMUL
+ * Contiguous elements move a page at a time, the strided ones, masked stores and pages that are
+ * not RAM or fault an element at a time, so masked-off elements never fault
+ * Loads gather into buf and merge it into vd like an element-wise op
+ * A fault leaves the elements before it done and vstart at the faulting one
+ */
+static bool frvCpuVecMem(struct FrvCPU* cpu, const struct FrvInst* inst)
+{
+	const bool store = (inst->op == FRV_OP_VSE || inst->op == FRV_OP_VSSE);
+	const uint64_t vtype = cpu->csrs[FRV_CSRS_VTYPE];
+	const uint32_t funct3 = FRV_INST_FUNCT3(inst->raw), eew = funct3 ? funct3 - 4 : 0;
+	const int32_t emul = frvCpuVecLmul(vtype) + (int32_t)eew - (int32_t)frvCpuVecSew(vtype);
+	struct FrvVecArgs a;
+	if (!frvCpuVecArgs(cpu, inst, eew, emul, !store, &a) || emul < -3 || emul > 3) return frvCpuIllegal(cpu, inst);
+
+	const uint64_t size = 1ull << eew, base = cpu->regs[inst->rs1];
+	const uint64_t stride = (inst->op == FRV_OP_VLSE || inst->op == FRV_OP_VSSE) ? cpu->regs[inst->rs2] : size;
+	uint8_t buf[FRV_VEC_GROUP_MAX];
+	uint32_t i = a.vstart;
+	while (i < a.vl) {
+		const uint64_t addr = base + i * stride;
+		uint64_t n = 1;
+		if (stride == size && !(store && a.mask)) {
+			uint8_t* host;
+			uint64_t paddr;
+			n = (FRV_BUS_PAGE_SIZE - (addr & FRV_BUS_PAGE_MASK)) / size;
+			n = (n < a.vl - i) ? n : a.vl - i;
+			if (n && frvMmuHost(&cpu->mmu, addr, store ? FRV_ACCESS_STORE : FRV_ACCESS_LOAD, &host, &paddr) && host) {
+				if (store) {
+					memcpy(host, a.vd + i * size, n * size);
+					frvTCacheInvalidateRange(&cpu->tcache, paddr, n * size);
+				} else {
+					memcpy(buf + i * size, host, n * size);
+				}
+				i += n;
+				continue;
+			}
+			cpu->mmu.cause = FRV_CAUSE_NONE; // Taken again by the first element that is active
+			n = n ? n : 1; // An element straddling the page
+		}
 
-	case FRV_INSTCODE_DIVUW: {
-		cpu->regs[rd] = frvDivuw(cpu->regs[rs1], cpu->regs[rs2]);
-		return true;
+		for (const uint32_t end = i + n; i < end; i++) {
+			const uint64_t eaddr = base + i * stride;
+			uint64_t val;
+			if (a.mask && !((a.mask[i >> 3] >> (i & 7)) & 1)) continue;
+			if (store) {
+				if (!frvCpuStore(cpu, eaddr, size, frvRamRead(a.vd + i * size, size)) &&
+				    cpu->mmu.cause != FRV_CAUSE_NONE) {
+					cpu->csrs[FRV_CSRS_VSTART] = i;
+					return false;
+				}
+			} else if (frvMmuLoadFast(&cpu->mmu, eaddr, size, &val)) {
+				frvRamWrite(buf + i * size, size, val);
+			} else {
+				cpu->csrs[FRV_CSRS_VSTART] = i;
+				a.vl = i;
+				a.vs2 = buf;
+				frvVecArith(inst->op, &a);
+				return false;
+			}
+		}
 	}
 
-	case FRV_INSTCODE_REM: {
-		cpu->regs[rd] = (cpu->regs[rs2]) ? (((int64_t)cpu->regs[rs1]) % ((int64_t)cpu->regs[rs2])) :
-				cpu->regs[rs1];
-		return true;
+	if (!store) {
+		a.vs2 = buf;
+		frvVecArith(inst->op, &a);
 	}
+	cpu->csrs[FRV_CSRS_VSTART] = 0;
+	return !cpu->tcache.stale;
+}
 
-	case FRV_INSTCODE_REMU: {
-		cpu->regs[rd] = (cpu->regs[rs2]) ? (cpu->regs[rs1] % cpu->regs[rs2]) : cpu->regs[rs1];
-		return true;
-	}
+#if !defined(FRV_THREADED) || defined(FRV_JIT)
+// The portable switch core, runs one instruction per call
+static bool frvCpuExec(struct FrvCPU* cpu, const struct FrvInst* inst)
+{
+#define FRV_OP(name)	case FRV_OP_##name:
+#define FRV_NEXT()	return true
+#define FRV_FAIL()	return false
+#define FRV_CHECK(ok)	do { if (!(ok)) FRV_FAIL(); } while (0)
+	switch (inst->op) {
+#include "exec.inc"
+	}
+#undef FRV_OP
+#undef FRV_NEXT
+#undef FRV_FAIL
+#undef FRV_CHECK
+	return false;
+}
+#endif
 
-	case FRV_INSTCODE_REMW: {
-		cpu->regs[rd] = frvRemw(cpu->regs[rs1], cpu->regs[rs2]);
-		return true;
-	}
+#ifdef FRV_JIT
+int frvCpuJitExec(struct FrvCPU* cpu, const struct FrvInst* inst)
+{
+	cpu->regs[0] = 0;
+	if (frvCpuExec(cpu, inst)) return FRV_JIT_CONTINUE;
+	return cpu->tcache.stale ? FRV_JIT_LEAVE : FRV_JIT_STOP;
+}
+#endif
 
-	case FRV_INSTCODE_REMUW: {
-		cpu->regs[rd] = frvRemuw(cpu->regs[rs1], cpu->regs[rs2]);
-		return true;
+#ifdef FRV_TRACE
+// Run one instruction and record it, what it wrote is read back from its destination register
+static bool frvCpuExecTraced(struct FrvCPU* cpu, const struct FrvInst* inst)
+{
+	const uint32_t raw = inst->raw;
+	const uint64_t pc = cpu->pc - inst->len;
+	const uint64_t base = cpu->regs[inst->rs1];
+	const uint64_t imm = inst->imm;
+	const bool vec = (FRV_INST_FUNCT3(raw) == 0x0 || FRV_INST_FUNCT3(raw) >= 0x5); // Vector ones of 0x07/0x27
+	uint64_t addr = 0;
+	uint8_t flags = (inst->rd) ? FRV_TRACE_XREG : 0;
+	switch (FRV_INST_OPCODE(raw)) {
+	case 0x03: // Loads and atomics write x[rd]
+		addr = base + imm;
+		flags |= FRV_TRACE_MEM;
+		break;
+	case 0x2f:
+		addr = base;
+		flags |= FRV_TRACE_MEM;
+		break;
+	case 0x23: // Stores
+		addr = base + imm;
+		flags = FRV_TRACE_MEM;
+		break;
+	case 0x07: // FP and vector loads and stores, the vector ones have no offset
+	case 0x27:
+		addr = (vec) ? base : base + imm;
+		flags = FRV_TRACE_MEM | ((FRV_INST_OPCODE(raw) == 0x07 && !vec) ? FRV_TRACE_FREG : 0);
+		break;
+	case 0x43: // Fused multiply-add
+	case 0x47:
+	case 0x4b:
+	case 0x4f:
+		flags = FRV_TRACE_FREG;
+		break;
+	case 0x53: // Compares (0x50), conversions to integer (0x60), fmv.x and fclass (0x70) write x, the rest f
+		if (FRV_INST_FUNCT7(raw) < 0x50 || (FRV_INST_FUNCT7(raw) & 0x0e)) flags = FRV_TRACE_FREG;
+		break;
+	case 0x57: // Only vsetvl* and vmv.x.s write x
+		if (FRV_INST_FUNCT3(raw) != 0x7 && !(FRV_INST_FUNCT3(raw) == 0x2 && FRV_INST_FUNCT6(raw) == 0x10))
+			flags = 0;
+		break;
+	case 0x63: // Branches and fences have no rd
+	case 0x0f:
+		flags = 0;
+		break;
+	}
+
+	const bool ok = frvCpuExec(cpu, inst);
+	struct FrvTraceRecord* rec = frvTraceNext(cpu->trace);
+	rec->pc = pc;
+	rec->val = (flags & FRV_TRACE_FREG) ? cpu->fregs[inst->rd] : cpu->regs[inst->rd];
+	rec->addr = addr;
+	rec->raw = raw;
+	rec->rd = inst->rd;
+	rec->hart = cpu->trace->hart;
+	rec->flags = (!ok && (cpu->cause != FRV_CAUSE_NONE || cpu->mmu.cause != FRV_CAUSE_NONE)) ? FRV_TRACE_TRAP : flags;
+	rec->len = inst->len;
+	return ok;
+}
+#endif
+
+#ifdef FRV_THREADED
+/* The direct threaded core, every handler jumps to the next one itself
+ * The handler addresses are filled into the block on its first run,
+ * the spare slot after the last instruction marks the end of the block
+ */
+static bool frvCpuExecBlock(struct FrvCPU* cpu, struct FrvBlock* block)
+{
+	static const void* const handlers[FRV_OP_COUNT] = {
+		[FRV_OP_ILLEGAL] = &&op_ILLEGAL, [FRV_OP_ADD] = &&op_ADD, [FRV_OP_SUB] = &&op_SUB,
+		[FRV_OP_ADDI] = &&op_ADDI, [FRV_OP_ADDIW] = &&op_ADDIW, [FRV_OP_ADDW] = &&op_ADDW,
+		[FRV_OP_SUBW] = &&op_SUBW, [FRV_OP_ANDI] = &&op_ANDI, [FRV_OP_ORI] = &&op_ORI,
+		[FRV_OP_XORI] = &&op_XORI, [FRV_OP_SLLI] = &&op_SLLI, [FRV_OP_SRLI] = &&op_SRLI,
+		[FRV_OP_SRAI] = &&op_SRAI, [FRV_OP_AND] = &&op_AND, [FRV_OP_OR] = &&op_OR,
+		[FRV_OP_XOR] = &&op_XOR, [FRV_OP_SLL] = &&op_SLL, [FRV_OP_SRL] = &&op_SRL,
+		[FRV_OP_SRA] = &&op_SRA, [FRV_OP_SLLIW] = &&op_SLLIW, [FRV_OP_SRLIW] = &&op_SRLIW,
+		[FRV_OP_SRAIW] = &&op_SRAIW, [FRV_OP_SLLW] = &&op_SLLW, [FRV_OP_SRLW] = &&op_SRLW,
+		[FRV_OP_SRAW] = &&op_SRAW, [FRV_OP_SLTI] = &&op_SLTI, [FRV_OP_SLTIU] = &&op_SLTIU,
+		[FRV_OP_SLT] = &&op_SLT, [FRV_OP_SLTU] = &&op_SLTU, [FRV_OP_LB] = &&op_LB,
+		[FRV_OP_LH] = &&op_LH, [FRV_OP_LW] = &&op_LW, [FRV_OP_LBU] = &&op_LBU,
+		[FRV_OP_LHU] = &&op_LHU, [FRV_OP_LWU] = &&op_LWU, [FRV_OP_LD] = &&op_LD,
+		[FRV_OP_SB] = &&op_SB, [FRV_OP_SH] = &&op_SH, [FRV_OP_SW] = &&op_SW,
+		[FRV_OP_SD] = &&op_SD, [FRV_OP_LUI] = &&op_LUI, [FRV_OP_AUIPC] = &&op_AUIPC,
+		[FRV_OP_JAL] = &&op_JAL, [FRV_OP_JALR] = &&op_JALR, [FRV_OP_BEQ] = &&op_BEQ,
+		[FRV_OP_BNE] = &&op_BNE, [FRV_OP_BLT] = &&op_BLT, [FRV_OP_BLTU] = &&op_BLTU,
+		[FRV_OP_BGE] = &&op_BGE, [FRV_OP_BGEU] = &&op_BGEU, [FRV_OP_FENCE] = &&op_FENCE,
+		[FRV_OP_FENCEI] = &&op_FENCEI, [FRV_OP_ECALL] = &&op_ECALL, [FRV_OP_EBREAK] = &&op_EBREAK,
+		[FRV_OP_SRET] = &&op_SRET, [FRV_OP_MRET] = &&op_MRET, [FRV_OP_WFI] = &&op_WFI,
+		[FRV_OP_SFENCEVMA] = &&op_SFENCEVMA,
+		[FRV_OP_CSRRW] = &&op_CSRRW, [FRV_OP_CSRRS] = &&op_CSRRS,
+		[FRV_OP_CSRRC] = &&op_CSRRC, [FRV_OP_CSRRWI] = &&op_CSRRWI,
+		[FRV_OP_CSRRSI] = &&op_CSRRSI, [FRV_OP_CSRRCI] = &&op_CSRRCI,
+		[FRV_OP_MUL] = &&op_MUL, [FRV_OP_MULH] = &&op_MULH, [FRV_OP_MULHU] = &&op_MULHU,
+		[FRV_OP_MULHSU] = &&op_MULHSU, [FRV_OP_MULW] = &&op_MULW, [FRV_OP_DIV] = &&op_DIV,
+		[FRV_OP_DIVU] = &&op_DIVU, [FRV_OP_DIVW] = &&op_DIVW, [FRV_OP_DIVUW] = &&op_DIVUW,
+		[FRV_OP_REM] = &&op_REM, [FRV_OP_REMU] = &&op_REMU, [FRV_OP_REMW] = &&op_REMW,
+		[FRV_OP_REMUW] = &&op_REMUW,
+		[FRV_OP_LRW] = &&op_LRW, [FRV_OP_SCW] = &&op_SCW, [FRV_OP_AMOSWAPW] = &&op_AMOSWAPW,
+		[FRV_OP_AMOADDW] = &&op_AMOADDW, [FRV_OP_AMOXORW] = &&op_AMOXORW, [FRV_OP_AMOANDW] = &&op_AMOANDW,
+		[FRV_OP_AMOORW] = &&op_AMOORW, [FRV_OP_AMOMINW] = &&op_AMOMINW, [FRV_OP_AMOMAXW] = &&op_AMOMAXW,
+		[FRV_OP_AMOMINUW] = &&op_AMOMINUW, [FRV_OP_AMOMAXUW] = &&op_AMOMAXUW, [FRV_OP_LRD] = &&op_LRD,
+		[FRV_OP_SCD] = &&op_SCD, [FRV_OP_AMOSWAPD] = &&op_AMOSWAPD, [FRV_OP_AMOADDD] = &&op_AMOADDD,
+		[FRV_OP_AMOXORD] = &&op_AMOXORD, [FRV_OP_AMOANDD] = &&op_AMOANDD, [FRV_OP_AMOORD] = &&op_AMOORD,
+		[FRV_OP_AMOMIND] = &&op_AMOMIND, [FRV_OP_AMOMAXD] = &&op_AMOMAXD, [FRV_OP_AMOMINUD] = &&op_AMOMINUD,
+		[FRV_OP_AMOMAXUD] = &&op_AMOMAXUD,
+		[FRV_OP_FLW] = &&op_FLW, [FRV_OP_FSW] = &&op_FSW, [FRV_OP_FMADDS] = &&op_FMADDS,
+		[FRV_OP_FMSUBS] = &&op_FMSUBS, [FRV_OP_FNMSUBS] = &&op_FNMSUBS,
+		[FRV_OP_FNMADDS] = &&op_FNMADDS, [FRV_OP_FADDS] = &&op_FADDS, [FRV_OP_FSUBS] = &&op_FSUBS,
+		[FRV_OP_FMULS] = &&op_FMULS, [FRV_OP_FDIVS] = &&op_FDIVS, [FRV_OP_FSQRTS] = &&op_FSQRTS,
+		[FRV_OP_FSGNJS] = &&op_FSGNJS, [FRV_OP_FSGNJNS] = &&op_FSGNJNS,
+		[FRV_OP_FSGNJXS] = &&op_FSGNJXS, [FRV_OP_FMINS] = &&op_FMINS, [FRV_OP_FMAXS] = &&op_FMAXS,
+		[FRV_OP_FCVTWS] = &&op_FCVTWS, [FRV_OP_FCVTWUS] = &&op_FCVTWUS, [FRV_OP_FCVTLS] = &&op_FCVTLS,
+		[FRV_OP_FCVTLUS] = &&op_FCVTLUS, [FRV_OP_FCVTSW] = &&op_FCVTSW,
+		[FRV_OP_FCVTSWU] = &&op_FCVTSWU, [FRV_OP_FCVTSL] = &&op_FCVTSL,
+		[FRV_OP_FCVTSLU] = &&op_FCVTSLU, [FRV_OP_FMVXW] = &&op_FMVXW, [FRV_OP_FMVWX] = &&op_FMVWX,
+		[FRV_OP_FEQS] = &&op_FEQS, [FRV_OP_FLTS] = &&op_FLTS, [FRV_OP_FLES] = &&op_FLES,
+		[FRV_OP_FCLASSS] = &&op_FCLASSS, [FRV_OP_FLD] = &&op_FLD, [FRV_OP_FSD] = &&op_FSD,
+		[FRV_OP_FMADDD] = &&op_FMADDD, [FRV_OP_FMSUBD] = &&op_FMSUBD, [FRV_OP_FNMSUBD] = &&op_FNMSUBD,
+		[FRV_OP_FNMADDD] = &&op_FNMADDD, [FRV_OP_FADDD] = &&op_FADDD, [FRV_OP_FSUBD] = &&op_FSUBD,
+		[FRV_OP_FMULD] = &&op_FMULD, [FRV_OP_FDIVD] = &&op_FDIVD, [FRV_OP_FSQRTD] = &&op_FSQRTD,
+		[FRV_OP_FSGNJD] = &&op_FSGNJD, [FRV_OP_FSGNJND] = &&op_FSGNJND,
+		[FRV_OP_FSGNJXD] = &&op_FSGNJXD, [FRV_OP_FMIND] = &&op_FMIND, [FRV_OP_FMAXD] = &&op_FMAXD,
+		[FRV_OP_FCVTWD] = &&op_FCVTWD, [FRV_OP_FCVTWUD] = &&op_FCVTWUD, [FRV_OP_FCVTLD] = &&op_FCVTLD,
+		[FRV_OP_FCVTLUD] = &&op_FCVTLUD, [FRV_OP_FCVTDW] = &&op_FCVTDW,
+		[FRV_OP_FCVTDWU] = &&op_FCVTDWU, [FRV_OP_FCVTDL] = &&op_FCVTDL,
+		[FRV_OP_FCVTDLU] = &&op_FCVTDLU, [FRV_OP_FCVTSD] = &&op_FCVTSD, [FRV_OP_FCVTDS] = &&op_FCVTDS,
+		[FRV_OP_FMVXD] = &&op_FMVXD, [FRV_OP_FMVDX] = &&op_FMVDX, [FRV_OP_FEQD] = &&op_FEQD,
+		[FRV_OP_FLTD] = &&op_FLTD, [FRV_OP_FLED] = &&op_FLED, [FRV_OP_FCLASSD] = &&op_FCLASSD,
+		[FRV_OP_VSETVLI] = &&op_VSETVLI, [FRV_OP_VSETIVLI] = &&op_VSETIVLI, [FRV_OP_VSETVL] = &&op_VSETVL,
+		[FRV_OP_VLE] = &&op_VLE, [FRV_OP_VLSE] = &&op_VLSE, [FRV_OP_VSE] = &&op_VSE, [FRV_OP_VSSE] = &&op_VSSE,
+		[FRV_OP_VADD] = &&op_VADD, [FRV_OP_VSUB] = &&op_VSUB, [FRV_OP_VRSUB] = &&op_VRSUB,
+		[FRV_OP_VMINU] = &&op_VMINU, [FRV_OP_VMIN] = &&op_VMIN, [FRV_OP_VMAXU] = &&op_VMAXU,
+		[FRV_OP_VMAX] = &&op_VMAX, [FRV_OP_VAND] = &&op_VAND, [FRV_OP_VOR] = &&op_VOR,
+		[FRV_OP_VXOR] = &&op_VXOR, [FRV_OP_VSLL] = &&op_VSLL, [FRV_OP_VSRL] = &&op_VSRL,
+		[FRV_OP_VSRA] = &&op_VSRA, [FRV_OP_VMERGE] = &&op_VMERGE, [FRV_OP_VMUL] = &&op_VMUL,
+		[FRV_OP_VMACC] = &&op_VMACC, [FRV_OP_VMVXS] = &&op_VMVXS, [FRV_OP_VMVSX] = &&op_VMVSX,
+		[FRV_OP_VREDSUM] = &&op_VREDSUM, [FRV_OP_VREDAND] = &&op_VREDAND, [FRV_OP_VREDOR] = &&op_VREDOR,
+		[FRV_OP_VREDXOR] = &&op_VREDXOR, [FRV_OP_VREDMINU] = &&op_VREDMINU, [FRV_OP_VREDMIN] = &&op_VREDMIN,
+		[FRV_OP_VREDMAXU] = &&op_VREDMAXU, [FRV_OP_VREDMAX] = &&op_VREDMAX,
+		[FRV_OP_SH1ADD] = &&op_SH1ADD, [FRV_OP_SH2ADD] = &&op_SH2ADD, [FRV_OP_SH3ADD] = &&op_SH3ADD,
+		[FRV_OP_ADDUW] = &&op_ADDUW, [FRV_OP_SH1ADDUW] = &&op_SH1ADDUW,
+		[FRV_OP_SH2ADDUW] = &&op_SH2ADDUW, [FRV_OP_SH3ADDUW] = &&op_SH3ADDUW,
+		[FRV_OP_SLLIUW] = &&op_SLLIUW, [FRV_OP_ANDN] = &&op_ANDN, [FRV_OP_ORN] = &&op_ORN,
+		[FRV_OP_XNOR] = &&op_XNOR, [FRV_OP_CLZ] = &&op_CLZ, [FRV_OP_CTZ] = &&op_CTZ,
+		[FRV_OP_CPOP] = &&op_CPOP, [FRV_OP_CLZW] = &&op_CLZW, [FRV_OP_CTZW] = &&op_CTZW,
+		[FRV_OP_CPOPW] = &&op_CPOPW, [FRV_OP_MAX] = &&op_MAX, [FRV_OP_MAXU] = &&op_MAXU,
+		[FRV_OP_MIN] = &&op_MIN, [FRV_OP_MINU] = &&op_MINU, [FRV_OP_SEXTB] = &&op_SEXTB,
+		[FRV_OP_SEXTH] = &&op_SEXTH, [FRV_OP_ZEXTH] = &&op_ZEXTH, [FRV_OP_ROL] = &&op_ROL,
+		[FRV_OP_ROR] = &&op_ROR, [FRV_OP_ROLW] = &&op_ROLW, [FRV_OP_RORW] = &&op_RORW,
+		[FRV_OP_RORI] = &&op_RORI, [FRV_OP_RORIW] = &&op_RORIW, [FRV_OP_ORCB] = &&op_ORCB,
+		[FRV_OP_REV8] = &&op_REV8, [FRV_OP_BCLR] = &&op_BCLR, [FRV_OP_BCLRI] = &&op_BCLRI,
+		[FRV_OP_BEXT] = &&op_BEXT, [FRV_OP_BEXTI] = &&op_BEXTI, [FRV_OP_BINV] = &&op_BINV,
+		[FRV_OP_BINVI] = &&op_BINVI, [FRV_OP_BSET] = &&op_BSET, [FRV_OP_BSETI] = &&op_BSETI,
+	};
+	struct FrvInst* inst = block->insts;
+	if (!block->insts[block->len].handler) {
+		for (uint32_t i = 0; i < block->len; i++)
+			block->insts[i].handler = handlers[block->insts[i].op];
+		block->insts[block->len].handler = &&block_end;
+	}
+
+#define FRV_OP(name)	op_##name:
+#define FRV_NEXT()	do { inst++; cpu->regs[0] = 0; cpu->pc += inst->len; goto *inst->handler; } while (0)
+#define FRV_FAIL()	return cpu->tcache.stale
+#define FRV_CHECK(ok)	do { if (!(ok)) FRV_FAIL(); } while (0)
+	cpu->regs[0] = 0; // always Hardwire x0 to 0
+	cpu->pc += inst->len;
+	goto *inst->handler;
+#include "exec.inc"
+#undef FRV_OP
+#undef FRV_NEXT
+#undef FRV_FAIL
+#undef FRV_CHECK
+
+block_end: // The end marker has a len of 0, pc is already past the block
+	return true;
+}
+#else
+/* Run one block in a tight loop, pc only has to be checked at the end
+ * A store into translated code "fails" to leave the block right after itself
+ */
+static bool frvCpuExecBlock(struct FrvCPU* cpu, struct FrvBlock* block)
+{
+	const struct FrvInst* inst = block->insts;
+	const struct FrvInst* end = inst + block->len;
+	for (; inst < end; inst++) {
+		cpu->regs[0] = 0; // always Hardwire x0 to 0
+		cpu->pc += inst->len;
+#ifdef FRV_PROFILE
+		frvProfileCount(&cpu->prof, cpu->pc - inst->len, inst);
+		const bool ok = frvCpuExec(cpu, inst);
+		if (inst->op == FRV_OP_JAL || inst->op == FRV_OP_JALR) frvProfileJump(&cpu->prof, inst, cpu->pc);
+		if (!ok) return cpu->tcache.stale;
+#elif defined(FRV_TRACE)
+		if (!(cpu->trace ? frvCpuExecTraced(cpu, inst) : frvCpuExec(cpu, inst))) return cpu->tcache.stale;
+#else
+		if (!frvCpuExec(cpu, inst)) return cpu->tcache.stale;
+#endif
 	}
+	return true;
+}
+#endif
 
-	case FRV_INSTCODE_FENCE: // Not usefull on a single-threaded simulator
-	case FRV_INSTCODE_FENCEI:
-		return true;
+// Hot blocks are handed to the JIT, everything else is interpreted
+static inline bool frvCpuRunBlock(struct FrvCPU* cpu, struct FrvBlock* block)
+{
+#ifdef FRV_JIT
+	if (block->native) return ((FrvJitFn)block->native)(cpu);
+	if (++block->hits == FRV_JIT_THRESHOLD && frvJitCompile(&cpu->jit, cpu, block))
+		return ((FrvJitFn)block->native)(cpu);
+#endif
+	return frvCpuExecBlock(cpu, block);
+}
 
-	default:
-		return false;
+static void frvCpuRunLoop(struct FrvCPU* cpu)
+{
+	struct FrvTCache* tcache = &cpu->tcache;
+	struct FrvBlock* prev = NULL;
+	while (true) {
+		if (tcache->stale) frvTCacheFlush(tcache);
+		const uint64_t gen = tcache->gen;
+
+		struct FrvBlock* block = frvTCacheLookup(tcache, cpu->pc);
+		if (!block && !(block = frvCpuTranslate(cpu))) {
+			if (!frvCpuException(cpu, cpu->pc)) break;
+			prev = NULL;
+			continue;
+		}
+		if (prev && gen == tcache->gen && prev->ctx == block->ctx) frvBlockLink(prev, block);
+
+		/* Follow the chained blocks until a successor is missing or the translation changed
+		 * The interrupts are only looked at in between, every FRV_IRQ_POLL_INSTS or when
+		 * something they depend on was written (irqpoll = 0)
+		 */
+		do {
+			// A block left early stopped right behind the last instruction it ran
+			cpu->block = block;
+			const bool ok = frvCpuRunBlock(cpu, block);
+			if (ok && !tcache->stale) {
+				cpu->instret += block->len;
+			} else if (cpu->cause != FRV_CAUSE_NONE || cpu->mmu.cause != FRV_CAUSE_NONE) {
+				// The faulting instruction does not retire
+				const uint32_t ran = frvBlockCount(block, cpu->pc);
+				cpu->pc -= block->insts[ran - 1].len;
+				cpu->instret += ran - 1;
+				if (!frvCpuException(cpu, cpu->pc)) return;
+				prev = NULL;
+				break;
+			} else {
+				cpu->instret += frvBlockCount(block, cpu->pc);
+				if (!ok) return;
+			}
+			if (cpu->pc == 0) {
+				cpu->halted = true;
+				return;
+			}
+			prev = block;
+			if (cpu->instret >= cpu->irqpoll && frvCpuInterrupt(cpu)) {
+				prev = NULL;
+				break;
+			}
+		} while (!tcache->stale && prev->ctx == tcache->ctx && (block = frvBlockChained(prev, cpu->pc)));
+		if (tcache->stale) prev = NULL;
 	}
 }
 
+// The FP exception flags accrue in the host FPU while the hart runs, fcsr takes them in at the end
 void frvCpuRun(struct FrvCPU* cpu)
 {
-	while (true) {
-		uint32_t inst;
-		if(!frvCpuFetch(cpu, &inst)) break;
-		cpu->regs[0] = 0; // always Hardwire x0 to 0
-		cpu->pc += 4;
-		if(!frvCpuExec(cpu, inst)) break;
-		if(cpu->pc == 0) break;
-	}
+	frvFpuClearFlags();
+	frvCpuRunLoop(cpu);
+	cpu->csrs[FRV_CSRS_FCSR] |= frvFpuFlags();
 }
@@ -5,11 +5,35 @@
 #include <stdbool.h>
 
 #include "fs.h"
+#include "loader.h"
 
 #include "bus.h"
+#include "mmu.h"
+#include "tcache.h"
+#include "clint.h"
+#include "fpu.h"
+#include "vec.h"
+#ifdef FRV_JIT
+#include "jit.h"
+#endif
+#ifdef FRV_PROFILE
+#if defined(FRV_JIT) || defined(FRV_THREADED)
+#error "The profiler counts in the switch core, build it without FRV_JIT and FRV_THREADED"
+#endif
+#include "prof.h"
+#endif
+#ifdef FRV_TRACE
+#if defined(FRV_JIT) || defined(FRV_THREADED)
+#error "The tracer records in the switch core, build it without FRV_JIT and FRV_THREADED"
+#endif
+#include "trace.h"
+#endif
 
 #define FRV_NUM_REGS 32
-#define FRV_NUM_CSRS 4096
+#define FRV_NUM_CSRS 4096 // CSR numbers, only the implemented ones have storage (enum FrvCsrSlot)
+#define FRV_NO_RESERVATION (UINT64_MAX) // Never an aligned address
+#define FRV_HART_STACK_SIZE (256 * 1024) // Each hart starts with sp that far below the previous one
+#define FRV_IRQ_POLL_INSTS (1024) // Retired instructions between two looks at the pending interrupts
 
 // ABI regs to machine regs
 enum FrvRegsAbi {
@@ -85,6 +109,11 @@ enum FrvRegsAbi {
 #define FRV_INSTCODE_FENCE	((0x0 << 7) | 0x0f) //Fence
 #define FRV_INSTCODE_FENCEI	((0x1 << 7) | 0x0f)
 #define FRV_INSTCODE_ECALL	((0x0 << 10)| (0x0 << 7) | 0x73) // Env
+#define FRV_INSTCODE_EBREAK	((0x1 << 10)| (0x0 << 7) | 0x73)
+#define FRV_INSTCODE_SRET	((0x102 << 10) | (0x0 << 7) | 0x73) // Privileged
+#define FRV_INSTCODE_MRET	((0x302 << 10) | (0x0 << 7) | 0x73)
+#define FRV_INSTCODE_WFI	((0x105 << 10) | (0x0 << 7) | 0x73)
+#define FRV_INSTCODE_SFENCEVMA	((0x120 << 10) | (0x0 << 7) | 0x73) // rs2 is masked out
 #define FRV_INSTCODE_CSRRW	((0x1 << 7) | 0x73) // Csrs
 #define FRV_INSTCODE_CSRRS	((0x2 << 7) | 0x73)
 #define FRV_INSTCODE_CSRRC	((0x3 << 7) | 0x73)
@@ -104,8 +133,191 @@ enum FrvRegsAbi {
 #define FRV_INSTCODE_REMU	((0x1 << 10) | (0x7 << 7) | 0x33)
 #define FRV_INSTCODE_REMW	((0x1 << 10) | (0x6 << 7) | 0x3b)
 #define FRV_INSTCODE_REMUW	((0x1 << 10) | (0x7 << 7) | 0x3b)
+#define FRV_INSTCODE_LRW	((0x08 << 10) | (0x2 << 7) | 0x2f) // A-extension, aq and rl are masked out
+#define FRV_INSTCODE_SCW	((0x0c << 10) | (0x2 << 7) | 0x2f)
+#define FRV_INSTCODE_AMOSWAPW	((0x04 << 10) | (0x2 << 7) | 0x2f)
+#define FRV_INSTCODE_AMOADDW	((0x00 << 10) | (0x2 << 7) | 0x2f)
+#define FRV_INSTCODE_AMOXORW	((0x10 << 10) | (0x2 << 7) | 0x2f)
+#define FRV_INSTCODE_AMOANDW	((0x30 << 10) | (0x2 << 7) | 0x2f)
+#define FRV_INSTCODE_AMOORW	((0x20 << 10) | (0x2 << 7) | 0x2f)
+#define FRV_INSTCODE_AMOMINW	((0x40 << 10) | (0x2 << 7) | 0x2f)
+#define FRV_INSTCODE_AMOMAXW	((0x50 << 10) | (0x2 << 7) | 0x2f)
+#define FRV_INSTCODE_AMOMINUW	((0x60 << 10) | (0x2 << 7) | 0x2f)
+#define FRV_INSTCODE_AMOMAXUW	((0x70 << 10) | (0x2 << 7) | 0x2f)
+#define FRV_INSTCODE_LRD	((0x08 << 10) | (0x3 << 7) | 0x2f)
+#define FRV_INSTCODE_SCD	((0x0c << 10) | (0x3 << 7) | 0x2f)
+#define FRV_INSTCODE_AMOSWAPD	((0x04 << 10) | (0x3 << 7) | 0x2f)
+#define FRV_INSTCODE_AMOADDD	((0x00 << 10) | (0x3 << 7) | 0x2f)
+#define FRV_INSTCODE_AMOXORD	((0x10 << 10) | (0x3 << 7) | 0x2f)
+#define FRV_INSTCODE_AMOANDD	((0x30 << 10) | (0x3 << 7) | 0x2f)
+#define FRV_INSTCODE_AMOORD	((0x20 << 10) | (0x3 << 7) | 0x2f)
+#define FRV_INSTCODE_AMOMIND	((0x40 << 10) | (0x3 << 7) | 0x2f)
+#define FRV_INSTCODE_AMOMAXD	((0x50 << 10) | (0x3 << 7) | 0x2f)
+#define FRV_INSTCODE_AMOMINUD	((0x60 << 10) | (0x3 << 7) | 0x2f)
+#define FRV_INSTCODE_AMOMAXUD	((0x70 << 10) | (0x3 << 7) | 0x2f)
+#define FRV_INSTCODE_FLW	((0x2 << 7) | 0x07) // F-extension, the rounding mode is masked out
+#define FRV_INSTCODE_FSW	((0x2 << 7) | 0x27)
+#define FRV_INSTCODE_FMADDS	((0x0 << 10) | 0x43)
+#define FRV_INSTCODE_FMSUBS	((0x0 << 10) | 0x47)
+#define FRV_INSTCODE_FNMSUBS	((0x0 << 10) | 0x4b)
+#define FRV_INSTCODE_FNMADDS	((0x0 << 10) | 0x4f)
+#define FRV_INSTCODE_FADDS	((0x00 << 10) | 0x53)
+#define FRV_INSTCODE_FSUBS	((0x04 << 10) | 0x53)
+#define FRV_INSTCODE_FMULS	((0x08 << 10) | 0x53)
+#define FRV_INSTCODE_FDIVS	((0x0c << 10) | 0x53)
+#define FRV_INSTCODE_FSQRTS	((0x0 << 17) | (0x2c << 10) | 0x53) // rs2 picks the operation
+#define FRV_INSTCODE_FSGNJS	((0x10 << 10) | (0x0 << 7) | 0x53)
+#define FRV_INSTCODE_FSGNJNS	((0x10 << 10) | (0x1 << 7) | 0x53)
+#define FRV_INSTCODE_FSGNJXS	((0x10 << 10) | (0x2 << 7) | 0x53)
+#define FRV_INSTCODE_FMINS	((0x14 << 10) | (0x0 << 7) | 0x53)
+#define FRV_INSTCODE_FMAXS	((0x14 << 10) | (0x1 << 7) | 0x53)
+#define FRV_INSTCODE_FCVTWS	((0x0 << 17) | (0x60 << 10) | 0x53)
+#define FRV_INSTCODE_FCVTWUS	((0x1 << 17) | (0x60 << 10) | 0x53)
+#define FRV_INSTCODE_FCVTLS	((0x2 << 17) | (0x60 << 10) | 0x53)
+#define FRV_INSTCODE_FCVTLUS	((0x3 << 17) | (0x60 << 10) | 0x53)
+#define FRV_INSTCODE_FCVTSW	((0x0 << 17) | (0x68 << 10) | 0x53)
+#define FRV_INSTCODE_FCVTSWU	((0x1 << 17) | (0x68 << 10) | 0x53)
+#define FRV_INSTCODE_FCVTSL	((0x2 << 17) | (0x68 << 10) | 0x53)
+#define FRV_INSTCODE_FCVTSLU	((0x3 << 17) | (0x68 << 10) | 0x53)
+#define FRV_INSTCODE_FMVXW	((0x0 << 17) | (0x70 << 10) | (0x0 << 7) | 0x53)
+#define FRV_INSTCODE_FCLASSS	((0x0 << 17) | (0x70 << 10) | (0x1 << 7) | 0x53)
+#define FRV_INSTCODE_FMVWX	((0x0 << 17) | (0x78 << 10) | (0x0 << 7) | 0x53)
+#define FRV_INSTCODE_FEQS	((0x50 << 10) | (0x2 << 7) | 0x53)
+#define FRV_INSTCODE_FLTS	((0x50 << 10) | (0x1 << 7) | 0x53)
+#define FRV_INSTCODE_FLES	((0x50 << 10) | (0x0 << 7) | 0x53)
+#define FRV_INSTCODE_FLD	((0x3 << 7) | 0x07) // D-extension
+#define FRV_INSTCODE_FSD	((0x3 << 7) | 0x27)
+#define FRV_INSTCODE_FMADDD	((0x1 << 10) | 0x43)
+#define FRV_INSTCODE_FMSUBD	((0x1 << 10) | 0x47)
+#define FRV_INSTCODE_FNMSUBD	((0x1 << 10) | 0x4b)
+#define FRV_INSTCODE_FNMADDD	((0x1 << 10) | 0x4f)
+#define FRV_INSTCODE_FADDD	((0x01 << 10) | 0x53)
+#define FRV_INSTCODE_FSUBD	((0x05 << 10) | 0x53)
+#define FRV_INSTCODE_FMULD	((0x09 << 10) | 0x53)
+#define FRV_INSTCODE_FDIVD	((0x0d << 10) | 0x53)
+#define FRV_INSTCODE_FSQRTD	((0x0 << 17) | (0x2d << 10) | 0x53)
+#define FRV_INSTCODE_FSGNJD	((0x11 << 10) | (0x0 << 7) | 0x53)
+#define FRV_INSTCODE_FSGNJND	((0x11 << 10) | (0x1 << 7) | 0x53)
+#define FRV_INSTCODE_FSGNJXD	((0x11 << 10) | (0x2 << 7) | 0x53)
+#define FRV_INSTCODE_FMIND	((0x15 << 10) | (0x0 << 7) | 0x53)
+#define FRV_INSTCODE_FMAXD	((0x15 << 10) | (0x1 << 7) | 0x53)
+#define FRV_INSTCODE_FCVTSD	((0x1 << 17) | (0x20 << 10) | 0x53)
+#define FRV_INSTCODE_FCVTDS	((0x0 << 17) | (0x21 << 10) | 0x53)
+#define FRV_INSTCODE_FCVTWD	((0x0 << 17) | (0x61 << 10) | 0x53)
+#define FRV_INSTCODE_FCVTWUD	((0x1 << 17) | (0x61 << 10) | 0x53)
+#define FRV_INSTCODE_FCVTLD	((0x2 << 17) | (0x61 << 10) | 0x53)
+#define FRV_INSTCODE_FCVTLUD	((0x3 << 17) | (0x61 << 10) | 0x53)
+#define FRV_INSTCODE_FCVTDW	((0x0 << 17) | (0x69 << 10) | 0x53)
+#define FRV_INSTCODE_FCVTDWU	((0x1 << 17) | (0x69 << 10) | 0x53)
+#define FRV_INSTCODE_FCVTDL	((0x2 << 17) | (0x69 << 10) | 0x53)
+#define FRV_INSTCODE_FCVTDLU	((0x3 << 17) | (0x69 << 10) | 0x53)
+#define FRV_INSTCODE_FMVXD	((0x0 << 17) | (0x71 << 10) | (0x0 << 7) | 0x53)
+#define FRV_INSTCODE_FCLASSD	((0x0 << 17) | (0x71 << 10) | (0x1 << 7) | 0x53)
+#define FRV_INSTCODE_FMVDX	((0x0 << 17) | (0x79 << 10) | (0x0 << 7) | 0x53)
+#define FRV_INSTCODE_FEQD	((0x51 << 10) | (0x2 << 7) | 0x53)
+#define FRV_INSTCODE_FLTD	((0x51 << 10) | (0x1 << 7) | 0x53)
+#define FRV_INSTCODE_FLED	((0x51 << 10) | (0x0 << 7) | 0x53)
+#define FRV_INSTCODE_VSETVLI	((0x00 << 10) | (0x7 << 7) | 0x57) // V-extension, the bits above the opcode
+#define FRV_INSTCODE_VSETIVLI	((0x30 << 10) | (0x7 << 7) | 0x57) // of vsetvli and vsetivli are vtypei
+#define FRV_INSTCODE_VSETVL	((0x40 << 10) | (0x7 << 7) | 0x57)
+#define FRV_INSTCODE_VLE	((0x0 << 17) | (0x0 << 10) | 0x07) // funct3 is the width, rs2 the unit-stride mode
+#define FRV_INSTCODE_VLSE	((0x2 << 10) | 0x07) // rs2 is the stride
+#define FRV_INSTCODE_VSE	((0x0 << 17) | (0x0 << 10) | 0x27)
+#define FRV_INSTCODE_VSSE	((0x2 << 10) | 0x27)
+#define FRV_INSTCODE_VADDVV	((0x00 << 10) | (0x0 << 7) | 0x57) // funct3 is the operand form, vm is masked out
+#define FRV_INSTCODE_VADDVX	((0x00 << 10) | (0x4 << 7) | 0x57)
+#define FRV_INSTCODE_VADDVI	((0x00 << 10) | (0x3 << 7) | 0x57)
+#define FRV_INSTCODE_VSUBVV	((0x02 << 10) | (0x0 << 7) | 0x57)
+#define FRV_INSTCODE_VSUBVX	((0x02 << 10) | (0x4 << 7) | 0x57)
+#define FRV_INSTCODE_VRSUBVX	((0x03 << 10) | (0x4 << 7) | 0x57)
+#define FRV_INSTCODE_VRSUBVI	((0x03 << 10) | (0x3 << 7) | 0x57)
+#define FRV_INSTCODE_VMINUVV	((0x04 << 10) | (0x0 << 7) | 0x57)
+#define FRV_INSTCODE_VMINUVX	((0x04 << 10) | (0x4 << 7) | 0x57)
+#define FRV_INSTCODE_VMINVV	((0x05 << 10) | (0x0 << 7) | 0x57)
+#define FRV_INSTCODE_VMINVX	((0x05 << 10) | (0x4 << 7) | 0x57)
+#define FRV_INSTCODE_VMAXUVV	((0x06 << 10) | (0x0 << 7) | 0x57)
+#define FRV_INSTCODE_VMAXUVX	((0x06 << 10) | (0x4 << 7) | 0x57)
+#define FRV_INSTCODE_VMAXVV	((0x07 << 10) | (0x0 << 7) | 0x57)
+#define FRV_INSTCODE_VMAXVX	((0x07 << 10) | (0x4 << 7) | 0x57)
+#define FRV_INSTCODE_VANDVV	((0x09 << 10) | (0x0 << 7) | 0x57)
+#define FRV_INSTCODE_VANDVX	((0x09 << 10) | (0x4 << 7) | 0x57)
+#define FRV_INSTCODE_VANDVI	((0x09 << 10) | (0x3 << 7) | 0x57)
+#define FRV_INSTCODE_VORVV	((0x0a << 10) | (0x0 << 7) | 0x57)
+#define FRV_INSTCODE_VORVX	((0x0a << 10) | (0x4 << 7) | 0x57)
+#define FRV_INSTCODE_VORVI	((0x0a << 10) | (0x3 << 7) | 0x57)
+#define FRV_INSTCODE_VXORVV	((0x0b << 10) | (0x0 << 7) | 0x57)
+#define FRV_INSTCODE_VXORVX	((0x0b << 10) | (0x4 << 7) | 0x57)
+#define FRV_INSTCODE_VXORVI	((0x0b << 10) | (0x3 << 7) | 0x57)
+#define FRV_INSTCODE_VMERGEVV	((0x17 << 10) | (0x0 << 7) | 0x57) // vmv.v.* unmasked
+#define FRV_INSTCODE_VMERGEVX	((0x17 << 10) | (0x4 << 7) | 0x57)
+#define FRV_INSTCODE_VMERGEVI	((0x17 << 10) | (0x3 << 7) | 0x57)
+#define FRV_INSTCODE_VSLLVV	((0x25 << 10) | (0x0 << 7) | 0x57)
+#define FRV_INSTCODE_VSLLVX	((0x25 << 10) | (0x4 << 7) | 0x57)
+#define FRV_INSTCODE_VSLLVI	((0x25 << 10) | (0x3 << 7) | 0x57)
+#define FRV_INSTCODE_VSRLVV	((0x28 << 10) | (0x0 << 7) | 0x57)
+#define FRV_INSTCODE_VSRLVX	((0x28 << 10) | (0x4 << 7) | 0x57)
+#define FRV_INSTCODE_VSRLVI	((0x28 << 10) | (0x3 << 7) | 0x57)
+#define FRV_INSTCODE_VSRAVV	((0x29 << 10) | (0x0 << 7) | 0x57)
+#define FRV_INSTCODE_VSRAVX	((0x29 << 10) | (0x4 << 7) | 0x57)
+#define FRV_INSTCODE_VSRAVI	((0x29 << 10) | (0x3 << 7) | 0x57)
+#define FRV_INSTCODE_VREDSUMVS	((0x00 << 10) | (0x2 << 7) | 0x57)
+#define FRV_INSTCODE_VREDANDVS	((0x01 << 10) | (0x2 << 7) | 0x57)
+#define FRV_INSTCODE_VREDORVS	((0x02 << 10) | (0x2 << 7) | 0x57)
+#define FRV_INSTCODE_VREDXORVS	((0x03 << 10) | (0x2 << 7) | 0x57)
+#define FRV_INSTCODE_VREDMINUVS	((0x04 << 10) | (0x2 << 7) | 0x57)
+#define FRV_INSTCODE_VREDMINVS	((0x05 << 10) | (0x2 << 7) | 0x57)
+#define FRV_INSTCODE_VREDMAXUVS	((0x06 << 10) | (0x2 << 7) | 0x57)
+#define FRV_INSTCODE_VREDMAXVS	((0x07 << 10) | (0x2 << 7) | 0x57)
+#define FRV_INSTCODE_VMVXS	((0x00 << 17) | (0x10 << 10) | (0x2 << 7) | 0x57) // vs1 picks the operation
+#define FRV_INSTCODE_VMVSX	((0x00 << 17) | (0x10 << 10) | (0x6 << 7) | 0x57) // vs2 picks the operation
+#define FRV_INSTCODE_VMULVV	((0x25 << 10) | (0x2 << 7) | 0x57)
+#define FRV_INSTCODE_VMULVX	((0x25 << 10) | (0x6 << 7) | 0x57)
+#define FRV_INSTCODE_VMACCVV	((0x2d << 10) | (0x2 << 7) | 0x57)
+#define FRV_INSTCODE_VMACCVX	((0x2d << 10) | (0x6 << 7) | 0x57)
+#define FRV_INSTCODE_SH1ADD	((0x10 << 10) | (0x2 << 7) | 0x33) // Zba
+#define FRV_INSTCODE_SH2ADD	((0x10 << 10) | (0x4 << 7) | 0x33)
+#define FRV_INSTCODE_SH3ADD	((0x10 << 10) | (0x6 << 7) | 0x33)
+#define FRV_INSTCODE_ADDUW	((0x04 << 10) | (0x0 << 7) | 0x3b)
+#define FRV_INSTCODE_SH1ADDUW	((0x10 << 10) | (0x2 << 7) | 0x3b)
+#define FRV_INSTCODE_SH2ADDUW	((0x10 << 10) | (0x4 << 7) | 0x3b)
+#define FRV_INSTCODE_SH3ADDUW	((0x10 << 10) | (0x6 << 7) | 0x3b)
+#define FRV_INSTCODE_SLLIUW	((0x04 << 10) | (0x1 << 7) | 0x1b) // The low bit of funct7 is shamt[5]
+#define FRV_INSTCODE_ANDN	((0x20 << 10) | (0x7 << 7) | 0x33) // Zbb
+#define FRV_INSTCODE_ORN	((0x20 << 10) | (0x6 << 7) | 0x33)
+#define FRV_INSTCODE_XNOR	((0x20 << 10) | (0x4 << 7) | 0x33)
+#define FRV_INSTCODE_CLZ	((0x600 << 10) | (0x1 << 7) | 0x13) // The unary ones have their funct12
+#define FRV_INSTCODE_CTZ	((0x601 << 10) | (0x1 << 7) | 0x13)
+#define FRV_INSTCODE_CPOP	((0x602 << 10) | (0x1 << 7) | 0x13)
+#define FRV_INSTCODE_SEXTB	((0x604 << 10) | (0x1 << 7) | 0x13)
+#define FRV_INSTCODE_SEXTH	((0x605 << 10) | (0x1 << 7) | 0x13)
+#define FRV_INSTCODE_CLZW	((0x600 << 10) | (0x1 << 7) | 0x1b)
+#define FRV_INSTCODE_CTZW	((0x601 << 10) | (0x1 << 7) | 0x1b)
+#define FRV_INSTCODE_CPOPW	((0x602 << 10) | (0x1 << 7) | 0x1b)
+#define FRV_INSTCODE_ORCB	((0x287 << 10) | (0x5 << 7) | 0x13)
+#define FRV_INSTCODE_REV8	((0x6b8 << 10) | (0x5 << 7) | 0x13)
+#define FRV_INSTCODE_ZEXTH	((0x04 << 10) | (0x4 << 7) | 0x3b) // rs2 is 0
+#define FRV_INSTCODE_MAX	((0x05 << 10) | (0x6 << 7) | 0x33)
+#define FRV_INSTCODE_MAXU	((0x05 << 10) | (0x7 << 7) | 0x33)
+#define FRV_INSTCODE_MIN	((0x05 << 10) | (0x4 << 7) | 0x33)
+#define FRV_INSTCODE_MINU	((0x05 << 10) | (0x5 << 7) | 0x33)
+#define FRV_INSTCODE_ROL	((0x30 << 10) | (0x1 << 7) | 0x33)
+#define FRV_INSTCODE_ROR	((0x30 << 10) | (0x5 << 7) | 0x33)
+#define FRV_INSTCODE_ROLW	((0x30 << 10) | (0x1 << 7) | 0x3b)
+#define FRV_INSTCODE_RORW	((0x30 << 10) | (0x5 << 7) | 0x3b)
+#define FRV_INSTCODE_RORI	((0x18 << 10) | (0x5 << 7) | 0x13)
+#define FRV_INSTCODE_RORIW	((0x30 << 10) | (0x5 << 7) | 0x1b)
+#define FRV_INSTCODE_BCLR	((0x24 << 10) | (0x1 << 7) | 0x33) // Zbs
+#define FRV_INSTCODE_BCLRI	((0x12 << 10) | (0x1 << 7) | 0x13)
+#define FRV_INSTCODE_BEXT	((0x24 << 10) | (0x5 << 7) | 0x33)
+#define FRV_INSTCODE_BEXTI	((0x12 << 10) | (0x5 << 7) | 0x13)
+#define FRV_INSTCODE_BINV	((0x34 << 10) | (0x1 << 7) | 0x33)
+#define FRV_INSTCODE_BINVI	((0x1a << 10) | (0x1 << 7) | 0x13)
+#define FRV_INSTCODE_BSET	((0x14 << 10) | (0x1 << 7) | 0x33)
+#define FRV_INSTCODE_BSETI	((0x0a << 10) | (0x1 << 7) | 0x13)
 
 // Machine-level CSRs
+/// ISA and extensions
+#define FRV_CSR_MISA (0x301)
 /// Hardware thread ID
 #define FRV_CSR_MHARTID (0xf14)
 /// Machine status register
@@ -130,6 +342,42 @@ enum FrvRegsAbi {
 #define FRV_CSR_MTVAL (0x343)
 /// Machine interrupt pending
 #define FRV_CSR_MIP (0x344)
+/// Machine cycle counter
+#define FRV_CSR_MCYCLE (0xb00)
+/// Machine instructions-retired counter
+#define FRV_CSR_MINSTRET (0xb02)
+
+// Floating-point CSRs, views of fcsr
+/// Accrued exceptions
+#define FRV_CSR_FFLAGS (0x001)
+/// Dynamic rounding mode
+#define FRV_CSR_FRM (0x002)
+/// Both of them
+#define FRV_CSR_FCSR (0x003)
+
+// Vector CSRs
+/// First element to execute, set by a trap in the middle of a vector instruction
+#define FRV_CSR_VSTART (0x008)
+/// Fixed-point saturation flag, a view of vcsr
+#define FRV_CSR_VXSAT (0x009)
+/// Fixed-point rounding mode, a view of vcsr
+#define FRV_CSR_VXRM (0x00a)
+/// Both of them
+#define FRV_CSR_VCSR (0x00f)
+/// Vector length, only vsetvl* write it
+#define FRV_CSR_VL (0xc20)
+/// Vector data type, only vsetvl* write it
+#define FRV_CSR_VTYPE (0xc21)
+/// Bytes of a vector register
+#define FRV_CSR_VLENB (0xc22)
+
+// Unprivileged counters, read-only shadows
+/// Cycle counter for RDCYCLE
+#define FRV_CSR_CYCLE (0xc00)
+/// Timer for RDTIME
+#define FRV_CSR_TIME (0xc01)
+/// Instructions-retired counter for RDINSTRET
+#define FRV_CSR_INSTRET (0xc02)
 
 // Supervisor-level CSRs
 /// Supervisor status register
@@ -138,6 +386,8 @@ enum FrvRegsAbi {
 #define FRV_CSR_SIE (0x104)
 /// Supervisor trap handler base address
 #define FRV_CSR_STVEC (0x105)
+/// Supervisor counter enable
+#define FRV_CSR_SCOUNTEREN (0x106)
 /// Scratch register for supervisor trap handlers
 #define FRV_CSR_SSCRATCH (0x140)
 /// Supervisor exception program counter
@@ -151,6 +401,47 @@ enum FrvRegsAbi {
 /// Supervisor address translation and protection
 #define FRV_CSR_SATP (0x180)
 
+// mstatus fields
+#define FRV_MSTATUS_SIE		(1ull << 1)
+#define FRV_MSTATUS_MIE		(1ull << 3)
+#define FRV_MSTATUS_SPIE	(1ull << 5)
+#define FRV_MSTATUS_MPIE	(1ull << 7)
+#define FRV_MSTATUS_SPP		(1ull << 8)
+#define FRV_MSTATUS_VS		(3ull << 9) // Vector unit off, initial, clean, dirty
+#define FRV_MSTATUS_MPP_SHIFT	(11)
+#define FRV_MSTATUS_MPP		(3ull << FRV_MSTATUS_MPP_SHIFT)
+#define FRV_MSTATUS_FS		(3ull << 13) // FPU off, initial, clean, dirty
+#define FRV_MSTATUS_MPRV	(1ull << 17)
+#define FRV_MSTATUS_SUM		(1ull << 18)
+#define FRV_MSTATUS_MXR		(1ull << 19)
+#define FRV_MSTATUS_SD		(1ull << 63) // FS or VS is dirty
+/// The part of mstatus visible as sstatus
+#define FRV_SSTATUS_MASK	(0x80000003000de762ull)
+
+// mip/mie bits the harts drive themselves, the machine ones come from the CLINT (clint.h)
+#define FRV_MIP_SSIP		(1ull << 1)
+#define FRV_MIP_STIP		(1ull << 5)
+#define FRV_MIP_SEIP		(1ull << 9)
+
+// misa: MXL 64 and the extension letters
+#define FRV_MISA_MXL_64		(2ull << 62)
+#define FRV_MISA_EXT(c)		(1ull << ((c) - 'A'))
+#define FRV_MISA		(FRV_MISA_MXL_64 | FRV_MISA_EXT('I') | FRV_MISA_EXT('M') | FRV_MISA_EXT('A') | \
+				 FRV_MISA_EXT('F') | FRV_MISA_EXT('D') | FRV_MISA_EXT('C') | FRV_MISA_EXT('V') | FRV_MISA_EXT('S') | \
+				 FRV_MISA_EXT('U') | FRV_MISA_EXT('B'))
+
+/* Storage of the implemented CSRs, the views (sstatus, sie, sip, cycle, ...) live in the slot they show
+ * mcycle and minstret hold their offset to the retired count, fcsr lacks the flags the host FPU still holds
+ */
+enum FrvCsrSlot {
+	FRV_CSRS_MSTATUS = 0, FRV_CSRS_MISA, FRV_CSRS_MEDELEG, FRV_CSRS_MIDELEG, FRV_CSRS_MIE, FRV_CSRS_MTVEC,
+	FRV_CSRS_MCOUNTEREN, FRV_CSRS_MSCRATCH, FRV_CSRS_MEPC, FRV_CSRS_MCAUSE, FRV_CSRS_MTVAL, FRV_CSRS_MIP,
+	FRV_CSRS_MCYCLE, FRV_CSRS_MINSTRET, FRV_CSRS_MHARTID,
+	FRV_CSRS_STVEC, FRV_CSRS_SCOUNTEREN, FRV_CSRS_SSCRATCH, FRV_CSRS_SEPC, FRV_CSRS_SCAUSE, FRV_CSRS_STVAL,
+	FRV_CSRS_SATP, FRV_CSRS_FCSR, FRV_CSRS_VSTART, FRV_CSRS_VCSR, FRV_CSRS_VL, FRV_CSRS_VTYPE, FRV_CSRS_VLENB,
+	FRV_CSRS_COUNT
+};
+
 // Helpers
 #define FRV_INST_OPCODE(inst) (inst & 0x7f)
 #define FRV_INST_CSR_CODE(inst) ((inst >> 20) & 0xfff)
@@ -176,15 +467,80 @@ enum FrvRegsAbi {
 #define FRV_INST_SHAMT64(inst) ((inst >> 20) & 0x3f)
 #define FRV_INST_SHAMT32(inst) ((inst >> 20) & 0x1f)
 
+enum FrvEnvMode {
+	FRV_ENV_FRV,	// The ecalls of enum FrvEcall, keyed on a0
+	FRV_ENV_LINUX	// Linux user-mode syscalls, keyed on a7
+};
+
+// Process state of the Linux syscall emulation
+#define FRV_LINUX_MAX_FDS (1024) // Host fds the guest can hold open
+
+struct FrvLinux {
+	uint64_t	base; // Guest address of the first RAM byte, the lowest page of the image
+	uint64_t	brk; // Current program break
+	uint64_t	brkmin; // Start of the heap, the end of the image
+	uint64_t	brkmax; // Highest break so far, the memory above it was never handed out
+	uint64_t	mmaptop; // Anonymous mappings are carved downwards from here
+	uint64_t	mmapend; // Start of the stack, the highest mmaptop
+	int64_t		status; // Exit status
+	uint8_t		fds[FRV_LINUX_MAX_FDS / 8]; // Bit per host fd the guest opened
+};
+
+// The hot state (pc, regs, the counters) comes first, the CSRs are only touched by system code
 struct FrvCPU {
 	uint64_t	pc;
 	uint64_t	regs[FRV_NUM_REGS];
-	uint64_t	csrs[FRV_NUM_CSRS];
+	uint64_t	fregs[FRV_NUM_REGS]; // Singles NaN-boxed
+	uint8_t		priv; // Current privilege mode
+	uint64_t	resaddr; // Reserved by LR, FRV_NO_RESERVATION if nothing is
+	uint64_t	resval; // What LR read there, SC only succeeds while memory still holds it
+	uint64_t	instret; // Retired instructions, counted a block at a time
+	const struct FrvBlock* block; // The running one, instret lags behind the pc by the part run of it
+	uint64_t	irqpoll; // instret at which the interrupts are looked at next, 0 to do it at the next block
+	uint64_t	cause; // Exception raised by the running instruction, FRV_CAUSE_NONE if none (the MMU has its own)
+	uint64_t	tval;
+	uint64_t	csrs[FRV_CSRS_COUNT]; // Indexed by enum FrvCsrSlot
+	uint8_t		vregs[FRV_NUM_VREGS][FRV_VLENB]; // Element i of a group starting at v is at vregs[v] + i * SEW
 	struct FrvBUS*	bus;
+	struct FrvMMU	mmu;
+	struct FrvTCache tcache;
+	const char*	snapshot; // Saved to by the snapshot ecall, NULL to ignore it
+	FILE*		out; // Where the ecalls print, stdout by default
+	uint8_t		env; // Ecall ABI, enum FrvEnvMode
+	bool		halted; // The guest ended the run itself (end ecall, exit, return to 0), not an error
+	struct FrvLinux	sys;
+#ifdef FRV_JIT
+	struct FrvJit	jit;
+#endif
+#ifdef FRV_PROFILE
+	struct FrvProfile prof;
+#endif
+#ifdef FRV_TRACE
+	struct FrvTraceRing* trace; // NULL while not tracing
+#endif
 };
 
-struct FrvCPU frvNewCpu(struct FrvBUS* bus);
+/* One hart, any number of them can share the bus, each on its own thread
+ * a0 and mhartid hold hartid at reset
+ * Built in place, the MMU makes the CPU about 46KB. frvIsCpuValid tells if it worked
+ */
+void frvCpuInit(struct FrvCPU* cpu, struct FrvBUS* bus, const uint64_t hartid);
+bool frvIsCpuValid(const struct FrvCPU* const cpu);
+void frvCpuDestroy(struct FrvCPU* cpu);
 void frvCpuPrintRegs(const struct FrvCPU* const cpu); // print regs
 void frvCpuPrintCsrs(const struct FrvCPU* const cpu); // print some of the csrs
-bool frvCpuLoadProgram(struct FrvCPU* cpu, const char* path); // load the binary from path into memory
-void frvCpuRun(struct FrvCPU* cpu); // The main frvCpu cycle to run the program
+bool frvCpuLoadProgram(struct FrvCPU* cpu, const char* path); // load the ELF or flat binary from path into memory
+/* The main frvCpu cycle to run the program
+ * Exceptions and interrupts go to mtvec/stvec, a vector of 0 is no handler: the exception stops it
+ * and halted stays false, as it does after a failed ecall
+ */
+void frvCpuRun(struct FrvCPU* cpu);
+/* Snapshots hold pc, privilege, regs, csrs and the RAM image
+ * The image is page aligned in the file so a restore into a lazy RAM maps it copy-on-write
+ */
+bool frvCpuSaveSnapshot(const struct FrvCPU* const cpu, const char* path);
+bool frvCpuRestoreSnapshot(struct FrvCPU* cpu, const char* path);
+uint64_t frvCpuSnapshotRamSize(const char* path); // 0 if path is not a snapshot
+#ifdef FRV_JIT
+int frvCpuJitExec(struct FrvCPU* cpu, const struct FrvInst* inst); // Interpret one instruction for the JIT
+#endif
@@ -1,67 +1,137 @@
 #include "env.h" 
 
+// Write the string at vaddr out a page at a time, byte loads only where there is no host memory
+static bool frvEnvPrintString(struct FrvCPU* cpu, uint64_t vaddr)
+{
+	while (true) {
+		uint8_t* host;
+		uint64_t paddr, c;
+		if (!frvMmuHost(&cpu->mmu, vaddr, FRV_ACCESS_LOAD, &host, &paddr)) return false;
+		if (!host) {
+			if (!frvMmuLoad(&cpu->mmu, vaddr, 1, &c)) return false;
+			if (c == '\0') return true;
+			fputc((char)c, cpu->out);
+			vaddr++;
+			continue;
+		}
+
+		const uint64_t len = FRV_BUS_PAGE_SIZE - (vaddr & FRV_BUS_PAGE_MASK);
+		const uint8_t* end = memchr(host, '\0', len);
+		fwrite(host, 1, end ? (uint64_t)(end - host) : len, cpu->out);
+		if (end) return true;
+		vaddr += len;
+	}
+}
+
+bool frvEnvCopyOut(struct FrvCPU* cpu, uint64_t vaddr, const uint8_t* src, uint64_t len)
+{
+	while (len) {
+		uint8_t* host;
+		uint64_t paddr;
+		if (!frvMmuHost(&cpu->mmu, vaddr, FRV_ACCESS_STORE, &host, &paddr)) return false;
+		uint64_t n = FRV_BUS_PAGE_SIZE - (vaddr & FRV_BUS_PAGE_MASK);
+		if (n > len) n = len;
+		if (host) {
+			memcpy(host, src, n);
+		} else {
+			if (!frvMmuStore(&cpu->mmu, vaddr, 1, *src, &paddr)) return false;
+			n = 1;
+		}
+		frvTCacheInvalidateRange(&cpu->tcache, paddr, n);
+		vaddr += n;
+		src += n;
+		len -= n;
+	}
+	return true;
+}
+
+/* Read a line of at most bufsiz - 1 chars into the guest buffer, the rest of a longer line is dropped
+ * The newline is not stored, the string is always terminated
+ */
+static bool frvEnvScanString(struct FrvCPU* cpu, const uint64_t vaddr, const uint64_t bufsiz)
+{
+	char line[FRV_ENV_LINE_CHUNK];
+	uint64_t i = 0;
+	bool eol = false;
+	while (!eol && i + 1 < bufsiz) {
+		const uint64_t want = (bufsiz - i < sizeof(line)) ? bufsiz - i : sizeof(line);
+		if (!fgets(line, want, stdin)) break;
+		uint64_t n = strlen(line);
+		if (n && line[n - 1] == '\n') {
+			line[--n] = '\0';
+			eol = true;
+		}
+		if (!frvEnvCopyOut(cpu, vaddr + i, (const uint8_t*)line, n)) return false;
+		i += n;
+		if (feof(stdin)) break;
+	}
+	if (!frvEnvCopyOut(cpu, vaddr + i, (const uint8_t*)"", 1)) return false;
+
+	int c;
+	if (!eol && !feof(stdin))
+		while ((c = getchar()) != EOF && c != '\n') {}
+	return true;
+}
+
 bool frvEcallExec(struct FrvCPU* cpu)
 {
+	if (cpu->env == FRV_ENV_LINUX) return frvLinuxSyscall(cpu);
+
 	const enum FrvEcall ecall = cpu->regs[FRV_ABI_REG_A0];
 	const uint64_t in = cpu->regs[FRV_ABI_REG_A1];
 	switch (ecall) {
 		case FRV_ECALL_PRINT_D: {
-			printf("%ld", (int64_t)in);
+			fprintf(cpu->out, "%ld", (int64_t)in);
 			return true;
 		}
 
 		case FRV_ECALL_PRINT_S: {
-			size_t i = 0;
-			uint64_t c;
-			while (true) {
-				if (!frvBusLoad(cpu->bus, in + i, 1, &c)) return false;
-				if (c != '\0') putchar((char)c);
-				else break;
-				i++;
-			}
-			return true;
+			return frvEnvPrintString(cpu, in);
 		}
 
 		case FRV_ECALL_PRINT_C: {
-			putchar((char)in);
+			fputc((char)in, cpu->out);
 			return true;
 		}
 
 		case FRV_ECALL_PRINT_X: {
-			printf("%lX", in);
+			fprintf(cpu->out, "%lX", in);
 			return true;
 		}
 
 		case FRV_ECALL_SCAN_D: {
+			fflush(cpu->out);
 			scanf("%ld", &cpu->regs[FRV_ABI_REG_A1]);
 			return true;
 	        }
 
 		case FRV_ECALL_SCAN_S: {
-			const uint64_t bufsiz = cpu->regs[FRV_ABI_REG_A2];
-			int c;
-			size_t i = 0;
-			while ((c = getchar()) != EOF && c != '\n' && i + 1 < bufsiz) {
-				if (!frvBusStore(cpu->bus, in + i, 1, (uint64_t) c)) return false;
-				i++;
-			}
-			if (!frvBusStore(cpu->bus, in + i, 1, 0)) return false;
-			if (c != '\n' && c != EOF)
-				while ((c = getchar()) != EOF && c != '\n') {}
-			return true;
+			fflush(cpu->out);
+			return frvEnvScanString(cpu, in, cpu->regs[FRV_ABI_REG_A2]);
 	        }
 
 		case FRV_ECALL_SCAN_C: {
+			fflush(cpu->out);
 			cpu->regs[FRV_ABI_REG_A1] = getchar();
 			return true;
 	        }
 
+		case FRV_ECALL_SNAPSHOT: {
+			// pc is already past the ecall, the restored machine carries on from there
+			cpu->regs[FRV_ABI_REG_A1] = 1;
+			const bool ok = !cpu->snapshot || frvCpuSaveSnapshot(cpu, cpu->snapshot);
+			cpu->regs[FRV_ABI_REG_A1] = 0;
+			return ok;
+		}
+
 		case FRV_ECALL_END: {
+			fflush(cpu->out);
+			cpu->halted = true;
 			return false;
 		}
 
 		default: {
-			printf("Invalid Ecall: 0x%X\n", ecall);
+			fprintf(cpu->out, "Invalid Ecall: 0x%X\n", ecall);
 			return false;
 		}
 	}
@@ -5,6 +5,10 @@
 #include <stdbool.h>
 
 #include "cpu.h"
+#include "linux.h"
+
+#define FRV_ENV_LINE_CHUNK (4096) // Bytes moved per step of the string scan
+#define FRV_ENV_OUT_BUF_SIZE (1 << 20) // Console buffer, flushed when full, on END and before reading input
 
 enum FrvEcall {
 	FRV_ECALL_PRINT_D = 0,	// Print the number at a1 as a decimal
@@ -14,8 +18,11 @@ enum FrvEcall {
 	FRV_ECALL_SCAN_D =  4,	// Scan the number from stdin and write to a1
 	FRV_ECALL_SCAN_S =  5,	// Scan the string from stdin and write the memory pointed by a1
 	FRV_ECALL_SCAN_C =  6,	// Scan the char from stdin and write to a1
-	FRV_ECALL_END =     7	// Terminate the program
+	FRV_ECALL_END =     7,	// Terminate the program
+	FRV_ECALL_SNAPSHOT = 8	// Save a snapshot, a1 is 0 here and 1 when resumed from it
 };
 
-// Do the ecalls
+// Do the ecalls of the cpu's env mode
 bool frvEcallExec(struct FrvCPU* cpu);
+// Copy len host bytes to the guest at vaddr a page at a time, dropping the blocks it overwrites
+bool frvEnvCopyOut(struct FrvCPU* cpu, uint64_t vaddr, const uint8_t* src, uint64_t len);
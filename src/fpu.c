@@ -0,0 +1,298 @@
+#include <float.h>
+
+#include "fpu.h"
+
+_Static_assert(LDBL_MANT_DIG >= DBL_MANT_DIG + 2, "RMM needs two more bits in long double");
+
+// What the arithmetic instructions compute, S and D alike
+enum FrvFpuKind {
+	FRV_FPUK_ADD, FRV_FPUK_SUB, FRV_FPUK_MUL, FRV_FPUK_DIV, FRV_FPUK_SQRT,
+	FRV_FPUK_MADD, FRV_FPUK_MSUB, FRV_FPUK_NMSUB, FRV_FPUK_NMADD,
+	FRV_FPUK_MOVE // Only rounded, the conversions
+};
+
+// The host modes of enum FrvRoundingMode, RMM is RNE with the ties fixed up afterwards
+static const int frvFpuHostRm[] = { FE_TONEAREST, FE_TOWARDZERO, FE_DOWNWARD, FE_UPWARD, FE_TONEAREST };
+
+uint32_t frvFpuFlags(void)
+{
+	const int host = fetestexcept(FE_ALL_EXCEPT);
+	return ((host & FE_INEXACT) ? FRV_FFLAGS_NX : 0) | ((host & FE_UNDERFLOW) ? FRV_FFLAGS_UF : 0) |
+		((host & FE_OVERFLOW) ? FRV_FFLAGS_OF : 0) | ((host & FE_DIVBYZERO) ? FRV_FFLAGS_DZ : 0) |
+		((host & FE_INVALID) ? FRV_FFLAGS_NV : 0);
+}
+
+void frvFpuClearFlags(void)
+{
+	feclearexcept(FE_ALL_EXCEPT);
+}
+
+static bool frvFpuIsSnanS(const uint64_t reg)
+{
+	const uint32_t bits = frvFpuBitsS(reg);
+	return (bits & 0x7fc00000) == 0x7f800000 && (bits & 0x003fffff);
+}
+
+static bool frvFpuIsSnanD(const uint64_t reg)
+{
+	return (reg & 0x7ff8000000000000ull) == 0x7ff0000000000000ull && (reg & 0x0007ffffffffffffull);
+}
+
+// The operation of kind in the precision of type
+#define FRV_FPU_OP(name, type, sqrtfn, fmafn) \
+static type name(const enum FrvFpuKind kind, const type a, const type b, const type c) \
+{ \
+	switch (kind) { \
+	case FRV_FPUK_ADD:	return a + b; \
+	case FRV_FPUK_SUB:	return a - b; \
+	case FRV_FPUK_MUL:	return a * b; \
+	case FRV_FPUK_DIV:	return a / b; \
+	case FRV_FPUK_SQRT:	return sqrtfn(a); \
+	case FRV_FPUK_MADD:	return fmafn(a, b, c); \
+	case FRV_FPUK_MSUB:	return fmafn(a, b, -c); \
+	case FRV_FPUK_NMSUB:	return fmafn(-a, b, c); \
+	case FRV_FPUK_NMADD:	return fmafn(-a, b, -c); \
+	default:		return a; \
+	} \
+}
+
+FRV_FPU_OP(frvFpuOpS, float, sqrtf, fmaf)
+FRV_FPU_OP(frvFpuOpD, double, sqrt, fma)
+FRV_FPU_OP(frvFpuOpWide, long double, sqrtl, fmal)
+
+/* RNE, RTZ, RDN and RUP are host modes, the host rounds right in them and raises the flags
+ * The volatiles keep the operation in between the mode switches
+ */
+static uint64_t frvFpuDirected(const enum FrvFpuKind kind, const bool dbl, const uint32_t rm,
+			       const long double a, const long double b, const long double c)
+{
+	volatile long double va = a, vb = b, vc = c;
+	volatile double d;
+	volatile float f;
+	fesetround(frvFpuHostRm[rm]);
+	if (dbl) d = frvFpuOpD(kind, va, vb, vc);
+	else f = frvFpuOpS(kind, va, vb, vc);
+	fesetround(FE_TONEAREST);
+	return dbl ? frvFpuRegD(d) : frvFpuRegS(f);
+}
+
+// A result truncated to long double rounded to odd instead: its last bit set if anything was cut off
+static long double frvFpuOdd(const long double w, const bool inexact)
+{
+	int exp;
+	if (!inexact || !isfinite(w) || fmodl(scalbnl(frexpl(w, &exp), LDBL_MANT_DIG), 2) != 0) return w;
+	return nextafterl(w, copysignl(INFINITY, w));
+}
+
+// RNE to the format, then a midpoint it took towards zero goes away from it
+static uint64_t frvFpuNearestMax(const long double w, const bool dbl)
+{
+	// The flags are the ones of RNE, nextafter must not add its own
+	volatile long double vw = w;
+	volatile double d;
+	volatile float f;
+	if (dbl) d = vw;
+	else f = vw;
+	fexcept_t flags;
+	fegetexceptflag(&flags, FE_ALL_EXCEPT);
+
+	if (dbl) {
+		double r = d;
+		if (isfinite(r) && r != w) {
+			const double other = nextafter(r, (w > r) ? INFINITY : -INFINITY);
+			if ((long double)r + other == 2 * w && fabs(other) > fabs(r)) r = other;
+		}
+		fesetexceptflag(&flags, FE_ALL_EXCEPT);
+		return frvFpuRegD(r);
+	}
+	float r = f;
+	if (isfinite(r) && r != w) {
+		const float other = nextafterf(r, (w > r) ? INFINITY : -INFINITY);
+		if ((long double)r + other == 2 * w && fabsf(other) > fabsf(r)) r = other;
+	}
+	fesetexceptflag(&flags, FE_ALL_EXCEPT);
+	return frvFpuRegS(r);
+}
+
+/* RMM, which the host lacks: compute in long double rounded to odd, then round that to the format
+ * With two bits to spare the first rounding never changes the outcome of the second
+ * Only NV and DZ come from the computation, the rounding raises the rest
+ */
+static uint64_t frvFpuRound(const enum FrvFpuKind kind, const bool dbl, const uint32_t rm,
+			    const long double a, const long double b, const long double c)
+{
+	if (rm != FRV_RM_RMM) return frvFpuDirected(kind, dbl, rm, a, b, c);
+
+	const int accrued = fetestexcept(FE_ALL_EXCEPT);
+	volatile long double va = a, vb = b, vc = c;
+	feclearexcept(FE_ALL_EXCEPT);
+	fesetround(FE_TOWARDZERO);
+	volatile long double w = frvFpuOpWide(kind, va, vb, vc);
+	fesetround(FE_TONEAREST);
+	const int wide = fetestexcept(FE_ALL_EXCEPT);
+	const long double odd = frvFpuOdd(w, wide & FE_INEXACT);
+
+	feclearexcept(FE_ALL_EXCEPT);
+	const uint64_t r = frvFpuNearestMax(odd, dbl);
+	feraiseexcept(accrued | (wide & (FE_INVALID | FE_DIVBYZERO)));
+	return r;
+}
+
+// The arithmetic instructions, the D ones follow the F ones in enum FrvOp
+static uint64_t frvFpuArith(const uint8_t op, const uint32_t rm, const uint64_t x, const uint64_t y, const uint64_t z)
+{
+	enum FrvFpuKind kind;
+	switch (op) {
+	case FRV_OP_FADDS: case FRV_OP_FADDD:		kind = FRV_FPUK_ADD; break;
+	case FRV_OP_FSUBS: case FRV_OP_FSUBD:		kind = FRV_FPUK_SUB; break;
+	case FRV_OP_FMULS: case FRV_OP_FMULD:		kind = FRV_FPUK_MUL; break;
+	case FRV_OP_FDIVS: case FRV_OP_FDIVD:		kind = FRV_FPUK_DIV; break;
+	case FRV_OP_FSQRTS: case FRV_OP_FSQRTD:		kind = FRV_FPUK_SQRT; break;
+	case FRV_OP_FMADDS: case FRV_OP_FMADDD:		kind = FRV_FPUK_MADD; break;
+	case FRV_OP_FMSUBS: case FRV_OP_FMSUBD:		kind = FRV_FPUK_MSUB; break;
+	case FRV_OP_FNMSUBS: case FRV_OP_FNMSUBD:	kind = FRV_FPUK_NMSUB; break;
+	default:					kind = FRV_FPUK_NMADD; break;
+	}
+
+	// Only the operands in use are converted, a signaling NaN elsewhere must not raise NV
+	const bool dbl = (op >= FRV_OP_FLD);
+	const long double a = dbl ? frvFpuD(x) : frvFpuS(x);
+	const long double b = (kind == FRV_FPUK_SQRT) ? 0 : (dbl ? frvFpuD(y) : frvFpuS(y));
+	const long double c = (kind < FRV_FPUK_MADD) ? 0 : (dbl ? frvFpuD(z) : frvFpuS(z));
+	const uint64_t r = frvFpuRound(kind, dbl, rm, a, b, c);
+	if (kind >= FRV_FPUK_MADD) frvFpuFmaInvalid(a, b, dbl ? frvFpuD(r) : frvFpuS(r));
+	return r;
+}
+
+// Round a value that long double holds exactly to the format, the conversions to S and D
+static uint64_t frvFpuConvert(const long double v, const bool dbl, const uint32_t rm)
+{
+	if (rm == FRV_RM_RNE) return dbl ? frvFpuRegD(v) : frvFpuRegS(v);
+	return frvFpuRound(FRV_FPUK_MOVE, dbl, rm, v, 0, 0);
+}
+
+/* To an integer in mode rm, saturated: NaN and the ones too large give the maximum, the ones
+ * too small the minimum, both invalid. The W forms are sign-extended, even the unsigned one
+ */
+static uint64_t frvFpuToInt(const double v, const uint32_t rm, const bool sign, const bool word)
+{
+	const double lo = sign ? (word ? -0x1p31 : -0x1p63) : 0;
+	const double hi = word ? (sign ? 0x1p31 : 0x1p32) : (sign ? 0x1p63 : 0x1p64);
+	const uint64_t min = sign ? (word ? (uint64_t)INT32_MIN : (uint64_t)INT64_MIN) : 0;
+	const uint64_t max = sign ? (word ? INT32_MAX : INT64_MAX) : UINT64_MAX;
+	if (v != v) {
+		feraiseexcept(FE_INVALID);
+		return max;
+	}
+
+	// Some of the libm roundings raise inexact themselves, the outcome decides here
+	fexcept_t flags;
+	fegetexceptflag(&flags, FE_ALL_EXCEPT);
+	double r;
+	switch (rm) {
+	case FRV_RM_RTZ:	r = trunc(v); break;
+	case FRV_RM_RDN:	r = floor(v); break;
+	case FRV_RM_RUP:	r = ceil(v); break;
+	case FRV_RM_RMM:	r = round(v); break;
+	default:		r = nearbyint(v); break;
+	}
+	fesetexceptflag(&flags, FE_ALL_EXCEPT);
+	if (r >= hi || r < lo) {
+		feraiseexcept(FE_INVALID);
+		return (r < lo) ? min : max;
+	}
+	if (r != v) feraiseexcept(FE_INEXACT);
+	if (!sign) return word ? (uint64_t)(int64_t)(int32_t)(uint32_t)r : (uint64_t)r;
+	return (uint64_t)(int64_t)r;
+}
+
+// -0 is below +0 here, a NaN only wins against another one
+static double frvFpuMinMax(const double a, const double b, const bool max)
+{
+	if (a != a) return b;
+	if (b != b) return a;
+	if (a == b) return ((signbit(a) != 0) != max) ? a : b;
+	return ((a < b) != max) ? a : b;
+}
+
+// fclass works on the bits, a compare would raise invalid on a signaling NaN
+static uint64_t frvFpuClass(const uint64_t bits, const int exp, const int mant)
+{
+	const bool neg = bits >> (exp + mant);
+	const uint64_t e = (bits >> mant) & ((1ull << exp) - 1), m = bits & ((1ull << mant) - 1);
+	if (e == (1ull << exp) - 1 && m) return (m >> (mant - 1)) ? (1 << 9) : (1 << 8);
+	if (e == (1ull << exp) - 1) return neg ? (1 << 0) : (1 << 7);
+	if (!e && !m) return neg ? (1 << 3) : (1 << 4);
+	if (!e) return neg ? (1 << 2) : (1 << 5);
+	return neg ? (1 << 1) : (1 << 6);
+}
+
+bool frvFpuExec(const struct FrvInst* inst, const uint32_t rm, uint64_t* fregs, uint64_t* regs)
+{
+	const uint64_t x = fregs[inst->rs1], y = fregs[inst->rs2], z = fregs[inst->raw >> 27];
+	const bool dbl = (inst->op >= FRV_OP_FLD);
+	const bool snan = dbl ? (frvFpuIsSnanD(x) || frvFpuIsSnanD(y)) : (frvFpuIsSnanS(x) || frvFpuIsSnanS(y));
+
+	// No rounding mode, the funct3 picks the operation
+	switch (inst->op) {
+	case FRV_OP_FMINS: case FRV_OP_FMAXS: case FRV_OP_FMIND: case FRV_OP_FMAXD: {
+		const bool max = (inst->op == FRV_OP_FMAXS || inst->op == FRV_OP_FMAXD);
+		if (snan) feraiseexcept(FE_INVALID);
+		fregs[inst->rd] = dbl ? frvFpuRegD(frvFpuMinMax(frvFpuD(x), frvFpuD(y), max)) :
+					frvFpuRegS(frvFpuMinMax(frvFpuS(x), frvFpuS(y), max));
+		return true;
+	}
+
+	case FRV_OP_FEQS: case FRV_OP_FEQD: // Quiet, only a signaling NaN is invalid
+		if (snan) feraiseexcept(FE_INVALID);
+		regs[inst->rd] = dbl ? (frvFpuD(x) == frvFpuD(y)) : (frvFpuS(x) == frvFpuS(y));
+		return true;
+
+	case FRV_OP_FLTS: case FRV_OP_FLES: case FRV_OP_FLTD: case FRV_OP_FLED: { // Any NaN is invalid
+		const double a = dbl ? frvFpuD(x) : frvFpuS(x), b = dbl ? frvFpuD(y) : frvFpuS(y);
+		const bool lt = (inst->op == FRV_OP_FLTS || inst->op == FRV_OP_FLTD);
+		if (a != a || b != b) {
+			feraiseexcept(FE_INVALID);
+			regs[inst->rd] = 0;
+		} else {
+			regs[inst->rd] = lt ? (a < b) : (a <= b);
+		}
+		return true;
+	}
+
+	case FRV_OP_FCLASSS:
+		regs[inst->rd] = frvFpuClass(frvFpuBitsS(x), 8, 23);
+		return true;
+
+	case FRV_OP_FCLASSD:
+		regs[inst->rd] = frvFpuClass(x, 11, 52);
+		return true;
+
+	default:
+		break;
+	}
+
+	if (rm > FRV_RM_RMM) return false;
+	switch (inst->op) {
+	case FRV_OP_FCVTWS:	regs[inst->rd] = frvFpuToInt(frvFpuS(x), rm, true, true); break;
+	case FRV_OP_FCVTWUS:	regs[inst->rd] = frvFpuToInt(frvFpuS(x), rm, false, true); break;
+	case FRV_OP_FCVTLS:	regs[inst->rd] = frvFpuToInt(frvFpuS(x), rm, true, false); break;
+	case FRV_OP_FCVTLUS:	regs[inst->rd] = frvFpuToInt(frvFpuS(x), rm, false, false); break;
+	case FRV_OP_FCVTWD:	regs[inst->rd] = frvFpuToInt(frvFpuD(x), rm, true, true); break;
+	case FRV_OP_FCVTWUD:	regs[inst->rd] = frvFpuToInt(frvFpuD(x), rm, false, true); break;
+	case FRV_OP_FCVTLD:	regs[inst->rd] = frvFpuToInt(frvFpuD(x), rm, true, false); break;
+	case FRV_OP_FCVTLUD:	regs[inst->rd] = frvFpuToInt(frvFpuD(x), rm, false, false); break;
+	case FRV_OP_FCVTSW:	fregs[inst->rd] = frvFpuConvert((int32_t)regs[inst->rs1], false, rm); break;
+	case FRV_OP_FCVTSWU:	fregs[inst->rd] = frvFpuConvert((uint32_t)regs[inst->rs1], false, rm); break;
+	case FRV_OP_FCVTSL:	fregs[inst->rd] = frvFpuConvert((int64_t)regs[inst->rs1], false, rm); break;
+	case FRV_OP_FCVTSLU:	fregs[inst->rd] = frvFpuConvert(regs[inst->rs1], false, rm); break;
+	case FRV_OP_FCVTDW:	fregs[inst->rd] = frvFpuConvert((int32_t)regs[inst->rs1], true, rm); break;
+	case FRV_OP_FCVTDWU:	fregs[inst->rd] = frvFpuConvert((uint32_t)regs[inst->rs1], true, rm); break;
+	case FRV_OP_FCVTDL:	fregs[inst->rd] = frvFpuConvert((int64_t)regs[inst->rs1], true, rm); break;
+	case FRV_OP_FCVTDLU:	fregs[inst->rd] = frvFpuConvert(regs[inst->rs1], true, rm); break;
+	case FRV_OP_FCVTSD:	fregs[inst->rd] = frvFpuConvert(frvFpuD(x), false, rm); break;
+	case FRV_OP_FCVTDS:	fregs[inst->rd] = frvFpuRegD(frvFpuS(x)); break; // Exact
+	default:		fregs[inst->rd] = frvFpuArith(inst->op, rm, x, y, z); break;
+	}
+	return true;
+}
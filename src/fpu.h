@@ -0,0 +1,101 @@
+#pragma once
+
+#include <math.h>
+#include <fenv.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "inst.h"
+
+// fcsr: the accrued exception flags and the rounding mode above them
+#define FRV_FFLAGS_NX		(1u << 0) // Inexact
+#define FRV_FFLAGS_UF		(1u << 1) // Underflow
+#define FRV_FFLAGS_OF		(1u << 2) // Overflow
+#define FRV_FFLAGS_DZ		(1u << 3) // Divide by zero
+#define FRV_FFLAGS_NV		(1u << 4) // Invalid operation
+#define FRV_FFLAGS_MASK		(0x1f)
+#define FRV_FRM_SHIFT		(5)
+#define FRV_FCSR_MASK		(0xff)
+
+// The rm field of the instructions and frm, DYN picks frm
+enum FrvRoundingMode {
+	FRV_RM_RNE = 0,	// To nearest, ties to even, the one the host runs in
+	FRV_RM_RTZ,	// Towards zero
+	FRV_RM_RDN,	// Down
+	FRV_RM_RUP,	// Up
+	FRV_RM_RMM,	// To nearest, ties away from zero
+	FRV_RM_DYN = 7
+};
+
+// Singles are NaN-boxed in the 64-bit registers, every NaN a result produces is the canonical one
+#define FRV_FPU_BOX	(0xffffffff00000000ull)
+#define FRV_FPU_NAN_S	(0x7fc00000u)
+#define FRV_FPU_NAN_D	(0x7ff8000000000000ull)
+
+// A register that does not hold a boxed single reads as the canonical NaN
+static inline uint32_t frvFpuBitsS(const uint64_t reg)
+{
+	return ((reg & FRV_FPU_BOX) == FRV_FPU_BOX) ? (uint32_t)reg : FRV_FPU_NAN_S;
+}
+
+static inline float frvFpuS(const uint64_t reg)
+{
+	const uint32_t bits = frvFpuBitsS(reg);
+	float f;
+	memcpy(&f, &bits, sizeof(f));
+	return f;
+}
+
+static inline double frvFpuD(const uint64_t reg)
+{
+	double d;
+	memcpy(&d, &reg, sizeof(d));
+	return d;
+}
+
+static inline uint64_t frvFpuRegS(const float f)
+{
+	uint32_t bits = FRV_FPU_NAN_S;
+	if (f == f) memcpy(&bits, &f, sizeof(bits));
+	return FRV_FPU_BOX | bits;
+}
+
+static inline uint64_t frvFpuRegD(const double d)
+{
+	uint64_t bits = FRV_FPU_NAN_D;
+	if (d == d) memcpy(&bits, &d, sizeof(bits));
+	return bits;
+}
+
+/* The host fma leaves it open whether 0 * inf + qNaN is invalid, RISC-V says it is
+ * Only a NaN result needs the look
+ */
+static inline void frvFpuFmaInvalid(const double a, const double b, const double r)
+{
+	if (r != r && ((isinf(a) && b == 0) || (a == 0 && isinf(b)))) feraiseexcept(FE_INVALID);
+}
+
+static inline uint64_t frvFpuFmaS(const float a, const float b, const float c)
+{
+	const float r = fmaf(a, b, c);
+	frvFpuFmaInvalid(a, b, r);
+	return frvFpuRegS(r);
+}
+
+static inline uint64_t frvFpuFmaD(const double a, const double b, const double c)
+{
+	const double r = fma(a, b, c);
+	frvFpuFmaInvalid(a, b, r);
+	return frvFpuRegD(r);
+}
+
+/* The exception flags accrue in the host FPU of the thread the hart runs on,
+ * fcsr only takes them in when it is read
+ */
+uint32_t frvFpuFlags(void); // Raised since the last clear, as fflags
+void frvFpuClearFlags(void);
+/* Everything off the fast path of exec.inc, that is every rounding mode but RNE and the
+ * conversions, compares, min/max and fclass. rm is resolved already, false if it is reserved
+ */
+bool frvFpuExec(const struct FrvInst* inst, const uint32_t rm, uint64_t* fregs, uint64_t* regs);
@@ -3,3 +3,7 @@
 #include "cpu.h"
 #include "ram.h"
 #include "bus.h"
+#include "clint.h"
+#include "env.h"
+#include "batch.h"
+#include "stats.h"
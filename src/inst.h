@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stdint.h>
+
+// Dense handler ids for the decoded instructions
+enum FrvOp {
+	FRV_OP_ILLEGAL = 0,
+	FRV_OP_ADD, FRV_OP_SUB, FRV_OP_ADDI, FRV_OP_ADDIW, FRV_OP_ADDW, FRV_OP_SUBW, // Arithmetic
+	FRV_OP_ANDI, FRV_OP_ORI, FRV_OP_XORI, FRV_OP_SLLI, FRV_OP_SRLI, FRV_OP_SRAI, // Logic
+	FRV_OP_AND, FRV_OP_OR, FRV_OP_XOR, FRV_OP_SLL, FRV_OP_SRL, FRV_OP_SRA,
+	FRV_OP_SLLIW, FRV_OP_SRLIW, FRV_OP_SRAIW, FRV_OP_SLLW, FRV_OP_SRLW, FRV_OP_SRAW,
+	FRV_OP_SLTI, FRV_OP_SLTIU, FRV_OP_SLT, FRV_OP_SLTU, // Compares
+	FRV_OP_LB, FRV_OP_LH, FRV_OP_LW, FRV_OP_LBU, FRV_OP_LHU, FRV_OP_LWU, FRV_OP_LD, // Loads
+	FRV_OP_SB, FRV_OP_SH, FRV_OP_SW, FRV_OP_SD, // Stores
+	FRV_OP_LUI, FRV_OP_AUIPC, // Upper immidiate
+	FRV_OP_JAL, FRV_OP_JALR, // Jumps
+	FRV_OP_BEQ, FRV_OP_BNE, FRV_OP_BLT, FRV_OP_BLTU, FRV_OP_BGE, FRV_OP_BGEU, // Branch
+	FRV_OP_FENCE, FRV_OP_FENCEI, // Fence
+	FRV_OP_ECALL, FRV_OP_EBREAK, // Env
+	FRV_OP_SRET, FRV_OP_MRET, FRV_OP_WFI, FRV_OP_SFENCEVMA, // Privileged
+	FRV_OP_CSRRW, FRV_OP_CSRRS, FRV_OP_CSRRC, FRV_OP_CSRRWI, FRV_OP_CSRRSI, FRV_OP_CSRRCI, // Csrs
+	FRV_OP_MUL, FRV_OP_MULH, FRV_OP_MULHU, FRV_OP_MULHSU, FRV_OP_MULW, // M-extension
+	FRV_OP_DIV, FRV_OP_DIVU, FRV_OP_DIVW, FRV_OP_DIVUW,
+	FRV_OP_REM, FRV_OP_REMU, FRV_OP_REMW, FRV_OP_REMUW,
+	FRV_OP_LRW, FRV_OP_SCW, FRV_OP_AMOSWAPW, FRV_OP_AMOADDW, FRV_OP_AMOXORW, FRV_OP_AMOANDW, // A-extension
+	FRV_OP_AMOORW, FRV_OP_AMOMINW, FRV_OP_AMOMAXW, FRV_OP_AMOMINUW, FRV_OP_AMOMAXUW,
+	FRV_OP_LRD, FRV_OP_SCD, FRV_OP_AMOSWAPD, FRV_OP_AMOADDD, FRV_OP_AMOXORD, FRV_OP_AMOANDD,
+	FRV_OP_AMOORD, FRV_OP_AMOMIND, FRV_OP_AMOMAXD, FRV_OP_AMOMINUD, FRV_OP_AMOMAXUD,
+	FRV_OP_FLW, FRV_OP_FSW, FRV_OP_FMADDS, FRV_OP_FMSUBS, FRV_OP_FNMSUBS, FRV_OP_FNMADDS, // F-extension
+	FRV_OP_FADDS, FRV_OP_FSUBS, FRV_OP_FMULS, FRV_OP_FDIVS, FRV_OP_FSQRTS,
+	FRV_OP_FSGNJS, FRV_OP_FSGNJNS, FRV_OP_FSGNJXS, FRV_OP_FMINS, FRV_OP_FMAXS,
+	FRV_OP_FCVTWS, FRV_OP_FCVTWUS, FRV_OP_FCVTLS, FRV_OP_FCVTLUS,
+	FRV_OP_FCVTSW, FRV_OP_FCVTSWU, FRV_OP_FCVTSL, FRV_OP_FCVTSLU,
+	FRV_OP_FMVXW, FRV_OP_FMVWX, FRV_OP_FEQS, FRV_OP_FLTS, FRV_OP_FLES, FRV_OP_FCLASSS,
+	FRV_OP_FLD, FRV_OP_FSD, FRV_OP_FMADDD, FRV_OP_FMSUBD, FRV_OP_FNMSUBD, FRV_OP_FNMADDD, // D-extension
+	FRV_OP_FADDD, FRV_OP_FSUBD, FRV_OP_FMULD, FRV_OP_FDIVD, FRV_OP_FSQRTD,
+	FRV_OP_FSGNJD, FRV_OP_FSGNJND, FRV_OP_FSGNJXD, FRV_OP_FMIND, FRV_OP_FMAXD,
+	FRV_OP_FCVTWD, FRV_OP_FCVTWUD, FRV_OP_FCVTLD, FRV_OP_FCVTLUD,
+	FRV_OP_FCVTDW, FRV_OP_FCVTDWU, FRV_OP_FCVTDL, FRV_OP_FCVTDLU, FRV_OP_FCVTSD, FRV_OP_FCVTDS,
+	FRV_OP_FMVXD, FRV_OP_FMVDX, FRV_OP_FEQD, FRV_OP_FLTD, FRV_OP_FLED, FRV_OP_FCLASSD,
+	FRV_OP_VSETVLI, FRV_OP_VSETIVLI, FRV_OP_VSETVL, FRV_OP_VLE, FRV_OP_VLSE, FRV_OP_VSE, FRV_OP_VSSE, // V-extension
+	FRV_OP_VADD, FRV_OP_VSUB, FRV_OP_VRSUB, FRV_OP_VMINU, FRV_OP_VMIN, FRV_OP_VMAXU, FRV_OP_VMAX,
+	FRV_OP_VAND, FRV_OP_VOR, FRV_OP_VXOR, FRV_OP_VSLL, FRV_OP_VSRL, FRV_OP_VSRA, FRV_OP_VMERGE,
+	FRV_OP_VMUL, FRV_OP_VMACC, FRV_OP_VMVXS, FRV_OP_VMVSX,
+	FRV_OP_VREDSUM, FRV_OP_VREDAND, FRV_OP_VREDOR, FRV_OP_VREDXOR,
+	FRV_OP_VREDMINU, FRV_OP_VREDMIN, FRV_OP_VREDMAXU, FRV_OP_VREDMAX,
+	FRV_OP_SH1ADD, FRV_OP_SH2ADD, FRV_OP_SH3ADD, FRV_OP_ADDUW, FRV_OP_SH1ADDUW, FRV_OP_SH2ADDUW, FRV_OP_SH3ADDUW, // Zba
+	FRV_OP_SLLIUW,
+	FRV_OP_ANDN, FRV_OP_ORN, FRV_OP_XNOR, FRV_OP_CLZ, FRV_OP_CTZ, FRV_OP_CPOP, FRV_OP_CLZW, FRV_OP_CTZW, // Zbb
+	FRV_OP_CPOPW, FRV_OP_MAX, FRV_OP_MAXU, FRV_OP_MIN, FRV_OP_MINU, FRV_OP_SEXTB, FRV_OP_SEXTH, FRV_OP_ZEXTH,
+	FRV_OP_ROL, FRV_OP_ROR, FRV_OP_ROLW, FRV_OP_RORW, FRV_OP_RORI, FRV_OP_RORIW, FRV_OP_ORCB, FRV_OP_REV8,
+	FRV_OP_BCLR, FRV_OP_BCLRI, FRV_OP_BEXT, FRV_OP_BEXTI, FRV_OP_BINV, FRV_OP_BINVI, FRV_OP_BSET, FRV_OP_BSETI, // Zbs
+	FRV_OP_COUNT
+};
+
+/* A pre-decoded instruction, compressed ones are expanded and only differ in len
+ * imm is already sign-extended (shamt for shifts, csr number for csr ops), every one fits 32 bits
+ */
+struct FrvInst {
+#ifdef FRV_THREADED
+	const void*	handler;	// Label of the handler in the threaded core
+#endif
+	int32_t		imm;
+	uint32_t	raw; // The 32-bit form
+	uint8_t		op;
+	uint8_t		rd;
+	uint8_t		rs1;
+	uint8_t		rs2;
+	uint8_t		len; // Bytes, 2 or 4 (0 for the end marker of the threaded core)
+};
@@ -0,0 +1,582 @@
+#define _DEFAULT_SOURCE // MAP_ANONYMOUS
+
+#include <stddef.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "jit.h"
+#include "cpu.h"
+
+#if !defined(__x86_64__)
+#error "FrvJit only emits x86-64 code"
+#endif
+
+// Host registers
+enum FrvJitReg {
+	FRV_JIT_RAX = 0, FRV_JIT_RCX, FRV_JIT_RDX, FRV_JIT_RBX,
+	FRV_JIT_RSP, FRV_JIT_RBP, FRV_JIT_RSI, FRV_JIT_RDI,
+	FRV_JIT_R8, FRV_JIT_R9, FRV_JIT_R10, FRV_JIT_R11,
+	FRV_JIT_R12, FRV_JIT_R13, FRV_JIT_R14, FRV_JIT_R15
+};
+
+// Host condition codes
+enum FrvJitCond {
+	FRV_JIT_CC_B = 0x2, FRV_JIT_CC_AE = 0x3, FRV_JIT_CC_E = 0x4, FRV_JIT_CC_NE = 0x5,
+	FRV_JIT_CC_A = 0x7, FRV_JIT_CC_L = 0xc, FRV_JIT_CC_GE = 0xd
+};
+
+/* rbx holds the cpu for the whole block, the callee-saved registers below
+ * hold the most used guest registers so they survive the helper calls
+ */
+static const uint8_t frvJitPinnable[] = {
+	FRV_JIT_RBP, FRV_JIT_R12, FRV_JIT_R13, FRV_JIT_R14, FRV_JIT_R15
+};
+#define FRV_JIT_NUM_PINNABLE (sizeof(frvJitPinnable) / sizeof(frvJitPinnable[0]))
+#define FRV_JIT_MAX_EXITS (FRV_BLOCK_MAX_INSTS * 2 + 2)
+#define FRV_JIT_REG_OFF(g) ((int32_t)(offsetof(struct FrvCPU, regs) + sizeof(uint64_t) * (g)))
+#define FRV_JIT_PC_OFF ((int32_t)offsetof(struct FrvCPU, pc))
+#define FRV_JIT_DTLB_OFF ((int32_t)offsetof(struct FrvCPU, mmu.dtlb))
+_Static_assert(sizeof(struct FrvMmuEntry) == 32, "frvJitMem indexes the DTLB with a shift by 5");
+
+struct FrvJitCtx {
+	uint8_t*	p;
+	int8_t		pinned[FRV_NUM_REGS];		// Host register of each guest register, -1 if in memory
+	uint8_t*	exits[FRV_JIT_MAX_EXITS];	// rel32 of the jumps to the exit stub
+	size_t		nexits;
+};
+
+struct FrvJit frvNewJit(void)
+{
+	struct FrvJit jit = { 0 };
+	void* code = mmap(NULL, FRV_JIT_SIZE, PROT_READ | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (code == MAP_FAILED) {
+		fprintf(stderr, "Failed to map the FrvJit code buffer: %s\n", strerror(errno));
+		return jit;
+	}
+	jit.code = code;
+	jit.gen = UINT64_MAX;
+	return jit;
+}
+
+bool frvIsJitValid(const struct FrvJit* const jit)
+{
+	return (jit->code != NULL);
+}
+
+void frvJitDestroy(struct FrvJit* jit)
+{
+	if (jit->code) munmap(jit->code, FRV_JIT_SIZE);
+	jit->code = NULL;
+}
+
+/* The buffer is never writable and executable at once (W^X): the pages of [from, to)
+ * are made writable while a block is emitted there and executable again after
+ */
+static bool frvJitProtect(struct FrvJit* jit, const uint64_t from, const uint64_t to, const bool write)
+{
+	const uint64_t page = sysconf(_SC_PAGESIZE);
+	const uint64_t start = from & ~(page - 1), end = (to + page - 1) & ~(page - 1);
+	if (!mprotect(jit->code + start, end - start, write ? PROT_READ | PROT_WRITE : PROT_READ | PROT_EXEC))
+		return true;
+	fprintf(stderr, "Failed to protect the FrvJit code buffer: %s\n", strerror(errno));
+	return false;
+}
+
+// Emitters
+static inline void frvJitByte(struct FrvJitCtx* ctx, const uint8_t b)
+{
+	*ctx->p++ = b;
+}
+
+static inline void frvJitU32(struct FrvJitCtx* ctx, const uint32_t v)
+{
+	memcpy(ctx->p, &v, sizeof(v));
+	ctx->p += sizeof(v);
+}
+
+static inline void frvJitU64(struct FrvJitCtx* ctx, const uint64_t v)
+{
+	memcpy(ctx->p, &v, sizeof(v));
+	ctx->p += sizeof(v);
+}
+
+// One to three byte opcodes, written most significant byte first
+static void frvJitOpcode(struct FrvJitCtx* ctx, const uint32_t op)
+{
+	if (op > 0xffff) frvJitByte(ctx, op >> 16);
+	if (op > 0xff) frvJitByte(ctx, op >> 8);
+	frvJitByte(ctx, op);
+}
+
+// op reg, rm with both operands in registers
+static void frvJitRR(struct FrvJitCtx* ctx, const uint32_t op, const bool w, const int reg, const int rm)
+{
+	const uint8_t rex = 0x40 | (w << 3) | ((reg & 8) >> 1) | ((rm & 8) >> 3);
+	if (rex != 0x40) frvJitByte(ctx, rex);
+	frvJitOpcode(ctx, op);
+	frvJitByte(ctx, 0xc0 | ((reg & 7) << 3) | (rm & 7));
+}
+
+// op reg, [base + disp32] (base must not be rsp or r12)
+static void frvJitRM(struct FrvJitCtx* ctx, const uint32_t op, const bool w, const int reg, const int base, const int32_t disp)
+{
+	const uint8_t rex = 0x40 | (w << 3) | ((reg & 8) >> 1) | ((base & 8) >> 3);
+	if (rex != 0x40) frvJitByte(ctx, rex);
+	frvJitOpcode(ctx, op);
+	frvJitByte(ctx, 0x80 | ((reg & 7) << 3) | (base & 7));
+	frvJitU32(ctx, disp);
+}
+
+// op reg, [base + index] (base must not be rbp or r13)
+static void frvJitRMX(struct FrvJitCtx* ctx, const uint32_t op, const bool w, const int reg,
+		      const int base, const int index, const bool byte, const bool word)
+{
+	if (word) frvJitByte(ctx, 0x66);
+	const uint8_t rex = 0x40 | (w << 3) | ((reg & 8) >> 1) | ((index & 8) >> 2) | ((base & 8) >> 3);
+	if (rex != 0x40 || (byte && reg >= FRV_JIT_RSP)) frvJitByte(ctx, rex);
+	frvJitOpcode(ctx, op);
+	frvJitByte(ctx, 0x04 | ((reg & 7) << 3));
+	frvJitByte(ctx, ((index & 7) << 3) | (base & 7));
+}
+
+static void frvJitMovImm(struct FrvJitCtx* ctx, const int reg, const uint64_t imm)
+{
+	if ((int64_t)imm == (int32_t)imm) {
+		frvJitRR(ctx, 0xc7, true, 0, reg);
+		frvJitU32(ctx, imm);
+	} else {
+		frvJitByte(ctx, 0x48 | ((reg & 8) >> 3));
+		frvJitByte(ctx, 0xb8 | (reg & 7));
+		frvJitU64(ctx, imm);
+	}
+}
+
+static inline void frvJitMov(struct FrvJitCtx* ctx, const int dst, const int src)
+{
+	frvJitRR(ctx, 0x89, true, src, dst);
+}
+
+static inline void frvJitPush(struct FrvJitCtx* ctx, const int reg)
+{
+	if (reg & 8) frvJitByte(ctx, 0x41);
+	frvJitByte(ctx, 0x50 | (reg & 7));
+}
+
+static inline void frvJitPop(struct FrvJitCtx* ctx, const int reg)
+{
+	if (reg & 8) frvJitByte(ctx, 0x41);
+	frvJitByte(ctx, 0x58 | (reg & 7));
+}
+
+// Forward jumps return their rel32 to be patched
+static uint8_t* frvJitJcc(struct FrvJitCtx* ctx, const int cc)
+{
+	frvJitByte(ctx, 0x0f);
+	frvJitByte(ctx, 0x80 | cc);
+	frvJitU32(ctx, 0);
+	return ctx->p - 4;
+}
+
+static uint8_t* frvJitJmp(struct FrvJitCtx* ctx)
+{
+	frvJitByte(ctx, 0xe9);
+	frvJitU32(ctx, 0);
+	return ctx->p - 4;
+}
+
+static void frvJitPatch(uint8_t* rel, const uint8_t* target)
+{
+	const int32_t off = (int32_t)(target - (rel + 4));
+	memcpy(rel, &off, sizeof(off));
+}
+
+// Leave the block with the status in eax
+static inline void frvJitExit(struct FrvJitCtx* ctx, uint8_t* rel)
+{
+	ctx->exits[ctx->nexits++] = rel;
+}
+
+// Guest registers
+static void frvJitGet(struct FrvJitCtx* ctx, const int host, const uint8_t g)
+{
+	if (g == 0) frvJitRR(ctx, 0x31, false, host, host); // xor
+	else if (ctx->pinned[g] >= 0) frvJitMov(ctx, host, ctx->pinned[g]);
+	else frvJitRM(ctx, 0x8b, true, host, FRV_JIT_RBX, FRV_JIT_REG_OFF(g));
+}
+
+static void frvJitSet(struct FrvJitCtx* ctx, const uint8_t g, const int host)
+{
+	if (g == 0) return; // x0 is never written
+	if (ctx->pinned[g] >= 0) frvJitMov(ctx, ctx->pinned[g], host);
+	else frvJitRM(ctx, 0x89, true, host, FRV_JIT_RBX, FRV_JIT_REG_OFF(g));
+}
+
+// Move the pinned guest registers to (store) or from the cpu
+static void frvJitSync(struct FrvJitCtx* ctx, const bool store)
+{
+	for (uint8_t g = 1; g < FRV_NUM_REGS; g++) {
+		if (ctx->pinned[g] < 0) continue;
+		frvJitRM(ctx, store ? 0x89 : 0x8b, true, ctx->pinned[g], FRV_JIT_RBX, FRV_JIT_REG_OFF(g));
+	}
+}
+
+static void frvJitSetPc(struct FrvJitCtx* ctx, const uint64_t pc)
+{
+	frvJitMovImm(ctx, FRV_JIT_RAX, pc);
+	frvJitRM(ctx, 0x89, true, FRV_JIT_RAX, FRV_JIT_RBX, FRV_JIT_PC_OFF);
+}
+
+// Run one instruction through the interpreter, which stays the reference, next is the pc after it
+static void frvJitFallback(struct FrvJitCtx* ctx, const struct FrvInst* inst, const uint64_t next)
+{
+	frvJitSync(ctx, true);
+	frvJitSetPc(ctx, next);
+	frvJitMov(ctx, FRV_JIT_RDI, FRV_JIT_RBX);
+	frvJitMovImm(ctx, FRV_JIT_RSI, (uint64_t)(uintptr_t)inst);
+	frvJitMovImm(ctx, FRV_JIT_RAX, (uint64_t)(uintptr_t)&frvCpuJitExec);
+	frvJitByte(ctx, 0xff); // call rax
+	frvJitByte(ctx, 0xd0);
+	frvJitSync(ctx, false);
+	frvJitRR(ctx, 0x83, false, 7, FRV_JIT_RAX); // cmp eax, FRV_JIT_CONTINUE
+	frvJitByte(ctx, FRV_JIT_CONTINUE);
+	frvJitExit(ctx, frvJitJcc(ctx, FRV_JIT_CC_NE));
+}
+
+// rd = rs1 op rs2, 0x01 add, 0x29 sub, 0x21 and, 0x09 or, 0x31 xor, 0x0faf imul
+static void frvJitAlu(struct FrvJitCtx* ctx, const struct FrvInst* inst, const uint32_t op, const bool w)
+{
+	frvJitGet(ctx, FRV_JIT_RAX, inst->rs1);
+	frvJitGet(ctx, FRV_JIT_RCX, inst->rs2);
+	if (op == 0x0faf) frvJitRR(ctx, op, w, FRV_JIT_RAX, FRV_JIT_RCX); // imul has the destination in reg
+	else frvJitRR(ctx, op, w, FRV_JIT_RCX, FRV_JIT_RAX);
+	if (!w) frvJitRR(ctx, 0x63, true, FRV_JIT_RAX, FRV_JIT_RAX); // movsxd
+	frvJitSet(ctx, inst->rd, FRV_JIT_RAX);
+}
+
+// rd = rs1 op imm, ext is the /digit of 0x81: 0 add, 1 or, 4 and, 6 xor
+static void frvJitAluImm(struct FrvJitCtx* ctx, const struct FrvInst* inst, const int ext, const bool w)
+{
+	frvJitGet(ctx, FRV_JIT_RAX, inst->rs1);
+	frvJitRR(ctx, 0x81, w, ext, FRV_JIT_RAX);
+	frvJitU32(ctx, inst->imm);
+	if (!w) frvJitRR(ctx, 0x63, true, FRV_JIT_RAX, FRV_JIT_RAX);
+	frvJitSet(ctx, inst->rd, FRV_JIT_RAX);
+}
+
+// Shifts, ext is 4 shl, 5 shr, 7 sar
+static void frvJitShift(struct FrvJitCtx* ctx, const struct FrvInst* inst, const int ext, const bool w, const bool imm)
+{
+	frvJitGet(ctx, FRV_JIT_RAX, inst->rs1);
+	if (imm) {
+		frvJitRR(ctx, 0xc1, w, ext, FRV_JIT_RAX);
+		frvJitByte(ctx, inst->imm);
+	} else {
+		frvJitGet(ctx, FRV_JIT_RCX, inst->rs2);
+		frvJitRR(ctx, 0xd3, w, ext, FRV_JIT_RAX); // The host masks cl like RISC-V does
+	}
+	if (!w) frvJitRR(ctx, 0x63, true, FRV_JIT_RAX, FRV_JIT_RAX);
+	frvJitSet(ctx, inst->rd, FRV_JIT_RAX);
+}
+
+// Set-less-than, rs2 is used unless imm
+static void frvJitSlt(struct FrvJitCtx* ctx, const struct FrvInst* inst, const int cc, const bool imm)
+{
+	frvJitGet(ctx, FRV_JIT_RAX, inst->rs1);
+	if (imm) {
+		frvJitRR(ctx, 0x81, true, 7, FRV_JIT_RAX);
+		frvJitU32(ctx, inst->imm);
+	} else {
+		frvJitGet(ctx, FRV_JIT_RCX, inst->rs2);
+		frvJitRR(ctx, 0x39, true, FRV_JIT_RCX, FRV_JIT_RAX);
+	}
+	frvJitRR(ctx, 0x0f90 | cc, false, 0, FRV_JIT_RAX); // setcc al
+	frvJitRR(ctx, 0x0fb6, false, FRV_JIT_RAX, FRV_JIT_RAX); // movzx eax, al
+	frvJitSet(ctx, inst->rd, FRV_JIT_RAX);
+}
+
+// ext is the /digit of 0xf7: 4 mul, 5 imul, the high half ends up in rdx
+static void frvJitMulh(struct FrvJitCtx* ctx, const struct FrvInst* inst, const int ext)
+{
+	frvJitGet(ctx, FRV_JIT_RAX, inst->rs1);
+	frvJitGet(ctx, FRV_JIT_RCX, inst->rs2);
+	frvJitRR(ctx, 0xf7, true, ext, FRV_JIT_RCX);
+	frvJitSet(ctx, inst->rd, FRV_JIT_RDX);
+}
+
+static void frvJitBranch(struct FrvJitCtx* ctx, const struct FrvInst* inst, const uint64_t pc, const int cc)
+{
+	frvJitGet(ctx, FRV_JIT_RAX, inst->rs1);
+	frvJitGet(ctx, FRV_JIT_RCX, inst->rs2);
+	frvJitMovImm(ctx, FRV_JIT_RSI, pc + inst->len);
+	frvJitMovImm(ctx, FRV_JIT_RDI, pc + inst->imm);
+	frvJitRR(ctx, 0x39, true, FRV_JIT_RCX, FRV_JIT_RAX);
+	frvJitRR(ctx, 0x0f40 | cc, true, FRV_JIT_RSI, FRV_JIT_RDI); // cmovcc rsi, rdi
+	frvJitRM(ctx, 0x89, true, FRV_JIT_RSI, FRV_JIT_RBX, FRV_JIT_PC_OFF);
+}
+
+/* Loads and stores that hit the DTLB are done inline, the same probe as frvMmuLoadFast
+ * anything else (misses, MMIO, faults, stores into translated code) takes the interpreter
+ */
+static void frvJitMem(struct FrvJitCtx* ctx, const struct FrvCPU* cpu, const struct FrvInst* inst, const uint64_t next)
+{
+	uint64_t size;
+	uint32_t op;
+	bool w = true, store = false;
+	switch (inst->op) {
+	case FRV_OP_LB:	size = 1; op = 0x0fbe; break;
+	case FRV_OP_LBU: size = 1; op = 0x0fb6; w = false; break;
+	case FRV_OP_LH:	size = 2; op = 0x0fbf; break;
+	case FRV_OP_LHU: size = 2; op = 0x0fb7; w = false; break;
+	case FRV_OP_LW:	size = 4; op = 0x63; break;
+	case FRV_OP_LWU: size = 4; op = 0x8b; w = false; break;
+	case FRV_OP_LD:	size = 8; op = 0x8b; break;
+	case FRV_OP_SB:	size = 1; op = 0x88; w = false; store = true; break;
+	case FRV_OP_SH:	size = 2; op = 0x89; w = false; store = true; break;
+	case FRV_OP_SW:	size = 4; op = 0x89; w = false; store = true; break;
+	default:	size = 8; op = 0x89; store = true; break;
+	}
+
+	// rax = guest address, rdx = page number, rcx = &cpu->mmu.dtlb[index] - FRV_JIT_DTLB_OFF
+	frvJitGet(ctx, FRV_JIT_RAX, inst->rs1);
+	frvJitRR(ctx, 0x81, true, 0, FRV_JIT_RAX);
+	frvJitU32(ctx, inst->imm);
+	frvJitMov(ctx, FRV_JIT_RDX, FRV_JIT_RAX);
+	frvJitRR(ctx, 0xc1, true, 5, FRV_JIT_RDX);
+	frvJitByte(ctx, FRV_BUS_PAGE_SHIFT);
+	frvJitRR(ctx, 0x89, false, FRV_JIT_RDX, FRV_JIT_RCX);
+	frvJitRR(ctx, 0x81, false, 4, FRV_JIT_RCX);
+	frvJitU32(ctx, FRV_MMU_DTLB_SIZE - 1);
+	frvJitRR(ctx, 0xc1, false, 4, FRV_JIT_RCX);
+	frvJitByte(ctx, 5); // sizeof(struct FrvMmuEntry)
+	frvJitRR(ctx, 0x01, true, FRV_JIT_RBX, FRV_JIT_RCX);
+	frvJitRM(ctx, 0x3b, true, FRV_JIT_RDX, FRV_JIT_RCX,
+		 FRV_JIT_DTLB_OFF + (store ? offsetof(struct FrvMmuEntry, wtag) : offsetof(struct FrvMmuEntry, rtag)));
+	uint8_t* slow[3] = { frvJitJcc(ctx, FRV_JIT_CC_NE), NULL, NULL };
+
+	// rdx = offset in the page, the access must not cross it
+	frvJitRR(ctx, 0x89, false, FRV_JIT_RAX, FRV_JIT_RDX);
+	frvJitRR(ctx, 0x81, false, 4, FRV_JIT_RDX);
+	frvJitU32(ctx, FRV_BUS_PAGE_MASK);
+	frvJitRR(ctx, 0x81, false, 7, FRV_JIT_RDX);
+	frvJitU32(ctx, FRV_BUS_PAGE_SIZE - size);
+	slow[1] = frvJitJcc(ctx, FRV_JIT_CC_A);
+
+	if (store) {
+		// Only aligned stores, they touch one code bitmap byte
+		if (size > 1) {
+			frvJitRR(ctx, 0xf7, false, 0, FRV_JIT_RAX);
+			frvJitU32(ctx, size - 1);
+			slow[2] = frvJitJcc(ctx, FRV_JIT_CC_NE);
+		}
+		// rsi = host page, rcx = offset into the RAM (the only writable region)
+		frvJitRM(ctx, 0x8b, true, FRV_JIT_RSI, FRV_JIT_RCX, FRV_JIT_DTLB_OFF + offsetof(struct FrvMmuEntry, host));
+		frvJitRM(ctx, 0x8b, true, FRV_JIT_RCX, FRV_JIT_RCX, FRV_JIT_DTLB_OFF + offsetof(struct FrvMmuEntry, phys));
+		frvJitRR(ctx, 0x01, true, FRV_JIT_RDX, FRV_JIT_RCX);
+		frvJitMovImm(ctx, FRV_JIT_R8, -(uint64_t)FRV_RAM_BASE_ADDR);
+		frvJitRR(ctx, 0x01, true, FRV_JIT_R8, FRV_JIT_RCX);
+
+		frvJitMov(ctx, FRV_JIT_R8, FRV_JIT_RCX);
+		frvJitRR(ctx, 0xc1, true, 5, FRV_JIT_R8);
+		frvJitByte(ctx, 5);
+		frvJitMovImm(ctx, FRV_JIT_RDI, (uint64_t)(uintptr_t)cpu->tcache.code);
+		frvJitRMX(ctx, 0x0fb6, false, FRV_JIT_R8, FRV_JIT_RDI, FRV_JIT_R8, false, false);
+		frvJitRR(ctx, 0xc1, false, 5, FRV_JIT_RCX);
+		frvJitByte(ctx, 2);
+		frvJitRR(ctx, 0x83, false, 4, FRV_JIT_RCX);
+		frvJitByte(ctx, 7);
+		frvJitRR(ctx, 0xd3, false, 5, FRV_JIT_R8);
+		frvJitRR(ctx, 0xf7, false, 0, FRV_JIT_R8);
+		frvJitU32(ctx, (size == 8) ? 3 : 1);
+		uint8_t* code = frvJitJcc(ctx, FRV_JIT_CC_NE);
+
+		frvJitGet(ctx, FRV_JIT_RDI, inst->rs2);
+		frvJitRMX(ctx, op, w, FRV_JIT_RDI, FRV_JIT_RSI, FRV_JIT_RDX, size == 1, size == 2);
+		uint8_t* done = frvJitJmp(ctx);
+
+		frvJitPatch(code, ctx->p);
+		for (int k = 0; k < 3; k++) if (slow[k]) frvJitPatch(slow[k], ctx->p);
+		frvJitFallback(ctx, inst, next);
+		frvJitPatch(done, ctx->p);
+		return;
+	}
+
+	frvJitRM(ctx, 0x8b, true, FRV_JIT_RCX, FRV_JIT_RCX, FRV_JIT_DTLB_OFF + offsetof(struct FrvMmuEntry, host));
+	frvJitRMX(ctx, op, w, FRV_JIT_RAX, FRV_JIT_RCX, FRV_JIT_RDX, false, false);
+	frvJitSet(ctx, inst->rd, FRV_JIT_RAX);
+	uint8_t* done = frvJitJmp(ctx);
+
+	for (int k = 0; k < 2; k++) frvJitPatch(slow[k], ctx->p);
+	frvJitFallback(ctx, inst, next);
+	frvJitPatch(done, ctx->p);
+}
+
+// Pin the most used guest registers of the block
+static void frvJitPin(struct FrvJitCtx* ctx, const struct FrvBlock* block)
+{
+	uint32_t uses[FRV_NUM_REGS] = { 0 };
+	for (uint32_t i = 0; i < block->len; i++) {
+		uses[block->insts[i].rd]++;
+		uses[block->insts[i].rs1]++;
+		uses[block->insts[i].rs2]++;
+	}
+	uses[0] = 0;
+
+	memset(ctx->pinned, -1, sizeof(ctx->pinned));
+	for (size_t k = 0; k < FRV_JIT_NUM_PINNABLE; k++) {
+		uint8_t best = 0;
+		for (uint8_t g = 1; g < FRV_NUM_REGS; g++)
+			if (uses[g] > uses[best]) best = g;
+		if (uses[best] < 2) break;
+		ctx->pinned[best] = frvJitPinnable[k];
+		uses[best] = 0;
+	}
+}
+
+bool frvJitCompile(struct FrvJit* jit, struct FrvCPU* cpu, struct FrvBlock* block)
+{
+	if (jit->gen != cpu->tcache.gen) {
+		jit->gen = cpu->tcache.gen;
+		jit->used = 0;
+	}
+	uint64_t limit = jit->used + block->len * FRV_JIT_MAX_INST_CODE + FRV_JIT_MAX_TAIL_CODE;
+	if (limit > FRV_JIT_SIZE) {
+		cpu->tcache.stale = true; // Start over with both caches
+		return false;
+	}
+	// Room for the check below to pass on the last instruction, the prologue is within the tail budget
+	limit = (limit + FRV_JIT_MAX_TAIL_CODE < FRV_JIT_SIZE) ? limit + FRV_JIT_MAX_TAIL_CODE : FRV_JIT_SIZE;
+	if (!frvJitProtect(jit, jit->used, limit, true)) return false;
+	const uint8_t* end = jit->code + limit;
+
+	struct FrvJitCtx ctx = { .p = jit->code + jit->used, .nexits = 0 };
+	uint8_t* entry = ctx.p;
+	frvJitPin(&ctx, block);
+
+	// Prologue, the stack stays 16 byte aligned for the helper calls
+	frvJitPush(&ctx, FRV_JIT_RBX);
+	for (size_t k = 0; k < FRV_JIT_NUM_PINNABLE; k++) frvJitPush(&ctx, frvJitPinnable[k]);
+	frvJitRR(&ctx, 0x83, true, 5, FRV_JIT_RSP);
+	frvJitByte(&ctx, 8);
+	frvJitMov(&ctx, FRV_JIT_RBX, FRV_JIT_RDI);
+	frvJitSync(&ctx, false);
+
+	bool pcset = false;
+	uint64_t next = block->pc;
+	for (uint32_t i = 0; i < block->len; i++) {
+		const struct FrvInst* inst = &block->insts[i];
+		const uint64_t pc = next;
+		next += inst->len;
+		pcset = false;
+		// The budget above holds if no instruction goes over its bound, never write past the writable part anyway
+		if (end - ctx.p < FRV_JIT_MAX_INST_CODE + FRV_JIT_MAX_TAIL_CODE) {
+			frvJitProtect(jit, jit->used, limit, false);
+			cpu->tcache.stale = true;
+			return false;
+		}
+		switch (inst->op) {
+		case FRV_OP_ADD:	frvJitAlu(&ctx, inst, 0x01, true); break;
+		case FRV_OP_SUB:	frvJitAlu(&ctx, inst, 0x29, true); break;
+		case FRV_OP_AND:	frvJitAlu(&ctx, inst, 0x21, true); break;
+		case FRV_OP_OR:		frvJitAlu(&ctx, inst, 0x09, true); break;
+		case FRV_OP_XOR:	frvJitAlu(&ctx, inst, 0x31, true); break;
+		case FRV_OP_ADDW:	frvJitAlu(&ctx, inst, 0x01, false); break;
+		case FRV_OP_SUBW:	frvJitAlu(&ctx, inst, 0x29, false); break;
+		case FRV_OP_MUL:	frvJitAlu(&ctx, inst, 0x0faf, true); break;
+		case FRV_OP_MULW:	frvJitAlu(&ctx, inst, 0x0faf, false); break;
+		case FRV_OP_ADDI:	frvJitAluImm(&ctx, inst, 0, true); break;
+		case FRV_OP_ORI:	frvJitAluImm(&ctx, inst, 1, true); break;
+		case FRV_OP_ANDI:	frvJitAluImm(&ctx, inst, 4, true); break;
+		case FRV_OP_XORI:	frvJitAluImm(&ctx, inst, 6, true); break;
+		case FRV_OP_ADDIW:	frvJitAluImm(&ctx, inst, 0, false); break;
+		case FRV_OP_SLL:	frvJitShift(&ctx, inst, 4, true, false); break;
+		case FRV_OP_SRL:	frvJitShift(&ctx, inst, 5, true, false); break;
+		case FRV_OP_SRA:	frvJitShift(&ctx, inst, 7, true, false); break;
+		case FRV_OP_SLLW:	frvJitShift(&ctx, inst, 4, false, false); break;
+		case FRV_OP_SRLW:	frvJitShift(&ctx, inst, 5, false, false); break;
+		case FRV_OP_SRAW:	frvJitShift(&ctx, inst, 7, false, false); break;
+		case FRV_OP_SLLI:	frvJitShift(&ctx, inst, 4, true, true); break;
+		case FRV_OP_SRLI:	frvJitShift(&ctx, inst, 5, true, true); break;
+		case FRV_OP_SRAI:	frvJitShift(&ctx, inst, 7, true, true); break;
+		case FRV_OP_SLLIW:	frvJitShift(&ctx, inst, 4, false, true); break;
+		case FRV_OP_SRLIW:	frvJitShift(&ctx, inst, 5, false, true); break;
+		case FRV_OP_SRAIW:	frvJitShift(&ctx, inst, 7, false, true); break;
+		case FRV_OP_SLT:	frvJitSlt(&ctx, inst, FRV_JIT_CC_L, false); break;
+		case FRV_OP_SLTU:	frvJitSlt(&ctx, inst, FRV_JIT_CC_B, false); break;
+		case FRV_OP_SLTI:	frvJitSlt(&ctx, inst, FRV_JIT_CC_L, true); break;
+		case FRV_OP_SLTIU:	frvJitSlt(&ctx, inst, FRV_JIT_CC_B, true); break;
+		case FRV_OP_MULH:	frvJitMulh(&ctx, inst, 5); break;
+		case FRV_OP_MULHU:	frvJitMulh(&ctx, inst, 4); break;
+
+		case FRV_OP_LUI:
+		case FRV_OP_AUIPC:
+			frvJitMovImm(&ctx, FRV_JIT_RAX, (inst->op == FRV_OP_LUI) ? inst->imm : pc + inst->imm);
+			frvJitSet(&ctx, inst->rd, FRV_JIT_RAX);
+			break;
+
+		case FRV_OP_LB: case FRV_OP_LH: case FRV_OP_LW: case FRV_OP_LD:
+		case FRV_OP_LBU: case FRV_OP_LHU: case FRV_OP_LWU:
+		case FRV_OP_SB: case FRV_OP_SH: case FRV_OP_SW: case FRV_OP_SD:
+			frvJitMem(&ctx, cpu, inst, next);
+			break;
+
+		case FRV_OP_JAL:
+			frvJitSetPc(&ctx, pc + inst->imm);
+			frvJitMovImm(&ctx, FRV_JIT_RAX, next);
+			frvJitSet(&ctx, inst->rd, FRV_JIT_RAX);
+			pcset = true;
+			break;
+
+		case FRV_OP_JALR:
+			frvJitGet(&ctx, FRV_JIT_RAX, inst->rs1);
+			frvJitRR(&ctx, 0x81, true, 0, FRV_JIT_RAX);
+			frvJitU32(&ctx, inst->imm);
+			frvJitRR(&ctx, 0x83, true, 4, FRV_JIT_RAX); // and rax, ~1
+			frvJitByte(&ctx, 0xfe);
+			frvJitRM(&ctx, 0x89, true, FRV_JIT_RAX, FRV_JIT_RBX, FRV_JIT_PC_OFF);
+			frvJitMovImm(&ctx, FRV_JIT_RAX, next);
+			frvJitSet(&ctx, inst->rd, FRV_JIT_RAX);
+			pcset = true;
+			break;
+
+		case FRV_OP_FENCE: // x86 only reorders a store with a later load, FENCE.TSO leaves that too
+			if ((inst->imm & 0x50) && (inst->imm & 0x0a) && ((inst->imm >> 8) & 0xf) != 0x8) {
+				frvJitByte(&ctx, 0x0f); // mfence
+				frvJitByte(&ctx, 0xae);
+				frvJitByte(&ctx, 0xf0);
+			}
+			break;
+
+		case FRV_OP_BEQ:	frvJitBranch(&ctx, inst, pc, FRV_JIT_CC_E); pcset = true; break;
+		case FRV_OP_BNE:	frvJitBranch(&ctx, inst, pc, FRV_JIT_CC_NE); pcset = true; break;
+		case FRV_OP_BLT:	frvJitBranch(&ctx, inst, pc, FRV_JIT_CC_L); pcset = true; break;
+		case FRV_OP_BGE:	frvJitBranch(&ctx, inst, pc, FRV_JIT_CC_GE); pcset = true; break;
+		case FRV_OP_BLTU:	frvJitBranch(&ctx, inst, pc, FRV_JIT_CC_B); pcset = true; break;
+		case FRV_OP_BGEU:	frvJitBranch(&ctx, inst, pc, FRV_JIT_CC_AE); pcset = true; break;
+
+		default:
+			frvJitFallback(&ctx, inst, next);
+			pcset = true; // The interpreter already moved pc past it
+			break;
+		}
+	}
+	if (!pcset) frvJitSetPc(&ctx, next);
+	frvJitRR(&ctx, 0xc7, false, 0, FRV_JIT_RAX); // mov eax, FRV_JIT_LEAVE
+	frvJitU32(&ctx, FRV_JIT_LEAVE);
+
+	// Exit stub, eax holds the status
+	for (size_t k = 0; k < ctx.nexits; k++) frvJitPatch(ctx.exits[k], ctx.p);
+	frvJitSync(&ctx, true);
+	frvJitRR(&ctx, 0x83, true, 0, FRV_JIT_RSP);
+	frvJitByte(&ctx, 8);
+	for (size_t k = FRV_JIT_NUM_PINNABLE; k > 0; k--) frvJitPop(&ctx, frvJitPinnable[k - 1]);
+	frvJitPop(&ctx, FRV_JIT_RBX);
+	frvJitByte(&ctx, 0xc3);
+
+	if (!frvJitProtect(jit, jit->used, limit, false)) {
+		cpu->tcache.stale = true; // The blocks already on those pages cannot run either
+		return false;
+	}
+	jit->used = ((ctx.p - jit->code) + 15) & ~15ULL;
+	block->native = entry;
+	return true;
+}
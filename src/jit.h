@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+
+#include "tcache.h"
+
+#define FRV_JIT_SIZE (1 << 24) // Bytes of host code before the translations are dropped
+#define FRV_JIT_THRESHOLD 64 // Interpreted runs before a block gets compiled
+#define FRV_JIT_MAX_INST_CODE 384 // Worst case host bytes of one instruction, a store with its fallback takes about 290
+#define FRV_JIT_MAX_TAIL_CODE 512 // Worst case host bytes of the prologue, the block end and the exit stub
+#define FRV_JIT_MAX_BLOCK_CODE (FRV_BLOCK_MAX_INSTS * FRV_JIT_MAX_INST_CODE + FRV_JIT_MAX_TAIL_CODE)
+
+// Results of the compiled blocks and of frvCpuJitExec
+enum FrvJitStatus {
+	FRV_JIT_STOP = 0,	// Stop the cpu (same as frvCpuExecBlock returning false)
+	FRV_JIT_LEAVE = 1,	// Leave the block, continue at cpu->pc
+	FRV_JIT_CONTINUE = 2	// Only from frvCpuJitExec: go on with the next instruction
+};
+
+struct FrvCPU;
+typedef int (*FrvJitFn)(struct FrvCPU* cpu);
+
+/* x86-64 translator for hot blocks
+ * The host code belongs to one tcache generation and is dropped with it
+ * Its buffer is executable, only the pages a block is being emitted to are writable, never both
+ */
+struct FrvJit {
+	uint8_t*	code;
+	uint64_t	used;
+	uint64_t	gen;
+};
+
+struct FrvJit frvNewJit(void);
+bool frvIsJitValid(const struct FrvJit* const jit);
+void frvJitDestroy(struct FrvJit* jit);
+bool frvJitCompile(struct FrvJit* jit, struct FrvCPU* cpu, struct FrvBlock* block); // Set block->native on success
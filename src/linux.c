@@ -0,0 +1,503 @@
+#define _DEFAULT_SOURCE // st_atim, preadv, getrandom
+
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/random.h>
+
+#include "env.h"
+#include "linux.h"
+
+// riscv64 syscall numbers (asm-generic)
+#define FRV_SYS_IOCTL		(29)
+#define FRV_SYS_OPENAT		(56)
+#define FRV_SYS_CLOSE		(57)
+#define FRV_SYS_LSEEK		(62)
+#define FRV_SYS_READ		(63)
+#define FRV_SYS_WRITE		(64)
+#define FRV_SYS_READV		(65)
+#define FRV_SYS_WRITEV		(66)
+#define FRV_SYS_NEWFSTATAT	(79)
+#define FRV_SYS_FSTAT		(80)
+#define FRV_SYS_EXIT		(93)
+#define FRV_SYS_EXIT_GROUP	(94)
+#define FRV_SYS_SET_TID_ADDRESS	(96)
+#define FRV_SYS_SET_ROBUST_LIST	(99)
+#define FRV_SYS_CLOCK_GETTIME	(113)
+#define FRV_SYS_RT_SIGACTION	(134)
+#define FRV_SYS_RT_SIGPROCMASK	(135)
+#define FRV_SYS_UNAME		(160)
+#define FRV_SYS_GETPID		(172)
+#define FRV_SYS_GETTID		(178)
+#define FRV_SYS_BRK		(214)
+#define FRV_SYS_MUNMAP		(215)
+#define FRV_SYS_MMAP		(222)
+#define FRV_SYS_MPROTECT	(226)
+#define FRV_SYS_GETRANDOM	(278)
+
+// auxv keys
+#define FRV_AT_NULL	(0)
+#define FRV_AT_PHDR	(3)
+#define FRV_AT_PHENT	(4)
+#define FRV_AT_PHNUM	(5)
+#define FRV_AT_PAGESZ	(6)
+#define FRV_AT_ENTRY	(9)
+#define FRV_AT_UID	(11)
+#define FRV_AT_EUID	(12)
+#define FRV_AT_GID	(13)
+#define FRV_AT_EGID	(14)
+#define FRV_AT_HWCAP	(16)
+#define FRV_AT_CLKTCK	(17)
+#define FRV_AT_RANDOM	(25)
+
+#define FRV_LINUX_AT_FDCWD	(-100)
+#define FRV_LINUX_MAP_FIXED	(0x10)
+#define FRV_LINUX_MAP_ANONYMOUS	(0x20)
+#define FRV_LINUX_STAT_SIZE	(128)
+#define FRV_LINUX_UTS_LEN	(65)
+#define FRV_LINUX_PATH_MAX	(4096)
+
+#define FRV_LINUX_PAGE_UP(x) (((x) + FRV_BUS_PAGE_MASK) & ~FRV_BUS_PAGE_MASK)
+// The single letter extensions the kernel reports in AT_HWCAP, with the misa bits
+#define FRV_LINUX_HWCAP (FRV_MISA_EXT('I') | FRV_MISA_EXT('M') | FRV_MISA_EXT('A') | FRV_MISA_EXT('F') | \
+			 FRV_MISA_EXT('D') | FRV_MISA_EXT('Q') | FRV_MISA_EXT('C') | FRV_MISA_EXT('V'))
+
+// stdio and the fds the guest opened itself, the other host fds belong to the emulator
+static bool frvLinuxIsGuestFd(const struct FrvCPU* const cpu, const int64_t fd)
+{
+	if (fd >= 0 && fd <= STDERR_FILENO) return true;
+	return fd > STDERR_FILENO && fd < FRV_LINUX_MAX_FDS && (cpu->sys.fds[fd >> 3] & (1 << (fd & 7)));
+}
+
+/* Host spans behind the guest buffer, adjacent pages are merged into one
+ * Stops early at a page without host memory, the transfer is short then
+ */
+static int frvLinuxSpans(struct FrvCPU* cpu, uint64_t vaddr, uint64_t len, const enum FrvAccess access,
+			 struct iovec* iov, uint64_t* paddrs)
+{
+	int n = 0;
+	while (len) {
+		uint8_t* host;
+		uint64_t paddr;
+		if (!frvMmuHost(&cpu->mmu, vaddr, access, &host, &paddr) || !host) break;
+		uint64_t chunk = FRV_BUS_PAGE_SIZE - (vaddr & FRV_BUS_PAGE_MASK);
+		if (chunk > len) chunk = len;
+
+		if (n && (uint8_t*)iov[n - 1].iov_base + iov[n - 1].iov_len == host &&
+		    paddrs[n - 1] + iov[n - 1].iov_len == paddr) {
+			iov[n - 1].iov_len += chunk;
+		} else if (n < FRV_LINUX_MAX_IOV) {
+			iov[n] = (struct iovec) { .iov_base = host, .iov_len = chunk };
+			paddrs[n++] = paddr;
+		} else {
+			break;
+		}
+		vaddr += chunk;
+		len -= chunk;
+	}
+	return n;
+}
+
+// The read data lands straight in the guest memory, translated code in it has to go
+static void frvLinuxInvalidate(struct FrvCPU* cpu, const struct iovec* iov, const uint64_t* paddrs, const int n,
+			       uint64_t done)
+{
+	for (int i = 0; i < n && done; i++) {
+		const uint64_t len = (iov[i].iov_len < done) ? iov[i].iov_len : done;
+		frvTCacheInvalidateRange(&cpu->tcache, paddrs[i], len);
+		done -= len;
+	}
+}
+
+static int64_t frvLinuxRead(struct FrvCPU* cpu, const int fd, const uint64_t buf, const uint64_t len, const int64_t off)
+{
+	struct iovec iov[FRV_LINUX_MAX_IOV];
+	uint64_t paddrs[FRV_LINUX_MAX_IOV];
+	if (!frvLinuxIsGuestFd(cpu, fd)) return -EBADF;
+	const int n = frvLinuxSpans(cpu, buf, len, FRV_ACCESS_STORE, iov, paddrs);
+	if (!n) return len ? -EFAULT : 0;
+
+	if (fd == STDIN_FILENO) fflush(cpu->out);
+	const ssize_t r = (off < 0) ? readv(fd, iov, n) : preadv(fd, iov, n, off);
+	if (r < 0) return -errno;
+	frvLinuxInvalidate(cpu, iov, paddrs, n, r);
+	return r;
+}
+
+// stdout goes through the cpu's buffered stream, everything else straight to the host fd
+static int64_t frvLinuxWrite(struct FrvCPU* cpu, const int fd, const uint64_t buf, const uint64_t len)
+{
+	struct iovec iov[FRV_LINUX_MAX_IOV];
+	uint64_t paddrs[FRV_LINUX_MAX_IOV];
+	if (!frvLinuxIsGuestFd(cpu, fd)) return -EBADF;
+	const int n = frvLinuxSpans(cpu, buf, len, FRV_ACCESS_LOAD, iov, paddrs);
+	if (!n) return len ? -EFAULT : 0;
+
+	if (fd == STDOUT_FILENO) {
+		int64_t done = 0;
+		for (int i = 0; i < n; i++) done += fwrite(iov[i].iov_base, 1, iov[i].iov_len, cpu->out);
+		return done;
+	}
+	const ssize_t r = writev(fd, iov, n);
+	return (r < 0) ? -errno : r;
+}
+
+// readv/writev one guest iovec at a time, stops at the first short transfer
+static int64_t frvLinuxVector(struct FrvCPU* cpu, const int fd, const uint64_t vec, const uint64_t count, const bool write)
+{
+	int64_t total = 0;
+	for (uint64_t i = 0; i < count; i++) {
+		uint64_t base, len;
+		if (!frvMmuLoad64(&cpu->mmu, vec + 16 * i, &base) || !frvMmuLoad64(&cpu->mmu, vec + 16 * i + 8, &len))
+			return -EFAULT;
+		const int64_t r = write ? frvLinuxWrite(cpu, fd, base, len) : frvLinuxRead(cpu, fd, base, len, -1);
+		if (r < 0) return total ? total : r;
+		total += r;
+		if ((uint64_t)r < len) break;
+	}
+	return total;
+}
+
+static bool frvLinuxPath(struct FrvCPU* cpu, const uint64_t vaddr, char* path)
+{
+	for (uint64_t i = 0; i < FRV_LINUX_PATH_MAX; i++) {
+		uint64_t c;
+		if (!frvMmuLoad8(&cpu->mmu, vaddr + i, &c)) return false;
+		path[i] = c;
+		if (!c) return true;
+	}
+	return false;
+}
+
+// struct stat of the asm-generic ABI
+static int64_t frvLinuxStat(struct FrvCPU* cpu, const int dirfd, const uint64_t pathaddr, const uint64_t buf,
+			    const int flags)
+{
+	char path[FRV_LINUX_PATH_MAX];
+	struct stat st;
+	if ((!pathaddr || dirfd != FRV_LINUX_AT_FDCWD) && !frvLinuxIsGuestFd(cpu, dirfd)) return -EBADF;
+	if (pathaddr && !frvLinuxPath(cpu, pathaddr, path)) return -EFAULT;
+	if ((pathaddr ? fstatat(dirfd, path, &st, flags) : fstat(dirfd, &st)) == -1) return -errno;
+
+	uint8_t out[FRV_LINUX_STAT_SIZE] = { 0 };
+	frvRamWrite(out + 0, 8, st.st_dev);
+	frvRamWrite(out + 8, 8, st.st_ino);
+	frvRamWrite(out + 16, 4, st.st_mode);
+	frvRamWrite(out + 20, 4, st.st_nlink);
+	frvRamWrite(out + 24, 4, st.st_uid);
+	frvRamWrite(out + 28, 4, st.st_gid);
+	frvRamWrite(out + 32, 8, st.st_rdev);
+	frvRamWrite(out + 48, 8, st.st_size);
+	frvRamWrite(out + 56, 4, st.st_blksize);
+	frvRamWrite(out + 64, 8, st.st_blocks);
+	frvRamWrite(out + 72, 8, st.st_atim.tv_sec);
+	frvRamWrite(out + 80, 8, st.st_atim.tv_nsec);
+	frvRamWrite(out + 88, 8, st.st_mtim.tv_sec);
+	frvRamWrite(out + 96, 8, st.st_mtim.tv_nsec);
+	frvRamWrite(out + 104, 8, st.st_ctim.tv_sec);
+	frvRamWrite(out + 112, 8, st.st_ctim.tv_nsec);
+	return frvEnvCopyOut(cpu, buf, out, sizeof(out)) ? 0 : -EFAULT;
+}
+
+// Host memory of the guest address, the RAM holds [base, base + size) of the address space
+static uint8_t* frvLinuxRam(struct FrvCPU* cpu, const uint64_t addr)
+{
+	return cpu->bus->ram->bytes + (addr - cpu->sys.base);
+}
+
+// Hand out [addr, addr + len) zeroed, fresh pages of a mapped RAM already are
+static void frvLinuxZero(struct FrvCPU* cpu, const uint64_t addr, const uint64_t len, const bool fresh)
+{
+	if (!len || (fresh && cpu->bus->ram->mapped)) return;
+	memset(frvLinuxRam(cpu, addr), 0, len);
+	frvRamMarkDirty(cpu->bus->ram, addr - cpu->sys.base, len);
+	frvTCacheInvalidateRange(&cpu->tcache, addr + cpu->mmu.offset, len);
+}
+
+static int64_t frvLinuxBrk(struct FrvCPU* cpu, const uint64_t addr)
+{
+	struct FrvLinux* sys = &cpu->sys;
+	if (addr < sys->brkmin || addr > sys->mmaptop) return sys->brk;
+
+	if (addr > sys->brk) {
+		const uint64_t reused = (addr < sys->brkmax) ? addr : sys->brkmax;
+		if (reused > sys->brk) frvLinuxZero(cpu, sys->brk, reused - sys->brk, false);
+		if (addr > sys->brkmax) {
+			const uint64_t from = (sys->brk > sys->brkmax) ? sys->brk : sys->brkmax;
+			frvLinuxZero(cpu, from, addr - from, true);
+			sys->brkmax = addr;
+		}
+	}
+	sys->brk = addr;
+	return sys->brk;
+}
+
+// Mappings are carved downwards from below the stack, only the lowest one can be given back
+static int64_t frvLinuxMmap(struct FrvCPU* cpu, const uint64_t len, const uint64_t flags, const int fd, const int64_t off)
+{
+	struct FrvLinux* sys = &cpu->sys;
+	const uint64_t size = FRV_LINUX_PAGE_UP(len);
+	if (flags & FRV_LINUX_MAP_FIXED) return -EINVAL;
+	if (!size || size > sys->mmaptop - sys->brk) return -ENOMEM;
+	if (!(flags & FRV_LINUX_MAP_ANONYMOUS) && !frvLinuxIsGuestFd(cpu, fd)) return -EBADF;
+
+	// Below brkmax the pages may still hold what an earlier, larger brk left in them
+	const uint64_t addr = sys->mmaptop - size;
+	const uint64_t used = (sys->brkmax <= addr) ? 0 : (sys->brkmax - addr < size) ? sys->brkmax - addr : size;
+	frvLinuxZero(cpu, addr, used, false);
+	frvLinuxZero(cpu, addr + used, size - used, true);
+	if (!(flags & FRV_LINUX_MAP_ANONYMOUS)) {
+		const int64_t r = frvLinuxRead(cpu, fd, addr, len, off);
+		if (r < 0) return r;
+	}
+	sys->mmaptop = addr;
+	return addr;
+}
+
+/* A stack of mappings: unmapping the lowest, most recent one hands its range out again
+ * Any other range stays carved out, munmap only succeeds on it
+ */
+static int64_t frvLinuxMunmap(struct FrvCPU* cpu, const uint64_t addr, const uint64_t len)
+{
+	struct FrvLinux* sys = &cpu->sys;
+	const uint64_t size = FRV_LINUX_PAGE_UP(len);
+	if ((addr & FRV_BUS_PAGE_MASK) || !size) return -EINVAL;
+	if (addr != sys->mmaptop || size > sys->mmapend - addr) return 0;
+
+	if (!frvRamDiscard(cpu->bus->ram, addr - sys->base, size)) return -ENOMEM;
+	frvTCacheInvalidateRange(&cpu->tcache, addr + cpu->mmu.offset, size);
+	sys->mmaptop = addr + size;
+	return 0;
+}
+
+static int64_t frvLinuxUname(struct FrvCPU* cpu, const uint64_t buf)
+{
+	static const char* const fields[] = { "Linux", "frv", "5.15.0", "#1", "riscv64", "" };
+	uint8_t out[FRV_LINUX_UTS_LEN * 6] = { 0 };
+	for (int i = 0; i < 6; i++) strcpy((char*)out + FRV_LINUX_UTS_LEN * i, fields[i]);
+	return frvEnvCopyOut(cpu, buf, out, sizeof(out)) ? 0 : -EFAULT;
+}
+
+bool frvLinuxSyscall(struct FrvCPU* cpu)
+{
+	const uint64_t nr = cpu->regs[FRV_ABI_REG_A7];
+	const uint64_t a0 = cpu->regs[FRV_ABI_REG_A0], a1 = cpu->regs[FRV_ABI_REG_A1];
+	const uint64_t a2 = cpu->regs[FRV_ABI_REG_A2], a3 = cpu->regs[FRV_ABI_REG_A3];
+	const uint64_t a4 = cpu->regs[FRV_ABI_REG_A4], a5 = cpu->regs[FRV_ABI_REG_A5];
+	const int fd = (int)a0; // The fd arguments are C ints, the upper half of a0 is not theirs
+	char path[FRV_LINUX_PATH_MAX];
+	struct timespec ts;
+	int64_t ret;
+
+	switch (nr) {
+	case FRV_SYS_READ:
+		ret = frvLinuxRead(cpu, fd, a1, a2, -1);
+		break;
+
+	case FRV_SYS_WRITE:
+		ret = frvLinuxWrite(cpu, fd, a1, a2);
+		break;
+
+	case FRV_SYS_READV:
+	case FRV_SYS_WRITEV:
+		ret = frvLinuxVector(cpu, fd, a1, a2, nr == FRV_SYS_WRITEV);
+		break;
+
+	case FRV_SYS_OPENAT: // The O_ flags of asm-generic are the host ones
+		if (fd != FRV_LINUX_AT_FDCWD && !frvLinuxIsGuestFd(cpu, fd)) {
+			ret = -EBADF;
+		} else if (!frvLinuxPath(cpu, a1, path)) {
+			ret = -EFAULT;
+		} else if ((ret = openat(fd, path, a2, a3)) == -1) {
+			ret = -errno;
+		} else if (ret < FRV_LINUX_MAX_FDS) {
+			cpu->sys.fds[ret >> 3] |= 1 << (ret & 7);
+		} else {
+			close(ret);
+			ret = -EMFILE;
+		}
+		break;
+
+	case FRV_SYS_CLOSE: // The emulator keeps its own stdio and never hands out its other fds
+		if (!frvLinuxIsGuestFd(cpu, fd)) {
+			ret = -EBADF;
+		} else if (fd <= STDERR_FILENO) {
+			ret = 0;
+		} else {
+			cpu->sys.fds[fd >> 3] &= ~(1 << (fd & 7));
+			ret = (close(fd) == -1) ? -errno : 0;
+		}
+		break;
+
+	case FRV_SYS_LSEEK:
+		if (!frvLinuxIsGuestFd(cpu, fd)) ret = -EBADF;
+		else if ((ret = lseek(fd, a1, a2)) == -1) ret = -errno;
+		break;
+
+	case FRV_SYS_FSTAT:
+		ret = frvLinuxStat(cpu, fd, 0, a1, 0);
+		break;
+
+	case FRV_SYS_NEWFSTATAT:
+		ret = frvLinuxStat(cpu, fd, a1, a2, a3);
+		break;
+
+	case FRV_SYS_EXIT:
+	case FRV_SYS_EXIT_GROUP:
+		cpu->sys.status = (int32_t)a0;
+		cpu->halted = true;
+		fflush(cpu->out);
+		return false;
+
+	case FRV_SYS_CLOCK_GETTIME:
+		if (clock_gettime(a0, &ts) == -1) {
+			ret = -errno;
+			break;
+		}
+		uint8_t out[16];
+		frvRamWrite(out, 8, ts.tv_sec);
+		frvRamWrite(out + 8, 8, ts.tv_nsec);
+		ret = frvEnvCopyOut(cpu, a1, out, sizeof(out)) ? 0 : -EFAULT;
+		break;
+
+	case FRV_SYS_BRK:
+		ret = frvLinuxBrk(cpu, a0);
+		break;
+
+	case FRV_SYS_MMAP:
+		ret = frvLinuxMmap(cpu, a1, a3, a4, a5);
+		break;
+
+	case FRV_SYS_MUNMAP:
+		ret = frvLinuxMunmap(cpu, a0, a1);
+		break;
+
+	case FRV_SYS_UNAME:
+		ret = frvLinuxUname(cpu, a0);
+		break;
+
+	case FRV_SYS_GETRANDOM: {
+		struct iovec iov[FRV_LINUX_MAX_IOV];
+		uint64_t paddrs[FRV_LINUX_MAX_IOV];
+		const int n = frvLinuxSpans(cpu, a0, a1, FRV_ACCESS_STORE, iov, paddrs);
+		ret = 0;
+		for (int i = 0; i < n; i++) {
+			const ssize_t r = getrandom(iov[i].iov_base, iov[i].iov_len, 0);
+			if (r < 0) {
+				ret = ret ? ret : -errno;
+				break;
+			}
+			ret += r;
+		}
+		frvLinuxInvalidate(cpu, iov, paddrs, n, ret > 0 ? ret : 0);
+		break;
+	}
+
+	case FRV_SYS_SET_TID_ADDRESS:
+	case FRV_SYS_GETPID:
+	case FRV_SYS_GETTID:
+		ret = 1;
+		break;
+
+	// Single threaded and without signals, these have nothing to do
+	case FRV_SYS_SET_ROBUST_LIST:
+	case FRV_SYS_RT_SIGACTION:
+	case FRV_SYS_RT_SIGPROCMASK:
+	case FRV_SYS_MPROTECT:
+		ret = 0;
+		break;
+
+	case FRV_SYS_IOCTL: // No terminals, stdio buffers fully
+		ret = -ENOTTY;
+		break;
+
+	default:
+		fprintf(stderr, "Linux syscall %lu is not supported\n", nr);
+		ret = -ENOSYS;
+		break;
+	}
+	cpu->regs[FRV_ABI_REG_A0] = ret;
+	return !cpu->tcache.stale;
+}
+
+// Push len bytes below *sp
+static uint64_t frvLinuxPush(struct FrvCPU* cpu, uint64_t* sp, const void* src, const uint64_t len)
+{
+	*sp -= len;
+	memcpy(frvLinuxRam(cpu, *sp), src, len);
+	frvRamMarkDirty(cpu->bus->ram, *sp - cpu->sys.base, len);
+	return *sp;
+}
+
+bool frvLinuxLoad(struct FrvCPU* cpu, const char* path, const int argc, char** argv)
+{
+	const int fd = open(path, O_RDONLY);
+	if (fd == -1) {
+		fprintf(stderr, "Failed to open file: %s [%s]\n", path, strerror(errno));
+		return false;
+	}
+	struct FrvElfInfo info;
+	bool ok = frvIsElf(fd);
+	if (!ok) fprintf(stderr, "Linux mode only runs ELF executables: %s\n", path);
+	ok = ok && frvElfLoad(cpu->bus->ram, fd, true, &info);
+	close(fd);
+	if (!ok) return false;
+
+	/* The image keeps its link addresses, the RAM is moved under it with a fixed offset
+	 * The heap starts behind the image, the mappings end where the stack begins
+	 */
+	cpu->sys.base = info.base;
+	cpu->mmu.offset = FRV_RAM_BASE_ADDR - info.base;
+	const uint64_t top = cpu->regs[FRV_ABI_REG_SP] - cpu->mmu.offset;
+	cpu->env = FRV_ENV_LINUX;
+	cpu->pc = info.entry;
+	cpu->sys.brk = cpu->sys.brkmin = cpu->sys.brkmax = FRV_LINUX_PAGE_UP(info.end);
+	cpu->sys.mmaptop = cpu->sys.mmapend = top - FRV_LINUX_STACK_SIZE;
+	cpu->sys.status = -1;
+	if (top - info.base < FRV_LINUX_STACK_SIZE || cpu->sys.mmaptop <= cpu->sys.brk) {
+		fprintf(stderr, "Linux mode needs %dMB of RAM above the image for the stack\n",
+			FRV_LINUX_STACK_SIZE >> 20);
+		return false;
+	}
+
+	// Strings first, then argc, argv, envp and auxv from the 16 byte aligned sp up
+	uint64_t sp = top;
+	uint64_t args[argc];
+	for (int i = argc - 1; i >= 0; i--) args[i] = frvLinuxPush(cpu, &sp, argv[i], strlen(argv[i]) + 1);
+	uint8_t random[16];
+	if (getrandom(random, sizeof(random), 0) != sizeof(random)) memset(random, 0x5a, sizeof(random));
+	const uint64_t rnd = frvLinuxPush(cpu, &sp, random, sizeof(random));
+
+	const uint64_t hwcap = cpu->csrs[FRV_CSRS_MISA] & FRV_LINUX_HWCAP;
+	const uint64_t auxv[] = {
+		FRV_AT_PHDR, info.phdr, FRV_AT_PHENT, 56, FRV_AT_PHNUM, info.phnum,
+		FRV_AT_PAGESZ, FRV_BUS_PAGE_SIZE, FRV_AT_ENTRY, info.entry,
+		FRV_AT_UID, 0, FRV_AT_EUID, 0, FRV_AT_GID, 0, FRV_AT_EGID, 0,
+		FRV_AT_HWCAP, hwcap, FRV_AT_CLKTCK, 100, FRV_AT_RANDOM, rnd, FRV_AT_NULL, 0
+	};
+	const uint64_t words = 1 + argc + 1 + 1 + sizeof(auxv) / 8;
+	sp = (sp - words * 8) & ~15ull;
+
+	uint64_t at = sp;
+	uint8_t word[8];
+	frvRamWrite(word, 8, argc);
+	memcpy(frvLinuxRam(cpu, at), word, 8);
+	at += 8;
+	for (int i = 0; i <= argc; i++, at += 8) {
+		frvRamWrite(word, 8, (i < argc) ? args[i] : 0);
+		memcpy(frvLinuxRam(cpu, at), word, 8);
+	}
+	frvRamWrite(word, 8, 0); // envp
+	memcpy(frvLinuxRam(cpu, at), word, 8);
+	at += 8;
+	for (size_t i = 0; i < sizeof(auxv) / 8; i++, at += 8) {
+		frvRamWrite(word, 8, auxv[i]);
+		memcpy(frvLinuxRam(cpu, at), word, 8);
+	}
+	frvRamMarkDirty(cpu->bus->ram, sp - info.base, at - sp);
+	cpu->regs[FRV_ABI_REG_SP] = sp;
+	cpu->regs[FRV_ABI_REG_A0] = 0; // No rtld_fini
+	return true;
+}
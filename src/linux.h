@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "cpu.h"
+
+#define FRV_LINUX_STACK_SIZE (4 * 1024 * 1024) // Kept free for the stack below the top of the RAM
+#define FRV_LINUX_MAX_IOV (64) // Host spans of one read or write, the rest is a short transfer
+
+/* Load the static ELF at path for the Linux user-mode emulation
+ * Builds the initial stack (argc, argv, an empty envp and the auxv) and the heap behind the image
+ */
+bool frvLinuxLoad(struct FrvCPU* cpu, const char* path, const int argc, char** argv);
+// Do the syscall in a7, false once the guest exited (or on an emulator error)
+bool frvLinuxSyscall(struct FrvCPU* cpu);
@@ -0,0 +1,78 @@
+#define _DEFAULT_SOURCE // pread
+
+#include <elf.h>
+#include <unistd.h>
+
+#include "bus.h"
+#include "loader.h"
+
+#ifndef EM_RISCV
+#define EM_RISCV 243
+#endif
+
+#define FRV_ELF_MAX_PHDRS 64
+
+bool frvIsElf(const int fd)
+{
+	unsigned char ident[SELFMAG];
+	return pread(fd, ident, SELFMAG, 0) == SELFMAG && !memcmp(ident, ELFMAG, SELFMAG);
+}
+
+static bool frvElfRead(const int fd, void* buf, const size_t size, const uint64_t off)
+{
+	if (pread(fd, buf, size, off) != (ssize_t)size) {
+		fprintf(stderr, "ELF load failed: truncated file\n");
+		return false;
+	}
+	return true;
+}
+
+bool frvElfLoad(struct FrvRAM* ram, const int fd, const bool virt, struct FrvElfInfo* info)
+{
+	Elf64_Ehdr eh;
+	if (!frvElfRead(fd, &eh, sizeof(eh), 0)) return false;
+	if (eh.e_ident[EI_CLASS] != ELFCLASS64 || eh.e_ident[EI_DATA] != ELFDATA2LSB || eh.e_machine != EM_RISCV) {
+		fprintf(stderr, "ELF load failed: not a 64-bit little-endian RISC-V file\n");
+		return false;
+	}
+	if (eh.e_type != ET_EXEC || eh.e_phentsize != sizeof(Elf64_Phdr) || eh.e_phnum > FRV_ELF_MAX_PHDRS) {
+		fprintf(stderr, "ELF load failed: unsupported executable\n");
+		return false;
+	}
+
+	Elf64_Phdr ph[FRV_ELF_MAX_PHDRS];
+	if (!frvElfRead(fd, ph, sizeof(Elf64_Phdr) * eh.e_phnum, eh.e_phoff)) return false;
+
+	// By p_vaddr the lowest segment goes to the start of the RAM
+	*info = (struct FrvElfInfo) { .entry = eh.e_entry, .base = FRV_RAM_BASE_ADDR, .phnum = eh.e_phnum };
+	if (virt) {
+		info->base = UINT64_MAX;
+		for (uint32_t i = 0; i < eh.e_phnum; i++)
+			if (ph[i].p_type == PT_LOAD && ph[i].p_memsz && ph[i].p_vaddr < info->base) info->base = ph[i].p_vaddr;
+		info->base &= ~FRV_BUS_PAGE_MASK;
+	}
+
+	for (uint32_t i = 0; i < eh.e_phnum; i++) {
+		if (ph[i].p_type != PT_LOAD || !ph[i].p_memsz) continue;
+		const uint64_t addr = virt ? ph[i].p_vaddr : ph[i].p_paddr;
+		const uint64_t off = addr - info->base;
+		if (addr < info->base || ph[i].p_filesz > ph[i].p_memsz || off > ram->size || ph[i].p_memsz > ram->size - off) {
+			fprintf(stderr, "ELF load failed: segment at 0x%lx does not fit in the RAM\n", addr);
+			return false;
+		}
+		if (!frvRamLoadFile(ram, fd, off, ph[i].p_offset, ph[i].p_filesz)) return false;
+
+		// A fresh mapped RAM is already zero past the page the file data ends in
+		uint64_t bss = ph[i].p_memsz - ph[i].p_filesz;
+		const uint64_t page = sysconf(_SC_PAGESIZE);
+		const uint64_t rest = (page - ((off + ph[i].p_filesz) & (page - 1))) & (page - 1);
+		if (ram->mapped && bss > rest) bss = rest;
+		memset(ram->bytes + off + ph[i].p_filesz, 0, bss);
+		frvRamMarkDirty(ram, off + ph[i].p_filesz, bss);
+
+		if (addr + ph[i].p_memsz > info->end) info->end = addr + ph[i].p_memsz;
+		if (eh.e_phoff >= ph[i].p_offset && eh.e_phoff - ph[i].p_offset < ph[i].p_filesz)
+			info->phdr = addr + (eh.e_phoff - ph[i].p_offset);
+	}
+	return true;
+}
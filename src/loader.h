@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+
+#include "ram.h"
+
+// What the loaded image looks like, the Linux emulation builds the auxv and the heap from it
+struct FrvElfInfo {
+	uint64_t	entry;
+	uint64_t	base; // Address of the first RAM byte, where the addresses below are counted from
+	uint64_t	end; // First address past the highest segment
+	uint64_t	phdr; // Where the program headers ended up, 0 if no segment holds them
+	uint64_t	phnum;
+};
+
+bool frvIsElf(const int fd);
+/* Place the PT_LOAD segments of an ELF64 RISC-V executable at their physical addresses
+ * With virt they go by p_vaddr instead, the RAM then starts at the lowest page of the image
+ * .bss is zero filled
+ */
+bool frvElfLoad(struct FrvRAM* ram, const int fd, const bool virt, struct FrvElfInfo* info);
@@ -1,33 +1,246 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
 
 #include "frv.h"
 
-#define MB(n) ((n) * 1024 * 1024)
+#define MB(n) ((uint64_t)(n) * 1024 * 1024)
 #define DEFAULT_MEM_SIZE (MB(32)) // 32MB Default
+#define MAX_HARTS (FRV_CLINT_MAX_HARTS) // The CLINT has a timer per hart
+
+/* The started harts wait at the gate until every thread is up,
+ * none of them runs when the machine cannot be started as a whole
+ */
+struct FrvHartGate {
+	pthread_mutex_t	lock;
+	pthread_cond_t	cond;
+	int		state; // 0 while the threads start, then 1 to run or -1 to leave
+};
+
+struct FrvHart {
+	struct FrvCPU*		cpu;
+	struct FrvHartGate*	gate;
+};
+
+static void* frvHartThread(void* arg)
+{
+	struct FrvHart* hart = arg;
+	pthread_mutex_lock(&hart->gate->lock);
+	while (!hart->gate->state) pthread_cond_wait(&hart->gate->cond, &hart->gate->lock);
+	const bool run = (hart->gate->state > 0);
+	pthread_mutex_unlock(&hart->gate->lock);
+	if (run) frvCpuRun(hart->cpu);
+	return NULL;
+}
+
+// Hart 0 runs on this thread, the machine is done when every hart is
+static bool frvRunHarts(struct FrvCPU* harts, const uint64_t nharts)
+{
+	struct FrvHartGate gate = { .lock = PTHREAD_MUTEX_INITIALIZER, .cond = PTHREAD_COND_INITIALIZER };
+	struct FrvHart args[MAX_HARTS];
+	pthread_t threads[MAX_HARTS];
+	uint64_t started = 1;
+	for (; started < nharts; started++) {
+		args[started] = (struct FrvHart) { .cpu = &harts[started], .gate = &gate };
+		const int err = pthread_create(&threads[started], NULL, frvHartThread, &args[started]);
+		if (err) {
+			fprintf(stderr, "Failed to start hart %lu: %s\n", started, strerror(err));
+			break;
+		}
+	}
+
+	const bool ok = (started == nharts);
+	pthread_mutex_lock(&gate.lock);
+	gate.state = ok ? 1 : -1;
+	pthread_cond_broadcast(&gate.cond);
+	pthread_mutex_unlock(&gate.lock);
+	if (ok) frvCpuRun(&harts[0]);
+	for (uint64_t i = 1; i < started; i++) pthread_join(threads[i], NULL);
+	return ok;
+}
+
+static void frvUsage(const char* name)
+{
+	printf("Usage: %s [options] [riscv binary] <ram size(MB)>\n", name);
+	printf("       %s [options] --restore <snapshot>\n", name);
+	printf("       %s [options] --batch <manifest> <ram size(MB)>\n", name);
+	printf("       %s [options] --linux <riscv elf> [guest args]\n", name);
+	printf("Options:\n");
+	printf("  --malloc-ram	take the RAM from malloc, the binary is copied in instead of mapped copy-on-write\n");
+	printf("  --huge-pages	back the RAM by transparent huge pages\n");
+	printf("  --harts <n>	run n harts on n host threads, all of them start at the entry\n");
+	printf("  --save-snapshot <file>	save the machine there when the guest asks for a snapshot\n");
+	printf("  --restore <file>	resume from a snapshot instead of loading a binary\n");
+	printf("  --batch <file>	run each binary listed in the file, its output is printed once all are done\n");
+	printf("  --jobs <n>	host threads of the batch, one per host cpu by default\n");
+	printf("  --linux	run a static Linux executable, its syscalls are done by the host\n");
+	printf("		munmap only gives back the most recent mapping, the range of any other is not reused\n");
+	printf("  --ram <n>	RAM size in MB\n");
+	printf("  --stats	print the guest MIPS and the host counters of the run as JSON to stderr\n");
+#ifdef FRV_TRACE
+	printf("  --trace <file>	record every instruction there, tools/frv-trace decodes it\n");
+#endif
+}
 
 int main(int argc, char** argv)
 {
-	if (argc < 2) {
-		printf("Usage: %s [riscv binary] <ram size(MB)>\n", argv[0]);
+	const char* path = NULL;
+	const char* save = NULL;
+	const char* restore = NULL;
+	const char* batch = NULL;
+#ifdef FRV_TRACE
+	const char* tracepath = NULL;
+#endif
+	uint64_t njobs = sysconf(_SC_NPROCESSORS_ONLN);
+	uint64_t ramsize = DEFAULT_MEM_SIZE;
+	uint64_t nharts = 1;
+	bool lazy = true, huge = false, linuxmode = false, stats = false;
+	int gargc = 0;
+	char** gargv = NULL;
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--lazy-ram")) { // The default now
+			lazy = true;
+		} else if (!strcmp(argv[i], "--malloc-ram")) {
+			lazy = false;
+		} else if (!strcmp(argv[i], "--huge-pages")) {
+			huge = true;
+		} else if (!strcmp(argv[i], "--harts") && i + 1 < argc) {
+			nharts = strtoull(argv[++i], NULL, 10);
+		} else if (!strcmp(argv[i], "--batch") && i + 1 < argc) {
+			batch = argv[++i];
+		} else if (!strcmp(argv[i], "--jobs") && i + 1 < argc) {
+			njobs = strtoull(argv[++i], NULL, 10);
+		} else if (!strcmp(argv[i], "--save-snapshot") && i + 1 < argc) {
+			save = argv[++i];
+		} else if (!strcmp(argv[i], "--restore") && i + 1 < argc) {
+			restore = argv[++i];
+		} else if (!strcmp(argv[i], "--ram") && i + 1 < argc) {
+			ramsize = MB(strtoull(argv[++i], NULL, 10));
+		} else if (!strcmp(argv[i], "--stats")) {
+			stats = true;
+#ifdef FRV_TRACE
+		} else if (!strcmp(argv[i], "--trace") && i + 1 < argc) {
+			tracepath = argv[++i];
+#endif
+		} else if (!strcmp(argv[i], "--linux")) {
+			linuxmode = true;
+		} else if (argv[i][0] == '-') {
+			frvUsage(argv[0]);
+			return -1;
+		} else if (!path && !batch) {
+			path = argv[i];
+			// Everything behind the executable belongs to the guest
+			if (linuxmode) {
+				gargc = argc - i;
+				gargv = &argv[i];
+				break;
+			}
+		} else {
+			ramsize = MB(strtoull(argv[i], NULL, 10));
+		}
+	}
+	// The guests print into a big buffer, flushed line by line only when someone is watching
+	setvbuf(stdout, NULL, isatty(STDOUT_FILENO) ? _IOLBF : _IOFBF, FRV_ENV_OUT_BUF_SIZE);
+
+	if (batch) {
+		if (!njobs || restore || save || nharts > 1 || linuxmode) {
+			frvUsage(argv[0]);
+			return -1;
+		}
+#ifdef FRV_TRACE
+		if (tracepath) {
+			fprintf(stderr, "Batches are not traced\n");
+			return -1;
+		}
+#endif
+		return frvBatchRun(batch, njobs, ramsize) ? 0 : -1;
+	}
+	if (!path == !restore || !nharts || nharts > MAX_HARTS) {
+		frvUsage(argv[0]);
+		return -1;
+	}
+	if (nharts > 1 && (save || restore)) {
+		fprintf(stderr, "Snapshots only hold a single hart\n");
 		return -1;
 	}
+	if (linuxmode && (nharts > 1 || save || restore)) {
+		fprintf(stderr, "Linux mode runs a single hart without snapshots\n");
+		return -1;
+	}
+
+	// The snapshot knows its RAM size, mapping it lazily makes the restore copy-on-write
+	if (restore) {
+		if (!(ramsize = frvCpuSnapshotRamSize(restore))) return -1;
+		lazy = true;
+	}
 
-	// Creating a RAM
-	struct FrvRAM ram = frvNewRam((argc == 3) ? MB(atoi(argv[2])) : DEFAULT_MEM_SIZE);
+	/* Creating a RAM, mmap'd unless asked otherwise: only the touched pages cost host memory
+	 * and the ELF segments are mapped copy-on-write from the file
+	 */
+	struct FrvRAM ram = (lazy || huge) ? frvNewLazyRam(ramsize, huge) : frvNewRam(ramsize);
 	if (!frvIsRamValid(&ram)) return -1;
 
-	// Initializing the BUS
+	// Initializing the BUS, from here on a failure still frees everything below
 	struct FrvBUS bus = frvNewBus(&ram);
+	struct FrvCLINT clint = frvNewClint();
+	bool ok = frvIsBusValid(&bus) && frvClintAttach(&clint, &bus);
 
-	// Initializing the CPU
-	struct FrvCPU cpu = frvNewCpu(&bus);
-	if (!frvCpuLoadProgram(&cpu, argv[1])) return -1;
-	frvCpuRun(&cpu);
-	// frvCpuPrintRegs(&cpu); // for debug
-	// frvCpuPrintCsrs(&cpu);
+	// Initializing the CPUs, too big for the stack once there are a few of them
+	struct FrvCPU* harts = ok ? calloc(nharts, sizeof(struct FrvCPU)) : NULL;
+	if (ok && !harts) {
+		fprintf(stderr, "Failed to allocate %lu harts: %s\n", nharts, strerror(errno));
+		ok = false;
+	}
+	for (uint64_t i = 0; ok && i < nharts; i++) {
+		frvCpuInit(&harts[i], &bus, i);
+		ok = frvIsCpuValid(&harts[i]);
+	}
+	ok = ok && (restore ? frvCpuRestoreSnapshot(&harts[0], restore) :
+		    linuxmode ? frvLinuxLoad(&harts[0], path, gargc, gargv) : frvCpuLoadProgram(&harts[0], path));
+	if (ok) {
+		harts[0].snapshot = save;
+		for (uint64_t i = 1; i < nharts; i++) harts[i].pc = harts[0].pc;
+	}
+#ifdef FRV_TRACE
+	// Each hart fills its own ring, one thread writes them all to the file
+	struct FrvTrace trace = { .fd = -1 };
+	if (ok && tracepath) {
+		trace = frvNewTrace(tracepath, nharts);
+		ok = frvIsTraceValid(&trace) && frvTraceStart(&trace);
+		for (uint64_t i = 0; ok && i < nharts; i++) harts[i].trace = &trace.rings[i];
+	}
+#endif
+
+	struct FrvStats counters = stats ? frvNewStats() : (struct FrvStats) { 0 };
+	ok = ok && frvRunHarts(harts, nharts);
+#ifdef FRV_TRACE
+	frvTraceDestroy(&trace);
+#endif
+	if (stats && ok) {
+		uint64_t instret = 0;
+		for (uint64_t i = 0; i < nharts; i++) instret += harts[i].instret;
+		fflush(stdout);
+		frvStatsReport(&counters, instret, stderr);
+	}
+	if (stats) frvStatsDestroy(&counters);
+#ifdef FRV_PROFILE
+	FILE* folded = ok ? fopen(FRV_PROF_FOLDED, "w") : NULL;
+	if (ok && !folded) fprintf(stderr, "Failed to open %s: %s\n", FRV_PROF_FOLDED, strerror(errno));
+	for (uint64_t i = 0; folded && i < nharts; i++) frvProfileReport(&harts[i].prof, i, stderr, folded);
+	if (folded) fclose(folded);
+#endif
+	// frvCpuPrintRegs(&harts[0]); // for debug
+	// frvCpuPrintCsrs(&harts[0]);
 
+	// A Linux guest hands its exit status to the host, a hart stopped by an error fails the run
+	const int status = (!ok || !harts[0].halted) ? -1 : linuxmode ? harts[0].sys.status : 0;
+	for (uint64_t i = 0; harts && i < nharts; i++) frvCpuDestroy(&harts[i]);
+	free(harts);
+	frvBusDestroy(&bus);
 	frvRamDestroy(&ram);
-	return 0;
+	return status;
 }
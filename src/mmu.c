@@ -0,0 +1,226 @@
+#include "mmu.h"
+
+static void frvMmuFlushTlbs(struct FrvMMU* mmu)
+{
+	for (uint32_t i = 0; i < FRV_MMU_DTLB_SIZE; i++) {
+		mmu->dtlb[i].rtag = FRV_MMU_EMPTY;
+		mmu->dtlb[i].wtag = FRV_MMU_EMPTY;
+	}
+	for (uint32_t i = 0; i < FRV_MMU_ITLB_SIZE; i++) {
+		mmu->itlb[i].rtag = FRV_MMU_EMPTY;
+		mmu->itlb[i].wtag = FRV_MMU_EMPTY;
+	}
+}
+
+void frvMmuInit(struct FrvMMU* mmu, struct FrvBUS* bus)
+{
+	memset(mmu, 0, sizeof(*mmu));
+	mmu->bus = bus;
+	mmu->ipriv = FRV_PRIV_M;
+	mmu->dpriv = FRV_PRIV_M;
+	mmu->cause = FRV_CAUSE_NONE;
+	frvMmuFlushTlbs(mmu);
+	for (uint32_t i = 0; i < FRV_MMU_WALKS_SIZE; i++)
+		mmu->walks[i].vpn = FRV_MMU_EMPTY;
+	frvBusFlushTlb(mmu->btlb);
+}
+
+void frvMmuSetContext(struct FrvMMU* mmu, const uint64_t satp, const uint8_t ipriv, const uint8_t dpriv,
+		      const bool sum, const bool mxr)
+{
+	if (mmu->satp == satp && mmu->ipriv == ipriv && mmu->dpriv == dpriv && mmu->sum == sum && mmu->mxr == mxr)
+		return;
+
+	mmu->satp = satp;
+	mmu->asid = (satp >> FRV_SATP_ASID_SHIFT) & FRV_SATP_ASID_MASK;
+	mmu->ipriv = ipriv;
+	mmu->dpriv = dpriv;
+	mmu->sum = sum;
+	mmu->mxr = mxr;
+	frvMmuFlushTlbs(mmu);
+
+	// The mode bits of satp are known, replace them with the privilege
+	mmu->ctx = 0;
+	if (satp && ipriv != FRV_PRIV_M)
+		mmu->ctx = (satp & ~(0xfull << FRV_SATP_MODE_SHIFT)) | ((uint64_t)ipriv << FRV_SATP_MODE_SHIFT) | (1ull << 63);
+}
+
+void frvMmuFence(struct FrvMMU* mmu, const uint64_t vaddr, const uint64_t asid, const bool anyaddr, const bool anyasid)
+{
+	const uint64_t vpn = vaddr >> FRV_BUS_PAGE_SHIFT;
+	for (uint32_t i = 0; i < FRV_MMU_WALKS_SIZE; i++) {
+		struct FrvMmuWalk* walk = &mmu->walks[i];
+		if (walk->vpn == FRV_MMU_EMPTY) continue;
+		if (!anyasid && ((walk->pte & FRV_PTE_G) || walk->asid != (asid & FRV_SATP_ASID_MASK))) continue;
+		if (!anyaddr && (walk->vpn >> (9 * walk->level)) != (vpn >> (9 * walk->level))) continue;
+		walk->vpn = FRV_MMU_EMPTY;
+	}
+	frvMmuFlushTlbs(mmu);
+}
+
+// A and D are assumed, the walker sets them
+static bool frvMmuAllowed(const struct FrvMMU* mmu, const uint8_t pte, const uint8_t priv, const enum FrvAccess access)
+{
+	if (pte & FRV_PTE_U) {
+		if (priv == FRV_PRIV_S && (access == FRV_ACCESS_FETCH || !mmu->sum)) return false;
+	} else if (priv == FRV_PRIV_U) {
+		return false;
+	}
+
+	switch (access) {
+	case FRV_ACCESS_FETCH:
+		return pte & FRV_PTE_X;
+	case FRV_ACCESS_LOAD:
+		return (pte & FRV_PTE_R) || (mmu->mxr && (pte & FRV_PTE_X));
+	default:
+		return (pte & FRV_PTE_W) && (pte & FRV_PTE_D);
+	}
+}
+
+// The Sv39 page table walk, updates A and D in the leaf and walks again if the leaf changed under it
+static bool frvMmuWalk(struct FrvMMU* mmu, const uint64_t vaddr, const uint8_t priv, const enum FrvAccess access,
+		       struct FrvMmuWalk* walk)
+{
+	const uint64_t vpn = vaddr >> FRV_BUS_PAGE_SHIFT;
+	if ((uint64_t)((int64_t)(vaddr << 25) >> 25) != vaddr) return false; // Not sign extended from bit 38
+
+	uint64_t table = (mmu->satp & FRV_SATP_PPN_MASK) << FRV_BUS_PAGE_SHIFT;
+	for (int level = 2; level >= 0; level--) {
+		const uint64_t pteaddr = table + ((vpn >> (9 * level)) & 0x1ff) * 8;
+		uint64_t pte;
+		if (!frvBusLoadFast(mmu->bus, mmu->btlb, pteaddr, 8, &pte)) return false;
+		if (!(pte & FRV_PTE_V) || (!(pte & FRV_PTE_R) && (pte & FRV_PTE_W))) return false;
+
+		const uint64_t ppn = (pte >> FRV_PTE_PPN_SHIFT) & FRV_SATP_PPN_MASK;
+		if (!(pte & (FRV_PTE_R | FRV_PTE_X))) {
+			table = ppn << FRV_BUS_PAGE_SHIFT;
+			continue;
+		}
+
+		const uint64_t low = (1ull << (9 * level)) - 1;
+		if ((ppn & low) || !frvMmuAllowed(mmu, pte | FRV_PTE_D, priv, access)) return false;
+
+		// Other harts may change the PTE meanwhile, the update only goes in over the value walked
+		const uint64_t ad = FRV_PTE_A | ((access == FRV_ACCESS_STORE) ? FRV_PTE_D : 0);
+		if ((pte & ad) != ad) {
+			bool writable = false;
+			uint8_t* host = frvBusHostPage(mmu->bus, mmu->btlb, pteaddr, &writable);
+			if (!host || !writable) return false;
+			uint64_t* p = (uint64_t*)(host + (pteaddr & FRV_BUS_PAGE_MASK)); // Aligned, little-endian like the AMOs
+			if (!__atomic_compare_exchange_n(p, &pte, pte | ad, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+				return frvMmuWalk(mmu, vaddr, priv, access, walk);
+			frvRamMarkDirty(mmu->bus->ram, pteaddr - FRV_RAM_BASE_ADDR, 8);
+			pte |= ad;
+		}
+		walk->vpn = vpn;
+		walk->ppn = ppn | (vpn & low);
+		walk->asid = mmu->asid;
+		walk->level = level;
+		walk->pte = pte;
+		return true;
+	}
+	return false;
+}
+
+// Point the TLB entry at the host memory of the physical page, if it has any
+static void frvMmuFill(struct FrvMMU* mmu, struct FrvMmuEntry* e, const uint64_t vpn, const uint64_t ppn,
+		       const bool read, const bool write)
+{
+	bool writable = false;
+	uint8_t* host = frvBusHostPage(mmu->bus, mmu->btlb, ppn << FRV_BUS_PAGE_SHIFT, &writable);
+	e->rtag = (host && read) ? vpn : FRV_MMU_EMPTY;
+	e->wtag = (host && write && writable) ? vpn : FRV_MMU_EMPTY;
+	e->host = host;
+	e->phys = ppn << FRV_BUS_PAGE_SHIFT;
+	if (e->wtag != FRV_MMU_EMPTY) frvRamMarkDirty(mmu->bus->ram, e->phys - FRV_RAM_BASE_ADDR, FRV_BUS_PAGE_SIZE);
+}
+
+static bool frvMmuFault(struct FrvMMU* mmu, const uint64_t cause, const uint64_t vaddr)
+{
+	mmu->cause = cause;
+	mmu->tval = vaddr;
+	return false;
+}
+
+bool frvMmuTranslate(struct FrvMMU* mmu, const uint64_t vaddr, const enum FrvAccess access, uint64_t* paddr)
+{
+	static const uint64_t faults[] = { FRV_CAUSE_FETCH_PAGE_FAULT, FRV_CAUSE_LOAD_PAGE_FAULT, FRV_CAUSE_STORE_PAGE_FAULT };
+	const bool fetch = (access == FRV_ACCESS_FETCH);
+	const uint8_t priv = fetch ? mmu->ipriv : mmu->dpriv;
+	const uint64_t vpn = vaddr >> FRV_BUS_PAGE_SHIFT;
+	struct FrvMmuEntry* e = fetch ? &mmu->itlb[vpn & (FRV_MMU_ITLB_SIZE - 1)] : frvMmuDtlb(mmu, vaddr);
+
+	if (!mmu->satp || priv == FRV_PRIV_M) {
+		*paddr = vaddr + mmu->offset;
+		frvMmuFill(mmu, e, vpn, *paddr >> FRV_BUS_PAGE_SHIFT, true, !fetch);
+		return true;
+	}
+
+	struct FrvMmuWalk* walk = &mmu->walks[vpn & (FRV_MMU_WALKS_SIZE - 1)];
+	if (walk->vpn != vpn || !((walk->pte & FRV_PTE_G) || walk->asid == mmu->asid) ||
+	    !frvMmuAllowed(mmu, walk->pte, priv, access)) {
+		if (!frvMmuWalk(mmu, vaddr, priv, access, walk)) return frvMmuFault(mmu, faults[access], vaddr);
+	}
+
+	frvMmuFill(mmu, e, vpn, walk->ppn, fetch || frvMmuAllowed(mmu, walk->pte, priv, FRV_ACCESS_LOAD),
+		   !fetch && frvMmuAllowed(mmu, walk->pte, priv, FRV_ACCESS_STORE));
+	*paddr = (walk->ppn << FRV_BUS_PAGE_SHIFT) | (vaddr & FRV_BUS_PAGE_MASK);
+	return true;
+}
+
+bool frvMmuLoad(struct FrvMMU* mmu, const uint64_t vaddr, const uint64_t size, uint64_t* dest)
+{
+	// Split the accesses crossing a page into bytes
+	if ((vaddr & FRV_BUS_PAGE_MASK) > FRV_BUS_PAGE_SIZE - size) {
+		uint64_t val = 0, byte;
+		for (uint64_t i = 0; i < size; i++) {
+			if (!frvMmuLoad(mmu, vaddr + i, 1, &byte)) return false;
+			val |= byte << (8 * i);
+		}
+		*dest = val;
+		return true;
+	}
+
+	uint64_t paddr;
+	if (!frvMmuTranslate(mmu, vaddr, FRV_ACCESS_LOAD, &paddr)) return false;
+	const struct FrvMmuEntry* e = frvMmuDtlb(mmu, vaddr);
+	if (e->rtag == (vaddr >> FRV_BUS_PAGE_SHIFT)) { // Refilled, the miss is served from it
+		*dest = frvRamRead(e->host + (vaddr & FRV_BUS_PAGE_MASK), size);
+		return true;
+	}
+	return frvBusLoad(mmu->bus, mmu->btlb, paddr, size, dest) || frvMmuFault(mmu, FRV_CAUSE_LOAD_ACCESS, vaddr);
+}
+
+bool frvMmuFetch(struct FrvMMU* mmu, const uint64_t vaddr, uint16_t* dest, uint64_t* paddr)
+{
+	const struct FrvMmuEntry* e = &mmu->itlb[(vaddr >> FRV_BUS_PAGE_SHIFT) & (FRV_MMU_ITLB_SIZE - 1)];
+	const uint64_t off = vaddr & FRV_BUS_PAGE_MASK;
+	if (e->rtag != (vaddr >> FRV_BUS_PAGE_SHIFT) && !frvMmuTranslate(mmu, vaddr, FRV_ACCESS_FETCH, paddr))
+		return false;
+
+	if (e->rtag == (vaddr >> FRV_BUS_PAGE_SHIFT) && off <= FRV_BUS_PAGE_SIZE - 2) {
+		*paddr = e->phys + off;
+		*dest = frvRamRead(e->host + off, 2);
+		return true;
+	}
+	*paddr = e->phys + off;
+	return frvBusLoadInst(mmu->bus, mmu->btlb, *paddr, dest) || frvMmuFault(mmu, FRV_CAUSE_FETCH_ACCESS, vaddr);
+}
+
+bool frvMmuHost(struct FrvMMU* mmu, const uint64_t vaddr, const enum FrvAccess access, uint8_t** host, uint64_t* paddr)
+{
+	const struct FrvMmuEntry* e = frvMmuDtlb(mmu, vaddr);
+	const uint64_t vpn = vaddr >> FRV_BUS_PAGE_SHIFT;
+	const uint64_t* tag = (access == FRV_ACCESS_STORE) ? &e->wtag : &e->rtag;
+	if (*tag != vpn && !frvMmuTranslate(mmu, vaddr, access, paddr)) return false;
+
+	*host = (*tag == vpn) ? e->host + (vaddr & FRV_BUS_PAGE_MASK) : NULL;
+	*paddr = e->phys + (vaddr & FRV_BUS_PAGE_MASK);
+	return true;
+}
+
+bool frvMmuStore(struct FrvMMU* mmu, const uint64_t vaddr, const uint64_t size, const uint64_t val, uint64_t* paddr)
+{
+	if (!frvMmuTranslate(mmu, vaddr, FRV_ACCESS_STORE, paddr)) return false;
+	return frvBusStore(mmu->bus, mmu->btlb, *paddr, size, val) || frvMmuFault(mmu, FRV_CAUSE_STORE_ACCESS, vaddr);
+}
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "bus.h"
+
+#define FRV_MMU_ITLB_SIZE	(64) // Power of 2
+#define FRV_MMU_DTLB_SIZE	(256) // Power of 2
+#define FRV_MMU_WALKS_SIZE	(1024) // Power of 2
+#define FRV_MMU_EMPTY		(UINT64_MAX)
+
+// satp fields
+#define FRV_SATP_MODE_SHIFT	(60)
+#define FRV_SATP_MODE_BARE	(0ull)
+#define FRV_SATP_MODE_SV39	(8ull)
+#define FRV_SATP_ASID_SHIFT	(44)
+#define FRV_SATP_ASID_MASK	(0xffffull)
+#define FRV_SATP_PPN_MASK	((1ull << 44) - 1)
+
+// Page table entry bits
+#define FRV_PTE_V		(1 << 0)
+#define FRV_PTE_R		(1 << 1)
+#define FRV_PTE_W		(1 << 2)
+#define FRV_PTE_X		(1 << 3)
+#define FRV_PTE_U		(1 << 4)
+#define FRV_PTE_G		(1 << 5)
+#define FRV_PTE_A		(1 << 6)
+#define FRV_PTE_D		(1 << 7)
+#define FRV_PTE_PPN_SHIFT	(10)
+
+enum FrvPriv {
+	FRV_PRIV_U = 0,
+	FRV_PRIV_S = 1,
+	FRV_PRIV_M = 3
+};
+
+enum FrvAccess {
+	FRV_ACCESS_FETCH,
+	FRV_ACCESS_LOAD,
+	FRV_ACCESS_STORE
+};
+
+// Exception causes of mcause/scause, interrupts have FRV_CAUSE_INTERRUPT set
+enum FrvCause {
+	FRV_CAUSE_MISALIGNED_FETCH = 0,
+	FRV_CAUSE_FETCH_ACCESS = 1,
+	FRV_CAUSE_ILLEGAL_INST = 2,
+	FRV_CAUSE_BREAKPOINT = 3,
+	FRV_CAUSE_MISALIGNED_LOAD = 4,
+	FRV_CAUSE_LOAD_ACCESS = 5,
+	FRV_CAUSE_MISALIGNED_STORE = 6, // Also AMOs
+	FRV_CAUSE_STORE_ACCESS = 7,
+	FRV_CAUSE_ECALL_U = 8, // + the privilege of the caller
+	FRV_CAUSE_ECALL_S = 9,
+	FRV_CAUSE_ECALL_M = 11,
+	FRV_CAUSE_FETCH_PAGE_FAULT = 12,
+	FRV_CAUSE_LOAD_PAGE_FAULT = 13,
+	FRV_CAUSE_STORE_PAGE_FAULT = 15
+};
+#define FRV_CAUSE_INTERRUPT	(1ull << 63)
+#define FRV_CAUSE_NONE		(UINT64_MAX) // Nothing raised
+
+/* A first level TLB entry, one virtual page to its host memory
+ * rtag/wtag hold the virtual page number while the access is allowed straight on host
+ * (in the ITLB rtag means fetch)
+ */
+struct FrvMmuEntry {
+	uint64_t	rtag;
+	uint64_t	wtag;
+	uint8_t*	host;
+	uint64_t	phys; // Physical address of the page
+};
+
+// A cached page table walk, superpages are cached per 4KB page too
+struct FrvMmuWalk {
+	uint64_t	vpn; // FRV_MMU_EMPTY if unused
+	uint64_t	ppn;
+	uint16_t	asid;
+	uint8_t		level; // Of the leaf, 0 for 4KB, 1 for 2MB and 2 for 1GB pages
+	uint8_t		pte; // Flags of the leaf
+};
+
+/* Sv39 address translation
+ * The split I/D TLBs are only valid for the current context (satp, privilege, sum, mxr)
+ * and are dropped whenever it changes. The walk cache behind them is tagged with the ASID
+ * so switching address spaces does not cost a page table walk per page
+ */
+struct FrvMMU {
+	struct FrvMmuEntry	dtlb[FRV_MMU_DTLB_SIZE];
+	struct FrvMmuEntry	itlb[FRV_MMU_ITLB_SIZE];
+	struct FrvBUS*		bus;
+	uint64_t		satp; // 0 while translation is off
+	uint64_t		offset; // Added to the addresses while it is off, the Linux env runs its image on it
+	uint64_t		ctx; // Identifies the fetch translation, 0 if there is none
+	uint16_t		asid;
+	uint8_t			ipriv; // Privilege of the instruction fetches
+	uint8_t			dpriv; // Privilege of the loads and stores (mstatus.MPRV)
+	bool			sum;
+	bool			mxr;
+	uint64_t		cause; // Exception of the last failed access, FRV_CAUSE_NONE once it was taken
+	uint64_t		tval; // Its faulting address
+	struct FrvMmuWalk	walks[FRV_MMU_WALKS_SIZE];
+	struct FrvTlbEntry	btlb[FRV_BUS_TLB_SIZE]; // Physical pages, this hart's TLB in front of the bus
+};
+
+void frvMmuInit(struct FrvMMU* mmu, struct FrvBUS* bus); // In place, the TLBs make it too big to copy around
+void frvMmuSetContext(struct FrvMMU* mmu, const uint64_t satp, const uint8_t ipriv, const uint8_t dpriv,
+		      const bool sum, const bool mxr);
+void frvMmuFence(struct FrvMMU* mmu, const uint64_t vaddr, const uint64_t asid, const bool anyaddr, const bool anyasid); // SFENCE.VMA
+
+/* Translate vaddr and cache it in the TLB
+ * The accesses do not print their faults, they leave the exception in cause and tval for the cpu
+ */
+bool frvMmuTranslate(struct FrvMMU* mmu, const uint64_t vaddr, const enum FrvAccess access, uint64_t* paddr);
+bool frvMmuLoad(struct FrvMMU* mmu, const uint64_t vaddr, const uint64_t size, uint64_t* dest);
+bool frvMmuFetch(struct FrvMMU* mmu, const uint64_t vaddr, uint16_t* dest, uint64_t* paddr); // One 16-bit parcel
+/* Host memory of vaddr for a load or a store, it stays valid up to the end of the page
+ * false on a page fault, *host is NULL when the page is not RAM or ROM
+ */
+bool frvMmuHost(struct FrvMMU* mmu, const uint64_t vaddr, const enum FrvAccess access, uint8_t** host, uint64_t* paddr);
+// The store must not cross a page, paddr is where it landed
+bool frvMmuStore(struct FrvMMU* mmu, const uint64_t vaddr, const uint64_t size, const uint64_t val, uint64_t* paddr);
+
+static inline struct FrvMmuEntry* frvMmuDtlb(struct FrvMMU* mmu, const uint64_t vaddr)
+{
+	return &mmu->dtlb[(vaddr >> FRV_BUS_PAGE_SHIFT) & (FRV_MMU_DTLB_SIZE - 1)];
+}
+
+/* Inlined fast path: a DTLB hit inside one page is a single native move on the host memory,
+ * the same whether translation is on or not
+ */
+static inline bool frvMmuLoadFast(struct FrvMMU* mmu, const uint64_t vaddr, const uint64_t size, uint64_t* dest)
+{
+	const struct FrvMmuEntry* e = frvMmuDtlb(mmu, vaddr);
+	const uint64_t off = vaddr & FRV_BUS_PAGE_MASK;
+	if (e->rtag == (vaddr >> FRV_BUS_PAGE_SHIFT) && off <= FRV_BUS_PAGE_SIZE - size) {
+		*dest = frvRamRead(e->host + off, size);
+		return true;
+	}
+	return frvMmuLoad(mmu, vaddr, size, dest);
+}
+
+// Size specialized entry points
+static inline bool frvMmuLoad8(struct FrvMMU* mmu, const uint64_t vaddr, uint64_t* dest)
+{
+	return frvMmuLoadFast(mmu, vaddr, 1, dest);
+}
+
+static inline bool frvMmuLoad16(struct FrvMMU* mmu, const uint64_t vaddr, uint64_t* dest)
+{
+	return frvMmuLoadFast(mmu, vaddr, 2, dest);
+}
+
+static inline bool frvMmuLoad32(struct FrvMMU* mmu, const uint64_t vaddr, uint64_t* dest)
+{
+	return frvMmuLoadFast(mmu, vaddr, 4, dest);
+}
+
+static inline bool frvMmuLoad64(struct FrvMMU* mmu, const uint64_t vaddr, uint64_t* dest)
+{
+	return frvMmuLoadFast(mmu, vaddr, 8, dest);
+}
@@ -0,0 +1,255 @@
+#include "prof.h"
+
+#define FRV_PROF_CHILDREN (FRV_PROF_MAX_NODES * 2)
+#define FRV_PROF_IS_LINK(r) ((r) == 1 || (r) == 5) // ra and t0
+
+static const char* const frvProfOpNames[FRV_OP_COUNT] = {
+	[FRV_OP_ILLEGAL] = "illegal", [FRV_OP_ADD] = "add", [FRV_OP_SUB] = "sub", [FRV_OP_ADDI] = "addi",
+	[FRV_OP_ADDIW] = "addiw", [FRV_OP_ADDW] = "addw", [FRV_OP_SUBW] = "subw", [FRV_OP_ANDI] = "andi",
+	[FRV_OP_ORI] = "ori", [FRV_OP_XORI] = "xori", [FRV_OP_SLLI] = "slli", [FRV_OP_SRLI] = "srli",
+	[FRV_OP_SRAI] = "srai", [FRV_OP_AND] = "and", [FRV_OP_OR] = "or", [FRV_OP_XOR] = "xor",
+	[FRV_OP_SLL] = "sll", [FRV_OP_SRL] = "srl", [FRV_OP_SRA] = "sra", [FRV_OP_SLLIW] = "slliw",
+	[FRV_OP_SRLIW] = "srliw", [FRV_OP_SRAIW] = "sraiw", [FRV_OP_SLLW] = "sllw", [FRV_OP_SRLW] = "srlw",
+	[FRV_OP_SRAW] = "sraw", [FRV_OP_SLTI] = "slti", [FRV_OP_SLTIU] = "sltiu", [FRV_OP_SLT] = "slt",
+	[FRV_OP_SLTU] = "sltu", [FRV_OP_LB] = "lb", [FRV_OP_LH] = "lh", [FRV_OP_LW] = "lw",
+	[FRV_OP_LBU] = "lbu", [FRV_OP_LHU] = "lhu", [FRV_OP_LWU] = "lwu", [FRV_OP_LD] = "ld",
+	[FRV_OP_SB] = "sb", [FRV_OP_SH] = "sh", [FRV_OP_SW] = "sw", [FRV_OP_SD] = "sd",
+	[FRV_OP_LUI] = "lui", [FRV_OP_AUIPC] = "auipc", [FRV_OP_JAL] = "jal", [FRV_OP_JALR] = "jalr",
+	[FRV_OP_BEQ] = "beq", [FRV_OP_BNE] = "bne", [FRV_OP_BLT] = "blt", [FRV_OP_BLTU] = "bltu",
+	[FRV_OP_BGE] = "bge", [FRV_OP_BGEU] = "bgeu", [FRV_OP_FENCE] = "fence", [FRV_OP_FENCEI] = "fence.i",
+	[FRV_OP_ECALL] = "ecall", [FRV_OP_EBREAK] = "ebreak", [FRV_OP_SRET] = "sret", [FRV_OP_MRET] = "mret",
+	[FRV_OP_WFI] = "wfi", [FRV_OP_SFENCEVMA] = "sfence.vma", [FRV_OP_CSRRW] = "csrrw", [FRV_OP_CSRRS] = "csrrs",
+	[FRV_OP_CSRRC] = "csrrc", [FRV_OP_CSRRWI] = "csrrwi", [FRV_OP_CSRRSI] = "csrrsi",
+	[FRV_OP_CSRRCI] = "csrrci", [FRV_OP_MUL] = "mul", [FRV_OP_MULH] = "mulh", [FRV_OP_MULHU] = "mulhu",
+	[FRV_OP_MULHSU] = "mulhsu", [FRV_OP_MULW] = "mulw", [FRV_OP_DIV] = "div", [FRV_OP_DIVU] = "divu",
+	[FRV_OP_DIVW] = "divw", [FRV_OP_DIVUW] = "divuw", [FRV_OP_REM] = "rem", [FRV_OP_REMU] = "remu",
+	[FRV_OP_REMW] = "remw", [FRV_OP_REMUW] = "remuw", [FRV_OP_LRW] = "lr.w", [FRV_OP_SCW] = "sc.w",
+	[FRV_OP_AMOSWAPW] = "amoswap.w", [FRV_OP_AMOADDW] = "amoadd.w", [FRV_OP_AMOXORW] = "amoxor.w",
+	[FRV_OP_AMOANDW] = "amoand.w", [FRV_OP_AMOORW] = "amoor.w", [FRV_OP_AMOMINW] = "amomin.w",
+	[FRV_OP_AMOMAXW] = "amomax.w", [FRV_OP_AMOMINUW] = "amominu.w", [FRV_OP_AMOMAXUW] = "amomaxu.w",
+	[FRV_OP_LRD] = "lr.d", [FRV_OP_SCD] = "sc.d", [FRV_OP_AMOSWAPD] = "amoswap.d",
+	[FRV_OP_AMOADDD] = "amoadd.d", [FRV_OP_AMOXORD] = "amoxor.d", [FRV_OP_AMOANDD] = "amoand.d",
+	[FRV_OP_AMOORD] = "amoor.d", [FRV_OP_AMOMIND] = "amomin.d", [FRV_OP_AMOMAXD] = "amomax.d",
+	[FRV_OP_AMOMINUD] = "amominu.d", [FRV_OP_AMOMAXUD] = "amomaxu.d",
+	[FRV_OP_FLW] = "flw", [FRV_OP_FSW] = "fsw", [FRV_OP_FMADDS] = "fmadd.s", [FRV_OP_FMSUBS] = "fmsub.s",
+	[FRV_OP_FNMSUBS] = "fnmsub.s", [FRV_OP_FNMADDS] = "fnmadd.s", [FRV_OP_FADDS] = "fadd.s",
+	[FRV_OP_FSUBS] = "fsub.s", [FRV_OP_FMULS] = "fmul.s", [FRV_OP_FDIVS] = "fdiv.s",
+	[FRV_OP_FSQRTS] = "fsqrt.s", [FRV_OP_FSGNJS] = "fsgnj.s", [FRV_OP_FSGNJNS] = "fsgnjn.s",
+	[FRV_OP_FSGNJXS] = "fsgnjx.s", [FRV_OP_FMINS] = "fmin.s", [FRV_OP_FMAXS] = "fmax.s",
+	[FRV_OP_FCVTWS] = "fcvt.w.s", [FRV_OP_FCVTWUS] = "fcvt.wu.s", [FRV_OP_FCVTLS] = "fcvt.l.s",
+	[FRV_OP_FCVTLUS] = "fcvt.lu.s", [FRV_OP_FCVTSW] = "fcvt.s.w", [FRV_OP_FCVTSWU] = "fcvt.s.wu",
+	[FRV_OP_FCVTSL] = "fcvt.s.l", [FRV_OP_FCVTSLU] = "fcvt.s.lu", [FRV_OP_FMVXW] = "fmv.x.w",
+	[FRV_OP_FMVWX] = "fmv.w.x", [FRV_OP_FEQS] = "feq.s", [FRV_OP_FLTS] = "flt.s", [FRV_OP_FLES] = "fle.s",
+	[FRV_OP_FCLASSS] = "fclass.s", [FRV_OP_FLD] = "fld", [FRV_OP_FSD] = "fsd", [FRV_OP_FMADDD] = "fmadd.d",
+	[FRV_OP_FMSUBD] = "fmsub.d", [FRV_OP_FNMSUBD] = "fnmsub.d", [FRV_OP_FNMADDD] = "fnmadd.d",
+	[FRV_OP_FADDD] = "fadd.d", [FRV_OP_FSUBD] = "fsub.d", [FRV_OP_FMULD] = "fmul.d",
+	[FRV_OP_FDIVD] = "fdiv.d", [FRV_OP_FSQRTD] = "fsqrt.d", [FRV_OP_FSGNJD] = "fsgnj.d",
+	[FRV_OP_FSGNJND] = "fsgnjn.d", [FRV_OP_FSGNJXD] = "fsgnjx.d", [FRV_OP_FMIND] = "fmin.d",
+	[FRV_OP_FMAXD] = "fmax.d", [FRV_OP_FCVTWD] = "fcvt.w.d", [FRV_OP_FCVTWUD] = "fcvt.wu.d",
+	[FRV_OP_FCVTLD] = "fcvt.l.d", [FRV_OP_FCVTLUD] = "fcvt.lu.d", [FRV_OP_FCVTDW] = "fcvt.d.w",
+	[FRV_OP_FCVTDWU] = "fcvt.d.wu", [FRV_OP_FCVTDL] = "fcvt.d.l", [FRV_OP_FCVTDLU] = "fcvt.d.lu",
+	[FRV_OP_FCVTSD] = "fcvt.s.d", [FRV_OP_FCVTDS] = "fcvt.d.s", [FRV_OP_FMVXD] = "fmv.x.d",
+	[FRV_OP_FMVDX] = "fmv.d.x", [FRV_OP_FEQD] = "feq.d", [FRV_OP_FLTD] = "flt.d", [FRV_OP_FLED] = "fle.d",
+	[FRV_OP_FCLASSD] = "fclass.d",
+	[FRV_OP_VSETVLI] = "vsetvli", [FRV_OP_VSETIVLI] = "vsetivli", [FRV_OP_VSETVL] = "vsetvl",
+	[FRV_OP_VLE] = "vle", [FRV_OP_VLSE] = "vlse", [FRV_OP_VSE] = "vse", [FRV_OP_VSSE] = "vsse",
+	[FRV_OP_VADD] = "vadd", [FRV_OP_VSUB] = "vsub", [FRV_OP_VRSUB] = "vrsub", [FRV_OP_VMINU] = "vminu",
+	[FRV_OP_VMIN] = "vmin", [FRV_OP_VMAXU] = "vmaxu", [FRV_OP_VMAX] = "vmax", [FRV_OP_VAND] = "vand",
+	[FRV_OP_VOR] = "vor", [FRV_OP_VXOR] = "vxor", [FRV_OP_VSLL] = "vsll", [FRV_OP_VSRL] = "vsrl",
+	[FRV_OP_VSRA] = "vsra", [FRV_OP_VMERGE] = "vmerge", [FRV_OP_VMUL] = "vmul", [FRV_OP_VMACC] = "vmacc",
+	[FRV_OP_VMVXS] = "vmv.x.s", [FRV_OP_VMVSX] = "vmv.s.x", [FRV_OP_VREDSUM] = "vredsum.vs",
+	[FRV_OP_VREDAND] = "vredand.vs", [FRV_OP_VREDOR] = "vredor.vs", [FRV_OP_VREDXOR] = "vredxor.vs",
+	[FRV_OP_VREDMINU] = "vredminu.vs", [FRV_OP_VREDMIN] = "vredmin.vs", [FRV_OP_VREDMAXU] = "vredmaxu.vs",
+	[FRV_OP_VREDMAX] = "vredmax.vs",
+	[FRV_OP_SH1ADD] = "sh1add", [FRV_OP_SH2ADD] = "sh2add", [FRV_OP_SH3ADD] = "sh3add",
+	[FRV_OP_ADDUW] = "add.uw", [FRV_OP_SH1ADDUW] = "sh1add.uw", [FRV_OP_SH2ADDUW] = "sh2add.uw",
+	[FRV_OP_SH3ADDUW] = "sh3add.uw", [FRV_OP_SLLIUW] = "slli.uw", [FRV_OP_ANDN] = "andn",
+	[FRV_OP_ORN] = "orn", [FRV_OP_XNOR] = "xnor", [FRV_OP_CLZ] = "clz", [FRV_OP_CTZ] = "ctz",
+	[FRV_OP_CPOP] = "cpop", [FRV_OP_CLZW] = "clzw", [FRV_OP_CTZW] = "ctzw", [FRV_OP_CPOPW] = "cpopw",
+	[FRV_OP_MAX] = "max", [FRV_OP_MAXU] = "maxu", [FRV_OP_MIN] = "min", [FRV_OP_MINU] = "minu",
+	[FRV_OP_SEXTB] = "sext.b", [FRV_OP_SEXTH] = "sext.h", [FRV_OP_ZEXTH] = "zext.h", [FRV_OP_ROL] = "rol",
+	[FRV_OP_ROR] = "ror", [FRV_OP_ROLW] = "rolw", [FRV_OP_RORW] = "rorw", [FRV_OP_RORI] = "rori",
+	[FRV_OP_RORIW] = "roriw", [FRV_OP_ORCB] = "orc.b", [FRV_OP_REV8] = "rev8", [FRV_OP_BCLR] = "bclr",
+	[FRV_OP_BCLRI] = "bclri", [FRV_OP_BEXT] = "bext", [FRV_OP_BEXTI] = "bexti", [FRV_OP_BINV] = "binv",
+	[FRV_OP_BINVI] = "binvi", [FRV_OP_BSET] = "bset", [FRV_OP_BSETI] = "bseti",
+};
+
+// The classes follow the order of enum FrvOp, each one ends with its last op
+static const struct {
+	uint8_t		last;
+	const char*	name;
+} frvProfClasses[] = {
+	{ FRV_OP_ILLEGAL, "illegal" }, { FRV_OP_SUBW, "arithmetic" }, { FRV_OP_SRAW, "logic" },
+	{ FRV_OP_SLTU, "compare" }, { FRV_OP_LD, "load" }, { FRV_OP_SD, "store" }, { FRV_OP_AUIPC, "upper" },
+	{ FRV_OP_JALR, "jump" }, { FRV_OP_BGEU, "branch" }, { FRV_OP_FENCEI, "fence" }, { FRV_OP_EBREAK, "env" },
+	{ FRV_OP_SFENCEVMA, "privileged" }, { FRV_OP_CSRRCI, "csr" }, { FRV_OP_REMUW, "mul/div" },
+	{ FRV_OP_AMOMAXUD, "atomic" }, { FRV_OP_FCLASSS, "float" }, { FRV_OP_FCLASSD, "double" },
+	{ FRV_OP_VREDMAX, "vector" }, { FRV_OP_BSETI, "bitmanip" },
+};
+#define FRV_PROF_CLASSES (sizeof(frvProfClasses) / sizeof(frvProfClasses[0]))
+
+static const char* frvProfileOpName(const uint8_t op)
+{
+	return (op < FRV_OP_COUNT && frvProfOpNames[op]) ? frvProfOpNames[op] : "?";
+}
+
+struct FrvProfile frvNewProfile(void)
+{
+	struct FrvProfile prof = {
+		.pcs = calloc(FRV_PROF_PCS, sizeof(struct FrvProfPc)),
+		.pcmask = FRV_PROF_PCS - 1,
+		.nodes = calloc(FRV_PROF_MAX_NODES, sizeof(struct FrvProfNode)),
+		.children = calloc(FRV_PROF_CHILDREN, sizeof(uint32_t)),
+		.nnodes = 1
+	};
+	if (!prof.pcs || !prof.nodes || !prof.children) {
+		fprintf(stderr, "Failed to create a new FrvProfile: %s\n", strerror(errno));
+		frvProfileDestroy(&prof);
+	}
+	return prof;
+}
+
+bool frvIsProfileValid(const struct FrvProfile* const prof)
+{
+	return (prof->pcs != NULL && prof->nodes != NULL && prof->children != NULL);
+}
+
+void frvProfileDestroy(struct FrvProfile* prof)
+{
+	free(prof->pcs);
+	free(prof->nodes);
+	free(prof->children);
+	prof->pcs = NULL;
+	prof->nodes = NULL;
+	prof->children = NULL;
+}
+
+// Double the pc table, false if the host is out of memory
+static bool frvProfileGrow(struct FrvProfile* prof)
+{
+	const uint64_t size = (prof->pcmask + 1) * 2;
+	struct FrvProfPc* pcs = calloc(size, sizeof(struct FrvProfPc));
+	if (!pcs) return false;
+	for (uint64_t i = 0; i <= prof->pcmask; i++) {
+		if (!prof->pcs[i].pc) continue;
+		uint64_t j = frvProfileHash(prof->pcs[i].pc) & (size - 1);
+		while (pcs[j].pc) j = (j + 1) & (size - 1);
+		pcs[j] = prof->pcs[i];
+	}
+	free(prof->pcs);
+	prof->pcs = pcs;
+	prof->pcmask = size - 1;
+	return true;
+}
+
+bool frvProfileAddPc(struct FrvProfile* prof, const uint64_t pc, const struct FrvInst* inst)
+{
+	if (!prof->nodes[0].func) prof->nodes[0].func = pc; // The first instruction opens the root function
+
+	// One slot always stays free to end the probes, a pc without memory for it goes uncounted
+	if (prof->pcused * 2 >= prof->pcmask && !frvProfileGrow(prof) && prof->pcused + 1 >= prof->pcmask)
+		return false;
+	uint64_t i = frvProfileHash(pc) & prof->pcmask;
+	while (prof->pcs[i].pc) i = (i + 1) & prof->pcmask;
+	prof->pcs[i] = (struct FrvProfPc) { .pc = pc, .count = 1, .raw = inst->raw, .op = inst->op };
+	prof->pcused++;
+	return true;
+}
+
+// The node of func called from the current one, created on the first call
+static bool frvProfileCall(struct FrvProfile* prof, const uint64_t func)
+{
+	const uint32_t parent = prof->node;
+	uint64_t i = frvProfileHash(func ^ ((uint64_t)parent << 40) ^ parent) & (FRV_PROF_CHILDREN - 1);
+	for (; prof->children[i]; i = (i + 1) & (FRV_PROF_CHILDREN - 1)) {
+		const struct FrvProfNode* n = &prof->nodes[prof->children[i] - 1];
+		if (n->func == func && n->parent == parent) {
+			prof->node = prof->children[i] - 1;
+			return true;
+		}
+	}
+	if (prof->nnodes == FRV_PROF_MAX_NODES) return false;
+	prof->nodes[prof->nnodes] = (struct FrvProfNode) { .func = func, .parent = parent };
+	prof->children[i] = prof->nnodes + 1;
+	prof->node = prof->nnodes++;
+	return true;
+}
+
+// Link register hints as in the return address stack table of the ISA manual
+void frvProfileJump(struct FrvProfile* prof, const struct FrvInst* inst, const uint64_t target)
+{
+	const bool push = FRV_PROF_IS_LINK(inst->rd);
+	const bool pop = inst->op == FRV_OP_JALR && FRV_PROF_IS_LINK(inst->rs1) && (!push || inst->rd != inst->rs1);
+	if (pop) {
+		if (prof->lost) prof->lost--;
+		else prof->node = prof->nodes[prof->node].parent;
+	}
+	if (push && (prof->lost || !frvProfileCall(prof, target))) prof->lost++;
+}
+
+static int frvProfilePcCompare(const void* a, const void* b)
+{
+	const uint64_t ca = ((const struct FrvProfPc*)a)->count, cb = ((const struct FrvProfPc*)b)->count;
+	return (ca < cb) - (ca > cb);
+}
+
+bool frvProfileReport(const struct FrvProfile* const prof, const uint64_t hart, FILE* out, FILE* folded)
+{
+	uint64_t total = 0;
+	for (uint32_t i = 0; i < FRV_OP_COUNT; i++) total += prof->ops[i];
+	const double scale = total ? 100.0 / total : 0;
+	fprintf(out, "hart %lu: %lu instructions retired\n", hart, total);
+
+	fprintf(out, "  %-12s %14s %7s\n", "class", "count", "%");
+	for (uint32_t c = 0, op = 0; c < FRV_PROF_CLASSES; c++) {
+		uint64_t n = 0;
+		for (; op <= frvProfClasses[c].last; op++) n += prof->ops[op];
+		if (n) fprintf(out, "  %-12s %14lu %6.2f%%\n", frvProfClasses[c].name, n, n * scale);
+	}
+
+	fprintf(out, "  %-12s %14s %7s\n", "op", "count", "%");
+	uint8_t order[FRV_OP_COUNT];
+	for (uint32_t i = 0; i < FRV_OP_COUNT; i++) order[i] = i;
+	for (uint32_t i = 1; i < FRV_OP_COUNT; i++) // Insertion sort, there are few ops
+		for (uint32_t j = i; j && prof->ops[order[j]] > prof->ops[order[j - 1]]; j--) {
+			const uint8_t t = order[j];
+			order[j] = order[j - 1];
+			order[j - 1] = t;
+		}
+	for (uint32_t i = 0; i < FRV_OP_COUNT && prof->ops[order[i]]; i++)
+		fprintf(out, "  %-12s %14lu %6.2f%%\n", frvProfileOpName(order[i]), prof->ops[order[i]],
+			prof->ops[order[i]] * scale);
+
+	// Hot spots, the table is sorted in a copy of its used slots
+	struct FrvProfPc* hot = malloc((prof->pcused + 1) * sizeof(struct FrvProfPc));
+	if (!hot) {
+		fprintf(stderr, "Failed to sort the profile: %s\n", strerror(errno));
+		return false;
+	}
+	uint64_t n = 0;
+	for (uint64_t i = 0; i <= prof->pcmask; i++)
+		if (prof->pcs[i].pc) hot[n++] = prof->pcs[i];
+	qsort(hot, n, sizeof(struct FrvProfPc), frvProfilePcCompare);
+	fprintf(out, "  %-18s %14s %7s  %-10s %s\n", "pc", "count", "%", "inst", "op");
+	for (uint64_t i = 0; i < n && i < FRV_PROF_HOT; i++)
+		fprintf(out, "  0x%-16lx %14lu %6.2f%%  %08x   %s\n", hot[i].pc, hot[i].count, hot[i].count * scale,
+			hot[i].raw, frvProfileOpName(hot[i].op));
+	free(hot);
+
+	// One line per call stack: hart;caller;...;callee self-count
+	uint32_t* stack = malloc(prof->nnodes * sizeof(uint32_t));
+	if (!stack) {
+		fprintf(stderr, "Failed to fold the call stacks: %s\n", strerror(errno));
+		return false;
+	}
+	for (uint32_t i = 0; i < prof->nnodes; i++) {
+		if (!prof->nodes[i].self) continue;
+		uint32_t depth = 0;
+		for (uint32_t node = i; node; node = prof->nodes[node].parent) stack[depth++] = node;
+		fprintf(folded, "hart%lu;0x%lx", hart, prof->nodes[0].func);
+		while (depth) fprintf(folded, ";0x%lx", prof->nodes[stack[--depth]].func);
+		fprintf(folded, " %lu\n", prof->nodes[i].self);
+	}
+	free(stack);
+	return !ferror(folded);
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+
+#include "inst.h"
+
+#define FRV_PROF_PCS (1 << 16) // Initial pc slots, doubled whenever half of them are used
+#define FRV_PROF_MAX_NODES (1 << 20) // Call tree nodes, deeper calls are counted in their caller
+#define FRV_PROF_HOT (32) // Lines of the hot spot report
+#define FRV_PROF_FOLDED "frv.folded" // Call stacks for flamegraph.pl and perf tooling
+
+// Retired instructions of one guest pc
+struct FrvProfPc {
+	uint64_t	pc;
+	uint64_t	count;
+	uint32_t	raw;
+	uint8_t		op;
+};
+
+// A function in the call tree, entered through a call from parent
+struct FrvProfNode {
+	uint64_t	func;
+	uint64_t	self; // Instructions retired in it, callees excluded
+	uint32_t	parent;
+};
+
+/* Per hart instruction profile, only built with FRV_PROFILE
+ * Calls and returns are recognised by their link registers (ra or t0) like a return address stack would
+ */
+struct FrvProfile {
+	uint64_t		ops[FRV_OP_COUNT];
+	struct FrvProfPc*	pcs; // Open addressing, pc 0 marks a free slot
+	uint64_t		pcmask;
+	uint64_t		pcused;
+	struct FrvProfNode*	nodes; // nodes[0] is the function the hart started in
+	uint32_t*		children; // Open addressing on (parent, func), node id + 1
+	uint32_t		nnodes;
+	uint32_t		node; // Current function
+	uint32_t		lost; // Calls past the node limit, their returns are ignored
+};
+
+struct FrvProfile frvNewProfile(void);
+bool frvIsProfileValid(const struct FrvProfile* const prof);
+void frvProfileDestroy(struct FrvProfile* prof);
+bool frvProfileAddPc(struct FrvProfile* prof, const uint64_t pc, const struct FrvInst* inst); // First run of pc
+void frvProfileJump(struct FrvProfile* prof, const struct FrvInst* inst, const uint64_t target); // After a JAL or JALR
+static inline uint64_t frvProfileHash(const uint64_t pc)
+{
+	return (pc * 0x9e3779b97f4a7c15ull) >> 32;
+}
+
+// Count the instruction at pc before it runs
+static inline void frvProfileCount(struct FrvProfile* prof, const uint64_t pc, const struct FrvInst* inst)
+{
+	prof->ops[inst->op]++;
+	prof->nodes[prof->node].self++;
+	for (uint64_t i = frvProfileHash(pc) & prof->pcmask;; i = (i + 1) & prof->pcmask) {
+		struct FrvProfPc* e = &prof->pcs[i];
+		if (e->pc == pc) {
+			e->count++;
+			return;
+		}
+		if (!e->pc) {
+			frvProfileAddPc(prof, pc, inst);
+			return;
+		}
+	}
+}
+
+// Print the op and hot spot report to out, add the call stacks of hart to the folded file
+bool frvProfileReport(const struct FrvProfile* const prof, const uint64_t hart, FILE* out, FILE* folded);
@@ -1,160 +1,180 @@
+#define _DEFAULT_SOURCE // MAP_ANONYMOUS, MAP_NORESERVE, madvise, ftruncate
+
+#include <sys/mman.h>
+#include <unistd.h>
+
 #include "ram.h"
 
+#define FRV_RAM_SAVE_CHUNK (4096)
+
 struct FrvRAM frvNewRam(const uint64_t size)
 {
 	uint8_t* bytes = malloc(sizeof(uint8_t) * size);
 	if (!bytes) fprintf(stderr, "Failed to create a new FrvRAM with size %lu: %s\n", size, strerror(errno));
 	return (struct FrvRAM) {
 		.bytes = bytes,
-		.size = size
+		.size = size,
+		.mapped = false
 	};
 }
 
-bool frvIsRamValid(const struct FrvRAM* const ram)
-{
-	return (ram->bytes != NULL);
-}
-
-void frvRamDestroy(struct FrvRAM* ram)
-{
-	free(ram->bytes);
-}
-
-static inline uint64_t frvRamLoad8(const struct FrvRAM* const ram, const uint64_t addr)
-{
-	return ram->bytes[addr];
-}
-
-static inline uint64_t frvRamLoad16(const struct FrvRAM* const ram, const uint64_t addr)
+struct FrvRAM frvNewLazyRam(const uint64_t size, const bool huge)
 {
-	return ((uint64_t)(ram->bytes[addr])) | 
-	       (((uint64_t)(ram->bytes[addr + 1])) << 8);
-}
+	struct FrvRAM ram = { .bytes = NULL, .size = size, .mapped = true };
+	// Huge pages need a 2MB aligned start, reserve the slack and trim it off
+	const uint64_t slack = huge ? FRV_RAM_HUGE_PAGE_SIZE : 0;
+	uint8_t* bytes = mmap(NULL, size + slack, PROT_READ | PROT_WRITE,
+			      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (bytes == MAP_FAILED) {
+		fprintf(stderr, "Failed to map a new FrvRAM with size %lu: %s\n", size, strerror(errno));
+		return ram;
+	}
 
-static inline uint64_t frvRamLoad32(const struct FrvRAM* const ram, const uint64_t addr)
-{
-	return ((uint64_t)(ram->bytes[addr]))		  | 
-	       (((uint64_t)(ram->bytes[addr + 1])) << 8)  |
-	       (((uint64_t)(ram->bytes[addr + 2])) << 16) |
-	       (((uint64_t)(ram->bytes[addr + 3])) << 24);
+	if (huge) {
+		uint8_t* start = (uint8_t*)(((uintptr_t)bytes + slack - 1) & ~(uintptr_t)(slack - 1));
+		if (start > bytes) munmap(bytes, start - bytes);
+		if (start + size < bytes + size + slack) munmap(start + size, (bytes + size + slack) - (start + size));
+		bytes = start;
+#ifdef MADV_HUGEPAGE
+		if (madvise(bytes, size, MADV_HUGEPAGE) == -1)
+			fprintf(stderr, "FrvRAM huge pages are not available: %s\n", strerror(errno));
+#else
+		fprintf(stderr, "FrvRAM huge pages are not supported on this host\n");
+#endif
+	}
+	ram.bytes = bytes;
+	return ram;
 }
 
-static inline uint64_t frvRamLoad64(const struct FrvRAM* const ram, const uint64_t addr)
+bool frvIsRamValid(const struct FrvRAM* const ram)
 {
-	return ((uint64_t)(ram->bytes[addr]))		  | 
-	       (((uint64_t)(ram->bytes[addr + 1])) << 8)  |
-	       (((uint64_t)(ram->bytes[addr + 2])) << 16) |
-	       (((uint64_t)(ram->bytes[addr + 3])) << 24) |
-	       (((uint64_t)(ram->bytes[addr + 4])) << 32) |
-	       (((uint64_t)(ram->bytes[addr + 5])) << 40) |
-	       (((uint64_t)(ram->bytes[addr + 6])) << 48) |
-	       (((uint64_t)(ram->bytes[addr + 7])) << 56);
+	return (ram->bytes != NULL);
 }
 
-static inline void frvRamStore8(struct FrvRAM* ram, const uint64_t addr, const uint64_t val)
+void frvRamDestroy(struct FrvRAM* ram)
 {
-	ram->bytes[addr] = val & 0xFF;
+	free(ram->dirty);
+	if (ram->mapped && ram->bytes) munmap(ram->bytes, ram->size);
+	else free(ram->bytes);
 }
 
-static inline void frvRamStore16(struct FrvRAM* ram, const uint64_t addr, const uint64_t val)
+// pread the whole range, a short file is an error
+static bool frvRamReadFile(struct FrvRAM* ram, const int fd, uint64_t off, uint64_t fileoff, uint64_t len)
 {
-	ram->bytes[addr] = (uint8_t)(val & 0xFF);
-	ram->bytes[addr + 1] = (uint8_t)((val >> 8) & 0xFF);
+	while (len) {
+		const ssize_t n = pread(fd, ram->bytes + off, len, fileoff);
+		if (n <= 0) {
+			fprintf(stderr, "FrvRAM load failed: %s\n", n ? strerror(errno) : "unexpected end of file");
+			return false;
+		}
+		off += n;
+		fileoff += n;
+		len -= n;
+	}
+	return true;
 }
 
-static inline void frvRamStore32(struct FrvRAM* ram, const uint64_t addr, const uint64_t val)
+bool frvRamLoadFile(struct FrvRAM* ram, const int fd, const uint64_t off, const uint64_t fileoff, const uint64_t len)
 {
-	ram->bytes[addr] = (uint8_t)(val & 0xFF);
-	ram->bytes[addr + 1] = (uint8_t)((val >> 8) & 0xFF);
-	ram->bytes[addr + 2] = (uint8_t)((val >> 16) & 0xFF);
-	ram->bytes[addr + 3] = (uint8_t)((val >> 24) & 0xFF);
-}
+	if (off > ram->size || len > ram->size - off) {
+		fprintf(stderr, "FrvRAM load failed: 0x%lx bytes do not fit at 0x%lx\n", len, off);
+		return false;
+	}
 
-static inline void frvRamStore64(struct FrvRAM* ram, const uint64_t addr, const uint64_t val)
-{
-	ram->bytes[addr] = (uint8_t)(val & 0xFF);
-	ram->bytes[addr + 1] = (uint8_t)((val >> 8) & 0xFF);
-	ram->bytes[addr + 2] = (uint8_t)((val >> 16) & 0xFF);
-	ram->bytes[addr + 3] = (uint8_t)((val >> 24) & 0xFF);
-	ram->bytes[addr + 4] = (uint8_t)((val >> 32) & 0xFF);
-	ram->bytes[addr + 5] = (uint8_t)((val >> 40) & 0xFF);
-	ram->bytes[addr + 6] = (uint8_t)((val >> 48) & 0xFF);
-	ram->bytes[addr + 7] = (uint8_t)((val >> 56) & 0xFF);
+	// [start, end) is mapped, the head and the tail around it are read
+	const uint64_t page = sysconf(_SC_PAGESIZE);
+	uint64_t start = off + len, end = off + len;
+	if (ram->mapped && (off % page) == (fileoff % page)) {
+		start = (off + page - 1) & ~(page - 1);
+		end = (off + len) & ~(page - 1);
+		if (start >= end) start = end = off + len;
+	}
+	if (start < end && mmap(ram->bytes + start, end - start, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED,
+				fd, fileoff + (start - off)) == MAP_FAILED) {
+		fprintf(stderr, "FrvRAM load failed: %s\n", strerror(errno));
+		return false;
+	}
+	frvRamMarkDirty(ram, off, len);
+	return frvRamReadFile(ram, fd, off, fileoff, start - off) &&
+	       frvRamReadFile(ram, fd, end, fileoff + (end - off), off + len - end);
 }
 
-bool frvRamLoad(const struct FrvRAM* const ram, uint64_t addr, const uint64_t size, uint64_t* dest)
+bool frvRamSaveFile(const struct FrvRAM* const ram, const int fd, const uint64_t fileoff)
 {
-	addr -= FRV_RAM_BASE_ADDR;
-
-	if (addr + size > ram->size) {
-		fprintf(stderr, "Ram load failed: Out of range Address\n");
+	static const uint8_t zero[FRV_RAM_SAVE_CHUNK] = { 0 };
+	if (ftruncate(fd, fileoff + ram->size) == -1) {
+		fprintf(stderr, "FrvRAM save failed: %s\n", strerror(errno));
 		return false;
 	}
 
-	switch (size) {
-		case 1:
-			*dest = frvRamLoad8(ram, addr);
-			break;
-		case 2:
-			*dest = frvRamLoad16(ram, addr);
-			break;
-		case 4:
-			*dest = frvRamLoad32(ram, addr);
-			break;
-		case 8:
-			*dest = frvRamLoad64(ram, addr);
-			break;
-
-		default:
-			fprintf(stderr, "Ram load failed: Invalid fetch size\n");
-			return false;
+	// Most of a lazy RAM was never touched, the file stays sparse there
+	for (uint64_t off = 0; off < ram->size; off += FRV_RAM_SAVE_CHUNK) {
+		const uint64_t len = (ram->size - off < FRV_RAM_SAVE_CHUNK) ? ram->size - off : FRV_RAM_SAVE_CHUNK;
+		if (!memcmp(ram->bytes + off, zero, len)) continue;
+		for (uint64_t done = 0; done < len;) {
+			const ssize_t n = pwrite(fd, ram->bytes + off + done, len - done, fileoff + off + done);
+			if (n <= 0) {
+				fprintf(stderr, "FrvRAM save failed: %s\n", n ? strerror(errno) : "nothing written");
+				return false;
+			}
+			done += n;
+		}
 	}
 	return true;
 }
 
-bool frvRamStore(struct FrvRAM* ram, uint64_t addr, const uint64_t size, const uint64_t val)
+bool frvRamTrackDirty(struct FrvRAM* ram)
 {
-	addr -= FRV_RAM_BASE_ADDR;
-
-	if (addr + size > ram->size) {
-		fprintf(stderr, "Ram store failed: Out of range Address\n");
+	const uint64_t pages = (ram->size + (1ull << FRV_RAM_DIRTY_SHIFT) - 1) >> FRV_RAM_DIRTY_SHIFT;
+	ram->dirty = calloc((pages + 63) / 64, sizeof(uint64_t));
+	if (!ram->dirty) {
+		fprintf(stderr, "FrvRAM dirty tracking failed: %s\n", strerror(errno));
 		return false;
 	}
-
-	switch (size) {
-		case 1:
-			frvRamStore8(ram, addr, val);
-			break;
-		case 2:
-			frvRamStore16(ram, addr, val);
-			break;
-		case 4:
-			frvRamStore32(ram, addr, val);
-			break;
-		case 8:
-			frvRamStore64(ram, addr, val);
-			break;
-
-		default:
-			fprintf(stderr, "Ram store failed: Invalid fetch size\n");
-			return false;
-	}
 	return true;
 }
 
-bool frvRamLoadInst(struct FrvRAM* ram, uint64_t addr, uint32_t* dest)
+bool frvRamDiscard(struct FrvRAM* ram, const uint64_t off, const uint64_t len)
 {
-	addr -= FRV_RAM_BASE_ADDR;
+	const uint64_t page = sysconf(_SC_PAGESIZE);
+	uint64_t start = off + len, end = off + len;
+	if (ram->mapped) {
+		start = (off + page - 1) & ~(page - 1);
+		end = (off + len) & ~(page - 1);
+		if (start >= end) start = end = off + len;
+	}
 
-	if (addr + 4 > ram->size) {
-		fprintf(stderr, "Ram Load instruction failed: Out of range Address\n");
+	// A fresh anonymous mapping also drops what the loader mapped from files
+	if (start < end && mmap(ram->bytes + start, end - start, PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0) == MAP_FAILED) {
+		fprintf(stderr, "FrvRAM discard failed: %s\n", strerror(errno));
 		return false;
 	}
+	memset(ram->bytes + off, 0, start - off);
+	memset(ram->bytes + end, 0, off + len - end);
+	return true;
+}
 
-	*dest = ((uint32_t)(ram->bytes[addr]))		   | 
-	        (((uint32_t)(ram->bytes[addr + 1])) << 8)  |
-	        (((uint32_t)(ram->bytes[addr + 2])) << 16) |
-	        (((uint32_t)(ram->bytes[addr + 3])) << 24);
-
+bool frvRamReset(struct FrvRAM* ram)
+{
+	const uint64_t pages = (ram->size + (1ull << FRV_RAM_DIRTY_SHIFT) - 1) >> FRV_RAM_DIRTY_SHIFT;
+	uint64_t page = 0;
+	while (page < pages) {
+		if (!(ram->dirty[page >> 6] & (1ull << (page & 63)))) {
+			page++;
+			continue;
+		}
+
+		// Wipe the whole run of dirty pages at once
+		uint64_t end = page;
+		while (end < pages && (ram->dirty[end >> 6] & (1ull << (end & 63)))) {
+			ram->dirty[end >> 6] &= ~(1ull << (end & 63));
+			end++;
+		}
+		const uint64_t off = page << FRV_RAM_DIRTY_SHIFT;
+		const uint64_t len = ((end << FRV_RAM_DIRTY_SHIFT) < ram->size ? (end << FRV_RAM_DIRTY_SHIFT) : ram->size) - off;
+		page = end;
+		if (!frvRamDiscard(ram, off, len)) return false;
+	}
 	return true;
 }
@@ -9,18 +9,102 @@
 
 #define FRV_RAM_BASE_ADDR (0x80000000)
 
+#define FRV_RAM_HUGE_PAGE_SIZE (2ull * 1024 * 1024)
+#define FRV_RAM_DIRTY_SHIFT (12) // Dirty tracking granule, the guest page size
+
 struct FrvRAM {
 	uint8_t*	bytes;
 	uint64_t	size;
+	bool		mapped; // mmap'd instead of malloc'd
+	uint64_t*	dirty; // One bit per page that may have been written, NULL when not tracked
 };
 
 struct FrvRAM frvNewRam(const size_t size);
+/* Reserve the RAM with mmap(MAP_NORESERVE), pages cost nothing until the guest touches them
+ * huge asks for transparent huge pages, worth it for large guests
+ */
+struct FrvRAM frvNewLazyRam(const uint64_t size, const bool huge);
 bool frvIsRamValid(const struct FrvRAM* const ram);
 void frvRamDestroy(struct FrvRAM* ram);
+/* Place len bytes of the file at fileoff into the RAM at off
+ * The whole pages are mapped copy-on-write when the RAM is mmap'd, the rest is read
+ */
+bool frvRamLoadFile(struct FrvRAM* ram, const int fd, const uint64_t off, const uint64_t fileoff, const uint64_t len);
+// Write the whole RAM to the file at fileoff, the zero pages are left as holes
+bool frvRamSaveFile(const struct FrvRAM* const ram, const int fd, const uint64_t fileoff);
+/* Start tracking the written pages so the RAM can be wiped cheaply and reused
+ * Everything handing out write access to the RAM has to call frvRamMarkDirty
+ */
+bool frvRamTrackDirty(struct FrvRAM* ram);
+// Zero [off, off + len), the whole host pages of a mapped RAM are given back to the host
+bool frvRamDiscard(struct FrvRAM* ram, const uint64_t off, const uint64_t len);
+// Zero the dirty pages, a mapped RAM gives them back to the host
+bool frvRamReset(struct FrvRAM* ram);
+
+static inline void frvRamMarkDirty(struct FrvRAM* ram, const uint64_t off, const uint64_t len)
+{
+	if (!ram->dirty || !len) return;
+	for (uint64_t page = off >> FRV_RAM_DIRTY_SHIFT; page <= (off + len - 1) >> FRV_RAM_DIRTY_SHIFT; page++)
+		ram->dirty[page >> 6] |= 1ull << (page & 63);
+}
+
+/* Unaligned-safe little-endian access of size bytes at a host pointer
+ * size should be a constant so the switch folds into one native move
+ */
+static inline uint64_t frvRamRead(const uint8_t* p, const uint64_t size)
+{
+	uint8_t v8;
+	uint16_t v16;
+	uint32_t v32;
+	uint64_t v64;
+	switch (size) {
+	case 1:
+		memcpy(&v8, p, 1);
+		return v8;
+	case 2:
+		memcpy(&v16, p, 2);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+		v16 = __builtin_bswap16(v16);
+#endif
+		return v16;
+	case 4:
+		memcpy(&v32, p, 4);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+		v32 = __builtin_bswap32(v32);
+#endif
+		return v32;
+	default:
+		memcpy(&v64, p, 8);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+		v64 = __builtin_bswap64(v64);
+#endif
+		return v64;
+	}
+}
 
-// Load/Store ops
-// return false on fail otherise true
-// size is in bytes [1,2,4,8]
-bool frvRamLoad(const struct FrvRAM* const ram, uint64_t addr, const uint64_t size, uint64_t* dest);
-bool frvRamLoadInst(struct FrvRAM* ram, uint64_t addr, uint32_t* dest); // Load 32-bit instruction
-bool frvRamStore(struct FrvRAM* ram, uint64_t addr, const uint64_t size, const uint64_t val);
+static inline void frvRamWrite(uint8_t* p, const uint64_t size, const uint64_t val)
+{
+	uint8_t v8 = val;
+	uint16_t v16 = val;
+	uint32_t v32 = val;
+	uint64_t v64 = val;
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	v16 = __builtin_bswap16(v16);
+	v32 = __builtin_bswap32(v32);
+	v64 = __builtin_bswap64(v64);
+#endif
+	switch (size) {
+	case 1:
+		memcpy(p, &v8, 1);
+		break;
+	case 2:
+		memcpy(p, &v16, 2);
+		break;
+	case 4:
+		memcpy(p, &v32, 4);
+		break;
+	default:
+		memcpy(p, &v64, 8);
+		break;
+	}
+}
@@ -0,0 +1,128 @@
+#include "rvc.h"
+
+// Encoders of the 32-bit formats
+static inline uint32_t frvRvcR(const uint32_t funct7, const uint32_t rs2, const uint32_t rs1, const uint32_t funct3,
+			       const uint32_t rd, const uint32_t opcode)
+{
+	return (funct7 << 25) | (rs2 << 20) | (rs1 << 15) | (funct3 << 12) | (rd << 7) | opcode;
+}
+
+static inline uint32_t frvRvcI(const uint32_t imm, const uint32_t rs1, const uint32_t funct3, const uint32_t rd,
+			       const uint32_t opcode)
+{
+	return ((imm & 0xfff) << 20) | (rs1 << 15) | (funct3 << 12) | (rd << 7) | opcode;
+}
+
+static inline uint32_t frvRvcS(const uint32_t imm, const uint32_t rs2, const uint32_t rs1, const uint32_t funct3,
+			       const uint32_t opcode)
+{
+	return (((imm >> 5) & 0x7f) << 25) | (rs2 << 20) | (rs1 << 15) | (funct3 << 12) | ((imm & 0x1f) << 7) | opcode;
+}
+
+static inline uint32_t frvRvcB(const uint32_t imm, const uint32_t rs2, const uint32_t rs1, const uint32_t funct3)
+{
+	return (((imm >> 12) & 0x1) << 31) | (((imm >> 5) & 0x3f) << 25) | (rs2 << 20) | (rs1 << 15) |
+	       (funct3 << 12) | (((imm >> 1) & 0xf) << 8) | (((imm >> 11) & 0x1) << 7) | 0x63;
+}
+
+static inline uint32_t frvRvcJ(const uint32_t imm, const uint32_t rd)
+{
+	return (((imm >> 20) & 0x1) << 31) | (((imm >> 1) & 0x3ff) << 21) | (((imm >> 11) & 0x1) << 20) |
+	       (((imm >> 12) & 0xff) << 12) | (rd << 7) | 0x6f;
+}
+
+// Sign extend the low bits of an immediate
+static inline uint32_t frvRvcSext(const uint32_t imm, const uint32_t bits)
+{
+	return (uint32_t)((int32_t)(imm << (32 - bits)) >> (32 - bits));
+}
+
+uint32_t frvRvcExpand(const uint16_t inst)
+{
+	const uint32_t c = inst;
+	const uint32_t funct3 = (c >> 13) & 0x7;
+	const uint32_t rd = (c >> 7) & 0x1f, rs2 = (c >> 2) & 0x1f; // Full registers
+	const uint32_t rs1p = 8 + ((c >> 7) & 0x7), rdp = 8 + ((c >> 2) & 0x7); // x8-x15, rdp is rs2' too
+	const uint32_t imm6 = frvRvcSext(((c >> 7) & 0x20) | ((c >> 2) & 0x1f), 6); // CI immediates and shamts
+	const uint32_t offw = ((c >> 7) & 0x38) | ((c >> 4) & 0x4) | ((c << 1) & 0x40); // CL/CS word offset
+	const uint32_t offd = ((c >> 7) & 0x38) | ((c << 1) & 0xc0); // CL/CS double offset
+
+	switch (((c & 0x3) << 3) | funct3) {
+	// Quadrant 0
+	case 0x00: { // C.ADDI4SPN
+		const uint32_t imm = ((c >> 7) & 0x30) | ((c >> 1) & 0x3c0) | ((c >> 4) & 0x4) | ((c >> 2) & 0x8);
+		return imm ? frvRvcI(imm, 2, 0x0, rdp, 0x13) : 0;
+	}
+	case 0x01:	return frvRvcI(offd, rs1p, 0x3, rdp, 0x07); // C.FLD
+	case 0x02:	return frvRvcI(offw, rs1p, 0x2, rdp, 0x03); // C.LW
+	case 0x03:	return frvRvcI(offd, rs1p, 0x3, rdp, 0x03); // C.LD
+	case 0x05:	return frvRvcS(offd, rdp, rs1p, 0x3, 0x27); // C.FSD
+	case 0x06:	return frvRvcS(offw, rdp, rs1p, 0x2, 0x23); // C.SW
+	case 0x07:	return frvRvcS(offd, rdp, rs1p, 0x3, 0x23); // C.SD
+
+	// Quadrant 1
+	case 0x08:	return frvRvcI(imm6, rd, 0x0, rd, 0x13); // C.ADDI, C.NOP
+	case 0x09:	return rd ? frvRvcI(imm6, rd, 0x0, rd, 0x1b) : 0; // C.ADDIW
+	case 0x0a:	return frvRvcI(imm6, 0, 0x0, rd, 0x13); // C.LI
+	case 0x0b: {
+		if (rd == 2) { // C.ADDI16SP
+			const uint32_t imm = frvRvcSext(((c >> 3) & 0x200) | ((c >> 2) & 0x10) | ((c << 1) & 0x40) |
+							((c << 4) & 0x180) | ((c << 3) & 0x20), 10);
+			return imm ? frvRvcI(imm, 2, 0x0, 2, 0x13) : 0;
+		}
+		const uint32_t imm = frvRvcSext(((c << 5) & 0x20000) | ((c << 10) & 0x1f000), 18); // C.LUI
+		return imm ? ((imm & 0xfffff000) | (rd << 7) | 0x37) : 0;
+	}
+	case 0x0c: {
+		const uint32_t shamt = imm6 & 0x3f;
+		switch ((c >> 10) & 0x3) {
+		case 0x0:	return frvRvcI(shamt, rs1p, 0x5, rs1p, 0x13); // C.SRLI
+		case 0x1:	return frvRvcI(shamt | 0x400, rs1p, 0x5, rs1p, 0x13); // C.SRAI
+		case 0x2:	return frvRvcI(imm6, rs1p, 0x7, rs1p, 0x13); // C.ANDI
+		default:	break;
+		}
+		static const uint8_t funct3s[] = { 0x0, 0x4, 0x6, 0x7 }; // SUB, XOR, OR, AND
+		const uint32_t op = (c >> 5) & 0x3;
+		if (!(c & 0x1000)) return frvRvcR((op == 0) ? 0x20 : 0x00, rdp, rs1p, funct3s[op], rs1p, 0x33);
+		if (op < 2) return frvRvcR((op == 0) ? 0x20 : 0x00, rdp, rs1p, 0x0, rs1p, 0x3b); // C.SUBW, C.ADDW
+		return 0;
+	}
+	case 0x0d: { // C.J
+		const uint32_t imm = frvRvcSext(((c >> 1) & 0x800) | ((c >> 7) & 0x10) | ((c >> 1) & 0x300) |
+						((c << 2) & 0x400) | ((c >> 1) & 0x40) | ((c << 1) & 0x80) |
+						((c >> 2) & 0xe) | ((c << 3) & 0x20), 12);
+		return frvRvcJ(imm, 0);
+	}
+	case 0x0e: // C.BEQZ, C.BNEZ
+	case 0x0f: {
+		const uint32_t imm = frvRvcSext(((c >> 4) & 0x100) | ((c >> 7) & 0x18) | ((c << 1) & 0xc0) |
+						((c >> 2) & 0x6) | ((c << 3) & 0x20), 9);
+		return frvRvcB(imm, 0, rs1p, funct3 & 0x1);
+	}
+
+	// Quadrant 2
+	case 0x10:	return frvRvcI(imm6 & 0x3f, rd, 0x1, rd, 0x13); // C.SLLI
+	case 0x11: // C.FLDSP
+		return frvRvcI(((c >> 7) & 0x20) | ((c >> 2) & 0x18) | ((c << 4) & 0x1c0), 2, 0x3, rd, 0x07);
+	case 0x12: // C.LWSP
+		return rd ? frvRvcI(((c >> 7) & 0x20) | ((c >> 2) & 0x1c) | ((c << 4) & 0xc0), 2, 0x2, rd, 0x03) : 0;
+	case 0x13: // C.LDSP
+		return rd ? frvRvcI(((c >> 7) & 0x20) | ((c >> 2) & 0x18) | ((c << 4) & 0x1c0), 2, 0x3, rd, 0x03) : 0;
+	case 0x14:
+		if (!(c & 0x1000)) {
+			if (rs2) return frvRvcR(0x00, rs2, 0, 0x0, rd, 0x33); // C.MV
+			return rd ? frvRvcI(0, rd, 0x0, 0, 0x67) : 0; // C.JR
+		}
+		if (rs2) return frvRvcR(0x00, rs2, rd, 0x0, rd, 0x33); // C.ADD
+		return rd ? frvRvcI(0, rd, 0x0, 1, 0x67) : 0x00100073; // C.JALR, C.EBREAK
+	case 0x15: // C.FSDSP
+		return frvRvcS(((c >> 7) & 0x38) | ((c >> 1) & 0x1c0), rs2, 2, 0x3, 0x27);
+	case 0x16: // C.SWSP
+		return frvRvcS(((c >> 7) & 0x3c) | ((c >> 1) & 0xc0), rs2, 2, 0x2, 0x23);
+	case 0x17: // C.SDSP
+		return frvRvcS(((c >> 7) & 0x38) | ((c >> 1) & 0x1c0), rs2, 2, 0x3, 0x23);
+
+	default: // Reserved
+		return 0;
+	}
+}
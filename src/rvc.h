@@ -0,0 +1,13 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// The lowest two bits are 11 only for the 32-bit instructions
+#define FRV_RVC_IS_COMPRESSED(parcel) (((parcel) & 0x3) != 0x3)
+
+/* Expand a 16-bit C-extension instruction to the 32-bit one it stands for
+ * so the decoder and the handlers never see the compressed forms
+ * 0 (an illegal instruction) for the reserved encodings
+ */
+uint32_t frvRvcExpand(const uint16_t inst);
@@ -0,0 +1,68 @@
+#define _DEFAULT_SOURCE // syscall
+
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "stats.h"
+
+static const char* const frvStatsNames[FRV_STATS_COUNT] = {
+	[FRV_STATS_CYCLES] = "host_cycles",
+	[FRV_STATS_INSTRUCTIONS] = "host_instructions",
+	[FRV_STATS_CACHE_MISSES] = "cache_misses",
+	[FRV_STATS_L1D_MISSES] = "l1d_misses",
+	[FRV_STATS_BRANCH_MISSES] = "branch_misses",
+};
+
+static int frvStatsOpen(const uint32_t type, const uint64_t config)
+{
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = type;
+	attr.config = config;
+	attr.inherit = 1; // The harts started later count too
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+struct FrvStats frvNewStats(void)
+{
+	struct FrvStats stats;
+	stats.fds[FRV_STATS_CYCLES] = frvStatsOpen(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+	stats.fds[FRV_STATS_INSTRUCTIONS] = frvStatsOpen(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+	stats.fds[FRV_STATS_CACHE_MISSES] = frvStatsOpen(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+	stats.fds[FRV_STATS_L1D_MISSES] = frvStatsOpen(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D |
+		(PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+	stats.fds[FRV_STATS_BRANCH_MISSES] = frvStatsOpen(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+	clock_gettime(CLOCK_MONOTONIC, &stats.start);
+	return stats;
+}
+
+void frvStatsDestroy(struct FrvStats* stats)
+{
+	for (int i = 0; i < FRV_STATS_COUNT; i++) {
+		if (stats->fds[i] != -1) close(stats->fds[i]);
+		stats->fds[i] = -1;
+	}
+}
+
+void frvStatsReport(const struct FrvStats* const stats, const uint64_t instret, FILE* out)
+{
+	struct timespec end;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	const double secs = (end.tv_sec - stats->start.tv_sec) + (end.tv_nsec - stats->start.tv_nsec) * 1e-9;
+
+	fprintf(out, "{\"instructions\": %lu, \"seconds\": %.6f, \"mips\": %.2f, \"ns_per_inst\": %.3f",
+		instret, secs, secs > 0 ? instret / secs * 1e-6 : 0, instret ? secs * 1e9 / instret : 0);
+	for (int i = 0; i < FRV_STATS_COUNT; i++) {
+		uint64_t val;
+		if (stats->fds[i] != -1 && read(stats->fds[i], &val, sizeof(val)) == sizeof(val))
+			fprintf(out, ", \"%s\": %lu", frvStatsNames[i], val);
+		else
+			fprintf(out, ", \"%s\": null", frvStatsNames[i]);
+	}
+	fprintf(out, "}\n");
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+// Host counters read through perf_event_open
+enum FrvStatsCounter {
+	FRV_STATS_CYCLES = 0,
+	FRV_STATS_INSTRUCTIONS,
+	FRV_STATS_CACHE_MISSES,
+	FRV_STATS_L1D_MISSES,
+	FRV_STATS_BRANCH_MISSES,
+	FRV_STATS_COUNT
+};
+
+/* Wall time and host counters of a run, started on creation
+ * The counters follow every thread the emulator starts later, a counter perf refuses stays at -1
+ */
+struct FrvStats {
+	struct timespec	start;
+	int		fds[FRV_STATS_COUNT];
+};
+
+struct FrvStats frvNewStats(void);
+void frvStatsDestroy(struct FrvStats* stats);
+// Print one JSON object with the guest throughput and the host counters
+void frvStatsReport(const struct FrvStats* const stats, const uint64_t instret, FILE* out);
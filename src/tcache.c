@@ -0,0 +1,69 @@
+#include "tcache.h"
+
+#define FRV_BLOCK_BYTES(len) ((sizeof(struct FrvBlock) + sizeof(struct FrvInst) * (len) + 7) & ~7ULL)
+
+struct FrvTCache frvNewTCache(const uint64_t ramsize)
+{
+	const uint64_t codesize = ramsize >> 2;
+	struct FrvTCache tcache = {
+		.arena = malloc(FRV_TCACHE_SIZE),
+		.buckets = calloc(FRV_TCACHE_BUCKETS, sizeof(struct FrvBlock*)),
+		.code = calloc((codesize + 7) >> 3, sizeof(uint8_t)),
+		.codesize = codesize
+	};
+	if (!tcache.arena || !tcache.buckets || !tcache.code) {
+		fprintf(stderr, "Failed to create a new FrvTCache: %s\n", strerror(errno));
+		frvTCacheDestroy(&tcache);
+	}
+	return tcache;
+}
+
+bool frvIsTCacheValid(const struct FrvTCache* const tcache)
+{
+	return (tcache->arena != NULL && tcache->buckets != NULL && tcache->code != NULL);
+}
+
+void frvTCacheDestroy(struct FrvTCache* tcache)
+{
+	free(tcache->arena);
+	free(tcache->buckets);
+	free(tcache->code);
+	tcache->arena = NULL;
+	tcache->buckets = NULL;
+	tcache->code = NULL;
+}
+
+void frvTCacheFlush(struct FrvTCache* tcache)
+{
+	memset(tcache->buckets, 0, sizeof(struct FrvBlock*) * FRV_TCACHE_BUCKETS);
+	memset(tcache->code, 0, (tcache->codesize + 7) >> 3);
+	tcache->used = 0;
+	tcache->stale = false;
+	tcache->gen++;
+}
+
+struct FrvBlock* frvTCacheAlloc(struct FrvTCache* tcache, const uint64_t pc)
+{
+	if (tcache->used + FRV_BLOCK_BYTES(FRV_BLOCK_MAX_INSTS + 1) > FRV_TCACHE_SIZE)
+		frvTCacheFlush(tcache);
+
+	struct FrvBlock* block = (struct FrvBlock*)(tcache->arena + tcache->used);
+	block->pc = pc;
+	block->ctx = tcache->ctx;
+	block->hnext = NULL;
+	block->next[0] = NULL;
+	block->next[1] = NULL;
+	block->native = NULL;
+	block->hits = 0;
+	block->len = 0;
+	return block;
+}
+
+void frvTCacheCommit(struct FrvTCache* tcache, struct FrvBlock* block)
+{
+	struct FrvBlock** bucket = &tcache->buckets[frvTCacheHash(block->pc)];
+	block->hnext = *bucket;
+	*bucket = block;
+	memset(&block->insts[block->len], 0, sizeof(struct FrvInst));
+	tcache->used += FRV_BLOCK_BYTES(block->len + 1);
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+
+#include "inst.h"
+#include "ram.h"
+
+#define FRV_TCACHE_SIZE (1 << 23) // Bytes of translated blocks before a full flush
+#define FRV_TCACHE_BUCKETS (1 << 14) // Must be a power of 2
+#define FRV_BLOCK_MAX_INSTS 64
+#define FRV_BLOCK_PAGE_SIZE 4096 // Blocks never start an instruction in the next page
+
+/* Straight-line guest code, pre-decoded up to the first branch or jump
+ * There is always room for one more instruction after the last one
+ */
+struct FrvBlock {
+	uint64_t		pc;		// Guest address of the first instruction
+	uint64_t		ctx;		// Fetch translation it was made under (FrvMMU ctx)
+	struct FrvBlock*	hnext;		// Next block in the same hash bucket
+	struct FrvBlock*	next[2];	// Chained successors
+	void*			native;		// Host code from the JIT, NULL while interpreted
+	uint32_t		hits;		// Interpreted runs, to find the hot blocks
+	uint32_t		len;
+	struct FrvInst		insts[];
+};
+
+/* Blocks are bump allocated in one arena and all die together on a flush,
+ * so chained pointers can never dangle.
+ * code has one bit per guest RAM word (physical), set if the word is in a block
+ */
+struct FrvTCache {
+	uint8_t*		arena;
+	uint64_t		used;
+	struct FrvBlock**	buckets;
+	uint8_t*		code;
+	uint64_t		codesize;
+	uint64_t		gen;		// Bumped on every flush
+	uint64_t		ctx;		// Fetch translation of the running code
+	bool			stale;		// A store hit translated code
+};
+
+struct FrvTCache frvNewTCache(const uint64_t ramsize);
+bool frvIsTCacheValid(const struct FrvTCache* const tcache);
+void frvTCacheDestroy(struct FrvTCache* tcache);
+void frvTCacheFlush(struct FrvTCache* tcache);
+struct FrvBlock* frvTCacheAlloc(struct FrvTCache* tcache, const uint64_t pc); // Room for FRV_BLOCK_MAX_INSTS
+void frvTCacheCommit(struct FrvTCache* tcache, struct FrvBlock* block); // Make the filled block visible
+
+static inline uint64_t frvTCacheHash(const uint64_t pc)
+{
+	return (pc >> 1) & (FRV_TCACHE_BUCKETS - 1);
+}
+
+static inline struct FrvBlock* frvTCacheLookup(const struct FrvTCache* const tcache, const uint64_t pc)
+{
+	struct FrvBlock* block = tcache->buckets[frvTCacheHash(pc)];
+	while (block && (block->pc != pc || block->ctx != tcache->ctx)) block = block->hnext;
+	return block;
+}
+
+// Note the physical bytes of an instruction going into a block, before the block is committed
+static inline void frvTCacheMarkCode(struct FrvTCache* tcache, const uint64_t addr, const uint64_t size)
+{
+	for (uint64_t word = (addr - FRV_RAM_BASE_ADDR) >> 2; word <= (addr + size - 1 - FRV_RAM_BASE_ADDR) >> 2; word++)
+		if (word < tcache->codesize) tcache->code[word >> 3] |= (1 << (word & 7));
+}
+
+static inline bool frvTCacheIsCode(const struct FrvTCache* const tcache, const uint64_t addr)
+{
+	const uint64_t word = (addr - FRV_RAM_BASE_ADDR) >> 2;
+	return (word < tcache->codesize) && (tcache->code[word >> 3] & (1 << (word & 7)));
+}
+
+/* Must be called after every store into the guest memory
+ * The flush itself is deferred to the next block boundary
+ */
+static inline void frvTCacheInvalidate(struct FrvTCache* tcache, const uint64_t addr, const uint64_t size)
+{
+	if (frvTCacheIsCode(tcache, addr) || frvTCacheIsCode(tcache, addr + size - 1))
+		tcache->stale = true;
+}
+
+// Remember the successor, the second slot is replaced for indirect jumps
+static inline void frvBlockLink(struct FrvBlock* block, struct FrvBlock* next)
+{
+	if (!block->next[0]) block->next[0] = next;
+	else block->next[1] = next;
+}
+
+// Instructions of the block starting below pc, the ones it ran when it stopped there
+static inline uint32_t frvBlockCount(const struct FrvBlock* const block, const uint64_t pc)
+{
+	uint64_t at = block->pc;
+	uint32_t i = 0;
+	while (i < block->len && at < pc) at += block->insts[i++].len;
+	return i;
+}
+
+static inline struct FrvBlock* frvBlockChained(const struct FrvBlock* const block, const uint64_t pc)
+{
+	if (block->next[0] && block->next[0]->pc == pc) return block->next[0];
+	if (block->next[1] && block->next[1]->pc == pc) return block->next[1];
+	return NULL;
+}
+
+// The same for a bulk write of any length, checks every word of the range
+static inline void frvTCacheInvalidateRange(struct FrvTCache* tcache, const uint64_t addr, const uint64_t len)
+{
+	for (uint64_t off = 0; off < len && !tcache->stale; off += 4)
+		frvTCacheInvalidate(tcache, addr + off, 1);
+	if (len) frvTCacheInvalidate(tcache, addr + len - 1, 1);
+}
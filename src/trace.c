@@ -0,0 +1,138 @@
+#define _DEFAULT_SOURCE // posix_memalign, nanosleep
+
+#include <fcntl.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "trace.h"
+
+struct FrvTrace frvNewTrace(const char* path, const uint64_t nharts)
+{
+	struct FrvTrace trace = { .fd = -1, .nrings = nharts };
+	void* rings = NULL;
+	if (posix_memalign(&rings, 64, nharts * sizeof(struct FrvTraceRing))) {
+		fprintf(stderr, "Failed to create a new FrvTrace: %s\n", strerror(ENOMEM));
+		return trace;
+	}
+	memset(rings, 0, nharts * sizeof(struct FrvTraceRing));
+	trace.rings = rings;
+	for (uint64_t i = 0; i < nharts; i++) {
+		trace.rings[i].hart = i;
+		trace.rings[i].recs = malloc(FRV_TRACE_RING * sizeof(struct FrvTraceRecord));
+		if (!trace.rings[i].recs) {
+			fprintf(stderr, "Failed to create a new FrvTrace: %s\n", strerror(errno));
+			frvTraceDestroy(&trace);
+			return trace;
+		}
+	}
+
+	trace.fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (trace.fd == -1) {
+		fprintf(stderr, "Failed to open the trace %s: %s\n", path, strerror(errno));
+		frvTraceDestroy(&trace);
+		return trace;
+	}
+	struct FrvTraceHeader header = {
+		.magic = FRV_TRACE_MAGIC, .version = FRV_TRACE_VERSION, .recsize = sizeof(struct FrvTraceRecord),
+		.nharts = nharts
+	};
+	if (write(trace.fd, &header, sizeof(header)) != sizeof(header)) {
+		fprintf(stderr, "Failed to write the trace %s: %s\n", path, strerror(errno));
+		frvTraceDestroy(&trace);
+	}
+	return trace;
+}
+
+bool frvIsTraceValid(const struct FrvTrace* const trace)
+{
+	return (trace->rings != NULL && trace->fd != -1);
+}
+
+// Write out the oldest published records of ring, the number taken
+static uint64_t frvTraceDrain(struct FrvTrace* trace, struct FrvTraceRing* ring)
+{
+	const uint64_t published = __atomic_load_n(&ring->published, __ATOMIC_ACQUIRE);
+	const uint64_t tail = ring->tail;
+	const uint64_t first = tail & (FRV_TRACE_RING - 1);
+	uint64_t n = published - tail;
+	if (n > FRV_TRACE_WRITE) n = FRV_TRACE_WRITE;
+	if (n > FRV_TRACE_RING - first) n = FRV_TRACE_RING - first; // Up to the wrap, the rest goes next time
+	if (!n) return 0;
+
+	const uint8_t* p = (const uint8_t*) &ring->recs[first];
+	size_t left = n * sizeof(struct FrvTraceRecord);
+	while (left && !trace->failed) {
+		const ssize_t done = write(trace->fd, p, left);
+		if (done < 0 && errno == EINTR) continue;
+		if (done <= 0) {
+			fprintf(stderr, "Failed to write the trace: %s, the rest is dropped\n", strerror(errno));
+			trace->failed = true;
+			break;
+		}
+		p += done;
+		left -= done;
+	}
+	__atomic_store_n(&ring->tail, tail + n, __ATOMIC_RELEASE); // Even after a failure, the harts must not block
+	return n;
+}
+
+static void* frvTraceWriter(void* arg)
+{
+	struct FrvTrace* trace = arg;
+	const struct timespec idle = { .tv_sec = 0, .tv_nsec = FRV_TRACE_IDLE_NS };
+	while (true) {
+		// Looked at before draining, so the last records published before done are not missed
+		const bool done = __atomic_load_n(&trace->done, __ATOMIC_ACQUIRE);
+		uint64_t moved = 0;
+		for (uint64_t i = 0; i < trace->nrings; i++) moved += frvTraceDrain(trace, &trace->rings[i]);
+		if (moved) continue;
+		if (done) break;
+		nanosleep(&idle, NULL);
+	}
+	return NULL;
+}
+
+bool frvTraceStart(struct FrvTrace* trace)
+{
+	const int err = pthread_create(&trace->writer, NULL, frvTraceWriter, trace);
+	if (err) {
+		fprintf(stderr, "Failed to start the trace writer: %s\n", strerror(err));
+		return false;
+	}
+	trace->started = true;
+	return true;
+}
+
+void frvTraceReserve(struct FrvTraceRing* ring)
+{
+	__atomic_store_n(&ring->published, ring->head, __ATOMIC_RELEASE);
+	if (__atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) + FRV_TRACE_RING < ring->head + FRV_TRACE_BATCH) {
+		ring->waits++;
+		while (__atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) + FRV_TRACE_RING < ring->head + FRV_TRACE_BATCH)
+			sched_yield();
+	}
+	ring->limit = ring->head + FRV_TRACE_BATCH;
+}
+
+void frvTraceDestroy(struct FrvTrace* trace)
+{
+	if (trace->started) {
+		uint64_t records = 0, waits = 0;
+		for (uint64_t i = 0; i < trace->nrings; i++) {
+			__atomic_store_n(&trace->rings[i].published, trace->rings[i].head, __ATOMIC_RELEASE);
+			records += trace->rings[i].head;
+			waits += trace->rings[i].waits;
+		}
+		__atomic_store_n(&trace->done, true, __ATOMIC_RELEASE);
+		pthread_join(trace->writer, NULL);
+		trace->started = false;
+		if (waits) fprintf(stderr, "Traced %lu instructions, the harts waited %lu times for the writer\n",
+				   records, waits);
+	}
+	if (trace->fd != -1) close(trace->fd);
+	for (uint64_t i = 0; trace->rings && i < trace->nrings; i++) free(trace->rings[i].recs);
+	free(trace->rings);
+	trace->rings = NULL;
+	trace->fd = -1;
+}
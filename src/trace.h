@@ -0,0 +1,83 @@
+#pragma once
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+#define FRV_TRACE_MAGIC "FRVTRACE"
+#define FRV_TRACE_VERSION (1)
+#define FRV_TRACE_RING (1 << 18) // Records per hart, a power of two
+#define FRV_TRACE_BATCH (1 << 10) // Records a hart fills before it hands them to the writer
+#define FRV_TRACE_WRITE (1 << 16) // Most records moved by one write
+#define FRV_TRACE_IDLE_NS (200 * 1000) // Writer sleep while every ring is empty
+
+// What a record holds beside pc and raw
+enum FrvTraceFlags {
+	FRV_TRACE_XREG = 1 << 0, // val is x[rd] after the instruction
+	FRV_TRACE_FREG = 1 << 1, // val is f[rd] after the instruction
+	FRV_TRACE_MEM = 1 << 2, // addr is the virtual address accessed (the base of vector accesses)
+	FRV_TRACE_TRAP = 1 << 3 // The instruction raised an exception, nothing else in the record is valid
+};
+
+// One retired (or trapped) instruction, the file is the header followed by these in host endian
+struct FrvTraceRecord {
+	uint64_t	pc;
+	uint64_t	val;
+	uint64_t	addr;
+	uint32_t	raw; // The 32-bit form, compressed ones are expanded
+	uint8_t		rd;
+	uint8_t		hart;
+	uint8_t		flags; // enum FrvTraceFlags
+	uint8_t		len; // Bytes of the instruction in memory, 2 or 4
+};
+
+struct FrvTraceHeader {
+	char		magic[8];
+	uint32_t	version;
+	uint32_t	recsize; // sizeof(struct FrvTraceRecord)
+	uint64_t	nharts;
+};
+
+/* Single producer, single consumer ring of one hart
+ * The hart publishes a batch at a time and only looks at tail when it runs out of reserved space
+ */
+struct FrvTraceRing {
+	struct FrvTraceRecord*	recs;
+	uint64_t		head; // Next record of the hart, only the hart touches it
+	uint64_t		limit; // head may grow up to here before the hart reserves again
+	uint64_t		waits; // Times the hart found the ring full
+	uint8_t			hart;
+	uint64_t		published __attribute__((aligned(64))); // Records the writer may take
+	uint64_t		tail __attribute__((aligned(64))); // Records the writer is done with
+};
+
+/* The rings of every hart and the thread writing them out, only built with FRV_TRACE
+ * Records of one hart stay in order in the file, the harts are interleaved a batch at a time
+ */
+struct FrvTrace {
+	struct FrvTraceRing*	rings;
+	uint64_t		nrings;
+	int			fd;
+	pthread_t		writer;
+	bool			started;
+	bool			done; // Set once the harts have stopped, the writer drains everything and leaves
+	bool			failed; // A write failed, the rest of the trace is dropped
+};
+
+struct FrvTrace frvNewTrace(const char* path, const uint64_t nharts);
+bool frvIsTraceValid(const struct FrvTrace* const trace);
+bool frvTraceStart(struct FrvTrace* trace); // Start the writer, trace must not move after this
+// Publish what the harts left, wait for the writer and close the file, the harts must have stopped
+void frvTraceDestroy(struct FrvTrace* trace);
+void frvTraceReserve(struct FrvTraceRing* ring); // Publish the batch and wait for room for the next one
+
+// The slot for the next record, filled in place
+static inline struct FrvTraceRecord* frvTraceNext(struct FrvTraceRing* ring)
+{
+	if (ring->head == ring->limit) frvTraceReserve(ring);
+	return &ring->recs[ring->head++ & (FRV_TRACE_RING - 1)];
+}
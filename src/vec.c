@@ -0,0 +1,206 @@
+#include <string.h>
+
+#include "vec.h"
+
+_Static_assert(FRV_VLEN == 256, "the lane tables below are written out for 32-byte registers");
+
+/* A vector register is one GCC generic vector, every instruction runs as a loop over the registers
+ * of its group with the operation picked once outside of it. On x86-64 the kernels are built twice,
+ * for AVX2 and the SSE2 baseline, and the loader picks one. Elsewhere GCC lowers them to what the host has
+ * The vectors are only ever moved with memcpy: the registers live in a calloc'ed FrvCPU and are not aligned,
+ * and the helpers are macros since passing 32-byte vectors around warns about the ABI without AVX
+ */
+#ifdef __x86_64__
+#define FRV_VEC_TARGETS __attribute__((target_clones("avx2", "default")))
+#else
+#define FRV_VEC_TARGETS
+#endif
+
+typedef uint8_t FrvVecU8 __attribute__((vector_size(FRV_VLENB)));
+typedef uint16_t FrvVecU16 __attribute__((vector_size(FRV_VLENB)));
+typedef uint32_t FrvVecU32 __attribute__((vector_size(FRV_VLENB)));
+typedef uint64_t FrvVecU64 __attribute__((vector_size(FRV_VLENB)));
+typedef int8_t FrvVecS8 __attribute__((vector_size(FRV_VLENB)));
+typedef int16_t FrvVecS16 __attribute__((vector_size(FRV_VLENB)));
+typedef int32_t FrvVecS32 __attribute__((vector_size(FRV_VLENB)));
+typedef int64_t FrvVecS64 __attribute__((vector_size(FRV_VLENB)));
+
+// Lane numbers
+static const FrvVecU8 frvVecIota8 = {
+	0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+	16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31
+};
+static const FrvVecU16 frvVecIota16 = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 };
+static const FrvVecU32 frvVecIota32 = { 0, 1, 2, 3, 4, 5, 6, 7 };
+static const FrvVecU64 frvVecIota64 = { 0, 1, 2, 3 };
+
+// The mask bit of each lane, the byte lanes first pick the byte of the mask that holds it
+static const FrvVecU8 frvVecByte8 = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+	2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3
+};
+static const FrvVecU8 frvVecBit8 = {
+	1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128,
+	1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128
+};
+static const FrvVecU16 frvVecBit16 = {
+	1 << 0, 1 << 1, 1 << 2, 1 << 3, 1 << 4, 1 << 5, 1 << 6, 1 << 7,
+	1 << 8, 1 << 9, 1 << 10, 1 << 11, 1 << 12, 1 << 13, 1 << 14, 1 << 15
+};
+static const FrvVecU32 frvVecBit32 = { 1, 2, 4, 8, 16, 32, 64, 128 };
+static const FrvVecU64 frvVecBit64 = { 1, 2, 4, 8 };
+
+// The v0 bits of the lanes from first on, a register has at most 32 lanes and they never straddle a word
+static inline uint32_t frvVecMaskBits(const uint8_t* v0, const uint32_t first, const uint32_t lanes)
+{
+	uint64_t word;
+	memcpy(&word, v0 + (first >> 6) * sizeof(word), sizeof(word));
+	return (uint32_t)(word >> (first & 63)) & (uint32_t)((1ull << lanes) - 1);
+}
+
+// Mask bits to lanes of all ones
+#define FRV_VEC_BITS8(bits)	((FrvVecU8)((__builtin_shuffle((FrvVecU8)((FrvVecU32){ 0 } + (bits)), \
+						frvVecByte8) & frvVecBit8) != 0))
+#define FRV_VEC_BITS16(bits)	((FrvVecU16)((((FrvVecU16){ 0 } + (uint16_t)(bits)) & frvVecBit16) != 0))
+#define FRV_VEC_BITS32(bits)	((FrvVecU32)((((FrvVecU32){ 0 } + (uint32_t)(bits)) & frvVecBit32) != 0))
+#define FRV_VEC_BITS64(bits)	((FrvVecU64)((((FrvVecU64){ 0 } + (uint64_t)(bits)) & frvVecBit64) != 0))
+
+#define FRV_VEC_SEL(c, p, q)	(((V)(c) & (p)) | (~(V)(c) & (q)))
+
+/* m = the lanes of register r of the group that take part, the ones in [vstart, vl) that are set in mask
+ * (NULL for all of them). Needs a, V, E and lanes
+ */
+#define FRV_VEC_ACTIVE(n, m, r, mask) do {								\
+	const uint32_t first_ = (r) * lanes;								\
+	const E lo_ = (a->vstart > first_) ? a->vstart - first_ : 0;					\
+	const E hi_ = (a->vl - first_ < lanes) ? a->vl - first_ : lanes;				\
+	m = (V)((frvVecIota##n >= lo_) & (frvVecIota##n < hi_));					\
+	if (mask) m &= FRV_VEC_BITS##n(frvVecMaskBits((mask), first_, lanes));				\
+} while (0)
+
+/* Every register of the group with an active lane, res = expr of x (vs2), y (vs1 or the scalar) and d (vd)
+ * only lands in the active lanes
+ */
+#define FRV_VEC_LOOP(n, expr, mask)									\
+	for (uint32_t r = a->vstart / lanes; r * lanes < a->vl; r++) {					\
+		V x, y = s, d, m, res;									\
+		memcpy(&x, a->vs2 + r * FRV_VLENB, FRV_VLENB);						\
+		if (a->vs1) memcpy(&y, a->vs1 + r * FRV_VLENB, FRV_VLENB);				\
+		memcpy(&d, a->vd + r * FRV_VLENB, FRV_VLENB);						\
+		FRV_VEC_ACTIVE(n, m, r, mask);								\
+		res = (expr);										\
+		res = FRV_VEC_SEL(m, res, d);								\
+		memcpy(a->vd + r * FRV_VLENB, &res, FRV_VLENB);						\
+	}
+
+/* acc = expr of x (acc) and y over the active vs2 elements, the inactive ones are the identity id
+ * Then the lanes are folded in halves, rotating them through buf, until lane 0 holds the result
+ */
+#define FRV_VEC_FOLD(n, expr)										\
+	for (uint32_t r = 0; r * lanes < a->vl; r++) {							\
+		V x = acc, y, m;									\
+		memcpy(&y, a->vs2 + r * FRV_VLENB, FRV_VLENB);						\
+		FRV_VEC_ACTIVE(n, m, r, a->mask);							\
+		y = FRV_VEC_SEL(m, y, id);								\
+		acc = (expr);										\
+	}												\
+	for (uint32_t half = lanes / 2; half; half /= 2) {						\
+		E buf[2 * FRV_VLENB / sizeof(E)];							\
+		V x = acc, y;										\
+		memcpy(buf, &acc, FRV_VLENB);								\
+		memcpy(buf + lanes, &acc, FRV_VLENB);							\
+		memcpy(&y, buf + half, FRV_VLENB);							\
+		acc = (expr);										\
+	}
+
+// The kernels of one element width, T is its type
+#define FRV_VEC_KERNELS(n, T)									\
+FRV_VEC_TARGETS static void frvVecArith##n(const uint8_t op, const struct FrvVecArgs* a)		\
+{													\
+	typedef T E;											\
+	typedef FrvVecU##n V;										\
+	typedef FrvVecS##n SV;										\
+	const uint32_t lanes = FRV_VLENB / sizeof(T);							\
+	const T shmask = 8 * sizeof(T) - 1;								\
+	const V s = (V){ 0 } + (T)a->scalar;								\
+	switch (op) {											\
+	case FRV_OP_VADD:	FRV_VEC_LOOP(n, x + y, a->mask); break;					\
+	case FRV_OP_VSUB:	FRV_VEC_LOOP(n, x - y, a->mask); break;					\
+	case FRV_OP_VRSUB:	FRV_VEC_LOOP(n, y - x, a->mask); break;					\
+	case FRV_OP_VMINU:	FRV_VEC_LOOP(n, FRV_VEC_SEL(x < y, x, y), a->mask); break;		\
+	case FRV_OP_VMIN:	FRV_VEC_LOOP(n, FRV_VEC_SEL((SV)x < (SV)y, x, y), a->mask); break;	\
+	case FRV_OP_VMAXU:	FRV_VEC_LOOP(n, FRV_VEC_SEL(x > y, x, y), a->mask); break;		\
+	case FRV_OP_VMAX:	FRV_VEC_LOOP(n, FRV_VEC_SEL((SV)x > (SV)y, x, y), a->mask); break;	\
+	case FRV_OP_VAND:	FRV_VEC_LOOP(n, x & y, a->mask); break;					\
+	case FRV_OP_VOR:	FRV_VEC_LOOP(n, x | y, a->mask); break;					\
+	case FRV_OP_VXOR:	FRV_VEC_LOOP(n, x ^ y, a->mask); break;					\
+	case FRV_OP_VSLL:	FRV_VEC_LOOP(n, x << (y & shmask), a->mask); break;			\
+	case FRV_OP_VSRL:	FRV_VEC_LOOP(n, x >> (y & shmask), a->mask); break;			\
+	case FRV_OP_VSRA:	FRV_VEC_LOOP(n, (V)((SV)x >> (SV)(y & shmask)), a->mask); break;	\
+	case FRV_OP_VMUL:	FRV_VEC_LOOP(n, x * y, a->mask); break;					\
+	case FRV_OP_VMACC:	FRV_VEC_LOOP(n, x * y + d, a->mask); break;				\
+	case FRV_OP_VLE:										\
+	case FRV_OP_VLSE:	FRV_VEC_LOOP(n, x, a->mask); break;					\
+	case FRV_OP_VMERGE: /* v0 picks the source, every body element is written */			\
+		if (!a->mask) FRV_VEC_LOOP(n, y, NULL)							\
+		else FRV_VEC_LOOP(n, FRV_VEC_SEL(FRV_VEC_BITS##n(frvVecMaskBits(a->mask, r * lanes, lanes)), \
+						 y, x), NULL)						\
+		break;											\
+	}												\
+}													\
+													\
+FRV_VEC_TARGETS static void frvVecReduce##n(const uint8_t op, const struct FrvVecArgs* a)		\
+{													\
+	typedef T E;											\
+	typedef FrvVecU##n V;										\
+	typedef FrvVecS##n SV;										\
+	const uint32_t lanes = FRV_VLENB / sizeof(T);							\
+	const T smax = (T)~(T)0 >> 1;									\
+	T e = 0;											\
+	switch (op) {											\
+	case FRV_OP_VREDAND:										\
+	case FRV_OP_VREDMINU:	e = (T)~(T)0; break;							\
+	case FRV_OP_VREDMIN:	e = smax; break;							\
+	case FRV_OP_VREDMAX:	e = (T)~smax; break;							\
+	}												\
+	const V id = (V){ 0 } + e, first = (V)(frvVecIota##n == 0);					\
+	V acc;												\
+	memcpy(&acc, a->vs1, FRV_VLENB);								\
+	acc = FRV_VEC_SEL(first, acc, id);								\
+	switch (op) {											\
+	case FRV_OP_VREDSUM:	FRV_VEC_FOLD(n, x + y); break;						\
+	case FRV_OP_VREDAND:	FRV_VEC_FOLD(n, x & y); break;						\
+	case FRV_OP_VREDOR:	FRV_VEC_FOLD(n, x | y); break;						\
+	case FRV_OP_VREDXOR:	FRV_VEC_FOLD(n, x ^ y); break;						\
+	case FRV_OP_VREDMINU:	FRV_VEC_FOLD(n, FRV_VEC_SEL(x < y, x, y)); break;			\
+	case FRV_OP_VREDMIN:	FRV_VEC_FOLD(n, FRV_VEC_SEL((SV)x < (SV)y, x, y)); break;		\
+	case FRV_OP_VREDMAXU:	FRV_VEC_FOLD(n, FRV_VEC_SEL(x > y, x, y)); break;			\
+	case FRV_OP_VREDMAX:	FRV_VEC_FOLD(n, FRV_VEC_SEL((SV)x > (SV)y, x, y)); break;		\
+	}												\
+	memcpy(a->vd, &acc, sizeof(T));									\
+}
+
+FRV_VEC_KERNELS(8, uint8_t)
+FRV_VEC_KERNELS(16, uint16_t)
+FRV_VEC_KERNELS(32, uint32_t)
+FRV_VEC_KERNELS(64, uint64_t)
+
+void frvVecArith(const uint8_t op, const struct FrvVecArgs* a)
+{
+	switch (a->sew) {
+	case 0:	frvVecArith8(op, a); break;
+	case 1:	frvVecArith16(op, a); break;
+	case 2:	frvVecArith32(op, a); break;
+	default: frvVecArith64(op, a); break;
+	}
+}
+
+void frvVecReduce(const uint8_t op, const struct FrvVecArgs* a)
+{
+	switch (a->sew) {
+	case 0:	frvVecReduce8(op, a); break;
+	case 1:	frvVecReduce16(op, a); break;
+	case 2:	frvVecReduce32(op, a); break;
+	default: frvVecReduce64(op, a); break;
+	}
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "inst.h"
+
+// The vector unit: VLEN 256, ELEN 64, one host vector per vector register
+#define FRV_NUM_VREGS		(32)
+#define FRV_VLEN		(256)
+#define FRV_VLENB		(FRV_VLEN / 8)
+#define FRV_VEC_GROUP_MAX	(8 * FRV_VLENB) // Bytes of the largest register group, LMUL 8
+
+// vtype, vsew and vlmul are log2 of the element bytes and of LMUL (fractional ones negative, 4 is reserved)
+#define FRV_VTYPE_VLMUL		(0x7)
+#define FRV_VTYPE_VSEW_SHIFT	(3)
+#define FRV_VTYPE_VSEW		(0x7 << FRV_VTYPE_VSEW_SHIFT)
+#define FRV_VTYPE_VTA		(1 << 6)
+#define FRV_VTYPE_VMA		(1 << 7)
+#define FRV_VTYPE_VILL		(1ull << 63)
+#define FRV_VTYPE_MASK		(0xff) // The bits vsetvl takes, anything above is vill
+
+// vcsr: the fixed-point saturation flag and rounding mode above it, vxsat and vxrm are views
+#define FRV_VCSR_VXSAT		(1u << 0)
+#define FRV_VCSR_VXRM_SHIFT	(1)
+#define FRV_VCSR_MASK		(0x7)
+
+/* One vector instruction as the kernels see it, cpu.c checked the encoding
+ * and resolved vtype, vl, vstart and the register groups
+ */
+struct FrvVecArgs {
+	uint8_t*	vd; // The register groups
+	const uint8_t*	vs2;
+	const uint8_t*	vs1; // NULL for the .vx and .vi forms, which use scalar
+	const uint8_t*	mask; // v0, NULL when unmasked
+	uint64_t	scalar; // x[rs1] or the immediate
+	uint32_t	sew; // log2 of the element bytes
+	uint32_t	vstart;
+	uint32_t	vl;
+};
+
+/* Tail and masked-off elements are left undisturbed, which vta and vma both allow
+ * The element-wise ops: vadd to vmacc and vmerge/vmv.v, the loads merge what they read (vs2) the same way
+ */
+void frvVecArith(const uint8_t op, const struct FrvVecArgs* a);
+void frvVecReduce(const uint8_t op, const struct FrvVecArgs* a); // vd[0] = vs1[0] op the active vs2 elements
@@ -0,0 +1,105 @@
+# RV64IM edge cases, run once interpreted and then hot enough for the JIT, every run must agree
+	.macro OP2 insn, a, b	# Store insn a, b to the next slot of out
+	li t1, \a
+	li t2, \b
+	\insn t3, t1, t2
+	sd t3, 0(a2)
+	addi a2, a2, 8
+	.endm
+	.macro OPI insn, a, imm
+	li t1, \a
+	\insn t3, t1, \imm
+	sd t3, 0(a2)
+	addi a2, a2, 8
+	.endm
+
+	.text
+	.globl _start
+_start:
+	la a2, first
+	call ops
+	la s0, first		# Print the first run
+	sub s1, a2, s0
+	srli s1, s1, 3
+	mv s2, s1
+1:	li a0, 3
+	ld a1, 0(s0)
+	ecall
+	li a0, 2
+	li a1, 10
+	ecall
+	addi s0, s0, 8
+	addi s2, s2, -1
+	bnez s2, 1b
+
+	li s3, 1000		# Count the slots that differ in later runs
+	li s4, 0
+2:	la a2, again
+	call ops
+	la t4, first
+	la t5, again
+	mv s2, s1
+3:	ld t1, 0(t4)
+	ld t2, 0(t5)
+	xor t1, t1, t2
+	snez t1, t1
+	add s4, s4, t1
+	addi t4, t4, 8
+	addi t5, t5, 8
+	addi s2, s2, -1
+	bnez s2, 3b
+	addi s3, s3, -1
+	bnez s3, 2b
+	li a0, 0
+	mv a1, s4
+	ecall
+	li a0, 2
+	li a1, 10
+	ecall
+	li a0, 7
+	ecall
+
+ops:
+	OP2 div, -7, 2
+	OP2 rem, -7, 2
+	OP2 div, 7, 0		# -1
+	OP2 rem, 7, 0		# The dividend
+	OP2 divu, 7, 0
+	OP2 remu, 7, 0
+	OP2 div, 0x8000000000000000, -1 # Overflow, the dividend and 0
+	OP2 rem, 0x8000000000000000, -1
+	OP2 divw, 0x80000000, -1
+	OP2 remw, 0x80000000, -1
+	OP2 divuw, -7, 2
+	OP2 remuw, -7, 2
+	OP2 divw, 7, 0
+	OP2 divw, 7, 0x100000000 # Only the low word is the divisor
+	OP2 remuw, -7, 0x100000000
+	OP2 mul, 0x123456789, 0x987654321
+	OP2 mulh, -3, 0x7fffffffffffffff
+	OP2 mulhu, -3, 0x7fffffffffffffff
+	OP2 mulhsu, -3, 0x7fffffffffffffff
+	OP2 mulw, 0x10000, 0x18000 # Wraps to negative
+	OP2 sll, 1, 67		# Shift amounts mod 64
+	OP2 srl, -1, 68
+	OP2 sra, -256, 68
+	OP2 sllw, 1, 31
+	OP2 srlw, -1, 36	# Mod 32, from the low word
+	OP2 sraw, 0x80000000, 4
+	OP2 addw, 0x7fffffff, 1
+	OP2 subw, 0, 0x80000000
+	OP2 slt, -1, 1
+	OP2 sltu, -1, 1
+	OPI sltiu, 0, 1		# seqz
+	OPI sltiu, 5, -1	# The immediate is sign extended, then compared unsigned
+	OPI srai, -17, 63
+	OPI sraiw, 0x80000000, 31
+	OPI slliw, 3, 31
+	OPI addiw, 0x7fffffff, 1
+	OPI xori, 0x0f0f, -1
+	ret
+
+	.data
+	.balign 8
+first:	.zero 8 * 64
+again:	.zero 8 * 64
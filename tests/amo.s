@@ -0,0 +1,59 @@
+# The results of each AMO, LR/SC pairs and sc without a reservation
+	.macro PRINT code, reg
+	li a0, \code
+	mv a1, \reg
+	ecall
+	li a0, 2
+	li a1, 10
+	ecall
+	.endm
+
+	.text
+	.globl _start
+_start:
+	la s0, w
+	li t1, -5
+	amomin.w t2, t1, (s0)	# Old 3, w = -5
+	PRINT 0, t2
+	li t1, 2
+	amomaxu.w t2, t1, (s0)	# Old -5 sign extended, unsigned it stays
+	PRINT 3, t2
+	lwu t2, 0(s0)
+	PRINT 3, t2
+	li t1, 7
+	amomax.w t2, t1, (s0)	# w = 7
+	amoxor.w t2, t1, (s0)	# w = 0
+	lw t2, 0(s0)
+	PRINT 0, t2
+	li t1, 9
+	amoswap.w t2, t1, (s0)
+	amoadd.w t2, t1, (s0)	# w = 18
+	lw t2, 0(s0)
+	PRINT 0, t2
+
+	la s1, d
+	li t1, -1
+	amominu.d t2, t1, (s1)	# Old 10, stays 10
+	amomaxu.d t2, t1, (s1)	# d = -1
+	amoand.d t2, zero, (s1)	# Old -1, d = 0
+	PRINT 0, t2
+	li t1, 0x55
+	amoor.d t2, t1, (s1)
+	ld t2, 0(s1)
+	PRINT 3, t2
+
+	lr.d t2, (s1)		# Reserved, sc succeeds
+	addi t2, t2, 1
+	sc.d t3, t2, (s1)
+	PRINT 0, t3
+	ld t2, 0(s1)
+	PRINT 3, t2
+	sc.d t3, t2, (s1)	# Without a reservation it fails
+	PRINT 0, t3
+	li a0, 7
+	ecall
+
+	.data
+	.balign 8
+d:	.dword 10
+w:	.word 3
@@ -0,0 +1,34 @@
+# Six copies through --batch on two workers, each one must find a fresh machine: data, RAM and CSRs
+# Then a guest that traps and one that does not load, either fails the batch
+# run: for i in 1 2 3 4 5 6; do cp $ELF job$i.elf && echo job$i.elf; done > jobs && $FRV --batch jobs --jobs 2 32 && printf '\0\0\0\0' > trap.bin && printf 'job1.elf\ntrap.bin\nmissing.elf\n' > bad && $FRV --batch bad --jobs 2 32
+	.text
+	.globl _start
+_start:
+	la t0, count		# 1 every time, the image is loaded again
+	ld t1, 0(t0)
+	addi t1, t1, 1
+	sd t1, 0(t0)
+	call print
+	li t0, 0x80800000	# Beyond the image, zero again
+	ld t1, 0(t0)
+	li t2, 0xdead
+	sd t2, 0(t0)
+	call print
+	csrr t1, mscratch
+	csrwi mscratch, 5
+	call print
+	li a0, 7
+	ecall
+
+print:
+	li a0, 3
+	mv a1, t1
+	ecall
+	li a0, 2
+	li a1, 10
+	ecall
+	ret
+
+	.data
+	.balign 8
+count:	.dword 0
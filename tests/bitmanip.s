@@ -0,0 +1,109 @@
+# Zba, Zbb and Zbs: every instruction once, on values where the 32-bit forms and the edges matter
+	.macro PRINT reg
+	li a0, 3
+	mv a1, \reg
+	ecall
+	li a0, 2
+	li a1, 10
+	ecall
+	.endm
+
+	.text
+	.globl _start
+_start:
+	li s0, 0x8000000180000003
+	li s1, 0x00ff00ff0000f0f0
+	li s2, 5
+	li s3, -2
+
+	# Zba
+	add.uw t1, s0, s2	# Only the low word of s0
+	PRINT t1
+	sh1add t1, s2, s1
+	PRINT t1
+	sh2add t1, s2, s1
+	PRINT t1
+	sh3add t1, s2, s1
+	PRINT t1
+	sh1add.uw t1, s0, s2
+	PRINT t1
+	sh2add.uw t1, s3, zero
+	PRINT t1
+	sh3add.uw t1, s0, zero
+	PRINT t1
+	slli.uw t1, s3, 4
+	PRINT t1
+
+	# Zbb logic, counts and extensions
+	andn t1, s0, s1
+	PRINT t1
+	orn t1, zero, s1
+	PRINT t1
+	xnor t1, s0, s1
+	PRINT t1
+	clz t1, s1
+	PRINT t1
+	clz t1, zero
+	PRINT t1
+	clzw t1, s1
+	PRINT t1
+	ctz t1, s1
+	PRINT t1
+	ctzw t1, zero
+	PRINT t1
+	cpop t1, s0
+	PRINT t1
+	cpopw t1, s3
+	PRINT t1
+	max t1, s0, s2
+	PRINT t1
+	maxu t1, s0, s2
+	PRINT t1
+	min t1, s3, s2
+	PRINT t1
+	minu t1, s3, s2
+	PRINT t1
+	sext.b t1, s0
+	PRINT t1
+	sext.h t1, s1
+	PRINT t1
+	zext.h t1, s3
+	PRINT t1
+
+	# Zbb rotates and byte ops
+	rol t1, s0, s2
+	PRINT t1
+	ror t1, s0, s2
+	PRINT t1
+	rori t1, s0, 63
+	PRINT t1
+	rolw t1, s0, s2		# Sign extended from bit 31
+	PRINT t1
+	rorw t1, s0, s2
+	PRINT t1
+	roriw t1, s0, 1
+	PRINT t1
+	orc.b t1, s0
+	PRINT t1
+	rev8 t1, s0
+	PRINT t1
+
+	# Zbs, the shift amount is taken mod 64
+	bset t1, zero, s2
+	PRINT t1
+	bseti t1, zero, 63
+	PRINT t1
+	bclr t1, s0, zero
+	PRINT t1
+	bclri t1, s0, 63
+	PRINT t1
+	binv t1, s1, s3		# Bit 62
+	PRINT t1
+	binvi t1, s1, 4
+	PRINT t1
+	bext t1, s0, s2
+	PRINT t1
+	bexti t1, s0, 31
+	PRINT t1
+	li a0, 7
+	ecall
@@ -0,0 +1,65 @@
+# The console ecalls: a number, chars, a line cut to its buffer, a line ending at EOF, a string across a page
+# run: printf '42\nhello world\nxyz' | $FRV $ELF
+	.text
+	.globl _start
+_start:
+	li a0, 4		# 42
+	ecall
+	mv s0, a1
+	li a0, 6		# The newline behind it
+	ecall
+	mv s1, a1
+	li a0, 5		# "hello", the rest of the line is dropped
+	la a1, line
+	li a2, 6
+	ecall
+	li a0, 5		# "xyz" without a newline
+	la a1, line2
+	li a2, 64
+	ecall
+	li a0, 6		# EOF
+	ecall
+	mv s2, a1
+
+	li a0, 0
+	mv a1, s0
+	ecall
+	li a0, 2
+	li a1, ' '
+	ecall
+	li a0, 0
+	mv a1, s1
+	ecall
+	li a0, 2
+	li a1, ' '
+	ecall
+	li a0, 0
+	mv a1, s2
+	ecall
+	li a0, 2
+	li a1, '\n'
+	ecall
+	li a0, 1
+	la a1, line
+	ecall
+	li a0, 2
+	li a1, '|'
+	ecall
+	li a0, 1
+	la a1, line2
+	ecall
+	li a0, 2
+	li a1, '\n'
+	ecall
+	li a0, 1
+	la a1, crossing
+	ecall
+	li a0, 7
+	ecall
+
+	.data
+line:	.zero 64
+line2:	.zero 64
+	.balign 4096
+	.zero 4090
+crossing:	.asciz "across the page\n"
@@ -0,0 +1,97 @@
+# CSR access rules, the M-mode handler prints "<mcause> <mtval>" for each access that traps
+	.option norvc
+	.text
+	.globl _start
+_start:
+	la t0, mhandler
+	csrw mtvec, t0
+	csrr t1, 0x7c0		# Custom, not implemented
+	csrw 0xf11, zero	# mvendorid is not implemented either
+	csrw mhartid, zero	# Read-only
+	csrr t1, mhartid
+	call printhex
+
+	# Scratch round trip and sstatus as a view of mstatus
+	li t1, 0x1234
+	csrw mscratch, t1
+	csrr t1, mscratch
+	call printhex
+	csrw sstatus, 0x2	# SIE
+	csrr t1, mstatus
+	andi t1, t1, 0x2
+	call printhex
+	csrw sstatus, zero
+
+	# fcsr only while mstatus.FS is on
+	li t1, 0x6000
+	csrc mstatus, t1
+	frcsr t1
+	li t1, 0x2000
+	csrs mstatus, t1
+	li t1, 3		# RUP
+	fsrm t1
+	frrm t1
+	call printhex
+
+	# cycle from U-mode needs both mcounteren and scounteren, from S-mode only mcounteren
+	la t0, user
+	li t2, 0
+	call lower
+user:	rdcycle t1
+	csrwi mcounteren, 0x1
+	la t0, user2
+	li t2, 0
+	call lower
+user2:	rdcycle t1
+	csrwi scounteren, 0x1
+	la t0, user3
+	li t2, 0
+	call lower
+user3:	rdcycle t1
+	ecall			# Done in U-mode
+	csrwi scounteren, 0
+	la t0, super
+	li t2, 0x800
+	call lower
+super:	rdcycle t1
+	ecall
+	li a0, 7
+	ecall
+
+# mret to t0 in the mode of MPP = t2
+lower:
+	csrw mepc, t0
+	li t0, 0x1800
+	csrc mstatus, t0
+	csrs mstatus, t2
+	mret
+
+printhex:
+	li a0, 3
+	mv a1, t1
+	ecall
+	li a0, 2
+	li a1, 10
+	ecall
+	ret
+
+	.align 2
+mhandler:
+	li a0, 3
+	csrr a1, mcause
+	ecall
+	li a0, 2
+	li a1, 32
+	ecall
+	li a0, 3
+	csrr a1, mtval
+	ecall
+	li a0, 2
+	li a1, 10
+	ecall
+	csrr t0, mepc
+	addi t0, t0, 4
+	csrw mepc, t0
+	li t0, 0x1800		# Back to M-mode, whatever mode trapped
+	csrs mstatus, t0
+	mret
@@ -0,0 +1,38 @@
+# ELF segments mapped copy-on-write and copied with --malloc-ram: .bss zeroed, stores never reach the file
+# run: cp $ELF elf.elf && $FRV elf.elf && cmp elf.elf $ELF && $FRV --malloc-ram elf.elf
+	.text
+	.globl _start
+_start:
+	la s0, value
+	ld t1, 0(s0)
+	addi t1, t1, 1
+	sd t1, 0(s0)
+	la s1, bss		# Zero past the end of the file
+	ld t2, 0(s1)
+	li t0, -1
+	sd t0, 0(s1)
+	la t0, _start		# Code pages are written through too
+	sw zero, 0(t0)
+	li a0, 0
+	ld a1, 0(s0)
+	ecall
+	li a0, 2
+	li a1, ' '
+	ecall
+	li a0, 0
+	mv a1, t2
+	ecall
+	li a0, 2
+	li a1, '\n'
+	ecall
+	li a0, 7
+	ecall
+
+	.data
+	.balign 8
+value:	.dword 41
+
+	.bss
+	.balign 8
+	.zero 8192
+bss:	.zero 8
@@ -0,0 +1,166 @@
+# F and D: results as bits, NaN boxing and canonical NaNs, rounding modes, conversions and fflags
+	.macro PRINT reg
+	li a0, 3
+	mv a1, \reg
+	ecall
+	li a0, 2
+	li a1, 10
+	ecall
+	.endm
+	.macro FLAGS		# Print fflags and clear them
+	frflags t6
+	PRINT t6
+	fsflags zero
+	.endm
+	.macro LD freg, bits
+	li t0, \bits
+	fmv.d.x \freg, t0
+	.endm
+
+	.text
+	.globl _start
+_start:
+	li t0, 0x2000		# FS
+	csrs mstatus, t0
+	LD fs0, 0x3ff0000000000000 # 1.0
+	LD fs1, 0x4008000000000000 # 3.0
+	LD fs2, 0x4004000000000000 # 2.5
+	LD fs3, 0xc004000000000000 # -2.5
+
+	# Double arithmetic, 1/3 is inexact
+	fdiv.d ft0, fs0, fs1
+	fmv.x.d t1, ft0
+	PRINT t1
+	FLAGS
+	fmadd.d ft1, ft0, fs1, fs0 # 1/3 * 3 + 1 fused
+	fmv.x.d t1, ft1
+	PRINT t1
+	fsqrt.d ft1, fs1
+	fmv.x.d t1, ft1
+	PRINT t1
+	FLAGS
+	fnmsub.d ft1, fs2, fs1, fs0 # -(2.5 * 3) + 1
+	fmv.x.d t1, ft1
+	PRINT t1
+
+	# Singles are NaN boxed, an unboxed input reads as the canonical NaN
+	li t0, 0x40400000	# 3.0f
+	fmv.w.x ft2, t0
+	fmv.x.d t1, ft2
+	PRINT t1
+	fcvt.s.d ft3, fs2
+	fmul.s ft3, ft3, ft2	# 7.5f
+	fmv.x.w t1, ft3
+	PRINT t1
+	fadd.s ft3, fs0, ft2	# fs0 holds a double
+	fmv.x.w t1, ft3
+	PRINT t1
+	FLAGS
+
+	# Invalid operations give the canonical NaN and NV, a divide by zero DZ
+	fmv.d.x ft4, zero
+	fdiv.d ft5, ft4, ft4
+	fmv.x.d t1, ft5
+	PRINT t1
+	FLAGS
+	fdiv.d ft5, fs0, ft4
+	fmv.x.d t1, ft5
+	PRINT t1
+	FLAGS
+
+	# Comparisons with a NaN, only flt signals
+	fdiv.d ft5, ft4, ft4
+	fsflags zero
+	feq.d t1, ft5, ft5
+	PRINT t1
+	FLAGS
+	flt.d t1, ft5, fs0
+	PRINT t1
+	FLAGS
+	fmin.d ft6, ft5, fs1	# The number wins over the NaN
+	fmv.x.d t1, ft6
+	PRINT t1
+	fneg.d ft7, ft4
+	fmin.d ft6, ft4, ft7	# -0 is below +0
+	fmv.x.d t1, ft6
+	PRINT t1
+	fmax.d ft6, ft7, ft4
+	fmv.x.d t1, ft6
+	PRINT t1
+	fsgnjx.d ft6, fs3, fs3	# fabs
+	fmv.x.d t1, ft6
+	PRINT t1
+	fclass.d t1, fs3
+	PRINT t1
+	fclass.d t1, ft7
+	PRINT t1
+	fclass.d t1, ft5
+	PRINT t1
+	FLAGS
+
+	# 2.5 and -2.5 to integers in RNE, RTZ, RDN, RUP and RMM
+	fcvt.w.d t1, fs2, rne
+	fcvt.w.d t2, fs3, rne
+	PRINT t1
+	PRINT t2
+	fcvt.w.d t1, fs2, rtz
+	fcvt.w.d t2, fs3, rtz
+	PRINT t1
+	PRINT t2
+	fcvt.w.d t1, fs2, rdn
+	fcvt.w.d t2, fs3, rdn
+	PRINT t1
+	PRINT t2
+	fcvt.w.d t1, fs2, rup
+	fcvt.w.d t2, fs3, rup
+	PRINT t1
+	PRINT t2
+	fcvt.w.d t1, fs2, rmm
+	fcvt.w.d t2, fs3, rmm
+	PRINT t1
+	PRINT t2
+	FLAGS
+	fsrmi 3			# RUP through frm
+	fcvt.l.d t1, fs2
+	PRINT t1
+	fsrmi 0
+	FLAGS
+
+	# Out of range conversions saturate and raise NV
+	fcvt.w.d t1, ft5	# NaN
+	PRINT t1
+	FLAGS
+	fcvt.lu.d t1, fs3
+	PRINT t1
+	FLAGS
+	LD ft6, 0x43f0000000000000 # 2^64
+	fcvt.l.d t1, ft6
+	PRINT t1
+	FLAGS
+	li t0, -7
+	fcvt.d.l ft6, t0
+	fmv.x.d t1, ft6
+	PRINT t1
+	li t0, -1
+	fcvt.s.lu ft6, t0
+	fmv.x.w t1, ft6
+	PRINT t1
+	FLAGS
+	fcvt.d.s ft6, ft2
+	fmv.x.d t1, ft6
+	PRINT t1
+
+	# Loads and stores, a single load is boxed
+	la t0, data
+	fld ft6, 0(t0)
+	fsw ft6, 8(t0)
+	flw ft7, 8(t0)
+	fmv.x.d t1, ft7
+	PRINT t1
+	li a0, 7
+	ecall
+
+	.data
+	.balign 8
+data:	.dword 0x0123456789abcdef
+	.dword 0
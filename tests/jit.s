@@ -0,0 +1,62 @@
+# Long blocks of stores made hot, every store has its DTLB probe and fallback inline,
+# the host code of the blocks runs to the end of the JIT buffer
+	.option norvc
+	.macro BLOCK		# 62 stores, one addi and a branch, each register pinned
+	.set off, 0
+	.rept 12
+	sd t0, off(a0)
+	sd t1, off + 8(a0)
+	sd t2, off + 16(a0)
+	sd t3, off + 24(a0)
+	sd t4, off + 32(a0)
+	.set off, off + 40
+	.endr
+	sd t0, off(a0)
+	sd t1, off + 8(a0)
+	addi t0, t0, 1
+	bltz a0, 3f		# Ends the block, the next one either way
+3:
+	.endm
+
+	.text
+	.globl _start
+_start:
+	la a0, out
+	li t0, 0
+	li t1, 1
+	li t2, 2
+	li t3, 3
+	li t4, 4
+	li s0, 70
+	.rept 3			# Moves the blocks so one is compiled in the last 18K of the buffer
+	nop
+	.endr
+1:	.rept 1000
+	BLOCK
+	.endr
+	addi s0, s0, -1
+	beqz s0, 2f
+	j 1b
+2:
+	mv s1, a0
+	mv a1, t0		# Blocks run
+	call print
+	ld a1, 0(s1)		# The last stores of t0 and t1
+	call print
+	ld a1, 488(s1)
+	call print
+	li a0, 7
+	li a1, 0
+	ecall
+
+print:
+	li a0, 0
+	ecall
+	li a0, 2
+	li a1, 10
+	ecall
+	ret
+
+	.data
+	.balign 8
+out:	.zero 8 * 62
@@ -0,0 +1,188 @@
+# Static Linux executable at the default link address: argv, auxv, fds, brk, mmap and the exit status
+# run: $FRV --linux $ELF one two
+	.text
+	.globl _start
+_start:
+	ld s0, 0(sp)		# argc
+	addi s1, sp, 8		# argv
+	li s2, 1		# argv[0] is wherever the tests are
+1:	bge s2, s0, 2f
+	slli t0, s2, 3
+	add t0, s1, t0
+	ld a0, 0(t0)
+	call puts
+	addi s2, s2, 1
+	j 1b
+
+	# AT_HWCAP, behind argv and envp
+2:	addi t0, s0, 2
+	slli t0, t0, 3
+	add t0, sp, t0
+3:	ld t1, 0(t0)
+	addi t0, t0, 8
+	bnez t1, 3b
+4:	ld t1, 0(t0)
+	li a0, 1
+	beqz t1, exit
+	addi t0, t0, 16
+	li t2, 16
+	bne t1, t2, 4b
+	ld t1, -8(t0)
+	li t2, 0x20112d		# IMAFDCV
+	li a0, 2
+	bne t1, t2, exit
+
+	# The host fds behind frv are not the guest's
+	li a0, 100
+	li a7, 57		# close
+	ecall
+	li t1, -9		# EBADF
+	mv t2, a0
+	li a0, 3
+	bne t2, t1, exit
+	li a0, 1
+	li a1, 0
+	li a2, 4
+	li a7, 64		# write from address 0
+	ecall
+	li t1, -14		# EFAULT
+	mv t2, a0
+	li a0, 4
+	bne t2, t1, exit
+
+	# Its own executable, read through a file of its own
+	li a0, -100		# AT_FDCWD
+	ld a1, 0(s1)
+	li a2, 0		# O_RDONLY
+	li a7, 56		# openat
+	ecall
+	mv s3, a0
+	li a0, 5
+	bltz s3, exit
+	mv a0, s3
+	addi sp, sp, -16
+	mv a1, sp
+	li a2, 4
+	li a7, 63		# read
+	ecall
+	lw t1, 0(sp)
+	addi sp, sp, 16
+	li t2, 0x464c457f	# \177ELF
+	li a0, 6
+	bne t1, t2, exit
+	li t1, 1		# close takes an int, the upper half of a0 is not the fd
+	slli t1, t1, 32
+	or a0, s3, t1
+	li a7, 57
+	ecall
+	mv t2, a0
+	li a0, 7
+	bnez t2, exit
+	mv a0, s3		# Closed now
+	li a7, 57
+	ecall
+	li t1, -9
+	mv t2, a0
+	li a0, 8
+	bne t2, t1, exit
+
+	# Anonymous memory is zero, also where an earlier brk wrote
+	li a0, 0
+	li a7, 214		# brk
+	ecall
+	li t0, 4095
+	add a0, a0, t0
+	srli a0, a0, 12		# Page aligned, so the gap above it can be mapped exactly
+	slli s4, a0, 12
+	li t0, 0x100000
+	add a0, s4, t0
+	ecall
+	li t0, 0x100000
+	add t0, s4, t0
+	mv t2, a0
+	li a0, 9
+	bne t2, t0, exit
+	li t1, 0x55
+	sd t1, -8(t0)
+	mv a0, s4		# Shrunk back, the dirty page is above brk again
+	li a7, 214
+	ecall
+	li a0, 0
+	li a1, 4096
+	li a2, 3		# PROT_READ | PROT_WRITE
+	li a3, 0x22		# MAP_PRIVATE | MAP_ANONYMOUS
+	li a4, -1
+	li a5, 0
+	li a7, 222		# mmap
+	ecall
+	mv s7, a0
+	sub a1, s7, s4		# The whole gap down to brk
+	li a0, 0
+	ecall
+	li t0, 0x100000
+	add t0, a0, t0
+	ld t1, -8(t0)
+	mv t2, a0
+	li a0, 10
+	bne t2, s4, exit
+	bnez t1, exit
+	mv a0, s4		# Both given back, the lowest first
+	sub a1, s7, s4
+	li a7, 215		# munmap
+	ecall
+	mv a0, s7
+	li a1, 4096
+	ecall
+
+	# Large buffers mapped and unmapped in a loop, more of them than the RAM holds
+	li s5, 64
+5:	li a0, 0
+	li a1, 0x400000
+	li a2, 3
+	li a3, 0x22
+	li a4, -1
+	li a5, 0
+	li a7, 222		# mmap
+	ecall
+	mv s6, a0
+	li t0, -4096		# -errno
+	li a0, 11
+	bgeu s6, t0, exit
+	ld t1, 0(s6)		# What the previous round stored is gone
+	li a0, 12
+	bnez t1, exit
+	sd s5, 0(s6)
+	mv a0, s6
+	li a1, 0x400000
+	li a7, 215		# munmap
+	ecall
+	mv t2, a0
+	li a0, 13
+	bnez t2, exit
+	addi s5, s5, -1
+	bnez s5, 5b
+
+	mv a0, s0		# argc as the status
+exit:	li a7, 94		# exit_group
+	ecall
+
+# The string at a0 and a newline to stdout
+puts:
+	mv a1, a0
+	li a2, 0
+1:	add t0, a1, a2
+	lbu t0, 0(t0)
+	addi a2, a2, 1
+	bnez t0, 1b
+	addi a2, a2, -1
+	li a0, 1
+	li a7, 64		# write
+	ecall
+	li a0, 1
+	la a1, newline
+	li a2, 1
+	ecall
+	ret
+
+	.section .rodata
+newline:	.ascii "\n"
@@ -0,0 +1,137 @@
+# Sv39 from S-mode: leaf pages, A/D updates, permissions, SUM and sfence.vma
+# The M-mode handler prints "<mcause> <mtval>" for each page fault and does the ecalls of S-mode
+	.option norvc
+	.macro PTE dst, phys, flags
+	srli \dst, \phys, 12
+	slli \dst, \dst, 10
+	ori \dst, \dst, \flags
+	.endm
+	.macro PRINT reg
+	li a0, 0
+	mv a1, \reg
+	ecall
+	li a0, 2
+	li a1, 10
+	ecall
+	.endm
+
+	.text
+	.globl _start
+_start:
+	la t0, mhandler
+	csrw mtvec, t0
+	li s0, 0x80100000	# Root table
+	li s1, 0x80101000	# Level 1
+	li s2, 0x80102000	# Level 0, VA 0 to 2MB
+	li s3, 0x80200000	# Data page
+	li s4, 0x80201000	# User data page
+	li t0, (0x80000 << 10) | 0xcf # VA 0x80000000 as a 1GB page, RWX, A and D
+	sd t0, 16(s0)
+	PTE t0, s1, 0x1
+	sd t0, 0(s0)
+	PTE t0, s2, 0x1
+	sd t0, 0(s1)
+	PTE t0, s3, 0x7		# 0x1000: RW, A and D left to the walk
+	sd t0, 8(s2)
+	PTE t0, s3, 0x43	# 0x2000: the same page read-only
+	sd t0, 16(s2)
+	PTE t0, s4, 0xd7	# 0x3000: user RW
+	sd t0, 24(s2)
+	la t1, func
+	PTE t0, t1, 0x49	# 0x4000: execute only
+	sd t0, 32(s2)
+	li t0, 42
+	sd t0, 0(s3)
+	li t0, 7
+	sd t0, 0(s4)
+	li t0, 8		# Sv39
+	slli t0, t0, 60
+	srli t1, s0, 12
+	or t0, t0, t1
+	csrw satp, t0
+	la t0, super
+	csrw mepc, t0
+	li t0, 0x800		# MPP = S
+	csrs mstatus, t0
+	mret
+
+super:
+	li t1, 0x1000
+	ld t2, 0(t1)
+	PRINT t2
+	li t2, 43
+	sd t2, 0(t1)
+	li t1, 0x2000		# Sees the store through the other mapping
+	ld t2, 0(t1)
+	PRINT t2
+	ld t2, 8(s2)		# A and D are set now
+	andi t2, t2, 0xc0
+	PRINT t2
+	sd t2, 0(t1)		# Read-only
+
+	li t1, 0x3000		# User page, needs SUM
+	ld t2, 0(t1)
+	li t0, 0x40000
+	csrs sstatus, t0
+	ld t2, 0(t1)
+	PRINT t2
+	li t0, 0x40000
+	csrc sstatus, t0
+
+	li t1, 0x4000
+	jalr t1
+	PRINT a1
+	lw t2, 0(t1)		# Not readable
+	li t0, 0x80000		# Unless MXR is set
+	csrs sstatus, t0
+	lw t2, 0(t1)
+	PRINT t2
+	csrc sstatus, t0
+
+	PTE t2, s4, 0xc7	# 0x1000 moves to the user data page without the U bit
+	sd t2, 8(s2)
+	sfence.vma
+	li t1, 0x1000
+	ld t2, 0(t1)
+	PRINT t2
+	PTE t2, s3, 0xc3	# 0x4000 turns into data
+	sd t2, 32(s2)
+	sfence.vma
+	li t1, 0x4000
+	jalr t1
+	li t1, 0x9000		# Not mapped
+	ld t2, 0(t1)
+	li a0, 7
+	ecall
+
+	.align 2
+mhandler:
+	csrr t0, mcause
+	li t6, 9
+	beq t0, t6, 1f
+	li a0, 0
+	mv a1, t0
+	ecall
+	li a0, 2
+	li a1, 32
+	ecall
+	li a0, 3
+	csrr a1, mtval
+	ecall
+	li a0, 2
+	li a1, 10
+	ecall
+	li t6, 12		# Instruction page fault, back to the caller
+	bne t0, t6, 2f
+	csrw mepc, ra
+	mret
+1:	ecall			# Done here for S-mode
+2:	csrr t0, mepc
+	addi t0, t0, 4
+	csrw mepc, t0
+	mret
+
+	.balign 4096
+func:
+	li a1, 100
+	ret
@@ -0,0 +1,56 @@
+# Saved over the snapshot it runs from, the pages it never wrote must still read as they were
+# run: $FRV --save-snapshot snap $ELF && $FRV --restore snap --save-snapshot snap && $FRV --restore snap
+	.text
+	.globl _start
+_start:
+	li a0, 8
+	ecall
+	bnez a1, resumed
+	la a1, msg_saved
+	li a0, 1
+	ecall
+	j exit
+
+resumed:
+	la t0, generation
+	ld t1, 0(t0)
+	bnez t1, again
+	li t1, 1
+	sd t1, 0(t0)
+	li a0, 8		# Over the file this machine was restored from
+	ecall
+	bnez a1, again
+	call check
+	la a1, msg_resaved
+	li a0, 1
+	ecall
+	j exit
+
+again:
+	call check
+	la a1, msg_again
+	li a0, 1
+	ecall
+exit:	li a0, 7
+	ecall
+
+	# Code and data in pages nothing touched since the first restore
+	.balign 4096
+check:
+	la t0, magic
+	ld t0, 0(t0)
+	li t1, 0x600dc0de
+	beq t0, t1, 1f
+	la a1, msg_lost
+	li a0, 1
+	ecall
+1:	ret
+
+	.data
+generation:	.dword 0
+msg_saved:	.asciz "saved\n"
+msg_resaved:	.asciz "saved over the snapshot it was restored from\n"
+msg_again:	.asciz "restored from the second snapshot\n"
+msg_lost:	.asciz "untouched page lost\n"
+	.balign 4096
+magic:	.dword 0x600dc0de
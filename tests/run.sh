@@ -0,0 +1,44 @@
+#!/bin/sh
+# Usage: run.sh <frv> [test...]
+# Runs each test (all of them by default) and compares its stdout and exit status with <test>.out
+# The command is "$FRV $ELF" unless the source has a "# run:" line, "# needs: <option>" skips
+# the test on builds whose usage does not list that option
+FRV=$1
+DIR=$(dirname "$0")
+
+[ -x "$FRV" ] || { echo "Usage: $0 <frv> [test...]" >&2; exit 1; }
+FRV=$(cd "$(dirname "$FRV")" && pwd)/$(basename "$FRV")
+shift
+TRACE=$(dirname "$FRV")/frv-trace # The decoder of --trace is built next to frv
+cd "$DIR" || exit 1
+TMP=$(mktemp -d) || exit 1
+trap 'rm -rf "$TMP"' EXIT
+[ $# -gt 0 ] || set -- $(ls *.out | sed 's/\.out$//')
+
+pass=0
+fail=0
+skip=0
+for t in "$@"; do
+	needs=$(sed -n 's/^# needs: //p' "$t.s")
+	if [ -n "$needs" ] && ! "$FRV" --help | grep -q -- "$needs"; then
+		echo "skip $t: no $needs in this build"
+		skip=$((skip + 1))
+		continue
+	fi
+	run=$(sed -n 's/^# run: //p' "$t.s")
+	ELF=$PWD/$t.elf
+	[ -n "$run" ] || run='$FRV $ELF'
+	# From the scratch directory, where the files a run leaves behind are removed
+	(cd "$TMP" && eval "$run") > "$TMP/out" 2> "$TMP/err"
+	echo "exit $?" >> "$TMP/out"
+	if cmp -s "$TMP/out" "$t.out"; then
+		pass=$((pass + 1))
+	else
+		echo "FAIL $t: $run"
+		diff "$t.out" "$TMP/out"
+		cat "$TMP/err"
+		fail=$((fail + 1))
+	fi
+done
+echo "$pass passed, $fail failed, $skip skipped"
+[ $fail -eq 0 ]
@@ -0,0 +1,144 @@
+# Compressed instructions: each form once, a trap on one, one across a page and one patched in place
+	.option rvc
+	.macro PRINT reg
+	li a0, 3
+	mv a1, \reg
+	ecall
+	li a0, 2
+	li a1, 10
+	ecall
+	.endm
+
+	.text
+	.globl _start
+_start:
+	la t0, mhandler
+	csrw mtvec, t0
+	li t0, 0x2000		# FS for c.fld/c.fsd
+	csrs mstatus, t0
+bp:	c.ebreak		# mepc must move by 2 only
+	la t0, bp
+	sub s1, s0, t0
+	PRINT s1
+
+	# Integer forms, on s0/s1 and a2-a5 so the 3-bit register fields are used
+	c.li s0, -3
+	c.lui s1, 0xfffff	# Sign extended
+	c.add s1, s0
+	PRINT s1
+	c.srai s1, 4
+	c.andi s1, -17
+	PRINT s1
+	c.slli s0, 40
+	c.srli s0, 36
+	PRINT s0
+	c.li a2, 12
+	c.li a3, 10
+	c.mv a4, a2
+	c.sub a4, a3
+	c.xor a4, a2
+	c.or a4, a3
+	c.and a4, a2
+	PRINT a4
+	li a5, 0x7fffffff
+	c.addiw a5, 1		# Wraps to negative
+	PRINT a5
+	c.addw a5, a5
+	c.subw a5, a3
+	PRINT a5
+
+	# Loads and stores, relative to sp and to a register
+	la sp, stack_top
+	c.addi16sp sp, -64
+	c.addi4spn a2, sp, 16
+	li t0, 0x1122334455667788
+	c.sdsp t0, 8(sp)
+	c.ldsp t1, 8(sp)
+	c.swsp t0, 20(sp)
+	c.lwsp t2, 20(sp)
+	add t1, t1, t2
+	PRINT t1
+	c.sd a3, 8(a2)
+	c.ld a4, 8(a2)
+	c.sw a3, 4(a2)
+	c.lw a5, 4(a2)
+	add a4, a4, a5
+	PRINT a4
+	c.fsd fs0, 0(a2)	# fs0 is 0 at reset
+	c.fld fa0, 0(a2)
+	fmv.x.d t0, fa0
+	PRINT t0
+	li t0, 0x4045000000000000 # 42.0
+	fmv.d.x fa1, t0
+	c.fsdsp fa1, 32(sp)
+	c.fldsp fa2, 32(sp)
+	fcvt.l.d t0, fa2
+	PRINT t0
+	c.addi16sp sp, 64
+
+	# Control flow
+	c.li s0, 0
+	c.li s1, 5
+1:	c.addi s0, 3
+	c.addi s1, -1
+	c.bnez s1, 1b
+	c.beqz s1, 2f
+	c.li s0, 0
+2:	PRINT s0
+	la t0, fn
+	c.jalr t0
+	PRINT a1
+	c.li a2, 1
+	la t0, 3f
+	c.jr t0
+	c.li a2, 0
+3:	c.j 4f
+	c.li a2, 0
+4:	PRINT a2
+
+	# A 4-byte instruction across the page, then compressed ones
+	li s0, 0
+	li s1, 7
+	j cross
+	.org 0xffe
+	.option norvc
+cross:	addi s0, s0, 1
+	.option rvc
+	c.addi s1, -1
+	c.bnez s1, cross
+	PRINT s0
+
+	# minstret counts compressed instructions one each
+	csrr t1, minstret
+	c.nop
+	c.li a1, 1
+	c.addi a1, 1
+	c.mv a2, a1
+	csrr t2, minstret
+	sub t1, t2, t1
+	PRINT t1
+
+	# c.li a1, 3 patched into c.li a1, 5
+	la t0, patch
+	li t1, 0x4595
+	sh t1, 0(t0)
+	fence.i
+patch:	c.li a1, 3
+	PRINT a1
+	li a0, 7
+	ecall
+
+fn:	c.li a1, 9
+	c.jr ra
+
+	.align 2
+mhandler:
+	csrr s0, mepc
+	addi t0, s0, 2
+	csrw mepc, t0
+	mret
+
+	.data
+	.balign 16
+stack:	.zero 128
+stack_top:
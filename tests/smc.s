@@ -0,0 +1,57 @@
+# Code rewritten after it was cached, chained and compiled: each fence.i must bring in the new code
+	.option norvc
+	.text
+	.globl _start
+_start:
+	la s0, fn
+	call hot		# 1000 calls of li a1, 1
+	li t1, 0x00200593	# li a1, 2
+	sw t1, 0(s0)
+	fence.i
+	call hot
+	li t1, 0x40bb8bb3	# sub s7, s7, a1, in the caller this time
+	la t0, body
+	sw t1, 0(t0)
+	fence.i
+	call hot
+
+	# A store into the block that is running, seen by the next pass once fenced
+	li s1, 0
+	li s2, 2
+	la s3, patch
+	li s4, 0x00a48493	# addi s1, s1, 10
+1:
+patch:	addi s1, s1, 1
+	sw s4, 0(s3)
+	fence.i
+	addi s2, s2, -1
+	bnez s2, 1b
+	mv a1, s1		# 1 then 10
+	li a0, 0
+	ecall
+	li a0, 2
+	li a1, 10
+	ecall
+	li a0, 7
+	ecall
+
+# Sum of 1000 calls to fn, printed
+hot:
+	mv s5, ra
+	li s6, 1000
+	li s7, 0
+1:	jalr s0
+body:	add s7, s7, a1
+	addi s6, s6, -1
+	bnez s6, 1b
+	li a0, 0
+	mv a1, s7
+	ecall
+	li a0, 2
+	li a1, 10
+	ecall
+	mv ra, s5
+	ret
+
+fn:	li a1, 1
+	ret
@@ -0,0 +1,64 @@
+# Four harts hammering the same words: amoadd, an lr/sc loop and a lock around plain stores
+# run: $FRV --harts 4 $ELF
+	.text
+	.globl _start
+_start:
+	csrr s0, mhartid
+	la s1, cnt
+	la s2, cnt2
+	la s3, cnt3
+	la s4, lock
+	li t0, 100000
+	li t1, 1
+1:	amoadd.d zero, t1, (s1)
+	addi t0, t0, -1
+	bnez t0, 1b
+	li t0, 100000
+2:	lr.d t2, (s2)
+	addi t2, t2, 1
+	sc.d t3, t2, (s2)
+	bnez t3, 2b
+	addi t0, t0, -1
+	bnez t0, 2b
+	li t0, 50000
+	li t4, 1
+3:	amoswap.w.aq t5, t4, (s4)
+	bnez t5, 3b
+	ld t6, 0(s3)
+	addi t6, t6, 1
+	sd t6, 0(s3)
+	amoswap.w.rl zero, zero, (s4)
+	addi t0, t0, -1
+	bnez t0, 3b
+	la t1, done
+	amoadd.d zero, t4, (t1)
+	bnez s0, exit
+
+	li t2, 4		# Hart 0 waits for the others and prints
+4:	ld t3, 0(t1)
+	bne t3, t2, 4b
+	ld t2, 0(s1)
+	call print
+	ld t2, 0(s2)
+	call print
+	ld t2, 0(s3)
+	call print
+exit:	li a0, 7
+	ecall
+
+print:
+	li a0, 0
+	mv a1, t2
+	ecall
+	li a0, 2
+	li a1, 10
+	ecall
+	ret
+
+	.data
+	.balign 8
+cnt:	.dword 0
+cnt2:	.dword 0
+cnt3:	.dword 0
+done:	.dword 0
+lock:	.word 0
@@ -0,0 +1,74 @@
+# A snapshot taken with a timer armed and a software interrupt pending, both must survive the restore
+# run: $FRV --save-snapshot snap $ELF && $FRV --restore snap
+	.text
+	.globl _start
+_start:
+	la t0, handler
+	csrw mtvec, t0
+	li s0, 0x2000000	# CLINT
+	li t0, 0xbff8
+	add s1, s0, t0		# mtime
+	li t0, 0x4000
+	add s2, s0, t0		# mtimecmp of hart 0
+	ld t0, 0(s1)
+	la t1, saved
+	sd t0, 0(t1)
+	li t1, 20000		# 2ms
+	add t0, t0, t1
+	sd t0, 0(s2)
+	li t0, 1
+	sw t0, 0(s0)		# msip, never taken as MSIE stays off
+	li t0, 0x80		# MTIE
+	csrw mie, t0
+	csrr s3, minstret
+	li a0, 8
+	ecall
+	bnez a1, resumed
+	la a1, msg_saved
+	li a0, 1
+	ecall
+	j exit
+
+resumed:
+	csrr t0, mip
+	andi t0, t0, 0x8
+	la a1, msg_nomsip
+	beqz t0, fail
+	ld t0, 0(s1)
+	la t1, saved
+	ld t1, 0(t1)
+	la a1, msg_back
+	bltu t0, t1, fail
+	csrr t0, minstret
+	la a1, msg_instret
+	bltu t0, s3, fail
+	csrsi mstatus, 0x8
+1:	la t0, ticked
+	ld t0, 0(t0)
+	beqz t0, 1b
+	la a1, msg_tick
+	li a0, 1
+	ecall
+exit:	li a0, 7
+	ecall
+fail:	li a0, 1
+	ecall
+	j exit
+
+	.align 2
+handler:
+	li t0, -1
+	sd t0, 0(s2)
+	la t0, ticked
+	li t1, 1
+	sd t1, 0(t0)
+	mret
+
+	.data
+saved:	.dword 0
+ticked:	.dword 0
+msg_saved:	.asciz "saved\n"
+msg_tick:	.asciz "timer fired after the restore\n"
+msg_nomsip:	.asciz "msip lost\n"
+msg_back:	.asciz "mtime went back\n"
+msg_instret:	.asciz "minstret went back\n"
@@ -0,0 +1,34 @@
+# A traced run decoded by frv-trace: the totals, the trapping instruction and the stores of the loop
+# needs: --trace
+# run: $FRV --trace trace $ELF > /dev/null && $TRACE --summary trace && $TRACE --traps trace && $TRACE --addr 0x80001000:0x80001020 trace
+	.option norvc
+	.text
+	.globl _start
+_start:
+	la t0, handler
+	csrw mtvec, t0
+	li s0, 10
+	li s1, 0
+	la s2, buf
+1:	sd s1, 0(s2)
+	addi s1, s1, 3
+	addi s2, s2, 8
+	addi s0, s0, -1
+	bnez s0, 1b
+	.word 0			# Illegal
+	.option rvc
+	c.addi s1, 1
+	c.addi s1, 1
+	.option norvc
+	li a0, 7
+	ecall
+
+	.align 2
+handler:
+	csrr t0, mepc
+	addi t0, t0, 4
+	csrw mepc, t0
+	mret
+
+	.balign 4096		# At 0x80001000 whatever the toolchain
+buf:	.zero 80
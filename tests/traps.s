@@ -0,0 +1,119 @@
+# Every exception and interrupt frv delivers, the M-mode handler prints "<mcause> <mtval>" for each and frv prints no error of its own
+# run: $FRV $ELF 2> err; s=$?; grep ^Frv err; exit $s
+	.option norvc		# The handler skips 4 bytes past the faulting instruction
+	.text
+	.globl _start
+_start:
+	la t0, mhandler
+	csrw mtvec, t0
+	.word 0			# Illegal instruction
+	ebreak
+	li t2, 0x80001001
+	lr.w t1, (t2)		# Misaligned LR
+	li t2, 0x80001002
+	amoadd.w t1, t1, (t2)	# Misaligned AMO
+	li t2, 0x10
+	ld t1, 0(t2)		# Nothing mapped there
+	sd t1, 0(t2)
+
+	# U-mode: an ecall and an M-mode CSR, the handler comes back to M after each
+	la t0, user
+	call tousermode
+user:	ecall
+	la t0, user2
+	call tousermode
+user2:	csrr t1, mstatus
+
+	# The ecalls of U-mode delegated to S, its handler hands scause on to M with an ecall of its own
+	la t0, shandler
+	csrw stvec, t0
+	li t0, 0x100
+	csrw medeleg, t0
+	la t0, user3
+	call tousermode
+user3:	ecall
+back:	csrw medeleg, zero
+
+	# Software interrupt of hart 0
+	li s2, 0x2000000	# CLINT
+	li t0, 1
+	sw t0, 0(s2)
+	li t0, 0x8		# MSIE
+	csrw mie, t0
+	li s3, 0
+	csrsi mstatus, 0x8
+1:	beqz s3, 1b
+
+	# Timer interrupt 100us from now
+	li t0, 0xbff8
+	add t0, s2, t0
+	ld t1, 0(t0)
+	addi t1, t1, 1000
+	li t0, 0x4000
+	add t0, s2, t0
+	sd t1, 0(t0)
+	li t0, 0x80		# MTIE
+	csrw mie, t0
+	li s3, 0
+	csrsi mstatus, 0x8
+2:	wfi
+	beqz s3, 2b
+	li a0, 7
+	ecall
+
+# mret to t0 in U-mode
+tousermode:
+	csrw mepc, t0
+	li t0, 0x1800
+	csrc mstatus, t0
+	mret
+
+	.align 2
+shandler:
+	csrr s5, scause
+	ecall
+
+	.align 2
+mhandler:
+	csrr s4, mcause
+	li a0, 3
+	mv a1, s4
+	ecall
+	li a0, 2
+	li a1, 32
+	ecall
+	li a0, 3
+	csrr a1, mtval
+	ecall
+	li a0, 2
+	li a1, 10
+	ecall
+	bltz s4, irq
+	li t0, 9
+	beq s4, t0, froms
+	csrr t0, mepc
+	addi t0, t0, 4
+	csrw mepc, t0
+	li t0, 0x1800		# Back to M-mode, whatever mode trapped
+	csrs mstatus, t0
+	mret
+froms:
+	li a0, 3		# What S-mode was handed
+	mv a1, s5
+	ecall
+	li a0, 2
+	li a1, 10
+	ecall
+	la t0, back
+	csrw mepc, t0
+	li t0, 0x1800
+	csrs mstatus, t0
+	mret
+irq:
+	li t0, -1		# Quiet both sources, mret enables the interrupts again
+	li t1, 0x2004000
+	sd t0, 0(t1)
+	li t1, 0x2000000
+	sw zero, 0(t1)
+	li s3, 1
+	mret
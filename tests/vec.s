@@ -0,0 +1,153 @@
+# Vector: vsetvl, loads and stores, arithmetic under a mask and in the tail, reductions and the traps
+# The M-mode handler prints "<mcause> <vstart>" for each trap and skips the instruction
+# run: $FRV --ram 32 $ELF
+	.option norvc
+	.macro PRINT code, reg
+	li a0, \code
+	mv a1, \reg
+	ecall
+	li a0, 2
+	li a1, 10
+	ecall
+	.endm
+
+	.text
+	.globl _start
+_start:
+	la t0, mhandler
+	csrw mtvec, t0
+	li t0, 0x600		# VS
+	csrs mstatus, t0
+	csrr t1, vlenb
+	PRINT 0, t1
+
+	# vl is the AVL up to VLMAX
+	li t0, 100
+	vsetvli t1, t0, e32, m1, ta, ma
+	PRINT 0, t1
+	vsetvli t1, t0, e8, m8, ta, ma
+	PRINT 0, t1
+	vsetvli t1, t0, e32, mf2, ta, ma
+	PRINT 0, t1
+	vsetivli t1, 3, e16, m1, ta, ma
+	PRINT 0, t1
+
+	# Sum of a[i] * b[i] + a[i] over a group of two registers
+	li t0, 16
+	vsetvli zero, t0, e32, m2, ta, ma
+	la s0, a
+	la s1, b
+	vle32.v v2, (s0)
+	vle32.v v4, (s1)
+	vmv.v.v v6, v2
+	vmacc.vv v6, v2, v4
+	vmv.s.x v8, zero
+	vredsum.vs v8, v6, v8
+	vmv.x.s t1, v8
+	PRINT 0, t1
+	vmv.s.x v8, zero
+	vredmaxu.vs v8, v4, v8
+	vmv.x.s t1, v8
+	PRINT 0, t1
+
+	# Every other dword of a, as a strided load, stored back strided into out
+	vsetivli zero, 4, e64, m1, ta, ma
+	li t0, 16
+	vlse64.v v10, (s0), t0
+	la s2, out
+	li t0, 24
+	vsse64.v v10, (s2), t0
+	ld t1, 0(s2)
+	PRINT 3, t1
+	ld t1, 72(s2)
+	PRINT 3, t1
+
+	# Masked and tail elements are left alone: vl 5 of 8, v0 = 0b01010101
+	vsetivli zero, 8, e32, m1, tu, mu
+	vmv.v.i v12, -1
+	li t0, 0x55
+	vmv.s.x v0, t0
+	vsetivli zero, 5, e32, m1, tu, mu
+	vle32.v v14, (s0)
+	vrsub.vx v12, v14, zero, v0.t
+	vsetivli zero, 8, e32, m1, tu, mu
+	vse32.v v12, (s2)
+	ld t1, 0(s2)
+	PRINT 3, t1
+	ld t1, 8(s2)
+	PRINT 3, t1
+	ld t1, 16(s2)
+	PRINT 3, t1
+	ld t1, 24(s2)
+	PRINT 3, t1
+
+	# Signed and unsigned views of the same elements
+	vsra.vi v16, v12, 1
+	vredmin.vs v18, v16, v16
+	vmv.x.s t1, v18
+	PRINT 0, t1
+	vredminu.vs v18, v16, v16
+	vmv.x.s t1, v18
+	PRINT 3, t1
+	vsetivli zero, 1, e8, m1, ta, ma
+	li t0, 0x80
+	vmv.s.x v20, t0
+	vmv.x.s t1, v20		# Sign extended from SEW
+	PRINT 3, t1
+
+	# A load running off the end of the RAM stops at the element that faults
+	li t0, 32
+	vsetvli zero, t0, e8, m1, tu, mu
+	vmv.v.i v22, 7
+	li t0, 0x82000000 - 10
+	li t1, 0x5a
+	sb t1, 9(t0)
+	vle8.v v22, (t0)
+	vse8.v v22, (s2)
+	lbu t1, 9(s2)
+	PRINT 3, t1
+	lbu t1, 10(s2)
+	PRINT 3, t1
+
+	# An illegal vtype sets vill, then any vector instruction traps
+	vsetvli t1, zero, e64, mf8, ta, ma
+	PRINT 0, t1
+	csrr t1, vtype
+	srli t1, t1, 63
+	PRINT 0, t1
+	vadd.vv v1, v2, v3
+	vsetivli zero, 4, e8, m2, ta, ma
+	vadd.vv v1, v2, v4	# Odd register for a group of two
+	li t0, 0x600
+	csrc mstatus, t0
+	vsetivli zero, 4, e8, m1, ta, ma # VS off
+	li a0, 7
+	ecall
+
+	.align 2
+mhandler:
+	li t0, 0x600		# The last trap is for VS off
+	csrs mstatus, t0
+	li a0, 0
+	csrr a1, mcause
+	ecall
+	li a0, 2
+	li a1, 32
+	ecall
+	li a0, 0
+	csrr a1, vstart
+	ecall
+	li a0, 2
+	li a1, 10
+	ecall
+	csrw vstart, zero
+	csrr t0, mepc
+	addi t0, t0, 4
+	csrw mepc, t0
+	mret
+
+	.data
+	.balign 8
+a:	.word 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16
+b:	.word 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1
+out:	.zero 128
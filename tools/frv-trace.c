@@ -0,0 +1,198 @@
+/* frv-trace: decode and filter the instruction traces written by frv --trace
+ * One line per record: hart, pc, the 32-bit instruction, the register it wrote, the address it accessed
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include "trace.h"
+
+#define FRV_TRACE_READ (1 << 16) // Records per read
+
+// A record is shown when it passes every filter that is set
+struct FrvTraceFilter {
+	uint64_t	hart; // UINT64_MAX for all
+	uint64_t	pclo, pchi; // [lo, hi)
+	uint64_t	addrlo, addrhi; // Only memory accesses in [lo, hi) once set
+	bool		addr;
+	int		reg; // x0-x31, f0-f31 as 32-63, -1 for any
+	bool		traps;
+	uint64_t	skip; // Matching records left out first
+	uint64_t	count; // Matching records shown at most
+};
+
+struct FrvTraceTotals {
+	uint64_t	records;
+	uint64_t	mem;
+	uint64_t	traps;
+	uint64_t	compressed;
+};
+
+static void frvTraceUsage(const char* name)
+{
+	printf("Usage: %s [options] <trace>\n", name);
+	printf("Options:\n");
+	printf("  --hart <n>	only the records of hart n\n");
+	printf("  --pc <lo>[:<hi>]	only the instructions at lo, or in [lo, hi)\n");
+	printf("  --addr <lo>[:<hi>]	only the memory accesses to lo, or in [lo, hi)\n");
+	printf("  --reg <xN|fN>	only the instructions writing that register\n");
+	printf("  --traps	only the instructions that raised an exception\n");
+	printf("  --skip <n>	leave out the first n matching records\n");
+	printf("  --count <n>	stop after n matching records\n");
+	printf("  --summary	print the totals of each hart instead of the records\n");
+	printf("Numbers can be given in hex with 0x\n");
+}
+
+// lo or lo:hi into [lo, hi)
+static bool frvTraceParseRange(const char* s, uint64_t* lo, uint64_t* hi)
+{
+	char* end;
+	errno = 0;
+	*lo = strtoull(s, &end, 0);
+	if (errno || end == s) return false;
+	if (!*end) {
+		*hi = *lo + 1;
+		return true;
+	}
+	if (*end != ':') return false;
+	s = end + 1;
+	*hi = strtoull(s, &end, 0);
+	return !errno && end != s && !*end && *lo < *hi;
+}
+
+static int frvTraceParseReg(const char* s)
+{
+	if ((s[0] != 'x' && s[0] != 'f') || !s[1]) return -1;
+	char* end;
+	const unsigned long n = strtoul(s + 1, &end, 10);
+	if (*end || n > 31) return -1;
+	return (s[0] == 'f') ? 32 + n : n;
+}
+
+static bool frvTraceMatch(const struct FrvTraceFilter* const f, const struct FrvTraceRecord* const r)
+{
+	if (f->hart != UINT64_MAX && r->hart != f->hart) return false;
+	if (r->pc < f->pclo || r->pc >= f->pchi) return false;
+	if (f->traps && !(r->flags & FRV_TRACE_TRAP)) return false;
+	if (f->addr && (!(r->flags & FRV_TRACE_MEM) || (r->flags & FRV_TRACE_TRAP) ||
+			r->addr < f->addrlo || r->addr >= f->addrhi))
+		return false;
+	if (f->reg >= 0) {
+		const uint8_t kind = (f->reg < 32) ? FRV_TRACE_XREG : FRV_TRACE_FREG;
+		if (!(r->flags & kind) || (r->flags & FRV_TRACE_TRAP) || r->rd != (f->reg & 31)) return false;
+	}
+	return true;
+}
+
+static void frvTracePrint(const struct FrvTraceRecord* const r, FILE* out)
+{
+	fprintf(out, "%u %016lx %08x%c", r->hart, r->pc, r->raw, (r->len == 2) ? 'c' : ' ');
+	if (r->flags & FRV_TRACE_TRAP) {
+		fprintf(out, " trap\n");
+		return;
+	}
+	if (r->flags & (FRV_TRACE_XREG | FRV_TRACE_FREG))
+		fprintf(out, " %c%u=%016lx", (r->flags & FRV_TRACE_FREG) ? 'f' : 'x', r->rd, r->val);
+	if (r->flags & FRV_TRACE_MEM) fprintf(out, " [%016lx]", r->addr);
+	fputc('\n', out);
+}
+
+int main(int argc, char** argv)
+{
+	struct FrvTraceFilter f = {
+		.hart = UINT64_MAX, .pclo = 0, .pchi = UINT64_MAX, .reg = -1, .count = UINT64_MAX
+	};
+	bool summary = false;
+	const char* path = NULL;
+	for (int i = 1; i < argc; i++) {
+		bool ok = true;
+		if (!strcmp(argv[i], "--hart") && i + 1 < argc) {
+			f.hart = strtoull(argv[++i], NULL, 0);
+		} else if (!strcmp(argv[i], "--pc") && i + 1 < argc) {
+			ok = frvTraceParseRange(argv[++i], &f.pclo, &f.pchi);
+		} else if (!strcmp(argv[i], "--addr") && i + 1 < argc) {
+			ok = f.addr = frvTraceParseRange(argv[++i], &f.addrlo, &f.addrhi);
+		} else if (!strcmp(argv[i], "--reg") && i + 1 < argc) {
+			ok = (f.reg = frvTraceParseReg(argv[++i])) >= 0;
+		} else if (!strcmp(argv[i], "--traps")) {
+			f.traps = true;
+		} else if (!strcmp(argv[i], "--skip") && i + 1 < argc) {
+			f.skip = strtoull(argv[++i], NULL, 0);
+		} else if (!strcmp(argv[i], "--count") && i + 1 < argc) {
+			f.count = strtoull(argv[++i], NULL, 0);
+		} else if (!strcmp(argv[i], "--summary")) {
+			summary = true;
+		} else if (argv[i][0] != '-' && !path) {
+			path = argv[i];
+		} else {
+			ok = false;
+		}
+		if (!ok) {
+			frvTraceUsage(argv[0]);
+			return -1;
+		}
+	}
+	if (!path) {
+		frvTraceUsage(argv[0]);
+		return -1;
+	}
+
+	FILE* in = fopen(path, "rb");
+	if (!in) {
+		fprintf(stderr, "Failed to open %s: %s\n", path, strerror(errno));
+		return -1;
+	}
+	struct FrvTraceHeader header;
+	if (fread(&header, sizeof(header), 1, in) != 1 || memcmp(header.magic, FRV_TRACE_MAGIC, sizeof(header.magic)) ||
+	    header.version != FRV_TRACE_VERSION || header.recsize != sizeof(struct FrvTraceRecord) || !header.nharts) {
+		fprintf(stderr, "%s is not a trace of this frv version\n", path);
+		fclose(in);
+		return -1;
+	}
+	// A run that was killed can leave half a record at the end
+	const long start = ftell(in);
+	if (!fseek(in, 0, SEEK_END) && (ftell(in) - start) % sizeof(struct FrvTraceRecord))
+		fprintf(stderr, "%s ends inside a record, it is left out\n", path);
+	fseek(in, start, SEEK_SET);
+	struct FrvTraceRecord* recs = malloc(FRV_TRACE_READ * sizeof(struct FrvTraceRecord));
+	struct FrvTraceTotals* totals = calloc(header.nharts, sizeof(struct FrvTraceTotals));
+	if (!recs || !totals) {
+		fprintf(stderr, "Failed to allocate the read buffer: %s\n", strerror(errno));
+		fclose(in);
+		return -1;
+	}
+
+	// The output is a pipe most of the time, a big buffer keeps the writes few
+	setvbuf(stdout, NULL, _IOFBF, 1 << 20);
+	uint64_t matched = 0, shown = 0;
+	size_t n;
+	while (shown < f.count && (n = fread(recs, sizeof(struct FrvTraceRecord), FRV_TRACE_READ, in))) {
+		for (size_t i = 0; i < n && shown < f.count; i++) {
+			const struct FrvTraceRecord* r = &recs[i];
+			if (!frvTraceMatch(&f, r) || matched++ < f.skip) continue;
+			shown++;
+			if (!summary) {
+				frvTracePrint(r, stdout);
+				continue;
+			}
+			if (r->hart >= header.nharts) continue;
+			struct FrvTraceTotals* t = &totals[r->hart];
+			t->records++;
+			t->traps += !!(r->flags & FRV_TRACE_TRAP);
+			t->mem += (r->flags & (FRV_TRACE_MEM | FRV_TRACE_TRAP)) == FRV_TRACE_MEM;
+			t->compressed += (r->len == 2);
+		}
+	}
+	if (ferror(in)) fprintf(stderr, "Failed to read %s: %s\n", path, strerror(errno));
+	for (uint64_t i = 0; summary && i < header.nharts; i++)
+		printf("hart %lu: %lu instructions, %lu memory accesses, %lu compressed, %lu traps\n", i,
+		       totals[i].records, totals[i].mem, totals[i].compressed, totals[i].traps);
+
+	free(recs);
+	free(totals);
+	fclose(in);
+	return 0;
+}